@@ -0,0 +1,372 @@
+/*
+ * Checks of the L2CAP bulk transfer framing (main/coc_proto.c): requests go
+ * in through coc_proto_request() and frames come out of coc_proto_next(),
+ * the way main/coc.c drives them, with in-memory streams standing in for
+ * history and the logs.  Exits non-zero and names the check if any fails.
+ *
+ * Usage:
+ *   coc_test
+ */
+
+#include "coc_proto.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BIG_SIZE        1000
+#define SHORT_SIZE      10
+#define SHRINK_FROM     500
+#define SHRINK_TO       200
+#define SDU             64      /* a small peer SDU, so a GET takes frames */
+
+static const char *test;        /* the case running, for CHECK */
+static int failures;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            printf("%s: line %d: %s\n", test, __LINE__, #cond);               \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+#define RUN(fn)     (test = #fn, fn())
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Bitwise CRC-32 (zlib), so the check does not rest on tsc_crc32() */
+static uint32_t crc32_ref(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+/* ---- Streams ------------------------------------------------------------ */
+
+static uint8_t big[BIG_SIZE];
+static uint32_t shrink_size;
+
+static size_t copy_from(const uint8_t *src, uint32_t size, uint32_t off,
+                        uint8_t *buf, size_t len)
+{
+    if (off >= size) {
+        return 0;
+    }
+    if (len > size - off) {
+        len = size - off;
+    }
+    memcpy(buf, &src[off], len);
+    return len;
+}
+
+static uint32_t big_size(void)
+{
+    return BIG_SIZE;
+}
+
+static size_t big_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    return copy_from(big, BIG_SIZE, off, buf, len);
+}
+
+static uint32_t short_size(void)
+{
+    return SHORT_SIZE;
+}
+
+static size_t short_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    return copy_from(big, SHORT_SIZE, off, buf, len);
+}
+
+/* Reports SHRINK_FROM bytes when the GET starts, then loses all but the
+ * first SHRINK_TO once reading begins, like a ring that wrapped. */
+static uint32_t shrink_size_get(void)
+{
+    return shrink_size;
+}
+
+static size_t shrink_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    shrink_size = SHRINK_TO;
+    return copy_from(big, shrink_size, off, buf, len);
+}
+
+static const struct coc_stream streams[] = {
+    { "big",    big_size,        big_read },
+    { "short",  short_size,      short_read },
+    { "shrink", shrink_size_get, shrink_read },
+};
+
+static const struct coc_link link = { .itvl = 12, .tx_phy = 2, .rx_phy = 1 };
+
+/* ---- Client side -------------------------------------------------------- */
+
+static size_t get_req(uint8_t *req, uint32_t off, uint32_t length,
+                      const char *name)
+{
+    size_t n = strlen(name);
+
+    req[0] = COC_OP_GET;
+    for (int i = 0; i < 4; i++) {
+        req[1 + i] = off >> (8 * i);
+        req[5 + i] = length >> (8 * i);
+    }
+    memcpy(&req[9], name, n);
+    return 9 + n;
+}
+
+/* What a GET delivered: the DATA payload and the END frame */
+struct transfer {
+    uint8_t data[BIG_SIZE];
+    uint32_t len;
+    unsigned frames;
+    uint8_t end[COC_END_LEN];
+};
+
+/* Pull frames until END (or max_frames DATA frames, if non-zero) */
+static void pull(struct coc_session *s, struct transfer *t,
+                 unsigned max_frames, uint32_t now_ms)
+{
+    uint8_t buf[SDU];
+    size_t n;
+
+    while ((n = coc_proto_next(s, buf, sizeof(buf), now_ms, &link)) != 0) {
+        if (buf[0] == COC_OP_END) {
+            CHECK(n == COC_END_LEN);
+            memcpy(t->end, buf, COC_END_LEN);
+            CHECK(!coc_proto_busy(s));
+            return;
+        }
+        CHECK(buf[0] == COC_OP_DATA);
+        CHECK(buf[1] == (uint8_t)t->frames);
+        CHECK(n > COC_DATA_HDR_LEN && t->len + n - COC_DATA_HDR_LEN <=
+                                          sizeof(t->data));
+        memcpy(&t->data[t->len], &buf[COC_DATA_HDR_LEN],
+               n - COC_DATA_HDR_LEN);
+        t->len += n - COC_DATA_HDR_LEN;
+        if (++t->frames == max_frames) {
+            return;
+        }
+    }
+}
+
+static size_t request(struct coc_session *s, const uint8_t *req, size_t len,
+                      uint8_t *rsp)
+{
+    struct coc_link_req lr;
+
+    return coc_proto_request(s, req, len, 100, rsp, 256, &lr);
+}
+
+static void check_end(const struct transfer *t, uint8_t status,
+                      uint32_t bytes, const uint8_t *expect)
+{
+    CHECK(t->end[0] == COC_OP_END);
+    CHECK(t->end[1] == status);
+    CHECK(get_le32(&t->end[2]) == bytes);
+    CHECK(t->len == bytes);
+    CHECK(memcmp(t->data, expect, bytes) == 0);
+    CHECK(get_le32(&t->end[6]) == crc32_ref(expect, bytes));
+    CHECK(t->end[14] == link.itvl && t->end[15] == 0);
+    CHECK(t->end[16] == link.tx_phy && t->end[17] == link.rx_phy);
+}
+
+/* ---- Cases -------------------------------------------------------------- */
+
+static void test_list(void)
+{
+    struct coc_session s;
+    uint8_t req[] = { COC_OP_LIST };
+    uint8_t rsp[256];
+    size_t n;
+
+    coc_proto_init(&s, streams, 3);
+    shrink_size = SHRINK_FROM;
+    n = request(&s, req, sizeof(req), rsp);
+    CHECK(n == 2 + (1 + 3 + 4) + (1 + 5 + 4) + (1 + 6 + 4));
+    CHECK(rsp[0] == COC_OP_STREAMS && rsp[1] == 3);
+    CHECK(rsp[2] == 3 && memcmp(&rsp[3], "big", 3) == 0);
+    CHECK(get_le32(&rsp[6]) == BIG_SIZE);
+    CHECK(rsp[10] == 5 && memcmp(&rsp[11], "short", 5) == 0);
+    CHECK(get_le32(&rsp[16]) == SHORT_SIZE);
+    CHECK(rsp[20] == 6 && get_le32(&rsp[27]) == SHRINK_FROM);
+
+    /* A reply buffer too small for every stream lists those that fit */
+    n = coc_proto_request(&s, req, sizeof(req), 0, rsp, 20, NULL);
+    CHECK(n == 2 + 8 + 10 && rsp[1] == 2);
+}
+
+static void test_get(void)
+{
+    struct coc_session s;
+    struct transfer t = { 0 };
+    uint8_t req[32], rsp[256];
+    size_t n;
+
+    coc_proto_init(&s, streams, 3);
+    n = get_req(req, 0, 0xffffffff, "big");
+    n = request(&s, req, n, rsp);
+    CHECK(n == COC_BEGIN_LEN && rsp[0] == COC_OP_BEGIN);
+    CHECK(rsp[1] == COC_STATUS_OK && get_le32(&rsp[2]) == BIG_SIZE);
+    CHECK(coc_proto_busy(&s));
+
+    pull(&s, &t, 0, 350);
+    CHECK(t.frames == (BIG_SIZE + SDU - COC_DATA_HDR_LEN - 1) /
+                          (SDU - COC_DATA_HDR_LEN));
+    check_end(&t, COC_STATUS_OK, BIG_SIZE, big);
+    CHECK(get_le32(&t.end[10]) == 250);
+    CHECK(coc_proto_next(&s, rsp, SDU, 400, &link) == 0);
+}
+
+static void test_get_range(void)
+{
+    struct coc_session s;
+    struct transfer t = { 0 }, t2 = { 0 };
+    uint8_t req[32], rsp[256];
+    size_t n;
+
+    /* Offset and length inside the stream */
+    coc_proto_init(&s, streams, 3);
+    request(&s, req, get_req(req, 100, 300, "big"), rsp);
+    CHECK(rsp[1] == COC_STATUS_OK && get_le32(&rsp[2]) == 300);
+    pull(&s, &t, 0, 100);
+    check_end(&t, COC_STATUS_OK, 300, &big[100]);
+
+    /* Past the end: an empty transfer, END straight away */
+    n = request(&s, req, get_req(req, BIG_SIZE + 5, 10, "big"), rsp);
+    CHECK(n == COC_BEGIN_LEN);
+    CHECK(rsp[1] == COC_STATUS_OK && get_le32(&rsp[2]) == 0);
+    pull(&s, &t2, 0, 100);
+    CHECK(t2.frames == 0);
+    check_end(&t2, COC_STATUS_OK, 0, big);
+}
+
+static void test_short(void)
+{
+    struct coc_session s;
+    struct transfer t = { 0 }, t2 = { 0 };
+    uint8_t req[32], rsp[256];
+
+    /* The whole stream fits in one DATA frame */
+    coc_proto_init(&s, streams, 3);
+    request(&s, req, get_req(req, 0, 0xffffffff, "short"), rsp);
+    CHECK(rsp[1] == COC_STATUS_OK && get_le32(&rsp[2]) == SHORT_SIZE);
+    pull(&s, &t, 0, 100);
+    CHECK(t.frames == 1);
+    check_end(&t, COC_STATUS_OK, SHORT_SIZE, big);
+
+    /* A length beyond the end is cut to the stream */
+    request(&s, req, get_req(req, 4, 1000, "short"), rsp);
+    CHECK(get_le32(&rsp[2]) == SHORT_SIZE - 4);
+    pull(&s, &t2, 0, 100);
+    check_end(&t2, COC_STATUS_OK, SHORT_SIZE - 4, &big[4]);
+}
+
+static void test_shrink(void)
+{
+    struct coc_session s;
+    struct transfer t = { 0 };
+    uint8_t req[32], rsp[256];
+
+    /* END counts fewer bytes than BEGIN, and its CRC covers those sent */
+    coc_proto_init(&s, streams, 3);
+    shrink_size = SHRINK_FROM;
+    request(&s, req, get_req(req, 0, 0xffffffff, "shrink"), rsp);
+    CHECK(rsp[1] == COC_STATUS_OK && get_le32(&rsp[2]) == SHRINK_FROM);
+    pull(&s, &t, 0, 100);
+    check_end(&t, COC_STATUS_OK, SHRINK_TO, big);
+}
+
+static void test_abort(void)
+{
+    struct coc_session s;
+    struct transfer t = { 0 }, t2 = { 0 };
+    uint8_t req[32], rsp[256];
+    uint8_t abort_req[] = { COC_OP_ABORT };
+    size_t n;
+
+    /* Idle: a RSP, nothing else */
+    coc_proto_init(&s, streams, 3);
+    n = request(&s, abort_req, sizeof(abort_req), rsp);
+    CHECK(n == COC_RSP_LEN && rsp[0] == COC_OP_RSP);
+    CHECK(rsp[1] == COC_OP_ABORT && rsp[2] == COC_STATUS_OK);
+
+    /* Running: END is the reply, with the bytes sent so far */
+    request(&s, req, get_req(req, 0, 0xffffffff, "big"), rsp);
+    pull(&s, &t, 3, 100);
+    CHECK(t.frames == 3 && coc_proto_busy(&s));
+    CHECK(request(&s, abort_req, sizeof(abort_req), rsp) == 0);
+    pull(&s, &t, 0, 100);
+    check_end(&t, COC_STATUS_ABORTED, 3 * (SDU - COC_DATA_HDR_LEN), big);
+
+    /* The next GET starts afresh */
+    request(&s, req, get_req(req, 0, 0xffffffff, "short"), rsp);
+    CHECK(rsp[1] == COC_STATUS_OK);
+    pull(&s, &t2, 0, 100);
+    check_end(&t2, COC_STATUS_OK, SHORT_SIZE, big);
+}
+
+static void test_errors(void)
+{
+    struct coc_session s;
+    struct coc_link_req lr = { 0 };
+    uint8_t req[32], rsp[256];
+    uint8_t link_req[] = { COC_OP_LINK, 24, 0, 2 };
+    uint8_t bad_op[] = { 0x7f };
+    size_t n;
+
+    coc_proto_init(&s, streams, 3);
+    request(&s, req, get_req(req, 0, 1, "none"), rsp);
+    CHECK(rsp[0] == COC_OP_BEGIN && rsp[1] == COC_STATUS_UNKNOWN_STREAM);
+    request(&s, req, get_req(req, 0, 1, ""), rsp);
+    CHECK(rsp[1] == COC_STATUS_BAD_REQUEST);
+    CHECK(!coc_proto_busy(&s));
+
+    /* Only one GET at a time */
+    request(&s, req, get_req(req, 0, 0xffffffff, "big"), rsp);
+    request(&s, req, get_req(req, 0, 0xffffffff, "short"), rsp);
+    CHECK(rsp[1] == COC_STATUS_BUSY);
+    coc_proto_stop(&s, COC_STATUS_FAILED);
+    CHECK(coc_proto_next(&s, rsp, SDU, 100, &link) == COC_END_LEN);
+    CHECK(rsp[1] == COC_STATUS_FAILED && get_le32(&rsp[2]) == 0);
+
+    n = request(&s, bad_op, sizeof(bad_op), rsp);
+    CHECK(n == COC_RSP_LEN && rsp[1] == 0x7f);
+    CHECK(rsp[2] == COC_STATUS_BAD_REQUEST);
+
+    /* LINK is handed back to the caller, or refused if malformed */
+    n = coc_proto_request(&s, link_req, sizeof(link_req), 0, rsp, 256, &lr);
+    CHECK(n == 0 && lr.itvl == 24 && lr.phys == 2);
+    n = request(&s, link_req, sizeof(link_req) - 1, rsp);
+    CHECK(n == COC_RSP_LEN && rsp[2] == COC_STATUS_BAD_REQUEST);
+    CHECK(request(&s, req, 0, rsp) == 0);
+}
+
+int main(void)
+{
+    for (int i = 0; i < BIG_SIZE; i++) {
+        big[i] = (uint8_t)(i * 7 + i / 256);
+    }
+
+    RUN(test_list);
+    RUN(test_get);
+    RUN(test_get_range);
+    RUN(test_short);
+    RUN(test_shrink);
+    RUN(test_abort);
+    RUN(test_errors);
+
+    printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+    return failures != 0;
+}
@@ -0,0 +1,157 @@
+#include "ota_file_backend.h"
+#include "sha256.h"
+
+#include <string.h>
+
+/* ---- Flash emulation ---------------------------------------------------- */
+
+static int erase_sector(struct ota_file_ctx *c, uint32_t sector)
+{
+    uint8_t ff[OTA_SECTOR_SIZE];
+
+    memset(ff, 0xff, sizeof(ff));
+    if (fseek(c->f, (long)sector * OTA_SECTOR_SIZE, SEEK_SET) != 0 ||
+        fwrite(ff, 1, sizeof(ff), c->f) != sizeof(ff)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Backend operations ------------------------------------------------- */
+
+static int file_begin(void *ctx, uint32_t image_size, uint32_t resume_offset)
+{
+    struct ota_file_ctx *c = ctx;
+
+    if (c->f == NULL) {
+        /* Keep existing contents (a resume needs them), create if absent */
+        c->f = fopen(c->part_path, "r+b");
+        if (c->f == NULL) {
+            c->f = fopen(c->part_path, "w+b");
+        }
+        if (c->f == NULL) {
+            return -1;
+        }
+    }
+    c->activated = false;
+    return image_size <= c->part_size && resume_offset <= image_size ? 0 : -1;
+}
+
+static int file_write(void *ctx, uint32_t offset, const uint8_t *data,
+                    size_t len)
+{
+    struct ota_file_ctx *c = ctx;
+    uint8_t old[OTA_SECTOR_SIZE];
+    uint32_t first = offset / OTA_SECTOR_SIZE;
+    uint32_t last = (offset + len - 1) / OTA_SECTOR_SIZE;
+
+    /* Same erase rule as esp_ota_write() with sequential writes */
+    for (uint32_t s = offset % OTA_SECTOR_SIZE == 0 ? first : first + 1;
+         s <= last; s++) {
+        if (erase_sector(c, s) != 0) {
+            return -1;
+        }
+    }
+
+    for (size_t done = 0; done < len; ) {
+        size_t n = len - done < sizeof(old) ? len - done : sizeof(old);
+        if (fseek(c->f, (long)(offset + done), SEEK_SET) != 0) {
+            return -1;
+        }
+        size_t got = fread(old, 1, n, c->f);
+        for (size_t i = 0; i < n; i++) {
+            if (i >= got || old[i] != 0xff) {
+                c->unerased_writes++;
+                break;
+            }
+        }
+        if (fseek(c->f, (long)(offset + done), SEEK_SET) != 0 ||
+            fwrite(data + done, 1, n, c->f) != n) {
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+static int file_verify(void *ctx, uint32_t image_size,
+                     const uint8_t sha256[OTA_SHA256_LEN])
+{
+    struct ota_file_ctx *c = ctx;
+    struct sha256_ctx sha;
+    uint8_t buf[OTA_SECTOR_SIZE];
+    uint8_t digest[OTA_SHA256_LEN];
+
+    fflush(c->f);
+    if (fseek(c->f, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+    sha256_init(&sha);
+    for (uint32_t off = 0; off < image_size; ) {
+        size_t n = image_size - off < sizeof(buf) ? image_size - off
+                                                  : sizeof(buf);
+        if (fread(buf, 1, n, c->f) != n) {
+            return -1;
+        }
+        sha256_update(&sha, buf, n);
+        off += n;
+    }
+    sha256_final(&sha, digest);
+    return memcmp(digest, sha256, OTA_SHA256_LEN) == 0 ? 0 : -1;
+}
+
+static int file_activate(void *ctx)
+{
+    struct ota_file_ctx *c = ctx;
+    c->activated = true;
+    return 0;
+}
+
+static void file_abort(void *ctx)
+{
+}
+
+static int file_save_progress(void *ctx, const struct ota_progress *p)
+{
+    struct ota_file_ctx *c = ctx;
+    FILE *f = fopen(c->progress_path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    size_t n = fwrite(p, sizeof(*p), 1, f);
+    fclose(f);
+    return n == 1 ? 0 : -1;
+}
+
+static int file_load_progress(void *ctx, struct ota_progress *p)
+{
+    struct ota_file_ctx *c = ctx;
+    FILE *f = fopen(c->progress_path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    size_t n = fread(p, sizeof(*p), 1, f);
+    fclose(f);
+    return n == 1 ? 0 : -1;
+}
+
+static void file_clear_progress(void *ctx)
+{
+    struct ota_file_ctx *c = ctx;
+    remove(c->progress_path);
+}
+
+void ota_file_backend_init(struct ota_backend *be, struct ota_file_ctx *ctx)
+{
+    memset(be, 0, sizeof(*be));
+    be->max_size = ctx->part_size;
+    be->begin = file_begin;
+    be->write = file_write;
+    be->verify = file_verify;
+    be->activate = file_activate;
+    be->abort = file_abort;
+    be->save_progress = file_save_progress;
+    be->load_progress = file_load_progress;
+    be->clear_progress = file_clear_progress;
+    be->ctx = ctx;
+}
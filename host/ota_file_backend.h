@@ -0,0 +1,29 @@
+#ifndef OTA_FILE_BACKEND_H
+#define OTA_FILE_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ota_proto.h"
+
+/*
+ * File-backed stand-in for the inactive OTA slot.  Writes follow NOR flash
+ * rules the way esp_ota does with OTA_WITH_SEQUENTIAL_WRITES: a sector is
+ * erased when a write starts on or crosses into it, and writing over bytes
+ * that were not erased is counted as an error.  Progress goes to a sidecar
+ * file in place of NVS.
+ */
+
+struct ota_file_ctx {
+    const char *part_path;
+    const char *progress_path;
+    uint32_t part_size;
+    FILE *f;
+    unsigned unerased_writes;   /* writes that would corrupt real flash */
+    bool activated;
+};
+
+void ota_file_backend_init(struct ota_backend *be, struct ota_file_ctx *ctx);
+
+#endif /* OTA_FILE_BACKEND_H */
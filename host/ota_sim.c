@@ -0,0 +1,340 @@
+/*
+ * Drive the OTA protocol (main/ota_proto.c) against a file-backed partition
+ * with dropped chunks, disconnects and reboots, the same way
+ * tools/ota_update.py drives it over BLE.  Exits non-zero if the image that
+ * lands in the partition differs from the input or would have required
+ * writing to unerased flash.  With --intruder a second central tries to
+ * abort the transfer after every reply; it must be refused until the
+ * owner's link drops.
+ *
+ * Usage:
+ *   ota_sim IMAGE [--chunk N] [--window N] [--drop-every N]
+ *                 [--disconnect-every BYTES] [--reboot-every BYTES]
+ *                 [--part FILE] [--corrupt] [--intruder]
+ */
+
+#include "ota_file_backend.h"
+#include "ota_proto.h"
+#include "sha256.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PART_SIZE   0x1e0000    /* matches ota_0/ota_1 in partitions.csv */
+#define CONN_OWNER      0       /* connection handles of the two centrals */
+#define CONN_INTRUDER   1
+
+struct sim_opts {
+    uint32_t chunk;
+    uint16_t window;
+    unsigned drop_every;
+    uint32_t disconnect_every;
+    uint32_t reboot_every;
+    const char *part_path;
+    int corrupt;
+    int intruder;
+};
+
+struct sim_stats {
+    unsigned chunks_sent;
+    unsigned chunks_dropped;
+    unsigned naks;
+    unsigned timeouts;
+    unsigned resumes;
+    unsigned refused;           /* intruder writes the glue turned away */
+    unsigned intrusions;        /* ... it let through: must stay 0 */
+    uint64_t bytes_sent;
+};
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ---- Host side of the protocol ------------------------------------------ */
+
+static int send_control(struct ota_session *s, uint16_t conn,
+                        const uint8_t *req, size_t len, uint32_t *offset)
+{
+    uint8_t rsp[OTA_RSP_MAX_LEN];
+    size_t rsp_len;
+
+    ota_proto_control(s, conn, req, len, rsp, &rsp_len);
+    *offset = get_u32(&rsp[3]);
+    return rsp[2];
+}
+
+static int send_begin(struct ota_session *s, uint32_t size,
+                      const uint8_t sha[32], uint16_t window,
+                      uint32_t *offset)
+{
+    uint8_t req[1 + 4 + 32 + 2];
+
+    req[0] = OTA_OP_BEGIN;
+    put_u32(&req[1], size);
+    memcpy(&req[5], sha, 32);
+    req[37] = window;
+    req[38] = window >> 8;
+    return send_control(s, CONN_OWNER, req, sizeof(req), offset);
+}
+
+/* The second central sends ABORT.  ota_svc.c hands a write to the protocol
+ * only if ota_proto_allowed() says so; otherwise it fails at the ATT layer. */
+static void intrude(struct ota_session *s, struct sim_stats *st)
+{
+    uint8_t req = OTA_OP_ABORT;
+    uint32_t offset;
+
+    if (!ota_proto_allowed(s, CONN_INTRUDER)) {
+        st->refused++;
+        return;
+    }
+    st->intrusions++;
+    send_control(s, CONN_INTRUDER, &req, 1, &offset);
+}
+
+static int transfer(const struct sim_opts *o, struct ota_session *s,
+                    struct ota_backend *be, struct ota_file_ctx *fctx,
+                    const uint8_t *image, uint32_t size,
+                    const uint8_t sha[32], struct sim_stats *st)
+{
+    uint8_t chunk[OTA_DATA_HDR_LEN + 4096];
+    uint8_t rsp[OTA_RSP_MAX_LEN];
+    size_t rsp_len;
+    uint32_t acked, sent;
+    uint32_t next_disconnect = o->disconnect_every;
+    uint32_t next_reboot = o->reboot_every;
+    int status;
+
+    status = send_begin(s, size, sha, o->window, &acked);
+    if (status != OTA_STATUS_OK) {
+        fprintf(stderr, "BEGIN failed: %d\n", status);
+        return -1;
+    }
+    sent = acked;
+
+    while (acked < size) {
+        bool got_reply = false;
+
+        /* Fill the window, stopping at the first notification */
+        while (!got_reply && sent < size &&
+               sent - acked < (uint32_t)o->window * o->chunk) {
+            uint32_t n = size - sent < o->chunk ? size - sent : o->chunk;
+            put_u32(chunk, sent);
+            memcpy(&chunk[OTA_DATA_HDR_LEN], image + sent, n);
+            sent += n;
+            st->chunks_sent++;
+            st->bytes_sent += n;
+
+            if (o->drop_every && st->chunks_sent % o->drop_every == 0) {
+                st->chunks_dropped++;
+                continue;
+            }
+            ota_proto_data(s, chunk, OTA_DATA_HDR_LEN + n, rsp, &rsp_len);
+            if (rsp_len == 0) {
+                continue;
+            }
+            got_reply = true;
+            if (o->intruder) {
+                intrude(s, st);
+            }
+            switch (rsp[0]) {
+            case OTA_OP_ACK:
+                acked = get_u32(&rsp[1]);
+                break;
+            case OTA_OP_NAK:
+                st->naks++;
+                acked = get_u32(&rsp[1]);
+                sent = acked;   /* rewind; later in-flight chunks are ignored */
+                break;
+            default:
+                fprintf(stderr, "data error: status %u at %lu\n", rsp[2],
+                        (unsigned long)get_u32(&rsp[3]));
+                return -1;
+            }
+        }
+
+        if (!got_reply && sent - acked > 0) {
+            /* Window full and nothing came back: time out, ask for status */
+            uint8_t req = OTA_OP_STATUS;
+            st->timeouts++;
+            if (send_control(s, CONN_OWNER, &req, 1,
+                             &acked) != OTA_STATUS_OK) {
+                return -1;
+            }
+            sent = acked;
+        }
+
+        if (next_reboot && acked >= next_reboot) {
+            /* Power loss: no disconnect hook, RAM session gone */
+            next_reboot += o->reboot_every;
+            fclose(fctx->f);
+            fctx->f = NULL;
+            ota_proto_init(s, be);
+            st->resumes++;
+            if (send_begin(s, size, sha, o->window, &acked) != OTA_STATUS_OK) {
+                return -1;
+            }
+            sent = acked;
+        } else if (next_disconnect && acked >= next_disconnect) {
+            next_disconnect += o->disconnect_every;
+            ota_proto_disconnect(s);
+            if (!ota_proto_allowed(s, CONN_INTRUDER)) {
+                fprintf(stderr, "session still owned after disconnect\n");
+                return -1;
+            }
+            st->resumes++;
+            if (send_begin(s, size, sha, o->window, &acked) != OTA_STATUS_OK) {
+                return -1;
+            }
+            sent = acked;
+        }
+    }
+
+    uint8_t req = OTA_OP_FINISH;
+    status = send_control(s, CONN_OWNER, &req, 1, &acked);
+    if (status != OTA_STATUS_OK) {
+        fprintf(stderr, "FINISH failed: %d\n", status);
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Main --------------------------------------------------------------- */
+
+static uint8_t *read_file(const char *path, uint32_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(n > 0 ? n : 1);
+    if (buf == NULL || fread(buf, 1, n, f) != (size_t)n) {
+        fclose(f);
+        free(buf);
+        return NULL;
+    }
+    fclose(f);
+    *size = n;
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    struct sim_opts o = {
+        .chunk = 240,
+        .window = 16,
+        .part_path = "ota_sim_part.bin",
+    };
+    static const struct option longopts[] = {
+        { "chunk", required_argument, NULL, 'c' },
+        { "window", required_argument, NULL, 'w' },
+        { "drop-every", required_argument, NULL, 'd' },
+        { "disconnect-every", required_argument, NULL, 'D' },
+        { "reboot-every", required_argument, NULL, 'r' },
+        { "part", required_argument, NULL, 'p' },
+        { "corrupt", no_argument, NULL, 'x' },
+        { "intruder", no_argument, NULL, 'i' },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'c': o.chunk = strtoul(optarg, NULL, 0); break;
+        case 'w': o.window = strtoul(optarg, NULL, 0); break;
+        case 'd': o.drop_every = strtoul(optarg, NULL, 0); break;
+        case 'D': o.disconnect_every = strtoul(optarg, NULL, 0); break;
+        case 'r': o.reboot_every = strtoul(optarg, NULL, 0); break;
+        case 'p': o.part_path = optarg; break;
+        case 'x': o.corrupt = 1; break;
+        case 'i': o.intruder = 1; break;
+        default: return 2;
+        }
+    }
+    if (optind >= argc || o.chunk == 0 || o.chunk > 4096 || o.window == 0) {
+        fprintf(stderr, "usage: %s IMAGE [--chunk N] [--window N] "
+                "[--drop-every N] [--disconnect-every BYTES] "
+                "[--reboot-every BYTES] [--part FILE] [--corrupt] "
+                "[--intruder]\n", argv[0]);
+        return 2;
+    }
+
+    uint32_t size;
+    uint8_t *image = read_file(argv[optind], &size);
+    if (image == NULL) {
+        return 1;
+    }
+
+    uint8_t sha[32];
+    struct sha256_ctx c;
+    sha256_init(&c);
+    sha256_update(&c, image, size);
+    sha256_final(&c, sha);
+    if (o.corrupt) {
+        sha[0] ^= 0xff;     /* FINISH must fail and not activate */
+    }
+
+    char progress_path[512];
+    snprintf(progress_path, sizeof(progress_path), "%s.progress", o.part_path);
+    remove(progress_path);
+    remove(o.part_path);
+
+    struct ota_file_ctx fctx = {
+        .part_path = o.part_path,
+        .progress_path = progress_path,
+        .part_size = PART_SIZE,
+    };
+    struct ota_backend be;
+    struct ota_session s;
+    struct sim_stats st = {0};
+
+    ota_file_backend_init(&be, &fctx);
+    ota_proto_init(&s, &be);
+
+    int rc = transfer(&o, &s, &be, &fctx, image, size, sha, &st);
+
+    printf("image %lu bytes, chunk %lu, window %u\n", (unsigned long)size,
+           (unsigned long)o.chunk, o.window);
+    printf("chunks sent %u (dropped %u), NAKs %u, timeouts %u, resumes %u\n",
+           st.chunks_sent, st.chunks_dropped, st.naks, st.timeouts,
+           st.resumes);
+    printf("overhead %.1f%% resent, unerased writes %u, activated %s\n",
+           size ? (st.bytes_sent - size) * 100.0 / size : 0.0,
+           fctx.unerased_writes, fctx.activated ? "yes" : "no");
+    if (o.intruder) {
+        printf("intruder writes refused %u, let through %u\n", st.refused,
+               st.intrusions);
+    }
+
+    if (o.corrupt) {
+        rc = (rc != 0 && !fctx.activated) ? 0 : 1;
+        printf("%s: corrupted hash %s\n", rc == 0 ? "PASS" : "FAIL",
+               rc == 0 ? "rejected" : "accepted");
+    } else {
+        if (rc == 0 && fctx.unerased_writes != 0) {
+            rc = 1;
+        }
+        if (o.intruder && (st.intrusions != 0 || st.refused == 0)) {
+            rc = 1;
+        }
+        printf("%s\n", rc == 0 ? "PASS" : "FAIL");
+    }
+
+    if (fctx.f) {
+        fclose(fctx.f);
+    }
+    free(image);
+    return rc == 0 ? 0 : 1;
+}
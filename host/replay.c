@@ -0,0 +1,753 @@
+/*
+ * Replay an input trace (main/record.h) or a battery_life.py log through the
+ * firmware's button, display rendering, history, rules and power-counter
+ * code, on a simulated clock and as fast as the host runs it.
+ *
+ * Usage:
+ *   replay LOG [--fb DIR] [--centrals N] [--quiet]
+ *
+ * LOG is any text holding "#T:" lines, such as an idf.py monitor capture of
+ * `trace dump`, or a battery_log.csv.  A CSV has no raw readouts, button or
+ * GATT records, only the samples it logged.
+ *
+ * The firmware's own sources do the work, built against host/shim: each
+ * sample goes through sample_process(), each pass of the display loop
+ * through render_loop_step() and render_page(), each write through
+ * settings.c, and the schedule through sched_eval().  What is left here is
+ * what sensor_task.c, display.c, alarm.c, profile.c and gatt_svc.c do with
+ * the results on the device: publishing, events instead of the radio and
+ * the panel.
+ *
+ * Output is one line per event, prefixed with the uptime in seconds, so two
+ * runs can be diffed: samples, notifications and indications sent, writes,
+ * alarm changes, display on/off and every frame that differs from the one
+ * before (page and hash).  --fb writes those frames as PBM images.  The end
+ * is the `power` console report for the run and the replay speed.
+ */
+
+#define _DEFAULT_SOURCE     /* timegm */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "bme280_comp.h"
+#include "button.h"
+#include "fb.h"
+#include "gatt_chr_table.h"
+#include "history.h"
+#include "powerstat.h"
+#include "render.h"
+#include "sample.h"
+#include "sched.h"
+#include "sdkconfig.h"
+#include "settings.h"
+#include "trace.h"
+
+#define MAX_CONNECTIONS     3       /* CONFIG_BT_NIMBLE_MAX_CONNECTIONS */
+#define BUTTON_OPEN_MV      2888
+
+/* ---- GATT table --------------------------------------------------------- */
+
+#define CHR_UUID(id, uuid, ...) UUID_##id = uuid,
+enum { GATT_CHR_TABLE(CHR_UUID, CHR_UUID) };
+
+#define CHR_NAME(id, uuid, name, ...) { uuid, name },
+static const struct {
+    uint16_t uuid;
+    const char *name;
+} chr_names[] = { GATT_CHR_TABLE(CHR_NAME, CHR_NAME) };
+
+/* sensor_task notifies every RN entry once per sample: the V ones through
+ * gatt_svc_notify_readings(), Derived from the sample result */
+#define CHR_RN_R    0
+#define CHR_RN_RW   0
+#define CHR_RN_RN   1
+#define CHR_RN_RI   0
+#define CHR_RN_WI   0
+#define CHR_COUNT_RN(id, uuid, name, fmt, unit, scale, flags, ...)            \
+    + CHR_RN_##flags
+enum { NOTIFY_CHRS = 0 GATT_CHR_TABLE(CHR_COUNT_RN, CHR_COUNT_RN) };
+
+static const char *chr_name(uint16_t uuid)
+{
+    for (size_t i = 0; i < sizeof(chr_names) / sizeof(chr_names[0]); i++) {
+        if (chr_names[i].uuid == uuid) {
+            return chr_names[i].name;
+        }
+    }
+    return "unknown";
+}
+
+/* ---- Simulated device --------------------------------------------------- */
+
+static int64_t now_us;
+static int64_t clock_base_us;       /* uptime at which UNIX time was... */
+static int64_t clock_base;          /* ...this */
+static int button_mv = BUTTON_OPEN_MV;
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+int button_read_mv(void)
+{
+    return button_mv;
+}
+
+static uint32_t unix_now(void)
+{
+    return (uint32_t)(clock_base + (now_us - clock_base_us) / 1000000);
+}
+
+static void set_clock(int64_t unix_s)
+{
+    clock_base = unix_s;
+    clock_base_us = now_us;
+}
+
+/* What gatt_svc.c and sensor_task.c keep */
+static int8_t tz_quarter_hours;
+static uint8_t display_mode = DISPLAY_MODE_BUTTON;
+static bool sensors_valid;
+static float pressure, temperature, humidity;
+static uint32_t battery_mv;
+static struct derived derived;
+static struct sched_entry schedule[SCHED_MAX];
+static size_t schedule_len;
+static uint8_t schedule_entry = SCHED_NONE;
+static int64_t schedule_due_us = INT64_MAX;
+
+static struct bme280_calib calib;
+static bool have_calib;
+
+/* What display.c keeps */
+static bool display_on;
+static struct render_loop loop;
+static int64_t next_tick_us;
+
+static uint8_t last_frame[FB_PAGES][FB_WIDTH];
+static unsigned frames;
+
+static const char *fb_dir;
+static int centrals = 1;
+static bool quiet;
+
+/* Links and advertising are not in a trace: assume the centrals stay
+ * connected throughout, with advertising on while a slot is free. */
+static void begin(int64_t at)
+{
+    now_us = next_tick_us = at;
+    powerstat_level(POWERSTAT_ADV, centrals < MAX_CONNECTIONS);
+    powerstat_level(POWERSTAT_CONN, centrals);
+}
+
+static void event(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (quiet) {
+        return;
+    }
+    printf("%10.3f ", now_us / 1e6);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    putchar('\n');
+}
+
+static void sent(int n)
+{
+    for (int i = 0; i < n * centrals; i++) {
+        powerstat_count(POWERSTAT_NOTIFY);
+    }
+}
+
+/* ---- Display (display_task, render_display) ----------------------------- */
+
+static uint32_t fnv1a(const void *p, size_t n)
+{
+    const uint8_t *b = p;
+    uint32_t h = 2166136261u;
+
+    while (n--) {
+        h = (h ^ *b++) * 16777619u;
+    }
+    return h;
+}
+
+static void write_pbm(unsigned n)
+{
+    char path[512];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/frame_%05u.pbm", fb_dir, n);
+    f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "P4\n%d %d\n", FB_WIDTH, FB_PAGES * 8);
+    for (int row = 0; row < FB_PAGES * 8; row++) {
+        for (int col = 0; col < FB_WIDTH; col += 8) {
+            uint8_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                if (fb[row / 8][col + i] >> (row % 8) & 1) {
+                    bits |= 0x80 >> i;
+                }
+            }
+            fputc(bits, f);
+        }
+    }
+    fclose(f);
+}
+
+static void fb_flush(void)
+{
+    powerstat_count(POWERSTAT_FLUSH);
+    if (memcmp(fb, last_frame, FB_BYTES) == 0) {
+        return;
+    }
+    memcpy(last_frame, fb, FB_BYTES);
+    frames++;
+    event("frame %u page %d %08x", frames, loop.page,
+          fnv1a(fb, FB_BYTES));
+    if (fb_dir) {
+        write_pbm(frames);
+    }
+}
+
+static void display_set_enabled(bool enabled)
+{
+    if (enabled == display_on) {
+        return;
+    }
+    display_on = enabled;
+    powerstat_level(POWERSTAT_DISPLAY, enabled);
+    event("display %s", enabled ? "on" : "off");
+}
+
+static void render_display(void)
+{
+    time_t local = unix_now() + tz_quarter_hours * 15 * 60;
+    struct render_input in = {
+        .sensors_valid = sensors_valid,
+        .derived = derived,
+        .pressure = pressure,
+        .temperature = temperature,
+        .humidity = humidity,
+        .battery_mv = battery_mv,
+        .rollup_get = history_rollup_get,
+    };
+    gmtime_r(&local, &in.local);
+
+    if (!render_panel_on(display_mode, now_us - button_time)) {
+        fb_clear();
+        fb_flush();
+        display_set_enabled(false);
+        return;
+    }
+    display_set_enabled(true);
+    render_page(loop.page, &in);
+    fb_flush();
+}
+
+static void display_iteration(void)
+{
+    button_poll();
+    if (render_loop_step(&loop, button_time, button_presses, display_on)) {
+        render_display();
+    }
+    next_tick_us = now_us + render_loop_wait_ms(display_on) * 1000LL;
+}
+
+/* ---- Schedule (profile.c) ----------------------------------------------- */
+
+/* The timer callback: find the entry in force and arm for the next switch.
+ * Only the display mode is applied; the profiles change timing, which the
+ * trace already has. */
+static void schedule_eval(bool force)
+{
+    uint32_t next;
+    uint8_t entry = sched_eval(schedule, schedule_len, unix_now(),
+                               tz_quarter_hours, &next);
+
+    schedule_due_us = entry != SCHED_NONE ? now_us + next * 1000000LL
+                                          : INT64_MAX;
+    if (entry == schedule_entry && !force) {
+        return;
+    }
+    schedule_entry = entry;
+    if (entry != SCHED_NONE &&
+        schedule[entry].profile.display_mode != SCHED_KEEP) {
+        display_mode = schedule[entry].profile.display_mode;
+    }
+    event("schedule entry %d, display mode %u",
+          entry == SCHED_NONE ? -1 : entry, display_mode);
+    event("indicate Profile");
+    sent(1);
+}
+
+/* Run the display loop and the schedule timer up to (not including) t */
+static void advance(int64_t t)
+{
+    while (next_tick_us < t || schedule_due_us < t) {
+        if (schedule_due_us <= next_tick_us) {
+            now_us = schedule_due_us;
+            schedule_eval(false);
+        } else {
+            now_us = next_tick_us;
+            display_iteration();
+        }
+    }
+    now_us = t;
+}
+
+/* ---- Samples (sensor_task, alarm_apply()) ------------------------------ */
+
+static void indicate_alarm(const struct rules_status *st)
+{
+    event("indicate Alarm active 0x%02x fired 0x%02x cleared 0x%02x",
+          st->active, st->fired, st->cleared);
+    sent(1);
+}
+
+static void alarm_apply(const struct sample_result *r)
+{
+    const struct rules_status *st = &r->alarm;
+
+    if (st->fired || st->cleared) {
+        event("alarm fired 0x%02x cleared 0x%02x, active 0x%02x",
+              st->fired, st->cleared, st->active);
+    }
+    if (r->fired & RULES_ACT_DISPLAY) {
+        button_time = now_us;
+    }
+    if (r->edge & RULES_ACT_INDICATE) {
+        indicate_alarm(st);
+    }
+}
+
+static void sample(bool ok, float t, float p, float h, uint32_t batt_mv)
+{
+    struct sample s = {
+        .ok = ok,
+        .temperature = t,
+        .pressure = p,
+        .humidity = h,
+        .battery_mv = batt_mv,
+        .uptime_s = (uint32_t)(now_us / 1000000),
+        .time = unix_now(),
+    };
+    struct sample_result r;
+
+    sample_process(&s, &r);
+    if (ok) {
+        temperature = t;
+        pressure = p;
+        humidity = h;
+        sensors_valid = true;
+        powerstat_count(POWERSTAT_SAMPLE);
+    }
+    derived = r.derived;
+    battery_mv = batt_mv;
+    event("sample %s %.2f C %.2f hPa %.1f %% %u mV", ok ? "ok" : "failed",
+          temperature, pressure / 100.0, humidity, battery_mv);
+    alarm_apply(&r);
+    if (centrals) {
+        event("notify dew %d alt %ld tend %d forecast %c",
+              derived.dew_point_c100, (long)derived.altitude_dm,
+              derived.tendency_pa, derived.forecast);
+    }
+    sent(NOTIFY_CHRS);
+}
+
+/* ---- GATT writes -------------------------------------------------------- */
+
+static const char *write_rules(const uint8_t *v, size_t len)
+{
+    struct rule r[RULES_MAX];
+    struct rules_status st = { .time = unix_now() };
+
+    if (len > sizeof(r) || len % sizeof(r[0]) != 0) {
+        return "rejected (length)";
+    }
+    memcpy(r, v, len);
+    if (!rules_validate(r, len / sizeof(r[0]))) {
+        return "rejected (value)";
+    }
+    st.cleared = sample_set_rules(r, len / sizeof(r[0]));
+    if (st.cleared) {
+        indicate_alarm(&st);
+    }
+    return "ok";
+}
+
+static const char *write_schedule(const uint8_t *v, size_t len)
+{
+    static const struct sched_profile max = {
+        DISPLAY_MODE_BLANK, SETTINGS_PROFILES - 1, SETTINGS_PROFILES - 1
+    };
+    struct sched_entry e[SCHED_MAX];
+
+    if (len > sizeof(e) || len % sizeof(e[0]) != 0) {
+        return "rejected (length)";
+    }
+    memcpy(e, v, len);
+    if (!sched_validate(e, len / sizeof(e[0]), &max)) {
+        return "rejected (value)";
+    }
+    memcpy(schedule, e, len);
+    schedule_len = len / sizeof(e[0]);
+    schedule_eval(true);
+    return "ok";
+}
+
+/* The setters of gatt_svc.c.  The profiles only change timing, which the
+ * trace already has, so they are checked but not applied. */
+static void tz_set(int8_t quarter_hours)
+{
+    tz_quarter_hours = quarter_hours;
+}
+
+static void display_mode_set(uint8_t mode)
+{
+    display_mode = mode;
+}
+
+static void sea_level_set(uint32_t pa)
+{
+    sample_set_sea_level(pa);
+    sample_get_derived(&derived);
+}
+
+static void schedule_update(void)
+{
+    schedule_eval(false);
+}
+
+static const struct settings_ops settings = {
+    .time = set_clock,
+    .tz = tz_set,
+    .display_mode = display_mode_set,
+    .sea_level = sea_level_set,
+    .schedule = schedule_update,
+};
+
+static const char *write_setting(uint8_t type, const uint8_t *v, size_t len)
+{
+    switch (settings_write(&settings, type, v, len)) {
+    case CTRL_ST_OK:
+        return "ok";
+    case CTRL_ST_BAD_LEN:
+        return "rejected (length)";
+    default:
+        return "rejected (value)";
+    }
+}
+
+static const char *write_control(const uint8_t *v, size_t len)
+{
+    static const char *const results[] = {
+        "ok", "rejected (opcode)", "rejected (malformed)", "rejected (item)",
+    };
+    struct ctrl_batch b;
+
+    return results[settings_control(&settings, v, len, &b)];
+}
+
+static void apply_write(uint16_t uuid, const uint8_t *v, size_t len)
+{
+    const char *result;
+
+    switch (uuid) {
+    case UUID_TIME:
+        result = write_setting(CTRL_T_TIME, v, len);
+        break;
+    case UUID_TIMEZONE:
+        result = write_setting(CTRL_T_TZ, v, len);
+        break;
+    case UUID_DISPLAY_MODE:
+        result = write_setting(CTRL_T_DISPLAY_MODE, v, len);
+        break;
+    case UUID_SEA_LEVEL:
+        result = write_setting(CTRL_T_SEA_LEVEL, v, len);
+        break;
+    case UUID_RULES:
+        result = write_rules(v, len);
+        break;
+    case UUID_CONTROL:
+        result = write_control(v, len);
+        break;
+    case UUID_SCHEDULE:
+        result = write_schedule(v, len);
+        break;
+    default:
+        result = "not replayed";
+        break;
+    }
+    event("write %s, %zu bytes: %s", chr_name(uuid), len, result);
+}
+
+/* ---- Trace input -------------------------------------------------------- */
+
+static int b64_value(int c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* Decode base64 up to the first character outside the alphabet */
+static size_t b64_decode(const char *s, uint8_t *out)
+{
+    uint32_t acc = 0;
+    int bits = 0, v;
+    size_t n = 0;
+
+    for (; (v = b64_value(*s)) >= 0; s++) {
+        acc = acc << 6 | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = acc >> bits & 0xff;
+        }
+    }
+    return n;
+}
+
+static uint8_t *load_trace(FILE *f, size_t *len)
+{
+    char line[1024];
+    uint8_t *buf = NULL;
+    size_t n = 0, cap = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        const char *p = strstr(line, "#T:");
+        if (!p) {
+            continue;
+        }
+        if (cap - n < TRACE_HDR_LEN + TRACE_PAYLOAD_MAX) {
+            cap = cap ? cap * 2 : 65536;
+            buf = realloc(buf, cap);
+        }
+        n += b64_decode(p + 3, buf + n);
+    }
+    *len = n;
+    return buf;
+}
+
+static void replay_trace(const uint8_t *buf, size_t len, size_t *records)
+{
+    struct trace_start st;
+    struct trace_rec rec;
+    size_t off = 0;
+    bool pending_ok = false;
+    float t = 0, p = 0, h = 0;
+    bool first = true;
+
+    while (trace_next(buf, len, &off, &rec)) {
+        int64_t at = rec.time_ms * 1000LL;
+
+        (*records)++;
+        if (first) {
+            begin(at);
+            first = false;
+        }
+        advance(at);
+
+        switch (rec.type) {
+        case TRACE_START:
+            if (rec.len < sizeof(st)) {
+                break;
+            }
+            memcpy(&st, rec.data, sizeof(st));
+            set_clock(st.time);
+            tz_quarter_hours = st.tz_quarter_hours;
+            display_mode = st.display_mode;
+            sample_init(st.sea_level_pa, st.qnh_scale_q16);
+            sample_get_derived(&derived);
+            event("start, UNIX time %lu, display mode %u",
+                  (unsigned long)st.time, st.display_mode);
+            break;
+
+        case TRACE_CALIB:
+            if (rec.len == BME280_CALIB_LEN) {
+                bme280_calib_parse(rec.data, &calib);
+                have_calib = true;
+            }
+            break;
+
+        case TRACE_BME280: {
+            int32_t adc_t, adc_p, adc_h, t_fine;
+
+            /* The integer forms, scaled the way bmx280_readoutFloat()
+             * returns them */
+            pending_ok = rec.len == BME280_DATA_LEN && have_calib;
+            if (pending_ok) {
+                bme280_data_parse(rec.data, &adc_t, &adc_p, &adc_h);
+                t = bme280_comp_temp_int(&calib, adc_t, &t_fine) / 100.0f;
+                p = bme280_comp_press_int(&calib, adc_p, t_fine) / 256.0f;
+                h = bme280_comp_hum_int(&calib, adc_h, t_fine) / 1024.0f;
+            }
+            break;
+        }
+
+        case TRACE_BATTERY:
+            if (rec.len == 4) {
+                sample(pending_ok, t, p, h, rec.data[2] | rec.data[3] << 8);
+                pending_ok = false;
+            }
+            break;
+
+        case TRACE_BUTTON:
+            /* Recorded inside a display_task iteration; run one here */
+            if (rec.len == 2) {
+                button_mv = rec.data[0] | rec.data[1] << 8;
+                display_iteration();
+            }
+            break;
+
+        case TRACE_WRITE:
+            if (rec.len >= 2) {
+                apply_write(rec.data[0] | rec.data[1] << 8, rec.data + 2,
+                            rec.len - 2);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+    if (off != len) {
+        fprintf(stderr, "trace truncated at byte %zu of %zu\n", off, len);
+    }
+}
+
+/* ---- CSV input ---------------------------------------------------------- */
+
+static void replay_csv(FILE *f, size_t *records)
+{
+    char line[256];
+    uint32_t first = 0;
+
+    sample_init(CONFIG_APP_SEA_LEVEL_PA, 0);
+    sample_get_derived(&derived);
+    while (fgets(line, sizeof(line), f)) {
+        struct tm tm = { 0 };
+        float elapsed, volts, t, p_hpa, h;
+        unsigned mv;
+        uint32_t time;
+
+        /* timestamp,elapsed_min,mv,volts,temp_c,press_hpa,humidity */
+        if (sscanf(line, "%d-%d-%d %d:%d:%d,%f,%u,%f,%f,%f,%f",
+                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour,
+                   &tm.tm_min, &tm.tm_sec, &elapsed, &mv, &volts,
+                   &t, &p_hpa, &h) != 12) {
+            continue;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        time = (uint32_t)timegm(&tm);
+        if (*records == 0) {
+            first = time;
+            begin(0);
+            set_clock(time);
+        }
+        (*records)++;
+        advance((int64_t)(time - first) * 1000000);
+        /* The log holds the battery voltage, the ADC sees half */
+        sample(true, t, p_hpa * 100.0f, h, mv / 2);
+    }
+}
+
+/* ---- Main --------------------------------------------------------------- */
+
+static double wall_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        { "fb",       required_argument, NULL, 'f' },
+        { "centrals", required_argument, NULL, 'c' },
+        { "quiet",    no_argument,       NULL, 'q' },
+        { NULL, 0, NULL, 0 },
+    };
+    size_t records = 0;
+    double t0;
+    FILE *f;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "f:c:q", opts, NULL)) != -1) {
+        switch (c) {
+        case 'f':
+            fb_dir = optarg;
+            break;
+        case 'c':
+            centrals = atoi(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || centrals < 0 || centrals > MAX_CONNECTIONS) {
+        fprintf(stderr, "usage: replay LOG [--fb DIR] [--centrals 0-%d] "
+                "[--quiet]\n", MAX_CONNECTIONS);
+        return 2;
+    }
+    f = fopen(argv[optind], "r");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fb_dir) {
+        mkdir(fb_dir, 0777);
+    }
+
+    render_loop_init(&loop, button_time, button_presses);
+    t0 = wall_ms();
+
+    char probe[4096];
+    size_t n = fread(probe, 1, sizeof(probe) - 1, f);
+    probe[n] = '\0';
+    rewind(f);
+
+    if (strstr(probe, "#T:")) {
+        size_t len;
+        uint8_t *buf = load_trace(f, &len);
+        replay_trace(buf, len, &records);
+        free(buf);
+    } else {
+        replay_csv(f, &records);
+    }
+    fclose(f);
+
+    if (records == 0) {
+        fprintf(stderr, "%s: no trace records or CSV rows\n", argv[optind]);
+        return 1;
+    }
+
+    printf("\n");
+    powerstat_print();
+    printf("\nreplayed %zu records, %.1f h of uptime in %.1f ms, %u frames\n",
+           records, now_us / 3.6e9, wall_ms() - t0, frames);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Minimal SHA-256 for the host tools (mbedtls does this on the device). */
+
+struct sha256_ctx {
+    uint32_t state[8];
+    uint64_t bits;
+    uint8_t buf[64];
+    size_t used;
+};
+
+void sha256_init(struct sha256_ctx *c);
+void sha256_update(struct sha256_ctx *c, const void *data, size_t len);
+void sha256_final(struct sha256_ctx *c, uint8_t digest[32]);
+
+#endif /* SHA256_H */
@@ -0,0 +1,4 @@
+#pragma once
+
+#define GPIO_PULLUP_ONLY                0
+#define gpio_set_pull_mode(pin, mode)   ((void)(pin), (void)(mode))
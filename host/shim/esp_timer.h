@@ -0,0 +1,8 @@
+/* Host stand-ins for the ESP-IDF headers that the firmware modules replay
+ * links (button.c, history.c, powerstat.c) include.  Only what those
+ * modules use is here; the clock is the replay's simulated one. */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,8 @@
+#pragma once
+
+/* replay is single-threaded, so critical sections are no-ops */
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define taskENTER_CRITICAL(lock)        ((void)(lock))
+#define taskEXIT_CRITICAL(lock)         ((void)(lock))
@@ -0,0 +1,6 @@
+#pragma once
+
+/* Kconfig defaults (main/Kconfig.projbuild); APP_TRACE is off so the
+ * record hooks compile away. */
+#define CONFIG_APP_HISTORY_SAMPLES  64
+#define CONFIG_APP_SEA_LEVEL_PA     101325
@@ -0,0 +1,275 @@
+/*
+ * Compress a battery_life.py log (battery_log.csv) with main/tscodec.c and
+ * report the compression ratio and encode cost per sample, for the float
+ * columns as logged and for the same values in fixed point.  Every block is
+ * decoded again and compared, so a PASS also covers the decoder.
+ *
+ * Usage:
+ *   tsc_bench battery_log.csv [--block BYTES] [--repeat N] [-o BLOCKS]
+ *
+ * -o writes the fixed-point stream's blocks for tools/tscodec.py.
+ */
+
+#define _DEFAULT_SOURCE     /* timegm */
+
+#include "tscodec.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define N_COLS  5           /* time, mv, temp, press, hum */
+
+struct row {
+    uint32_t time;
+    uint32_t mv;
+    float temp_c, press_hpa, hum;
+};
+
+static const struct tsc_schema schema_float = {
+    .n_cols = N_COLS,
+    .kind = { TSC_TIME, TSC_INT, TSC_F32, TSC_F32, TSC_F32 },
+};
+
+static const struct tsc_schema schema_fixed = {
+    .n_cols = N_COLS,
+    .kind = { TSC_TIME, TSC_INT, TSC_INT, TSC_INT, TSC_INT },
+};
+
+/* ---- CSV ---------------------------------------------------------------- */
+
+static struct row *load_csv(const char *path, size_t *n_rows)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    struct row *rows = NULL;
+    size_t n = 0, cap = 0;
+
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        struct tm tm = { 0 };
+        float elapsed, volts;
+        struct row r;
+
+        /* timestamp,elapsed_min,mv,volts,temp_c,press_hpa,humidity */
+        if (sscanf(line, "%d-%d-%d %d:%d:%d,%f,%u,%f,%f,%f,%f",
+                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour,
+                   &tm.tm_min, &tm.tm_sec, &elapsed, &r.mv, &volts,
+                   &r.temp_c, &r.press_hpa, &r.hum) != 12) {
+            continue;       /* header or a malformed line */
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        r.time = (uint32_t)timegm(&tm);
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            rows = realloc(rows, cap * sizeof(*rows));
+        }
+        rows[n++] = r;
+    }
+    fclose(f);
+    *n_rows = n;
+    return rows;
+}
+
+static uint32_t f32_bits(float v)
+{
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+static void to_values(const struct row *r, int fixed, uint32_t *v)
+{
+    v[0] = r->time;
+    v[1] = r->mv;
+    if (fixed) {
+        /* The resolution the CSV was written with */
+        v[2] = (uint32_t)(int32_t)lroundf(r->temp_c * 100);
+        v[3] = (uint32_t)lroundf(r->press_hpa * 100);
+        v[4] = (uint32_t)lroundf(r->hum * 10);
+    } else {
+        v[2] = f32_bits(r->temp_c);
+        v[3] = f32_bits(r->press_hpa);
+        v[4] = f32_bits(r->hum);
+    }
+}
+
+/* ---- Benchmark ---------------------------------------------------------- */
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* Encode all rows into blocks; returns the number of blocks. */
+static size_t encode(const struct tsc_schema *s, int fixed,
+                     const struct row *rows, size_t n, uint8_t *out,
+                     size_t block_size, size_t *payload)
+{
+    struct tsc_encoder e;
+    uint32_t v[N_COLS];
+    size_t blocks = 0;
+
+    *payload = 0;
+    tsc_enc_init(&e, s, out, block_size);
+    for (size_t i = 0; i < n; i++) {
+        to_values(&rows[i], fixed, v);
+        if (tsc_enc_append(&e, v) != 0) {
+            *payload += tsc_enc_finish(&e);
+            blocks++;
+            tsc_enc_init(&e, s, out + blocks * block_size, block_size);
+            tsc_enc_append(&e, v);
+        }
+    }
+    if (e.count) {
+        *payload += tsc_enc_finish(&e);
+        blocks++;
+    }
+    return blocks;
+}
+
+/* Decode every block, by index, and compare with the input. */
+static int verify(const struct tsc_schema *s, int fixed, const struct row *rows,
+                  size_t n, const uint8_t *blocks, size_t n_blocks,
+                  size_t block_size)
+{
+    uint32_t *out = malloc(block_size * 8 * N_COLS * sizeof(uint32_t));
+    uint32_t v[N_COLS];
+    size_t row = 0;
+    int ok = 1;
+
+    for (size_t b = 0; b < n_blocks && ok; b++) {
+        int count = tsc_dec_block(s, blocks + b * block_size, block_size,
+                                  out, block_size * 8);
+        if (count < 0) {
+            printf("  block %zu: decode error\n", b);
+            ok = 0;
+            break;
+        }
+        for (int i = 0; i < count && ok; i++, row++) {
+            if (row >= n) {
+                printf("  block %zu: more samples than input\n", b);
+                ok = 0;
+                break;
+            }
+            to_values(&rows[row], fixed, v);
+            if (memcmp(v, out + i * N_COLS, sizeof(v)) != 0) {
+                printf("  block %zu sample %d: mismatch\n", b, i);
+                ok = 0;
+            }
+        }
+    }
+    free(out);
+    return ok && row == n;
+}
+
+static int run(const char *name, const struct tsc_schema *s, int fixed,
+               const struct row *rows, size_t n, size_t block_size,
+               int repeat, const char *out_path)
+{
+    /* Worst case is one sample per block */
+    uint8_t *buf = malloc(n * block_size);
+    size_t blocks = 0, payload = 0;
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+
+    for (int i = 0; i < repeat; i++) {
+        blocks = encode(s, fixed, rows, n, buf, block_size, &payload);
+    }
+    double ns = (now_ns() - t0) / repeat / n;
+    double cyc = (double)(cycles() - c0) / repeat / n;
+
+    size_t raw = n * N_COLS * 4;
+    size_t stored = blocks * block_size;
+    printf("%s\n", name);
+    printf("  %zu samples, %zu blocks of %zu bytes\n", n, blocks, block_size);
+    printf("  raw %zu bytes, stored %zu (payload %zu)\n", raw, stored, payload);
+    printf("  ratio %.2f stored, %.2f payload; %.1f bits/sample\n",
+           (double)raw / stored, (double)raw / payload,
+           payload * 8.0 / n);
+    printf("  encode %.0f ns/sample", ns);
+#ifdef HAVE_TSC
+    printf(", %.0f cycles/sample", cyc);
+#endif
+    printf("\n");
+
+    int ok = verify(s, fixed, rows, n, buf, blocks, block_size);
+    printf("  round trip: %s\n", ok ? "ok" : "FAILED");
+
+    if (out_path) {
+        FILE *f = fopen(out_path, "wb");
+        if (f) {
+            fwrite(buf, block_size, blocks, f);
+            fclose(f);
+        }
+    }
+    free(buf);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_opts[] = {
+        { "block",  required_argument, NULL, 'b' },
+        { "repeat", required_argument, NULL, 'r' },
+        { "output", required_argument, NULL, 'o' },
+        { NULL, 0, NULL, 0 },
+    };
+    size_t block_size = 256;
+    int repeat = 20;
+    const char *out_path = NULL;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "b:r:o:", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'b': block_size = strtoul(optarg, NULL, 0); break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:
+            return 2;
+        }
+    }
+    if (optind >= argc || block_size < 64 || block_size > 65535 ||
+        repeat < 1) {
+        fprintf(stderr, "usage: tsc_bench LOG.csv [--block BYTES] "
+                "[--repeat N] [-o BLOCKS]\n");
+        return 2;
+    }
+
+    size_t n;
+    struct row *rows = load_csv(argv[optind], &n);
+    if (!rows || n == 0) {
+        fprintf(stderr, "%s: no samples\n", argv[optind]);
+        return 1;
+    }
+
+    int ok = run("float columns (Gorilla XOR)", &schema_float, 0, rows, n,
+                 block_size, repeat, NULL);
+    ok &= run("fixed point (zig-zag varint)", &schema_fixed, 1, rows, n,
+              block_size, repeat, out_path);
+    free(rows);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
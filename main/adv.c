@@ -0,0 +1,219 @@
+#include "adv.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+
+#include "ble_conn.h"
+#include "bmx280_sensor.h"
+#include "gatt_svc.h"
+#include "powerstat.h"
+#include "sensor_task.h"
+
+static const char *TAG = "adv";
+
+#define ADV_ITVL_ALARM      160     /* 100 ms while a rule asks for it */
+
+/* In 0.625 ms units */
+static const uint16_t adv_itvls[ADV_PROFILE_COUNT] = {
+    [ADV_PROFILE_NORMAL] = 3200,
+    [ADV_PROFILE_FAST] = 800,
+    [ADV_PROFILE_SLOW] = 16000,
+};
+
+static const char *adv_name;
+static ble_gap_event_fn *adv_cb;
+static volatile bool adv_synced;
+static volatile uint8_t adv_alarm;
+static volatile uint8_t adv_profile = ADV_PROFILE_NORMAL;
+static uint16_t adv_itvl_running;   /* interval of the running advertisement */
+static struct ble_npl_event adv_refresh_ev;
+
+/* Company ID followed by the payload described in adv.h. */
+static uint8_t mfg_data[2 + ADV_MFG_LEN] = {
+    ADV_COMPANY_ID & 0xff, ADV_COMPANY_ID >> 8, ADV_MFG_VERSION,
+};
+static uint8_t mfg_seq;
+static portMUX_TYPE mfg_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ---- Payload ------------------------------------------------------------ */
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void mfg_build(uint8_t *out)
+{
+    int16_t temp = INT16_MIN;
+    uint16_t press = 0xffff;
+    uint8_t hum = 0xff;
+
+    if (sensors_valid) {
+        temp = (int16_t)lroundf(gatt_svc_temperature * 100.0f);
+        press = (uint16_t)lroundf(gatt_svc_pressure / 10.0f); /* Pa -> 0.1 hPa */
+        hum = (uint8_t)lroundf(gatt_svc_humidity);
+    }
+
+    out[0] = ADV_COMPANY_ID & 0xff;
+    out[1] = ADV_COMPANY_ID >> 8;
+    out[2] = ADV_MFG_VERSION;
+    out[3] = ++mfg_seq;
+    put_le16(&out[4], (uint16_t)temp);
+    put_le16(&out[6], press);
+    out[8] = hum;
+    put_le16(&out[9], (uint16_t)gatt_svc_battery_mv);
+    out[11] = adv_alarm;
+}
+
+static int set_rsp_fields(void)
+{
+    struct ble_hs_adv_fields rsp;
+    uint8_t mfg[sizeof(mfg_data)];
+
+    taskENTER_CRITICAL(&mfg_lock);
+    memcpy(mfg, mfg_data, sizeof(mfg));
+    taskEXIT_CRITICAL(&mfg_lock);
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.name = (uint8_t *)adv_name;
+    rsp.name_len = strlen(adv_name);
+    rsp.name_is_complete = 1;
+    rsp.mfg_data = mfg;
+    rsp.mfg_data_len = sizeof(mfg);
+
+    return ble_gap_adv_rsp_set_fields(&rsp);
+}
+
+static uint16_t adv_itvl(void)
+{
+    return adv_alarm ? ADV_ITVL_ALARM : adv_itvls[adv_profile];
+}
+
+/* Only the host task starts and stops advertising: the GAP handler does
+ * on connect, disconnect and complete, and this event for the rest.
+ * Posting it again while queued is a no-op, so updates coalesce. */
+static void adv_refresh(struct ble_npl_event *ev)
+{
+    if (!ble_gap_adv_active()) {
+        return;     /* the next adv_start() picks up the new data */
+    }
+
+    /* The interval can't be changed in place, so restart to enter or
+     * leave alarm advertising, or for a new profile; the scan response is
+     * replaced otherwise. */
+    if (adv_itvl() != adv_itvl_running) {
+        ble_gap_adv_stop();
+        adv_start();
+        return;
+    }
+    int rc = set_rsp_fields();
+    if (rc != 0) {
+        ESP_LOGW(TAG, "scan response update failed: %d", rc);
+    }
+}
+
+static void adv_refresh_post(void)
+{
+    if (adv_synced) {
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &adv_refresh_ev);
+    }
+}
+
+/* ---- Public API --------------------------------------------------------- */
+
+void adv_init(const char *name, ble_gap_event_fn *cb)
+{
+    adv_name = name;
+    adv_cb = cb;
+    ble_npl_event_init(&adv_refresh_ev, adv_refresh, NULL);
+}
+
+void adv_start(void)
+{
+    struct ble_gap_adv_params adv_params;
+    struct ble_hs_adv_fields fields;
+    int rc;
+
+    adv_synced = true;
+
+    /* Every change in advertising state (connect, disconnect, complete)
+     * ends up here, so this is where the time is accounted. */
+    powerstat_level(POWERSTAT_ADV, ble_gap_adv_active());
+    if (ble_gap_adv_active() || !ble_conn_slot_free()) {
+        return;
+    }
+
+    memset(&fields, 0, sizeof(fields));
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.tx_pwr_lvl_is_present = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+    fields.uuids128 = gatt_svc_get_uuid();
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+
+    rc = ble_gap_adv_set_fields(&fields);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gap_adv_set_fields failed: %d", rc);
+        return;
+    }
+
+    rc = set_rsp_fields();
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gap_adv_rsp_set_fields failed: %d", rc);
+        return;
+    }
+
+    memset(&adv_params, 0, sizeof(adv_params));
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+    adv_itvl_running = adv_itvl();
+    adv_params.itvl_min = adv_itvl_running;
+    adv_params.itvl_max = adv_params.itvl_min;
+
+    rc = ble_gap_adv_start(BLE_OWN_ADDR_PUBLIC, NULL, BLE_HS_FOREVER,
+                           &adv_params, adv_cb, NULL);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gap_adv_start failed: %d", rc);
+        return;
+    }
+    powerstat_level(POWERSTAT_ADV, 1);
+}
+
+void adv_update(void)
+{
+    uint8_t mfg[sizeof(mfg_data)];
+
+    mfg_build(mfg);
+    taskENTER_CRITICAL(&mfg_lock);
+    memcpy(mfg_data, mfg, sizeof(mfg));
+    taskEXIT_CRITICAL(&mfg_lock);
+    adv_refresh_post();
+}
+
+void adv_set_profile(uint8_t profile)
+{
+    if (profile >= ADV_PROFILE_COUNT || profile == adv_profile) {
+        return;
+    }
+    adv_profile = profile;
+    ESP_LOGI(TAG, "advertising interval %u ms",
+             (unsigned)(adv_itvls[profile] * 5 / 8));
+    adv_refresh_post();
+}
+
+uint8_t adv_get_profile(void)
+{
+    return adv_profile;
+}
+
+void adv_set_alarm(uint8_t active)
+{
+    adv_alarm = active;
+}
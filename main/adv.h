@@ -0,0 +1,60 @@
+#ifndef ADV_H
+#define ADV_H
+
+#include "host/ble_gap.h"
+
+/*
+ * Advertising.  The advertisement carries the service UUID so collectors
+ * can filter on it; the scan response carries the name and the latest
+ * readings as manufacturer data, so a scanner gets them without connecting.
+ *
+ * Manufacturer data (company 0xFFFF, little-endian, ADV_MFG_LEN bytes):
+ *
+ *   0  u8   format version (ADV_MFG_VERSION)
+ *   1  u8   sample sequence, incremented on every adv_update()
+ *   2  s16  temperature, 0.01 °C      (INT16_MIN when unknown)
+ *   4  u16  pressure, 0.1 hPa         (0xFFFF when unknown)
+ *   6  u8   relative humidity, %      (0xFF when unknown)
+ *   7  u16  battery, mV as read on the ADC (same as the battery chr)
+ *   9  u8   alarm: bit per active rule that asks for alarm advertising
+ *
+ * The interval follows the advertising profile (2 s normally).  While the
+ * alarm byte is non-zero it drops to 100 ms whatever the profile, so
+ * scanners pick the alarm up quickly.  Parsers that stop at byte 9 keep
+ * working; the version only changes for incompatible layouts.
+ */
+
+#define ADV_COMPANY_ID      0xFFFF
+#define ADV_MFG_VERSION     1
+#define ADV_MFG_LEN         10
+
+/* Advertising profiles: the interval outside an alarm. */
+enum {
+    ADV_PROFILE_NORMAL = 0,     /* 2 s */
+    ADV_PROFILE_FAST,           /* 500 ms, quicker to find and connect */
+    ADV_PROFILE_SLOW,           /* 10 s */
+    ADV_PROFILE_COUNT,
+};
+
+/** Set the device name and the GAP handler used for every adv_start(). */
+void adv_init(const char *name, ble_gap_event_fn *cb);
+
+/** Start advertising unless already active or all connection slots are in
+ *  use.  Call from on_sync and from the GAP handler. */
+void adv_start(void);
+
+/** Refresh the manufacturer data from the current readings.  Safe to call
+ *  from any task: the advertisement itself is updated on the host task.
+ *  A no-op until the host has synced. */
+void adv_update(void);
+
+/** Select an advertising profile; a running advertisement restarts with
+ *  the new interval. */
+void adv_set_profile(uint8_t profile);
+
+uint8_t adv_get_profile(void);
+
+/** Set the alarm byte (0 to clear); takes effect on the next adv_update(). */
+void adv_set_alarm(uint8_t active);
+
+#endif /* ADV_H */
@@ -0,0 +1,272 @@
+#include "alarm.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+
+#include "adv.h"
+#include "ble_conn.h"
+#include "bmx280_sensor.h"
+#include "button.h"
+#include "gatt_svc.h"
+#include "sensor_task.h"
+
+static const char *TAG = "alarm";
+
+#define ALARM_NVS_NAMESPACE "rules"
+#define ALARM_NVS_KEY       "table"
+
+#define LED_GPIO            8
+#define LED_ON_LEVEL        1       /* flip if the LED is wired to 3V3 */
+#define LED_PERIOD_US       1000000
+#define LED_FLASH_US        50000   /* short flash, mostly dark */
+
+static esp_timer_handle_t led_period_timer;
+static esp_timer_handle_t led_off_timer;
+
+/* Only the sensor task calls apply(), so it is the one writer of the
+ * status and the actions.  A new table waits in pending until that task
+ * picks it up in alarm_poll(). */
+static struct rules_status status;      /* the Alarm characteristic */
+static struct rule pending[RULES_MAX];
+static size_t pending_len;
+static bool pending_set;
+static portMUX_TYPE alarm_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ---- LED ---------------------------------------------------------------- */
+
+/* The output is latched so light sleep doesn't glitch it (see README). */
+static void led_set(bool on)
+{
+    gpio_hold_dis(LED_GPIO);
+    gpio_set_level(LED_GPIO, on ? LED_ON_LEVEL : !LED_ON_LEVEL);
+    gpio_hold_en(LED_GPIO);
+}
+
+static void led_off_cb(void *arg)
+{
+    led_set(false);
+}
+
+static void led_flash_cb(void *arg)
+{
+    led_set(true);
+    esp_timer_start_once(led_off_timer, LED_FLASH_US);
+}
+
+static void led_blink(bool on)
+{
+    if (!led_period_timer) {
+        return;
+    }
+    if (on) {
+        /* Fails harmlessly if already blinking */
+        if (esp_timer_start_periodic(led_period_timer, LED_PERIOD_US) ==
+            ESP_OK) {
+            led_flash_cb(NULL);
+        }
+    } else {
+        esp_timer_stop(led_period_timer);
+        esp_timer_stop(led_off_timer);
+        led_set(false);
+    }
+}
+
+static void led_init(void)
+{
+    const esp_timer_create_args_t period_args = {
+        .callback = led_flash_cb,
+        .name = "alarm_led",
+    };
+    const esp_timer_create_args_t off_args = {
+        .callback = led_off_cb,
+        .name = "alarm_led_off",
+    };
+
+    gpio_reset_pin(LED_GPIO);
+    gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
+    led_set(false);
+
+    if (esp_timer_create(&period_args, &led_period_timer) != ESP_OK ||
+        esp_timer_create(&off_args, &led_off_timer) != ESP_OK) {
+        ESP_LOGW(TAG, "LED timers unavailable, alarms won't blink");
+        led_period_timer = NULL;
+    }
+}
+
+/* ---- Actions ------------------------------------------------------------ */
+
+/* fired/edge: actions of the rules that fired, and that fired or cleared;
+ * adv: rules asking for alarm advertising that are active. */
+static void apply(const struct rules_status *st, uint8_t fired, uint8_t edge,
+                  uint8_t adv)
+{
+    taskENTER_CRITICAL(&alarm_lock);
+    status = *st;
+    taskEXIT_CRITICAL(&alarm_lock);
+
+    if (st->fired || st->cleared) {
+        ESP_LOGI(TAG, "fired 0x%02x cleared 0x%02x, active 0x%02x",
+                 st->fired, st->cleared, st->active);
+    }
+    if (fired & RULES_ACT_DISPLAY) {
+        button_time = esp_timer_get_time();
+    }
+    adv_set_alarm(adv);
+    led_blink(st->actions & RULES_ACT_LED);
+    if (edge & RULES_ACT_INDICATE) {
+        ble_conn_indicate(gatt_svc_val_handle(GATT_CHR_ALARM), st,
+                          sizeof(*st));
+    }
+}
+
+void alarm_apply(const struct sample_result *r)
+{
+    apply(&r->alarm, r->fired, r->edge, r->adv);
+}
+
+void alarm_get_status(struct rules_status *st)
+{
+    taskENTER_CRITICAL(&alarm_lock);
+    *st = status;
+    taskEXIT_CRITICAL(&alarm_lock);
+}
+
+/* ---- Table -------------------------------------------------------------- */
+
+/* A table not yet picked up is what the next sample will use */
+size_t alarm_get_rules(struct rule *r)
+{
+    size_t n = 0;
+    bool set;
+
+    taskENTER_CRITICAL(&alarm_lock);
+    set = pending_set;
+    if (set) {
+        n = pending_len;
+        memcpy(r, pending, n * sizeof(*r));
+    }
+    taskEXIT_CRITICAL(&alarm_lock);
+    return set ? n : sample_get_rules(r);
+}
+
+void alarm_poll(void)
+{
+    struct rule r[RULES_MAX];
+    struct rules_status st = { .time = (uint32_t)time(NULL) };
+    size_t n = 0;
+    bool set;
+
+    taskENTER_CRITICAL(&alarm_lock);
+    set = pending_set;
+    if (set) {
+        n = pending_len;
+        memcpy(r, pending, n * sizeof(*r));
+        pending_set = false;
+    }
+    taskEXIT_CRITICAL(&alarm_lock);
+    if (!set) {
+        return;
+    }
+
+    st.cleared = sample_set_rules(r, n);
+
+    /* Stop whatever the old table was doing now rather than at the next
+     * sample; a central watching Alarm sees the clear. */
+    apply(&st, 0, st.cleared ? RULES_ACT_INDICATE : 0, 0);
+    adv_update();
+    ESP_LOGI(TAG, "%u rule(s) set", (unsigned)n);
+}
+
+esp_err_t alarm_set_rules(const struct rule *r, size_t n)
+{
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    if (!rules_validate(r, n)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&alarm_lock);
+    memcpy(pending, r, n * sizeof(*r));
+    pending_len = n;
+    pending_set = true;
+    taskEXIT_CRITICAL(&alarm_lock);
+    sensor_task_wake();
+
+    err = nvs_open(ALARM_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = n ? nvs_set_blob(nvs, ALARM_NVS_KEY, r, n * sizeof(*r))
+                : nvs_erase_key(nvs, ALARM_NVS_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "rules not saved: %s", esp_err_to_name(err));
+    }
+    return ESP_OK;
+}
+
+/* ---- Console ------------------------------------------------------------ */
+
+static const char *const metric_names[RULES_METRIC_COUNT] = {
+    "temp", "hum", "press", "batt", "dew", "tendency", "alt",
+};
+static const char *const op_names[RULES_OP_COUNT] = {
+    ">", "<", "rate>", "rate<",
+};
+
+void alarm_print(void)
+{
+    struct rule r[RULES_MAX];
+    struct rules_status st;
+    size_t n = alarm_get_rules(r);
+
+    alarm_get_status(&st);
+
+    for (size_t i = 0; i < n; i++) {
+        printf("%u: %-8s %-5s %ld  hyst %lu  for %us  actions 0x%02x%s%s\n",
+               (unsigned)i, metric_names[r[i].metric], op_names[r[i].op],
+               (long)r[i].threshold, (unsigned long)r[i].hysteresis,
+               r[i].min_duration_s, r[i].actions,
+               (r[i].flags & RULES_F_ENABLED) ? "" : "  disabled",
+               (st.active & (1u << i)) ? "  ACTIVE" : "");
+    }
+    printf("%u of %u rules\n", (unsigned)n, RULES_MAX);
+}
+
+/* ---- Initialization ----------------------------------------------------- */
+
+void alarm_init(void)
+{
+    struct rule r[RULES_MAX];
+    size_t len = sizeof(r);
+    nvs_handle_t nvs;
+
+    led_init();
+
+    if (nvs_open(ALARM_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, ALARM_NVS_KEY, r, &len) == ESP_OK) {
+        if (len % sizeof(r[0]) == 0 && rules_validate(r, len / sizeof(r[0]))) {
+            sample_set_rules(r, len / sizeof(r[0]));
+            ESP_LOGI(TAG, "%u rule(s) loaded", (unsigned)(len / sizeof(r[0])));
+        } else {
+            ESP_LOGW(TAG, "stored rules are malformed, ignoring them");
+        }
+    }
+    nvs_close(nvs);
+}
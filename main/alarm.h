@@ -0,0 +1,49 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "rules.h"
+#include "sample.h"
+
+/*
+ * Carries out the actions of the rules that sample_process() evaluated on
+ * each sample: wake the display, alarm advertising, blink the LED on
+ * GPIO8, indicate the Alarm characteristic.
+ *
+ * The table is written and read through the Rules characteristic as an
+ * array of struct rule and kept in NVS.  The status after each sample is
+ * the Alarm characteristic (struct rules_status).  Everything that acts
+ * runs on the sensor task: a new table is handed over to it and takes
+ * effect in alarm_poll().
+ */
+
+/** Load the table from NVS and set up the LED.  Call before the sensor
+ *  task starts. */
+void alarm_init(void);
+
+/** Publish the Alarm status of a sample and act on the rules' edges.
+ *  Sensor task only. */
+void alarm_apply(const struct sample_result *r);
+
+/** Put a table from alarm_set_rules() into force and clear what the old
+ *  one had active.  Sensor task only; does nothing if none is waiting. */
+void alarm_poll(void);
+
+/** Copy the status after the last sample or table change. */
+void alarm_get_status(struct rules_status *st);
+
+/** Copy the table into r (RULES_MAX entries); returns the count. */
+size_t alarm_get_rules(struct rule *r);
+
+/** Validate and persist a new table, and hand it to the sensor task.
+ *  Every rule starts inactive.  Returns ESP_ERR_INVALID_ARG if an entry
+ *  is malformed. */
+esp_err_t alarm_set_rules(const struct rule *r, size_t n);
+
+/** Print the table and the active rules to stdout. */
+void alarm_print(void);
+
+#endif /* ALARM_H */
@@ -0,0 +1,167 @@
+#include "app_console.h"
+#include "alarm.h"
+#include "boot.h"
+#include "display.h"
+#include "history.h"
+#include "memstat.h"
+#include "powerstat.h"
+#include "profile.h"
+#include "record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_console.h"
+#include "esp_log.h"
+
+static const char *TAG = "console";
+
+/* ---- Commands ----------------------------------------------------------- */
+
+static int cmd_mem(int argc, char **argv)
+{
+    memstat_print();
+    return 0;
+}
+
+static int cmd_power(int argc, char **argv)
+{
+    powerstat_print();
+    printf("dropped      %10lu    (frames drawn over before the flush)\n",
+           (unsigned long)display_frames_dropped());
+    return 0;
+}
+
+static int cmd_boot(int argc, char **argv)
+{
+    boot_print();
+    return 0;
+}
+
+static int cmd_rules(int argc, char **argv)
+{
+    alarm_print();
+    return 0;
+}
+
+static int cmd_schedule(int argc, char **argv)
+{
+    profile_print();
+    return 0;
+}
+
+static int cmd_history(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10;
+    size_t count = history_count();
+    size_t first = n < count ? count - n : 0;
+    struct history_sample s;
+
+    for (size_t i = first; history_get(i, &s); i++) {
+        time_t t = s.time;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        printf("%04d-%02d-%02d %02d:%02d:%02d  %6.2f C  %7.2f hPa  "
+               "%5.1f %%  %4u mV\n",
+               tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+               tm.tm_hour, tm.tm_min, tm.tm_sec,
+               s.temp_c100 / 100.0, s.press_pa / 100.0,
+               s.hum_x100 / 100.0, s.batt_mv * 2);
+    }
+    printf("%u of %u samples\n", (unsigned)count,
+           (unsigned)history_capacity());
+    return 0;
+}
+
+#if CONFIG_APP_TRACE
+static int cmd_trace(int argc, char **argv)
+{
+    const char *op = argc > 1 ? argv[1] : "";
+
+    if (strcmp(op, "start") == 0) {
+        record_start();
+    } else if (strcmp(op, "stop") == 0) {
+        record_stop();
+    } else if (argc > 1 && strcmp(op, "dump") != 0) {
+        printf("usage: trace [start|stop|dump]\n");
+        return 1;
+    }
+    record_print(strcmp(op, "dump") == 0);
+    return 0;
+}
+#endif
+
+static const esp_console_cmd_t commands[] = {
+    {
+        .command = "mem",
+        .help = "Stack headroom, heap and mbuf usage",
+        .func = cmd_mem,
+    },
+    {
+        .command = "power",
+        .help = "Activity counters for the battery-life model",
+        .func = cmd_power,
+    },
+    {
+        .command = "boot",
+        .help = "Log the boot timeline",
+        .func = cmd_boot,
+    },
+    {
+        .command = "rules",
+        .help = "Alarm rules and which are active",
+        .func = cmd_rules,
+    },
+    {
+        .command = "schedule",
+        .help = "Power schedule and the entry in force",
+        .func = cmd_schedule,
+    },
+    {
+        .command = "history",
+        .help = "Print the newest N samples (default 10)",
+        .hint = "[N]",
+        .func = cmd_history,
+    },
+#if CONFIG_APP_TRACE
+    {
+        .command = "trace",
+        .help = "Input trace status; start, stop or dump it",
+        .hint = "[start|stop|dump]",
+        .func = cmd_trace,
+    },
+#endif
+};
+
+/* ---- Initialization ----------------------------------------------------- */
+
+esp_err_t app_console_init(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    esp_err_t err;
+
+    repl_config.prompt = "c3>";
+    repl_config.task_stack_size = APP_CONSOLE_STACK;
+
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t hw_config =
+        ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    err = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+#else
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    err = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "REPL init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        ESP_ERROR_CHECK(esp_console_cmd_register(&commands[i]));
+    }
+    return esp_console_start_repl(repl);
+}
@@ -0,0 +1,12 @@
+#ifndef APP_CONSOLE_H
+#define APP_CONSOLE_H
+
+#include "esp_err.h"
+
+#define APP_CONSOLE_STACK   3072    /* REPL task stack, bytes */
+
+/** Start the serial console REPL with the application commands (`mem`,
+ *  `history`).  Only built with CONFIG_APP_CONSOLE. */
+esp_err_t app_console_init(void);
+
+#endif /* APP_CONSOLE_H */
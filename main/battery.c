@@ -4,6 +4,7 @@
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include "esp_log.h"
+#include "record.h"
 
 static const char *TAG = "battery";
 
@@ -75,6 +76,7 @@ int battery_get_voltage_mv(void)
         voltage_mv = raw_val * 2500 / 4095;
         ESP_LOGW(TAG, "ADC calibration not enabled, using linear conversion. Voltage: %d mV", voltage_mv);
     }
+    record_battery(raw_val, voltage_mv);
     return voltage_mv;
 }
 
@@ -0,0 +1,276 @@
+#include "bench.h"
+#include "bme280_comp.h"
+#include "derived.h"
+#include "bmx280_sensor.h"
+#include "display.h"
+#include "fb.h"
+#include "gatt_svc.h"
+#include "sensor_task.h"
+#include "tscodec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host/ble_hs.h"
+#include "host/ble_uuid.h"
+
+static const char *TAG = "bench";
+
+#define BENCH_REPEATS   9   /* timed repetitions per case (median reported) */
+
+#if CONFIG_COMPILER_OPTIMIZATION_DEBUG
+#define BENCH_OPT "Og"
+#elif CONFIG_COMPILER_OPTIMIZATION_SIZE
+#define BENCH_OPT "Os"
+#elif CONFIG_COMPILER_OPTIMIZATION_PERF
+#define BENCH_OPT "O2"
+#elif CONFIG_COMPILER_OPTIMIZATION_NONE
+#define BENCH_OPT "O0"
+#else
+#define BENCH_OPT "unknown"
+#endif
+
+/* Results are written here so the compiler cannot discard the work. */
+static volatile uint32_t sink;
+
+/* ---- Case table --------------------------------------------------------- */
+
+struct bench_case {
+    char name[24];
+    void (*fn)(void *arg);
+    void *arg;
+    uint32_t iters;     /* calls per timed repetition */
+};
+
+#define BENCH_MAX_CASES 32
+
+static struct bench_case cases[BENCH_MAX_CASES];
+static int num_cases;
+
+static void bench_add(const char *name, void (*fn)(void *), void *arg,
+                      uint32_t iters)
+{
+    if (num_cases >= BENCH_MAX_CASES) {
+        ESP_LOGE(TAG, "case table full, dropping %s", name);
+        return;
+    }
+    struct bench_case *c = &cases[num_cases++];
+    strlcpy(c->name, name, sizeof(c->name));
+    c->fn = fn;
+    c->arg = arg;
+    c->iters = iters;
+}
+
+/* ---- Display cases ------------------------------------------------------ */
+
+static void case_fb_draw_glyph(void *arg)
+{
+    /* One full page of glyphs: 16 blits */
+    for (int col = 0; col < FB_WIDTH; col += 8) {
+        fb_draw_glyph(3, col, (col / 8) % (GLYPH_H + 1));
+    }
+    sink += fb[3][FB_WIDTH - 1];
+}
+
+static void case_render_display(void *arg)
+{
+    render_display();
+    sink += fb[4][40];
+}
+
+/* ---- Compensation cases ------------------------------------------------- */
+
+/* Calibration and ADC values from the BMP280/BME280 datasheet worked
+ * example (25.08 °C, 100653 Pa). */
+static const struct bme280_calib calib = {
+    .t1 = 27504, .t2 = 26435, .t3 = -1000,
+    .p1 = 36477, .p2 = -10685, .p3 = 3024, .p4 = 2855, .p5 = 140,
+    .p6 = -7, .p7 = 15500, .p8 = -14600, .p9 = 6000,
+    .h1 = 75, .h2 = 362, .h3 = 0, .h4 = 324, .h5 = 0, .h6 = 30,
+};
+
+#define ADC_T 519888
+#define ADC_P 415148
+#define ADC_H 30000
+
+static void case_comp_int(void *arg)
+{
+    int32_t t_fine;
+    sink += bme280_comp_temp_int(&calib, ADC_T + (sink & 1), &t_fine);
+    sink += bme280_comp_press_int(&calib, ADC_P, t_fine);
+    sink += bme280_comp_hum_int(&calib, ADC_H, t_fine);
+}
+
+static void case_comp_float(void *arg)
+{
+    int32_t t_fine;
+    float t = bme280_comp_temp_float(&calib, ADC_T + (sink & 1), &t_fine);
+    float p = bme280_comp_press_float(&calib, ADC_P, t_fine);
+    float h = bme280_comp_hum_float(&calib, ADC_H, t_fine);
+    sink += (uint32_t)(t + p + h);
+}
+
+/* ---- Derived metrics case ----------------------------------------------- */
+
+static struct derived_state bench_derived;
+static uint32_t bench_now_s;
+
+static void case_derived_update(void *arg)
+{
+    /* One sample every 2 minutes, as sensor_task does, so the pressure
+     * ring advances on every fifth call. */
+    bench_now_s += 120;
+    derived_update(&bench_derived, 2508 + (sink & 7), 5196,
+                   100653 - (bench_now_s & 63), bench_now_s);
+    sink += bench_derived.out.altitude_dm;
+}
+
+/* ---- Time-series codec -------------------------------------------------- */
+
+/* A history_sample-shaped row: time, mV, temp, pressure, humidity */
+static const struct tsc_schema bench_tsc_schema = {
+    .n_cols = 5,
+    .kind = { TSC_TIME, TSC_INT, TSC_INT, TSC_INT, TSC_INT },
+};
+static struct tsc_encoder bench_tsc;
+static uint8_t bench_tsc_block[256];
+
+static void case_tsc_append(void *arg)
+{
+    uint32_t t = bench_now_s += 120;
+    uint32_t v[5] = {
+        t, 1430 - (sink & 1), 2508 + (sink & 7), 100653 - (t & 63),
+        5196 + (sink & 3),
+    };
+
+    /* Includes closing the block (header and CRC) every ~40 samples */
+    if (tsc_enc_append(&bench_tsc, v) != 0) {
+        sink += tsc_enc_finish(&bench_tsc);
+        tsc_enc_init(&bench_tsc, &bench_tsc_schema, bench_tsc_block,
+                     sizeof(bench_tsc_block));
+        tsc_enc_append(&bench_tsc, v);
+    }
+}
+
+/* ---- GATT read encode cases --------------------------------------------- */
+
+/*
+ * Drive the registered access callbacks directly with a READ op, using a
+ * private mbuf pool so the NimBLE host never needs to be started.  This
+ * measures the dispatch and encode work a central's read triggers.
+ */
+
+#define BENCH_MBUF_BLOCK_SIZE   128
+#define BENCH_MBUF_COUNT        4
+
+static os_membuf_t bench_mbuf_mem[OS_MEMPOOL_SIZE(BENCH_MBUF_COUNT,
+                                                  BENCH_MBUF_BLOCK_SIZE)];
+static struct os_mempool bench_mempool;
+static struct os_mbuf_pool bench_mbuf_pool;
+
+static void case_gatt_read(void *arg)
+{
+    const struct ble_gatt_chr_def *chr = arg;
+    struct ble_gatt_access_ctxt ctxt = {
+        .op = BLE_GATT_ACCESS_OP_READ_CHR,
+        .chr = chr,
+    };
+
+    ctxt.om = os_mbuf_get_pkthdr(&bench_mbuf_pool, 0);
+    if (ctxt.om == NULL) {
+        return;
+    }
+    sink += chr->access_cb(BLE_HS_CONN_HANDLE_NONE, 0, &ctxt, chr->arg);
+    sink += OS_MBUF_PKTLEN(ctxt.om);
+    os_mbuf_free_chain(ctxt.om);
+}
+
+static void add_gatt_cases(void)
+{
+    os_mempool_init(&bench_mempool, BENCH_MBUF_COUNT, BENCH_MBUF_BLOCK_SIZE,
+                    bench_mbuf_mem, "bench_mbuf");
+    os_mbuf_pool_init(&bench_mbuf_pool, &bench_mempool, BENCH_MBUF_BLOCK_SIZE,
+                      BENCH_MBUF_COUNT);
+
+    for (const struct ble_gatt_svc_def *svc = gatt_svc_get_defs();
+         svc->type != 0; svc++) {
+        for (const struct ble_gatt_chr_def *chr = svc->characteristics;
+             chr->uuid != NULL; chr++) {
+            if (!(chr->flags & BLE_GATT_CHR_F_READ)) {
+                continue;
+            }
+            /* "deadbeef-1002-2000-..." -> "gatt_read_1002" */
+            char uuid[BLE_UUID_STR_LEN];
+            char name[24];
+            ble_uuid_to_str(chr->uuid, uuid);
+            snprintf(name, sizeof(name), "gatt_read_%.4s", uuid + 9);
+            bench_add(name, case_gatt_read, (void *)chr, 200);
+        }
+    }
+}
+
+/* ---- Runner ------------------------------------------------------------- */
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_one(const struct bench_case *c)
+{
+    uint32_t per_call[BENCH_REPEATS];
+
+    c->fn(c->arg);  /* warm caches and any lazy initialisation */
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (uint32_t i = 0; i < c->iters; i++) {
+            c->fn(c->arg);
+        }
+        per_call[r] = (esp_cpu_get_cycle_count() - start) / c->iters;
+        vTaskDelay(1);  /* let the idle task run between repetitions */
+    }
+
+    qsort(per_call, BENCH_REPEATS, sizeof(per_call[0]), cmp_u32);
+    printf("BENCH {\"case\":\"%s\",\"opt\":\"%s\",\"iters\":%lu,"
+           "\"repeats\":%d,\"min\":%lu,\"median\":%lu,\"max\":%lu}\n",
+           c->name, BENCH_OPT, (unsigned long)c->iters, BENCH_REPEATS,
+           (unsigned long)per_call[0],
+           (unsigned long)per_call[BENCH_REPEATS / 2],
+           (unsigned long)per_call[BENCH_REPEATS - 1]);
+}
+
+void bench_run(void)
+{
+    /* Fixed, plausible readings so every run renders the same frame */
+    gatt_svc_pressure = 101325.0f;
+    gatt_svc_temperature = 21.5f;
+    gatt_svc_humidity = 45.0f;
+    gatt_svc_battery_mv = 2850;
+    gatt_svc_display_mode = DISPLAY_MODE_NORMAL;
+    sensors_valid = true;
+
+    bench_add("fb_draw_glyph", case_fb_draw_glyph, NULL, 1000);
+    bench_add("render_display", case_render_display, NULL, 100);
+    bench_add("comp_int", case_comp_int, NULL, 1000);
+    bench_add("comp_float", case_comp_float, NULL, 1000);
+    derived_init(&bench_derived, 0, 0);
+    bench_add("derived_update", case_derived_update, NULL, 1000);
+    tsc_enc_init(&bench_tsc, &bench_tsc_schema, bench_tsc_block,
+                 sizeof(bench_tsc_block));
+    bench_add("tsc_append", case_tsc_append, NULL, 1000);
+    add_gatt_cases();
+
+    ESP_LOGI(TAG, "running %d cases at -%s", num_cases, BENCH_OPT);
+    for (int i = 0; i < num_cases; i++) {
+        bench_one(&cases[i]);
+    }
+    printf("BENCH_DONE\n");
+    fflush(stdout);
+}
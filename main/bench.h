@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * Run every microbenchmark case and print one machine-readable result line
+ * per case.  Replaces the firmware's app_main when CONFIG_APP_BENCHMARK is
+ * set; see bench/README.md.
+ */
+void bench_run(void);
+
+#endif /* BENCH_H */
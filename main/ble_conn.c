@@ -0,0 +1,307 @@
+#include "ble_conn.h"
+
+#include <string.h>
+
+#include "memstat.h"
+#include "powerstat.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host/ble_hs.h"
+
+static const char *TAG = "ble_conn";
+
+/* Leave this many mbufs for ATT responses and the OTA service. */
+#define NOTIFY_MIN_FREE_MBUFS   4
+
+/* Parameters requested from each new central.  Relaxed, so several
+ * connections fit in the controller's schedule and the radio sleeps; the
+ * OTA service asks for a fast interval for the length of a transfer. */
+#define CONN_ITVL_MIN       40      /* 50 ms in 1.25 ms units */
+#define CONN_ITVL_MAX       80      /* 100 ms */
+#define CONN_LATENCY        4
+#define CONN_TIMEOUT        600     /* 6 s in 10 ms units */
+
+static struct ble_conn conns[BLE_CONN_MAX];
+static uint16_t notify_handles[BLE_CONN_MAX_NOTIFY_CHR];
+static int rr_next;
+static portMUX_TYPE conn_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ---- Lookup helpers ----------------------------------------------------- */
+
+static struct ble_conn *conn_find(uint16_t conn_handle)
+{
+    for (int i = 0; i < BLE_CONN_MAX; i++) {
+        if (conns[i].handle == conn_handle) {
+            return &conns[i];
+        }
+    }
+    return NULL;
+}
+
+/* Bit index for a characteristic value handle, allocated on first use. */
+static int notify_bit(uint16_t attr_handle, bool add)
+{
+    for (int i = 0; i < BLE_CONN_MAX_NOTIFY_CHR; i++) {
+        if (notify_handles[i] == attr_handle) {
+            return i;
+        }
+        if (notify_handles[i] == 0 && add) {
+            notify_handles[i] = attr_handle;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Copy the link's current parameters from the stack into its slot.  The
+ * query is made outside conn_lock; the slot is looked up again under it,
+ * as the link may have gone in between. */
+static bool conn_refresh_params(uint16_t conn_handle,
+                                struct ble_gap_conn_desc *desc)
+{
+    struct ble_conn *c;
+
+    if (ble_gap_conn_find(conn_handle, desc) != 0) {
+        return false;
+    }
+    taskENTER_CRITICAL(&conn_lock);
+    c = conn_find(conn_handle);
+    if (c) {
+        c->itvl = desc->conn_itvl;
+        c->latency = desc->conn_latency;
+        c->timeout = desc->supervision_timeout;
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+    return c != NULL;
+}
+
+static bool conn_live(uint16_t conn_handle)
+{
+    bool live;
+
+    taskENTER_CRITICAL(&conn_lock);
+    live = conn_find(conn_handle) != NULL;
+    taskEXIT_CRITICAL(&conn_lock);
+    return live;
+}
+
+/* Account one notification or indication to conn_handle, if still there */
+static void conn_count(uint16_t conn_handle, bool sent)
+{
+    taskENTER_CRITICAL(&conn_lock);
+    struct ble_conn *c = conn_find(conn_handle);
+    if (c) {
+        if (sent) {
+            c->notify_sent++;
+        } else {
+            c->notify_dropped++;
+        }
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+}
+
+/* ---- Connection table --------------------------------------------------- */
+
+void ble_conn_init(void)
+{
+    for (int i = 0; i < BLE_CONN_MAX; i++) {
+        conns[i].handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+}
+
+void ble_conn_add(uint16_t conn_handle)
+{
+    struct ble_conn *c;
+
+    taskENTER_CRITICAL(&conn_lock);
+    c = conn_find(BLE_HS_CONN_HANDLE_NONE);
+    if (c) {
+        memset(c, 0, sizeof(*c));
+        c->handle = conn_handle;
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+
+    if (c == NULL) {
+        ESP_LOGE(TAG, "no slot for connection %d", conn_handle);
+        return;
+    }
+    struct ble_gap_conn_desc desc;
+    conn_refresh_params(conn_handle, &desc);
+    powerstat_level(POWERSTAT_CONN, ble_conn_count());
+
+    struct ble_gap_upd_params params = {
+        .itvl_min = CONN_ITVL_MIN,
+        .itvl_max = CONN_ITVL_MAX,
+        .latency = CONN_LATENCY,
+        .supervision_timeout = CONN_TIMEOUT,
+    };
+    ble_gap_update_params(conn_handle, &params);
+
+    /* Free heap per connection count, to size
+     * CONFIG_BT_NIMBLE_MAX_CONNECTIONS from; `mem` keeps the last figures. */
+    memstat_connected(ble_conn_count());
+    ESP_LOGI(TAG, "connection %d: %d/%d slots, free heap %u (min %u)",
+             conn_handle, ble_conn_count(), BLE_CONN_MAX,
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+}
+
+void ble_conn_remove(uint16_t conn_handle)
+{
+    uint32_t sent = 0, dropped = 0;
+
+    taskENTER_CRITICAL(&conn_lock);
+    struct ble_conn *c = conn_find(conn_handle);
+    if (c) {
+        sent = c->notify_sent;
+        dropped = c->notify_dropped;
+        c->handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+    if (c) {
+        ESP_LOGD(TAG, "connection %d closed: %lu notifications, %lu dropped",
+                 conn_handle, (unsigned long)sent, (unsigned long)dropped);
+    }
+    powerstat_level(POWERSTAT_CONN, ble_conn_count());
+}
+
+int ble_conn_count(void)
+{
+    int n = 0;
+
+    taskENTER_CRITICAL(&conn_lock);
+    for (int i = 0; i < BLE_CONN_MAX; i++) {
+        if (conns[i].handle != BLE_HS_CONN_HANDLE_NONE) {
+            n++;
+        }
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+    return n;
+}
+
+bool ble_conn_slot_free(void)
+{
+    return ble_conn_count() < BLE_CONN_MAX;
+}
+
+/* ---- GAP event hooks ---------------------------------------------------- */
+
+void ble_conn_on_subscribe(const struct ble_gap_event *event)
+{
+    int bit = notify_bit(event->subscribe.attr_handle, true);
+    if (bit < 0) {
+        ESP_LOGW(TAG, "too many notifiable characteristics");
+        return;
+    }
+
+    taskENTER_CRITICAL(&conn_lock);
+    struct ble_conn *c = conn_find(event->subscribe.conn_handle);
+    if (c) {
+        if (event->subscribe.cur_notify) {
+            c->notify_mask |= 1u << bit;
+        } else {
+            c->notify_mask &= ~(1u << bit);
+        }
+        if (event->subscribe.cur_indicate) {
+            c->indicate_mask |= 1u << bit;
+        } else {
+            c->indicate_mask &= ~(1u << bit);
+        }
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+}
+
+void ble_conn_on_update(uint16_t conn_handle)
+{
+    struct ble_gap_conn_desc desc;
+
+    if (conn_refresh_params(conn_handle, &desc)) {
+        ESP_LOGI(TAG, "connection %d: interval %u.%02u ms, latency %u, "
+                 "timeout %u ms", conn_handle, desc.conn_itvl * 125 / 100,
+                 desc.conn_itvl * 125 % 100, desc.conn_latency,
+                 desc.supervision_timeout * 10);
+    }
+}
+
+bool ble_conn_indicating(uint16_t conn_handle, uint16_t attr_handle)
+{
+    int bit = notify_bit(attr_handle, false);
+    bool on = false;
+
+    if (bit < 0) {
+        return false;
+    }
+    taskENTER_CRITICAL(&conn_lock);
+    struct ble_conn *c = conn_find(conn_handle);
+    if (c) {
+        on = c->indicate_mask & (1u << bit);
+    }
+    taskEXIT_CRITICAL(&conn_lock);
+    return on;
+}
+
+/* ---- Notification fan-out ----------------------------------------------- */
+
+static void fan_out(uint16_t attr_handle, const void *data, size_t len,
+                    bool indicate)
+{
+    uint16_t targets[BLE_CONN_MAX];
+    int ntargets = 0;
+    int bit = notify_bit(attr_handle, false);
+
+    if (bit < 0) {
+        return;     /* nobody has ever subscribed */
+    }
+
+    /* Snapshot subscribers in round-robin order starting at rr_next */
+    taskENTER_CRITICAL(&conn_lock);
+    for (int n = 0; n < BLE_CONN_MAX; n++) {
+        struct ble_conn *c = &conns[(rr_next + n) % BLE_CONN_MAX];
+        uint16_t mask = indicate ? c->indicate_mask : c->notify_mask;
+        if (c->handle != BLE_HS_CONN_HANDLE_NONE && (mask & (1u << bit))) {
+            targets[ntargets++] = c->handle;
+        }
+    }
+    rr_next = (rr_next + 1) % BLE_CONN_MAX;
+    taskEXIT_CRITICAL(&conn_lock);
+
+    /* Sent outside the lock, so every slot access below takes it again; a
+     * target that disconnects after the check fails the send, and
+     * conn_count() then finds no slot to charge. */
+    memstat_sample();
+    for (int i = 0; i < ntargets; i++) {
+        if (!conn_live(targets[i])) {
+            continue;
+        }
+        if (os_msys_num_free() < NOTIFY_MIN_FREE_MBUFS) {
+            conn_count(targets[i], false);
+            continue;
+        }
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+        if (om == NULL) {
+            conn_count(targets[i], false);
+            continue;
+        }
+        /* Both calls consume om, also on failure */
+        int rc = indicate
+                     ? ble_gatts_indicate_custom(targets[i], attr_handle, om)
+                     : ble_gatts_notify_custom(targets[i], attr_handle, om);
+        conn_count(targets[i], rc == 0);
+        if (rc == 0) {
+            powerstat_count(POWERSTAT_NOTIFY);
+        }
+    }
+}
+
+void ble_conn_notify(uint16_t attr_handle, const void *data, size_t len)
+{
+    fan_out(attr_handle, data, len, false);
+}
+
+void ble_conn_indicate(uint16_t attr_handle, const void *data, size_t len)
+{
+    fan_out(attr_handle, data, len, true);
+}
@@ -0,0 +1,60 @@
+#ifndef BLE_CONN_H
+#define BLE_CONN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "host/ble_gap.h"
+
+/*
+ * Per-connection state for up to CONFIG_BT_NIMBLE_MAX_CONNECTIONS centrals:
+ * CCCD subscriptions, connection parameters and notification accounting.
+ * Called from the NimBLE host task (GAP events) and from any task that
+ * publishes values (ble_conn_notify, ble_conn_indicate).
+ */
+
+#define BLE_CONN_MAX            CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define BLE_CONN_MAX_NOTIFY_CHR 16  /* distinct notifiable characteristics */
+
+struct ble_conn {
+    uint16_t handle;            /* BLE_HS_CONN_HANDLE_NONE when free */
+    uint16_t notify_mask;       /* bit per tracked characteristic (CCCD) */
+    uint16_t indicate_mask;
+    uint16_t itvl;              /* 1.25 ms units */
+    uint16_t latency;
+    uint16_t timeout;           /* 10 ms units */
+    uint32_t notify_sent;
+    uint32_t notify_dropped;    /* skipped while the mbuf pool was low */
+};
+
+void ble_conn_init(void);
+void ble_conn_add(uint16_t conn_handle);
+void ble_conn_remove(uint16_t conn_handle);
+int  ble_conn_count(void);
+bool ble_conn_slot_free(void);
+
+/** GAP event hooks: SUBSCRIBE and CONN_UPDATE. */
+void ble_conn_on_subscribe(const struct ble_gap_event *event);
+void ble_conn_on_update(uint16_t conn_handle);
+
+/**
+ * Notify every connection subscribed to attr_handle.  The starting
+ * connection rotates on every call so no central is always served last, and
+ * a connection is skipped (and counted) rather than queued while the mbuf
+ * pool is nearly exhausted, so a stalled central cannot starve the others.
+ */
+void ble_conn_notify(uint16_t attr_handle, const void *data, size_t len);
+
+/**
+ * Indicate to every connection that enabled indications on attr_handle,
+ * with the same ordering and mbuf reserve as ble_conn_notify().  The stack
+ * allows one unconfirmed indication per connection; a send refused because
+ * the previous one is still pending counts as dropped.
+ */
+void ble_conn_indicate(uint16_t attr_handle, const void *data, size_t len);
+
+/** True if conn_handle has enabled indications on attr_handle. */
+bool ble_conn_indicating(uint16_t conn_handle, uint16_t attr_handle);
+
+#endif /* BLE_CONN_H */
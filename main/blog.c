@@ -0,0 +1,268 @@
+#include "blog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/base64.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG || \
+    CONFIG_ESP_CONSOLE_SECONDARY_USB_SERIAL_JTAG
+#include "driver/usb_serial_jtag.h"
+#endif
+
+/*
+ * Record layout (little-endian):
+ *
+ *   u8  len        whole record, header included
+ *   u8  level      esp_log_level_t, bit 7 set if arguments were cut short
+ *   u32 fmt        address of the format string
+ *   u32 tag        address of the tag string
+ *   u32 time       esp_log_timestamp(), ms
+ *   ... arguments
+ */
+#define BLOG_HDR_LEN        14
+#define BLOG_TRUNCATED      0x80
+
+#define BLOG_BATCH_MS       500     /* let a burst of records collect */
+
+static const char *TAG = "blog";
+
+static uint8_t ring[CONFIG_APP_BLOG_RING_SIZE];
+static size_t ring_head;            /* next byte written */
+static size_t ring_tail;            /* oldest record */
+static size_t ring_used;
+static uint32_t dropped;
+static bool drain_pending;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t drain_task;
+static StaticTask_t drain_tcb;
+static StackType_t drain_stack[BLOG_TASK_STACK];
+
+/* ---- Record encoding ---------------------------------------------------- */
+
+static void put(struct blog_rec *r, const void *src, size_t n)
+{
+    if (r->len + n > BLOG_REC_MAX) {
+        r->buf[1] |= BLOG_TRUNCATED;
+        return;
+    }
+    memcpy(r->buf + r->len, src, n);
+    r->len += n;
+}
+
+void blog_begin(struct blog_rec *r, esp_log_level_t level, const char *tag,
+                const char *fmt)
+{
+    uint32_t hdr[3] = {
+        (uint32_t)fmt, (uint32_t)tag, esp_log_timestamp(),
+    };
+
+    r->buf[0] = 0;
+    r->buf[1] = level;
+    memcpy(r->buf + 2, hdr, sizeof(hdr));
+    r->len = BLOG_HDR_LEN;
+}
+
+void blog_put_u32(struct blog_rec *r, uint32_t v)
+{
+    put(r, &v, sizeof(v));
+}
+
+void blog_put_u64(struct blog_rec *r, uint64_t v)
+{
+    put(r, &v, sizeof(v));
+}
+
+void blog_put_f64(struct blog_rec *r, double v)
+{
+    put(r, &v, sizeof(v));
+}
+
+void blog_put_ptr(struct blog_rec *r, const void *p)
+{
+    blog_put_u32(r, (uint32_t)p);
+}
+
+void blog_put_str(struct blog_rec *r, const char *s)
+{
+    uint8_t n;
+
+    if (s == NULL) {
+        s = "(null)";
+    }
+    n = strnlen(s, BLOG_STR_MAX);
+    if (r->len + 1 + n > BLOG_REC_MAX) {
+        r->buf[1] |= BLOG_TRUNCATED;
+        return;
+    }
+    r->buf[r->len++] = n;
+    put(r, s, n);
+}
+
+/* ---- Ring --------------------------------------------------------------- */
+
+static void ring_copy_in(const uint8_t *src, size_t n)
+{
+    size_t first = sizeof(ring) - ring_head;
+
+    if (first > n) {
+        first = n;
+    }
+    memcpy(ring + ring_head, src, first);
+    memcpy(ring, src + first, n - first);
+    ring_head = (ring_head + n) % sizeof(ring);
+    ring_used += n;
+}
+
+static void ring_copy_out(uint8_t *dst, size_t n)
+{
+    size_t first = sizeof(ring) - ring_tail;
+
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, ring + ring_tail, first);
+    memcpy(dst + first, ring, n - first);
+    ring_tail = (ring_tail + n) % sizeof(ring);
+    ring_used -= n;
+}
+
+void blog_commit(struct blog_rec *r)
+{
+    bool wake = false;
+
+    r->buf[0] = r->len;
+
+    taskENTER_CRITICAL(&ring_lock);
+    /* Drop the oldest records to make room: the newest are more useful. */
+    while (sizeof(ring) - ring_used < r->len) {
+        size_t n = ring[ring_tail];
+        ring_tail = (ring_tail + n) % sizeof(ring);
+        ring_used -= n;
+        dropped++;
+    }
+    ring_copy_in(r->buf, r->len);
+    if (!drain_pending && drain_task) {
+        drain_pending = true;
+        wake = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (wake) {
+        xTaskNotifyGive(drain_task);
+    }
+}
+
+size_t blog_used(void)
+{
+    return ring_used;
+}
+
+size_t blog_take(uint8_t *dst, size_t max)
+{
+    size_t n = 0;
+
+    taskENTER_CRITICAL(&ring_lock);
+    while (ring_used && n + ring[ring_tail] <= max) {
+        size_t len = ring[ring_tail];
+        ring_copy_out(dst + n, len);
+        n += len;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return n;
+}
+
+/* ---- Drain -------------------------------------------------------------- */
+
+static bool host_attached(void)
+{
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG || \
+    CONFIG_ESP_CONSOLE_SECONDARY_USB_SERIAL_JTAG
+    return usb_serial_jtag_is_connected();
+#else
+    return true;    /* a UART cannot tell */
+#endif
+}
+
+/* Identifies the build so the decoder can refuse a mismatched ELF. */
+static void print_build_id(void)
+{
+    char sha[17];
+
+    esp_app_get_elf_sha256(sha, sizeof(sha));
+    printf("#B:elf=%s\n", sha);
+}
+
+static void blog_drain_task(void *arg)
+{
+    uint8_t rec[BLOG_REC_MAX];
+    unsigned char line[4 * ((BLOG_REC_MAX + 2) / 3) + 1];
+    bool was_attached = false;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(BLOG_BATCH_MS));
+
+        taskENTER_CRITICAL(&ring_lock);
+        drain_pending = false;
+        taskEXIT_CRITICAL(&ring_lock);
+
+        /* Without a host the records stay in the ring, oldest overwritten
+         * first, until one attaches and something new is logged. */
+        if (!host_attached()) {
+            was_attached = false;
+            continue;
+        }
+        if (!was_attached) {
+            print_build_id();
+            was_attached = true;
+        }
+
+        for (;;) {
+            size_t n = 0;
+            uint32_t lost;
+
+            taskENTER_CRITICAL(&ring_lock);
+            if (ring_used) {
+                n = ring[ring_tail];
+                ring_copy_out(rec, n);
+            }
+            lost = dropped;
+            dropped = 0;
+            taskEXIT_CRITICAL(&ring_lock);
+
+            if (lost) {
+                printf("#B:dropped=%lu\n", lost);
+            }
+            if (n == 0) {
+                break;
+            }
+            size_t olen;
+            mbedtls_base64_encode(line, sizeof(line), &olen, rec, n);
+            printf("#B:%s\n", (char *)line);
+        }
+        fflush(stdout);
+    }
+}
+
+void blog_init(void)
+{
+    drain_task = xTaskCreateStatic(blog_drain_task, "blog", BLOG_TASK_STACK,
+                                   NULL, tskIDLE_PRIORITY + 1, drain_stack,
+                                   &drain_tcb);
+    ESP_LOGI(TAG, "binary log: %u byte ring, decode with "
+             "tools/blog_decode.py", (unsigned)sizeof(ring));
+
+    /* Flush whatever was recorded before the task existed. */
+    taskENTER_CRITICAL(&ring_lock);
+    drain_pending = ring_used != 0;
+    taskEXIT_CRITICAL(&ring_lock);
+    if (drain_pending) {
+        xTaskNotifyGive(drain_task);
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef BLOG_H
+#define BLOG_H
+
+/*
+ * Deferred binary logging.
+ *
+ * A record is the address of the format string, the address of the tag,
+ * a millisecond timestamp, the level and the raw argument bytes.  Nothing
+ * is formatted on the device: records go into a RAM ring and a low-priority
+ * task writes them out as "#B:<base64>" lines, only while a host is
+ * attached to the USB Serial/JTAG port.  tools/blog_decode.py looks the
+ * strings up in the ELF and prints the usual "I (1234) tag: message" lines.
+ *
+ * A module opts in by defining BLOG_LOCAL and including this header after
+ * esp_log.h; its ESP_LOGx calls then become records.  Removing the define
+ * (or turning off CONFIG_APP_BLOG) gives plain ESP_LOG back.  Levels
+ * are filtered at compile time against BLOG_LEVEL, which defaults to
+ * CONFIG_LOG_DEFAULT_LEVEL and can be raised per module before the
+ * include; esp_log_level_set() has no effect on records.
+ *
+ * Arguments are stored by type, the same way printf promotes them:
+ * floats as 8-byte doubles, (unsigned) long long as 8 bytes, strings as a
+ * length byte plus up to BLOG_STR_MAX characters, everything else as 4
+ * bytes.  At most BLOG_MAX_ARGS arguments per call.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define BLOG_REC_MAX    96      /* bytes per record, header included */
+#define BLOG_STR_MAX    24
+#define BLOG_MAX_ARGS   8
+#define BLOG_TASK_STACK 2560    /* drain task, bytes */
+
+#ifndef BLOG_LEVEL
+#define BLOG_LEVEL      CONFIG_LOG_DEFAULT_LEVEL
+#endif
+
+struct blog_rec {
+    uint8_t len;
+    uint8_t buf[BLOG_REC_MAX];
+};
+
+void blog_begin(struct blog_rec *r, esp_log_level_t level, const char *tag,
+                const char *fmt);
+void blog_put_u32(struct blog_rec *r, uint32_t v);
+void blog_put_u64(struct blog_rec *r, uint64_t v);
+void blog_put_f64(struct blog_rec *r, double v);
+void blog_put_str(struct blog_rec *r, const char *s);
+void blog_put_ptr(struct blog_rec *r, const void *p);
+void blog_commit(struct blog_rec *r);
+
+/** Start the drain task.  Records written before this are kept. */
+void blog_init(void);
+
+/** Bytes of records waiting in the ring. */
+size_t blog_used(void);
+
+/** Move whole records, oldest first, into dst while they fit in max bytes;
+ *  returns the bytes moved.  Records taken here are not printed. */
+size_t blog_take(uint8_t *dst, size_t max);
+
+/* ---- Argument encoding -------------------------------------------------- */
+
+#define BLOG_PUT_ARG(r, x) _Generic((x),                                    \
+        float: blog_put_f64,                                                \
+        double: blog_put_f64,                                               \
+        long long: blog_put_u64,                                            \
+        unsigned long long: blog_put_u64,                                   \
+        char *: blog_put_str,                                               \
+        const char *: blog_put_str,                                         \
+        void *: blog_put_ptr,                                               \
+        const void *: blog_put_ptr,                                         \
+        default: blog_put_u32)((r), (x));
+
+#define BLOG_NARG(...)  BLOG_NARG_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define BLOG_NARG_(_, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+#define BLOG_CAT(a, b)  BLOG_CAT_(a, b)
+#define BLOG_CAT_(a, b) a##b
+
+#define BLOG_ARGS_0(r)
+#define BLOG_ARGS_1(r, x)      BLOG_PUT_ARG(r, x)
+#define BLOG_ARGS_2(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_1(r, __VA_ARGS__)
+#define BLOG_ARGS_3(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_2(r, __VA_ARGS__)
+#define BLOG_ARGS_4(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_3(r, __VA_ARGS__)
+#define BLOG_ARGS_5(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_4(r, __VA_ARGS__)
+#define BLOG_ARGS_6(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_5(r, __VA_ARGS__)
+#define BLOG_ARGS_7(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_6(r, __VA_ARGS__)
+#define BLOG_ARGS_8(r, x, ...) BLOG_PUT_ARG(r, x) BLOG_ARGS_7(r, __VA_ARGS__)
+
+#define BLOG(level, tag, fmt, ...) do {                                     \
+        if (BLOG_LEVEL >= (level)) {                                        \
+            struct blog_rec _blog_r;                                        \
+            blog_begin(&_blog_r, (level), (tag), (fmt));                    \
+            BLOG_CAT(BLOG_ARGS_, BLOG_NARG(__VA_ARGS__))(&_blog_r,          \
+                                                         ##__VA_ARGS__)     \
+            blog_commit(&_blog_r);                                          \
+        }                                                                   \
+    } while (0)
+
+#endif /* BLOG_H */
+
+/* ---- ESP_LOG compatibility ---------------------------------------------- */
+
+/* Outside the include guard so that it applies even when another header
+ * has already pulled this one in. */
+#if CONFIG_APP_BLOG && defined(BLOG_LOCAL) && !defined(BLOG_LOCAL_DONE)
+#define BLOG_LOCAL_DONE
+#undef ESP_LOGE
+#undef ESP_LOGW
+#undef ESP_LOGI
+#undef ESP_LOGD
+#undef ESP_LOGV
+#define ESP_LOGE(tag, fmt, ...) BLOG(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) BLOG(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) BLOG(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) BLOG(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) BLOG(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+#endif
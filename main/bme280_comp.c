@@ -0,0 +1,146 @@
+#include "bme280_comp.h"
+
+/* ---- Integer compensation ----------------------------------------------- */
+
+int32_t bme280_comp_temp_int(const struct bme280_calib *c, int32_t adc_t,
+                             int32_t *t_fine)
+{
+    int32_t var1, var2;
+
+    var1 = ((((adc_t >> 3) - ((int32_t)c->t1 << 1))) * ((int32_t)c->t2)) >> 11;
+    var2 = (((((adc_t >> 4) - ((int32_t)c->t1)) *
+              ((adc_t >> 4) - ((int32_t)c->t1))) >> 12) *
+            ((int32_t)c->t3)) >> 14;
+    *t_fine = var1 + var2;
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+uint32_t bme280_comp_press_int(const struct bme280_calib *c, int32_t adc_p,
+                               int32_t t_fine)
+{
+    int64_t var1, var2, p;
+
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)c->p6;
+    var2 = var2 + ((var1 * (int64_t)c->p5) << 17);
+    var2 = var2 + (((int64_t)c->p4) << 35);
+    var1 = ((var1 * var1 * (int64_t)c->p3) >> 8) +
+           ((var1 * (int64_t)c->p2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c->p1) >> 33;
+    if (var1 == 0) {
+        return 0;   /* avoid division by zero */
+    }
+    p = 1048576 - adc_p;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)c->p9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)c->p8) * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + (((int64_t)c->p7) << 4);
+    return (uint32_t)p;
+}
+
+uint32_t bme280_comp_hum_int(const struct bme280_calib *c, int32_t adc_h,
+                             int32_t t_fine)
+{
+    int32_t v = t_fine - ((int32_t)76800);
+
+    v = (((((adc_h << 14) - (((int32_t)c->h4) << 20) -
+            (((int32_t)c->h5) * v)) + ((int32_t)16384)) >> 15) *
+         (((((((v * ((int32_t)c->h6)) >> 10) *
+              (((v * ((int32_t)c->h3)) >> 11) + ((int32_t)32768))) >> 10) +
+            ((int32_t)2097152)) * ((int32_t)c->h2) + 8192) >> 14));
+    v = v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t)c->h1)) >> 4);
+    v = v < 0 ? 0 : v;
+    v = v > 419430400 ? 419430400 : v;
+    return (uint32_t)(v >> 12);
+}
+
+/* ---- Floating point compensation ---------------------------------------- */
+
+float bme280_comp_temp_float(const struct bme280_calib *c, int32_t adc_t,
+                             int32_t *t_fine)
+{
+    float var1, var2;
+
+    var1 = ((float)adc_t / 16384.0f - (float)c->t1 / 1024.0f) * (float)c->t2;
+    var2 = ((float)adc_t / 131072.0f - (float)c->t1 / 8192.0f);
+    var2 = var2 * var2 * (float)c->t3;
+    *t_fine = (int32_t)(var1 + var2);
+    return (var1 + var2) / 5120.0f;
+}
+
+float bme280_comp_press_float(const struct bme280_calib *c, int32_t adc_p,
+                              int32_t t_fine)
+{
+    float var1, var2, p;
+
+    var1 = ((float)t_fine / 2.0f) - 64000.0f;
+    var2 = var1 * var1 * (float)c->p6 / 32768.0f;
+    var2 = var2 + var1 * (float)c->p5 * 2.0f;
+    var2 = (var2 / 4.0f) + ((float)c->p4 * 65536.0f);
+    var1 = ((float)c->p3 * var1 * var1 / 524288.0f +
+            (float)c->p2 * var1) / 524288.0f;
+    var1 = (1.0f + var1 / 32768.0f) * (float)c->p1;
+    if (var1 == 0.0f) {
+        return 0.0f;    /* avoid division by zero */
+    }
+    p = 1048576.0f - (float)adc_p;
+    p = (p - (var2 / 4096.0f)) * 6250.0f / var1;
+    var1 = (float)c->p9 * p * p / 2147483648.0f;
+    var2 = p * (float)c->p8 / 32768.0f;
+    return p + (var1 + var2 + (float)c->p7) / 16.0f;
+}
+
+float bme280_comp_hum_float(const struct bme280_calib *c, int32_t adc_h,
+                            int32_t t_fine)
+{
+    float h = (float)t_fine - 76800.0f;
+
+    h = ((float)adc_h - ((float)c->h4 * 64.0f + (float)c->h5 / 16384.0f * h)) *
+        ((float)c->h2 / 65536.0f *
+         (1.0f + (float)c->h6 / 67108864.0f * h *
+                 (1.0f + (float)c->h3 / 67108864.0f * h)));
+    h = h * (1.0f - (float)c->h1 * h / 524288.0f);
+    if (h > 100.0f) h = 100.0f;
+    if (h < 0.0f) h = 0.0f;
+    return h;
+}
+
+/* ---- Register images ---------------------------------------------------- */
+
+static uint16_t le16(const uint8_t *b)
+{
+    return (uint16_t)(b[0] | b[1] << 8);
+}
+
+void bme280_calib_parse(const uint8_t *regs, struct bme280_calib *c)
+{
+    const uint8_t *h = regs + 26;       /* 0xe1 */
+
+    c->t1 = le16(regs + 0);
+    c->t2 = (int16_t)le16(regs + 2);
+    c->t3 = (int16_t)le16(regs + 4);
+    c->p1 = le16(regs + 6);
+    c->p2 = (int16_t)le16(regs + 8);
+    c->p3 = (int16_t)le16(regs + 10);
+    c->p4 = (int16_t)le16(regs + 12);
+    c->p5 = (int16_t)le16(regs + 14);
+    c->p6 = (int16_t)le16(regs + 16);
+    c->p7 = (int16_t)le16(regs + 18);
+    c->p8 = (int16_t)le16(regs + 20);
+    c->p9 = (int16_t)le16(regs + 22);
+    c->h1 = regs[25];                   /* 0xa1; 0xa0 is unused */
+    c->h2 = (int16_t)le16(h + 0);
+    c->h3 = h[2];
+    /* H4 and H5 are 12-bit values sharing the nibbles of 0xe5 */
+    c->h4 = (int16_t)((int8_t)h[3] * 16 | (h[4] & 0x0f));
+    c->h5 = (int16_t)((int8_t)h[5] * 16 | h[4] >> 4);
+    c->h6 = (int8_t)h[6];
+}
+
+void bme280_data_parse(const uint8_t *regs, int32_t *adc_t, int32_t *adc_p,
+                       int32_t *adc_h)
+{
+    *adc_p = (int32_t)regs[0] << 12 | regs[1] << 4 | regs[2] >> 4;
+    *adc_t = (int32_t)regs[3] << 12 | regs[4] << 4 | regs[5] >> 4;
+    *adc_h = (int32_t)regs[6] << 8 | regs[7];
+}
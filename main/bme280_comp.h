@@ -0,0 +1,52 @@
+#ifndef BME280_COMP_H
+#define BME280_COMP_H
+
+#include <stdint.h>
+
+/*
+ * BME280 compensation formulas from the Bosch datasheet (BST-BME280-DS002,
+ * section 4.2.3 and appendix 8.1), in both the integer and the floating
+ * point form.  The bmx280 component does its own compensation; these exist
+ * so the two forms can be benchmarked against each other and so raw
+ * readouts can be compensated off-device.
+ */
+
+struct bme280_calib {
+    uint16_t t1;
+    int16_t  t2, t3;
+    uint16_t p1;
+    int16_t  p2, p3, p4, p5, p6, p7, p8, p9;
+    uint8_t  h1;
+    int16_t  h2;
+    uint8_t  h3;
+    int16_t  h4, h5;
+    int8_t   h6;
+};
+
+/* Integer forms.  Temperature in 0.01 °C, pressure in Q24.8 Pa,
+ * humidity in Q22.10 %RH.  t_fine carries temperature into the others. */
+int32_t  bme280_comp_temp_int(const struct bme280_calib *c, int32_t adc_t,
+                              int32_t *t_fine);
+uint32_t bme280_comp_press_int(const struct bme280_calib *c, int32_t adc_p,
+                               int32_t t_fine);
+uint32_t bme280_comp_hum_int(const struct bme280_calib *c, int32_t adc_h,
+                             int32_t t_fine);
+
+/* Floating point forms.  Temperature in °C, pressure in Pa, humidity in %RH. */
+float bme280_comp_temp_float(const struct bme280_calib *c, int32_t adc_t,
+                             int32_t *t_fine);
+float bme280_comp_press_float(const struct bme280_calib *c, int32_t adc_p,
+                              int32_t t_fine);
+float bme280_comp_hum_float(const struct bme280_calib *c, int32_t adc_h,
+                            int32_t t_fine);
+
+/* Register images as read over I2C: the calibration is 0x88-0xa1 followed
+ * by 0xe1-0xe7, a readout is 0xf7-0xfe (pressure, temperature, humidity). */
+#define BME280_CALIB_LEN    33
+#define BME280_DATA_LEN     8
+
+void bme280_calib_parse(const uint8_t *regs, struct bme280_calib *c);
+void bme280_data_parse(const uint8_t *regs, int32_t *adc_t, int32_t *adc_p,
+                       int32_t *adc_h);
+
+#endif /* BME280_COMP_H */
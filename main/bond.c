@@ -0,0 +1,140 @@
+#include "bond.h"
+#include "gatt_svc.h"
+#include "ota_svc.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "host/ble_hs.h"
+#include "host/ble_store.h"
+#include "host/ble_uuid.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+static const char *TAG = "bond";
+
+#define BOND_NVS_NAMESPACE  "bond"
+
+/* Not in a public header; the ESP-IDF NimBLE examples declare it too. */
+void ble_store_config_init(void);
+
+/* ---- GATT layout fingerprint -------------------------------------------- */
+
+static void hash_uuid(mbedtls_sha256_context *sha, const ble_uuid_t *uuid)
+{
+    uint8_t flat[16];
+
+    ble_uuid_flat(uuid, flat);
+    mbedtls_sha256_update(sha, flat, ble_uuid_length(uuid));
+}
+
+/* Everything that decides attribute handles and properties: service and
+ * characteristic UUIDs in registration order, flags, descriptors and the
+ * handles the stack assigned. */
+static void hash_svcs(mbedtls_sha256_context *sha,
+                      const struct ble_gatt_svc_def *svc)
+{
+    for (; svc && svc->type; svc++) {
+        mbedtls_sha256_update(sha, &svc->type, 1);
+        hash_uuid(sha, svc->uuid);
+        for (const struct ble_gatt_chr_def *chr = svc->characteristics;
+             chr && chr->uuid; chr++) {
+            uint16_t v[2] = { chr->flags,
+                              chr->val_handle ? *chr->val_handle : 0 };
+            hash_uuid(sha, chr->uuid);
+            mbedtls_sha256_update(sha, (const uint8_t *)v, sizeof(v));
+            for (const struct ble_gatt_dsc_def *dsc = chr->descriptors;
+                 dsc && dsc->uuid; dsc++) {
+                hash_uuid(sha, dsc->uuid);
+                mbedtls_sha256_update(sha, &dsc->att_flags, 1);
+            }
+        }
+    }
+}
+
+static uint64_t gatt_fingerprint(void)
+{
+    mbedtls_sha256_context sha;
+    uint8_t digest[32];
+    uint64_t fp;
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    hash_svcs(&sha, gatt_svc_get_defs());
+    hash_svcs(&sha, ota_svc_get_defs());
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    memcpy(&fp, digest, sizeof(fp));
+    return fp;
+}
+
+void bond_on_sync(void)
+{
+    nvs_handle_t nvs;
+    uint64_t fp = gatt_fingerprint();
+    uint64_t saved = 0;
+
+    if (nvs_open(BOND_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    nvs_get_u64(nvs, "gatt_fp", &saved);
+    if (saved != fp) {
+        /* A first boot has no bonds, so this only matters after an
+         * update; cached handles may all have moved. */
+        if (saved != 0) {
+            ESP_LOGI(TAG, "GATT layout changed, indicating Service Changed");
+            ble_svc_gatt_changed(0x0001, 0xffff);
+        }
+        nvs_set_u64(nvs, "gatt_fp", fp);
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+/* ---- Security manager --------------------------------------------------- */
+
+void bond_init(void)
+{
+    ble_hs_cfg.sm_io_cap = BLE_HS_IO_NO_INPUT_OUTPUT;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_mitm = 0;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC |
+                                 BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC |
+                                   BLE_SM_PAIR_KEY_DIST_ID;
+    /* When the store is full, forget the least recently bonded peer. */
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+
+    ble_store_config_init();
+}
+
+int bond_on_gap_event(struct ble_gap_event *event)
+{
+    struct ble_gap_conn_desc desc;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        if (ble_gap_conn_find(event->enc_change.conn_handle, &desc) == 0) {
+            ESP_LOGI(TAG, "connection %d: encryption %s%s",
+                     event->enc_change.conn_handle,
+                     event->enc_change.status == 0 ? "on" : "failed",
+                     desc.sec_state.bonded ? ", bonded" : "");
+        }
+        return 0;
+
+    case BLE_GAP_EVENT_REPEAT_PAIRING:
+        /* The central lost its keys (e.g. "forget device").  Drop ours
+         * and let it pair again rather than refusing it forever. */
+        if (ble_gap_conn_find(event->repeat_pairing.conn_handle,
+                              &desc) == 0) {
+            ble_store_util_delete_peer(&desc.peer_id_addr);
+        }
+        return BLE_GAP_REPEAT_PAIRING_RETRY;
+
+    default:
+        return 0;
+    }
+}
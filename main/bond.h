@@ -0,0 +1,32 @@
+#ifndef BOND_H
+#define BOND_H
+
+#include "host/ble_gap.h"
+
+/*
+ * Bonding and GATT caching.
+ *
+ * Centrals may pair with LE Secure Connections (Just Works; there is no
+ * display or keyboard to confirm a passkey).  Keys and CCCD state are kept
+ * in NVS, so a bonded central reconnects encrypted with its subscriptions
+ * intact.  With CONFIG_BT_NIMBLE_GATT_CACHING the GATT service carries the
+ * Database Hash and Client Supported Features characteristics, so a client
+ * can check one hash instead of rediscovering every characteristic.
+ *
+ * A fingerprint of the registered services is kept in NVS.  When a new
+ * image changes the layout, Service Changed is indicated to every bonded
+ * central (on its next connection, if it is not connected now) so none of
+ * them keeps using stale handles.
+ */
+
+/** Configure the security manager and the NVS key store.  Call after
+ *  nimble_port_init() and before the host task starts. */
+void bond_init(void);
+
+/** Host synced: compare the GATT layout with the last boot's. */
+void bond_on_sync(void);
+
+/** GAP ENC_CHANGE and REPEAT_PAIRING; returns the value for the stack. */
+int bond_on_gap_event(struct ble_gap_event *event);
+
+#endif /* BOND_H */
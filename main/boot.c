@@ -0,0 +1,86 @@
+#include "boot.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+static const char *TAG = "boot";
+
+static struct {
+    const char *phase;
+    int64_t us;
+} marks[BOOT_MARKS_MAX];
+static unsigned mark_count;
+static bool printed;
+static portMUX_TYPE marks_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static StaticEventGroup_t events_buf;
+static EventGroupHandle_t events;
+
+/* ---- Timeline ----------------------------------------------------------- */
+
+void boot_mark(const char *phase)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&marks_lock);
+    if (!printed && mark_count < BOOT_MARKS_MAX) {
+        marks[mark_count].phase = phase;
+        marks[mark_count].us = now;
+        mark_count++;
+    }
+    taskEXIT_CRITICAL(&marks_lock);
+}
+
+void boot_print(void)
+{
+    int64_t prev;
+
+    /* Marks are only appended until printed is set, so the table is stable
+     * to read outside the lock afterwards. */
+    taskENTER_CRITICAL(&marks_lock);
+    printed = true;
+    taskEXIT_CRITICAL(&marks_lock);
+
+    if (mark_count == 0) {
+        return;
+    }
+    prev = marks[0].us;
+    ESP_LOGI(TAG, "timeline (ms since app_main, +ms since previous):");
+    for (unsigned i = 0; i < mark_count; i++) {
+        ESP_LOGI(TAG, "  %7.1f  %+7.1f  %s",
+                 (marks[i].us - marks[0].us) / 1000.0,
+                 (marks[i].us - prev) / 1000.0, marks[i].phase);
+        prev = marks[i].us;
+    }
+}
+
+/* ---- Events ------------------------------------------------------------- */
+
+void boot_signal(uint32_t bits)
+{
+    if (events) {
+        xEventGroupSetBits(events, bits);
+    }
+}
+
+bool boot_wait(uint32_t bits, uint32_t timeout_ms)
+{
+    EventBits_t got;
+
+    if (!events) {
+        return false;
+    }
+    got = xEventGroupWaitBits(events, bits, pdFALSE, pdTRUE,
+                              pdMS_TO_TICKS(timeout_ms));
+    return (got & bits) == bits;
+}
+
+/* ---- Initialization ----------------------------------------------------- */
+
+void boot_init(void)
+{
+    events = xEventGroupCreateStatic(&events_buf);
+    boot_mark("app_main");
+}
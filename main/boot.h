@@ -0,0 +1,43 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Boot timeline and start-up sequencing.  app_main and the tasks it starts
+ * mark the end of each init phase with boot_mark(); once the device is
+ * advertising and the deferred work has run, boot_print() logs the marks
+ * as one table.  Times are esp_timer microseconds, which start counting
+ * shortly before app_main (the ROM and second-stage bootloader are not
+ * included).
+ *
+ * The BOOT_EV_* bits let app_main wait for work running elsewhere: the
+ * peripheral init task and the first advertisement from the host task.
+ */
+
+#define BOOT_MARKS_MAX      16
+
+#define BOOT_EV_PERIPH      0x01    /* display and sensor init finished */
+#define BOOT_EV_ADV         0x02    /* first advertisement started */
+
+/** Set up the event bits and take the first mark; call first in app_main. */
+void boot_init(void);
+
+/**
+ * Record that a phase ended now.  phase must outlive the call (a string
+ * literal).  Marks after boot_print() or beyond BOOT_MARKS_MAX are dropped,
+ * so a later host resync doesn't add to the table.
+ */
+void boot_mark(const char *phase);
+
+/** Set BOOT_EV_* bits, waking whoever waits on them. */
+void boot_signal(uint32_t bits);
+
+/** Wait until all of the given bits are set; false on timeout. */
+bool boot_wait(uint32_t bits, uint32_t timeout_ms);
+
+/** Log the timeline: time since app_main and since the previous mark. */
+void boot_print(void);
+
+#endif /* BOOT_H */
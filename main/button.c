@@ -1,10 +1,10 @@
 #include "button.h"
 #include "battery.h"
+#include "record.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
 
 #define BUTTON_GPIO 4
-#define LED_GPIO 8
 
 /* ---- Time Stamp for Button Press ----------------------------------------- */
 
@@ -12,16 +12,25 @@
 // Initialized to 10 seconds ago to avoid spurious display on startup
 volatile int64_t button_time = -100000000;
 
+// Presses counted separately, since other code also sets button_time to
+// wake the display
+volatile uint32_t button_presses;
+
 /* ---- Button polling function --------------------------------------------- */
 static bool button_was_pressed = false;
 
 void button_poll(void)
 {
-    bool pressed = (button_read_mv() < 1500);
+    int mv = button_read_mv();
+    bool pressed = (mv < BUTTON_PRESSED_MV);
+    if (pressed != button_was_pressed) {
+        record_button(mv);
+    }
     if (pressed && !button_was_pressed) {
         int64_t now = esp_timer_get_time();
-        if (now - button_time > 300000) {
+        if (now - button_time > BUTTON_DEBOUNCE_US) {
             button_time = now;
+            button_presses++;
         }
     }
     button_was_pressed = pressed;
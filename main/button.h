@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 
+#define BUTTON_PRESSED_MV   1500    /* ADC reads ~2888 mV when open */
+#define BUTTON_DEBOUNCE_US  300000
+
 extern volatile int64_t button_time; // Time of last button press in microseconds
+extern volatile uint32_t button_presses; // Presses since boot
 void button_init(void);
 void button_poll(void);
 
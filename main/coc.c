@@ -0,0 +1,357 @@
+#include "coc.h"
+#include "coc_proto.h"
+
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#include "sdkconfig.h"
+
+#include "history.h"
+#include "record.h"
+#if CONFIG_APP_BLOG
+#include "blog.h"
+#endif
+
+static const char *TAG = "coc";
+
+#define COC_RX_MTU          64      /* requests are a few bytes */
+#define COC_SDU_MAX         1024    /* largest frame we send */
+#define COC_MIN_FREE_MBUFS  8       /* leave room for ATT and the radio */
+#define COC_RETRY_MS        5       /* when mbufs run short */
+#define COC_ITVL_MIN        6       /* LINK limits, 1.25 ms units */
+#define COC_ITVL_MAX        400
+#define COC_TIMEOUT         400     /* 4 s in 10 ms units */
+#define COC_PHYS_ALL        (BLE_GAP_LE_PHY_1M_MASK | \
+                             BLE_GAP_LE_PHY_2M_MASK | \
+                             BLE_GAP_LE_PHY_CODED_MASK)
+
+static struct coc_session session;
+static struct ble_l2cap_chan *coc_chan;     /* one channel at a time */
+static uint16_t coc_conn;
+static uint16_t coc_sdu;        /* frame size: ours or the peer's MTU */
+static bool coc_stalled;
+
+/* The frame being sent, kept until the stack takes it */
+static uint8_t frame[COC_SDU_MAX];
+static size_t frame_len;
+static uint8_t rsp[128];
+static size_t rsp_len;
+
+static struct ble_npl_callout coc_retry;
+static esp_pm_lock_handle_t coc_pm_lock;
+static bool coc_pm_held;
+
+/* ---- Streams ------------------------------------------------------------ */
+
+static uint32_t history_size(void)
+{
+    return history_count() * sizeof(struct history_sample);
+}
+
+static size_t history_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len) {
+        struct history_sample s;
+        size_t i = (off + n) / sizeof(s), at = (off + n) % sizeof(s);
+        size_t k = sizeof(s) - at;
+
+        if (!history_get(i, &s)) {
+            break;
+        }
+        if (k > len - n) {
+            k = len - n;
+        }
+        memcpy(buf + n, (const uint8_t *)&s + at, k);
+        n += k;
+    }
+    return n;
+}
+
+#if CONFIG_APP_TRACE
+static size_t trace_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    return record_read(off, buf, len);
+}
+#endif
+
+#if CONFIG_APP_BLOG
+#define ELF_ID_LEN  16
+
+static uint32_t logs_size(void)
+{
+    return ELF_ID_LEN + blog_used();
+}
+
+/* The build id first, so the log can be decoded against the right ELF */
+static size_t logs_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    if (off < ELF_ID_LEN) {
+        char sha[ELF_ID_LEN + 1];
+        size_t n = ELF_ID_LEN - off < len ? ELF_ID_LEN - off : len;
+
+        esp_app_get_elf_sha256(sha, sizeof(sha));
+        memcpy(buf, sha + off, n);
+        return n;
+    }
+    return blog_take(buf, len);
+}
+#endif
+
+static uint32_t bench_size(void)
+{
+    return COC_BENCH_BYTES;
+}
+
+static size_t bench_read(uint32_t off, uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(off + i);
+    }
+    return len;
+}
+
+static const struct coc_stream streams[] = {
+    { "history", history_size, history_read },
+#if CONFIG_APP_TRACE
+    { "trace",   record_size,  trace_read },
+#endif
+#if CONFIG_APP_BLOG
+    { "logs",    logs_size,    logs_read },
+#endif
+    { "bench",   bench_size,   bench_read },
+};
+
+/* ---- Sending ------------------------------------------------------------ */
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void hold_awake(bool hold)
+{
+    if (hold == coc_pm_held || coc_pm_lock == NULL) {
+        return;
+    }
+    coc_pm_held = hold;
+    if (hold) {
+        esp_pm_lock_acquire(coc_pm_lock);
+    } else {
+        esp_pm_lock_release(coc_pm_lock);
+    }
+}
+
+static void link_get(struct coc_link *link)
+{
+    struct ble_gap_conn_desc desc;
+
+    memset(link, 0, sizeof(*link));
+    if (ble_gap_conn_find(coc_conn, &desc) == 0) {
+        link->itvl = desc.conn_itvl;
+    }
+    ble_gap_read_le_phy(coc_conn, &link->tx_phy, &link->rx_phy);
+}
+
+/* Send frames until the peer runs out of credits, the mbufs run short or
+ * there is nothing left.  Runs on the host task only: from the L2CAP
+ * events and from the retry callout, which NimBLE queues there too. */
+static void pump(void)
+{
+    while (coc_chan && !coc_stalled) {
+        if (frame_len == 0) {
+            if (rsp_len) {
+                memcpy(frame, rsp, rsp_len);
+                frame_len = rsp_len;
+                rsp_len = 0;
+            } else if (coc_proto_busy(&session)) {
+                struct coc_link link;
+                link_get(&link);
+                frame_len = coc_proto_next(&session, frame, coc_sdu,
+                                           now_ms(), &link);
+            }
+            if (frame_len == 0) {
+                break;
+            }
+        }
+
+        if (os_msys_num_free() < COC_MIN_FREE_MBUFS) {
+            ble_npl_callout_reset(&coc_retry,
+                                  ble_npl_time_ms_to_ticks32(COC_RETRY_MS));
+            return;
+        }
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(frame, frame_len);
+        if (om == NULL) {
+            ble_npl_callout_reset(&coc_retry,
+                                  ble_npl_time_ms_to_ticks32(COC_RETRY_MS));
+            return;
+        }
+
+        /* ESTALLED: the SDU is queued and goes out as credits arrive.
+         * EBUSY leaves om with us and the frame for later; other errors
+         * free it. */
+        int rc = ble_l2cap_send(coc_chan, om);
+        if (rc == BLE_HS_EBUSY) {
+            os_mbuf_free_chain(om);
+            ble_npl_callout_reset(&coc_retry,
+                                  ble_npl_time_ms_to_ticks32(COC_RETRY_MS));
+            return;
+        }
+        if (rc == BLE_HS_ESTALLED) {
+            coc_stalled = true;
+        } else if (rc != 0) {
+            ESP_LOGW(TAG, "send failed: %d", rc);
+            coc_proto_stop(&session, COC_STATUS_FAILED);
+        }
+        frame_len = 0;
+    }
+    if (!coc_proto_busy(&session) && frame_len == 0) {
+        hold_awake(false);
+    }
+}
+
+static void retry_cb(struct ble_npl_event *ev)
+{
+    pump();
+}
+
+/* ---- Requests ----------------------------------------------------------- */
+
+static uint8_t link_request(const struct coc_link_req *l)
+{
+    struct ble_gap_upd_params params = {
+        .itvl_min = l->itvl,
+        .itvl_max = l->itvl,
+        .latency = 0,
+        .supervision_timeout = COC_TIMEOUT,
+    };
+
+    if (l->itvl < COC_ITVL_MIN || l->itvl > COC_ITVL_MAX ||
+        (l->phys & ~COC_PHYS_ALL)) {
+        return COC_STATUS_BAD_REQUEST;
+    }
+    if (ble_gap_update_params(coc_conn, &params) != 0) {
+        return COC_STATUS_FAILED;
+    }
+    if (l->phys &&
+        ble_gap_set_prefered_le_phy(coc_conn, l->phys, l->phys,
+                                    BLE_GAP_LE_PHY_CODED_ANY) != 0) {
+        return COC_STATUS_FAILED;
+    }
+    ESP_LOGI(TAG, "link: interval %u.%02u ms, PHY mask 0x%x asked",
+             l->itvl * 125 / 100, l->itvl * 125 % 100, l->phys);
+    return COC_STATUS_OK;
+}
+
+static void on_request(struct os_mbuf *sdu)
+{
+    uint8_t req[COC_RX_MTU];
+    uint16_t len = OS_MBUF_PKTLEN(sdu);
+    struct coc_link_req link;
+
+    if (len > sizeof(req)) {
+        len = sizeof(req);
+    }
+    os_mbuf_copydata(sdu, 0, len, req);
+
+    rsp_len = coc_proto_request(&session, req, len, now_ms(), rsp,
+                                sizeof(rsp), &link);
+    if (len && req[0] == COC_OP_LINK && rsp_len == 0) {
+        rsp_len = coc_proto_rsp(rsp, COC_OP_LINK, link_request(&link));
+    }
+    if (coc_proto_busy(&session)) {
+        hold_awake(true);
+    }
+    pump();
+}
+
+/* ---- L2CAP events ------------------------------------------------------- */
+
+static int rx_ready(struct ble_l2cap_chan *chan)
+{
+    struct os_mbuf *om = os_msys_get_pkthdr(COC_RX_MTU, 0);
+
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+    return ble_l2cap_recv_ready(chan, om);
+}
+
+static int coc_event(struct ble_l2cap_event *event, void *arg)
+{
+    struct ble_l2cap_chan_info info;
+
+    switch (event->type) {
+    case BLE_L2CAP_EVENT_COC_ACCEPT:
+        if (coc_chan) {
+            return BLE_HS_EBUSY;
+        }
+        return rx_ready(event->accept.chan);
+
+    case BLE_L2CAP_EVENT_COC_CONNECTED:
+        if (event->connect.status != 0) {
+            ESP_LOGW(TAG, "channel failed: %d", event->connect.status);
+            return 0;
+        }
+        coc_chan = event->connect.chan;
+        coc_conn = event->connect.conn_handle;
+        coc_stalled = false;
+        frame_len = rsp_len = 0;
+        coc_sdu = COC_SDU_MAX;
+        if (ble_l2cap_get_chan_info(coc_chan, &info) == 0 &&
+            info.peer_coc_mtu < coc_sdu) {
+            coc_sdu = info.peer_coc_mtu;
+        }
+        /* Longest LL packets; the interval and PHY are the central's
+         * to pick (LINK) */
+        ble_gap_set_data_len(coc_conn, 251, 2120);
+        ESP_LOGI(TAG, "channel open on connection %d, %u-byte frames",
+                 coc_conn, coc_sdu);
+        return 0;
+
+    case BLE_L2CAP_EVENT_COC_DISCONNECTED:
+        if (event->disconnect.chan == coc_chan) {
+            coc_proto_stop(&session, COC_STATUS_FAILED);
+            session.cur = NULL;
+            coc_chan = NULL;
+            ble_npl_callout_stop(&coc_retry);
+            hold_awake(false);
+            ESP_LOGI(TAG, "channel closed");
+        }
+        return 0;
+
+    case BLE_L2CAP_EVENT_COC_DATA_RECEIVED:
+        on_request(event->receive.sdu_rx);
+        os_mbuf_free_chain(event->receive.sdu_rx);
+        return rx_ready(event->receive.chan);
+
+    case BLE_L2CAP_EVENT_COC_TX_UNSTALLED:
+        coc_stalled = false;
+        pump();
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+/* ---- Initialization ----------------------------------------------------- */
+
+int coc_init(void)
+{
+    coc_proto_init(&session, streams, sizeof(streams) / sizeof(streams[0]));
+    ble_npl_callout_init(&coc_retry, nimble_port_get_dflt_eventq(),
+                         retry_cb, NULL);
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "coc",
+                           &coc_pm_lock) != ESP_OK) {
+        coc_pm_lock = NULL;
+    }
+    return ble_l2cap_create_server(CONFIG_APP_COC_PSM, COC_RX_MTU, coc_event,
+                                   NULL);
+}
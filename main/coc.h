@@ -0,0 +1,27 @@
+#ifndef COC_H
+#define COC_H
+
+/*
+ * Bulk transfer over an L2CAP connection-oriented channel on PSM
+ * CONFIG_APP_COC_PSM, for data too big for characteristics: the sample
+ * history, the input trace and the binary log.  The framing is in
+ * coc_proto.h; tools/coc_client.py is the central side.
+ *
+ * Streams (GET by name):
+ *   history   struct history_sample[], oldest first
+ *   trace     the records of the input trace (CONFIG_APP_TRACE)
+ *   logs      16 hex digits of the ELF SHA-256, then binary log records
+ *             (CONFIG_APP_BLOG); reading takes them out of the ring
+ *   bench     COC_BENCH_BYTES of filler, for throughput measurements
+ *
+ * L2CAP credits pace the sender: a frame the peer has no credits for
+ * stalls the channel and the next one goes out on TX_UNSTALLED, so a slow
+ * central never makes the device queue more than one SDU.
+ */
+
+#define COC_BENCH_BYTES     (256 * 1024)
+
+/** Register the L2CAP server.  Call after nimble_port_init(). */
+int coc_init(void);
+
+#endif /* COC_H */
@@ -0,0 +1,204 @@
+#include "coc_proto.h"
+
+#include <string.h>
+
+#include "tscodec.h"
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void coc_proto_init(struct coc_session *s, const struct coc_stream *streams,
+                    size_t n)
+{
+    memset(s, 0, sizeof(*s));
+    s->streams = streams;
+    s->nstreams = n;
+}
+
+size_t coc_proto_rsp(uint8_t *buf, uint8_t op, uint8_t status)
+{
+    buf[0] = COC_OP_RSP;
+    buf[1] = op;
+    buf[2] = status;
+    return COC_RSP_LEN;
+}
+
+/* ---- Requests ----------------------------------------------------------- */
+
+static size_t list(const struct coc_session *s, uint8_t *rsp, size_t size)
+{
+    size_t len = 2;
+
+    rsp[0] = COC_OP_STREAMS;
+    rsp[1] = 0;
+    for (size_t i = 0; i < s->nstreams; i++) {
+        const struct coc_stream *st = &s->streams[i];
+        size_t n = strlen(st->name);
+
+        if (len + 1 + n + 4 > size) {
+            break;
+        }
+        rsp[len++] = n;
+        memcpy(&rsp[len], st->name, n);
+        len += n;
+        put_le32(&rsp[len], st->size());
+        len += 4;
+        rsp[1]++;
+    }
+    return len;
+}
+
+static size_t begin(struct coc_session *s, const uint8_t *req, size_t len,
+                    uint32_t now_ms, uint8_t *rsp)
+{
+    const struct coc_stream *st = NULL;
+    size_t name_len = len > 9 ? len - 9 : 0;
+    uint32_t off, want, size;
+
+    rsp[0] = COC_OP_BEGIN;
+    put_le32(&rsp[2], 0);
+    if (name_len == 0 || name_len > COC_NAME_MAX) {
+        rsp[1] = COC_STATUS_BAD_REQUEST;
+        return COC_BEGIN_LEN;
+    }
+    if (s->cur) {
+        rsp[1] = COC_STATUS_BUSY;
+        return COC_BEGIN_LEN;
+    }
+    for (size_t i = 0; i < s->nstreams; i++) {
+        if (strlen(s->streams[i].name) == name_len &&
+            memcmp(s->streams[i].name, &req[9], name_len) == 0) {
+            st = &s->streams[i];
+        }
+    }
+    if (!st) {
+        rsp[1] = COC_STATUS_UNKNOWN_STREAM;
+        return COC_BEGIN_LEN;
+    }
+
+    off = get_le32(&req[1]);
+    want = get_le32(&req[5]);
+    size = st->size();
+    if (off > size) {
+        off = size;
+    }
+    if (want > size - off) {
+        want = size - off;
+    }
+    s->cur = st;
+    s->off = off;
+    s->end = off + want;
+    s->sent = 0;
+    s->crc = 0;
+    s->seq = 0;
+    s->status = COC_STATUS_OK;
+    s->start_ms = now_ms;
+
+    rsp[1] = COC_STATUS_OK;
+    put_le32(&rsp[2], want);
+    return COC_BEGIN_LEN;
+}
+
+size_t coc_proto_request(struct coc_session *s, const uint8_t *req,
+                         size_t len, uint32_t now_ms, uint8_t *rsp,
+                         size_t size, struct coc_link_req *link)
+{
+    if (len == 0) {
+        return 0;
+    }
+    switch (req[0]) {
+    case COC_OP_LIST:
+        return list(s, rsp, size);
+    case COC_OP_GET:
+        return begin(s, req, len, now_ms, rsp);
+    case COC_OP_LINK:
+        if (len != COC_LINK_LEN) {
+            return coc_proto_rsp(rsp, req[0], COC_STATUS_BAD_REQUEST);
+        }
+        link->itvl = req[1] | req[2] << 8;
+        link->phys = req[3];
+        return 0;
+    case COC_OP_ABORT:
+        if (!s->cur) {
+            return coc_proto_rsp(rsp, req[0], COC_STATUS_OK);
+        }
+        coc_proto_stop(s, COC_STATUS_ABORTED);
+        return 0;       /* the END frame is the reply */
+    default:
+        return coc_proto_rsp(rsp, req[0], COC_STATUS_BAD_REQUEST);
+    }
+}
+
+/* ---- Transfer ----------------------------------------------------------- */
+
+bool coc_proto_busy(const struct coc_session *s)
+{
+    return s->cur != NULL;
+}
+
+void coc_proto_stop(struct coc_session *s, uint8_t status)
+{
+    if (s->cur) {
+        s->status = status;
+        s->end = s->off;
+    }
+}
+
+static size_t end(struct coc_session *s, uint8_t *buf, uint32_t now_ms,
+                  const struct coc_link *link)
+{
+    buf[0] = COC_OP_END;
+    buf[1] = s->status;
+    put_le32(&buf[2], s->sent);
+    put_le32(&buf[6], s->crc);
+    put_le32(&buf[10], now_ms - s->start_ms);
+    put_le16(&buf[14], link->itvl);
+    buf[16] = link->tx_phy;
+    buf[17] = link->rx_phy;
+    s->cur = NULL;
+    return COC_END_LEN;
+}
+
+size_t coc_proto_next(struct coc_session *s, uint8_t *buf, size_t size,
+                      uint32_t now_ms, const struct coc_link *link)
+{
+    size_t want, got;
+
+    if (!s->cur) {
+        return 0;
+    }
+    if (s->off >= s->end) {
+        return end(s, buf, now_ms, link);
+    }
+
+    want = size - COC_DATA_HDR_LEN;
+    if (want > s->end - s->off) {
+        want = s->end - s->off;
+    }
+    got = s->cur->read(s->off, &buf[COC_DATA_HDR_LEN], want);
+    if (got == 0) {
+        return end(s, buf, now_ms, link);   /* the stream ended early */
+    }
+    buf[0] = COC_OP_DATA;
+    buf[1] = s->seq++;
+    s->crc = tsc_crc32(s->crc, &buf[COC_DATA_HDR_LEN], got);
+    s->off += got;
+    s->sent += got;
+    return COC_DATA_HDR_LEN + got;
+}
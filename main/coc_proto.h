@@ -0,0 +1,130 @@
+#ifndef COC_PROTO_H
+#define COC_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bulk transfer protocol over an L2CAP connection-oriented channel,
+ * independent of NimBLE so the framing runs on Linux too.  Each frame is
+ * one SDU, so frames never straddle SDUs or need a length field.
+ *
+ * Requests from the central, little-endian:
+ *   LIST    01                                   names and sizes of streams
+ *   GET     02 offset:u32 length:u32 name[...]   read a stream
+ *   LINK    03 itvl:u16 phys:u8                  ask for a connection
+ *                                                interval and PHY
+ *   ABORT   04                                   end the running GET
+ *
+ * Frames from the peripheral:
+ *   STREAMS 81 count:u8 { len:u8 name[len] size:u32 } ...
+ *   BEGIN   82 status:u8 size:u32                GET accepted (or not)
+ *   DATA    83 seq:u8 payload[...]               stream bytes, in order
+ *   END     84 status:u8 bytes:u32 crc:u32 ms:u32 itvl:u16 tx_phy:u8
+ *              rx_phy:u8
+ *   RSP     85 op:u8 status:u8                   reply to LINK and errors
+ *
+ * A GET sends BEGIN, then DATA frames until length bytes (or the rest of
+ * the stream, whichever is less) have gone, then END.  END carries the
+ * CRC-32 of the payload (tsc_crc32()), the time the device spent on it and
+ * the link parameters at the end, so a client can attribute throughput to
+ * them.  Only one GET runs at a time.  length 0xffffffff reads to the end.
+ * The size is taken when the GET starts, and a stream that grows in the
+ * meantime is cut there.  One that shrinks (a ring that wrapped, log
+ * records dropped) ends early; END then counts fewer bytes than BEGIN.
+ */
+
+#define COC_OP_LIST     0x01
+#define COC_OP_GET      0x02
+#define COC_OP_LINK     0x03
+#define COC_OP_ABORT    0x04
+#define COC_OP_STREAMS  0x81
+#define COC_OP_BEGIN    0x82
+#define COC_OP_DATA     0x83
+#define COC_OP_END      0x84
+#define COC_OP_RSP      0x85
+
+enum {
+    COC_STATUS_OK = 0,
+    COC_STATUS_BAD_REQUEST,
+    COC_STATUS_UNKNOWN_STREAM,
+    COC_STATUS_BUSY,            /* a GET is already running */
+    COC_STATUS_ABORTED,
+    COC_STATUS_FAILED,          /* the stream or the link gave up */
+};
+
+#define COC_NAME_MAX        16
+#define COC_DATA_HDR_LEN    2
+#define COC_BEGIN_LEN       6
+#define COC_END_LEN         18
+#define COC_RSP_LEN         3
+#define COC_LINK_LEN        4
+
+/* A named source of bytes.  read() copies up to len bytes from offset off
+ * and returns how many it copied, 0 at the end.  A destructive stream
+ * (logs) ignores off and hands out what it has not sent before. */
+struct coc_stream {
+    const char *name;
+    uint32_t (*size)(void);
+    size_t   (*read)(uint32_t off, uint8_t *buf, size_t len);
+};
+
+/* Link parameters as END reports them. */
+struct coc_link {
+    uint16_t itvl;              /* 1.25 ms units */
+    uint8_t  tx_phy;            /* 1 = 1M, 2 = 2M, 3 = coded */
+    uint8_t  rx_phy;
+};
+
+struct coc_session {
+    const struct coc_stream *streams;
+    size_t nstreams;
+    const struct coc_stream *cur;   /* NULL while no GET is running */
+    uint32_t off;               /* next byte of the stream */
+    uint32_t end;
+    uint32_t sent;
+    uint32_t crc;
+    uint32_t start_ms;
+    uint8_t  seq;
+    uint8_t  status;            /* for END: OK until aborted or failed */
+};
+
+/* A decoded LINK request, for the caller to act on. */
+struct coc_link_req {
+    uint16_t itvl;
+    uint8_t  phys;              /* BLE_GAP_LE_PHY_*_MASK bits */
+};
+
+void coc_proto_init(struct coc_session *s, const struct coc_stream *streams,
+                    size_t n);
+
+/**
+ * Handle a request SDU.  A reply is written to rsp (size bytes, enough for
+ * the stream list) and its length returned; 0 means none.  now_ms stamps
+ * the start of a GET.  A LINK request is only checked: it is copied to
+ * *link, and the function returns 0 so the caller can reply once it has
+ * asked the stack for it (coc_proto_rsp()).
+ */
+size_t coc_proto_request(struct coc_session *s, const uint8_t *req,
+                         size_t len, uint32_t now_ms, uint8_t *rsp,
+                         size_t size, struct coc_link_req *link);
+
+/** True while a GET has frames left to send (its END included). */
+bool coc_proto_busy(const struct coc_session *s);
+
+/**
+ * Build the next frame of the running GET into buf (size bytes, at most
+ * the peer's SDU size) and return its length: a DATA frame, or END once
+ * the data is out, after which the session is idle.
+ */
+size_t coc_proto_next(struct coc_session *s, uint8_t *buf, size_t size,
+                      uint32_t now_ms, const struct coc_link *link);
+
+/** Stop the running GET with status; the next frame is its END. */
+void coc_proto_stop(struct coc_session *s, uint8_t status);
+
+/** A RSP frame (COC_RSP_LEN bytes) for op. */
+size_t coc_proto_rsp(uint8_t *buf, uint8_t op, uint8_t status);
+
+#endif /* COC_PROTO_H */
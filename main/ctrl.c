@@ -0,0 +1,127 @@
+#include "ctrl.h"
+
+#include <string.h>
+
+/* ---- Items -------------------------------------------------------------- */
+
+static const struct ctrl_param *param_find(const struct ctrl_param *params,
+                                           size_t n, uint8_t type)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (params[i].type == type) {
+            return &params[i];
+        }
+    }
+    return NULL;
+}
+
+static int64_t get_le(const uint8_t *p, size_t len, bool is_signed)
+{
+    uint64_t v = 0;
+
+    for (size_t i = len; i-- > 0;) {
+        v = v << 8 | p[i];
+    }
+    if (is_signed && len < 8 && (v >> (len * 8 - 1)) & 1) {
+        v |= ~(uint64_t)0 << (len * 8);
+    }
+    return (int64_t)v;
+}
+
+uint8_t ctrl_check(const struct ctrl_param *params, size_t n, uint8_t type,
+                   const uint8_t *val, size_t len, int64_t *value)
+{
+    const struct ctrl_param *p = param_find(params, n, type);
+
+    if (!p) {
+        return CTRL_ST_UNKNOWN;
+    }
+    if (len != p->len) {
+        return CTRL_ST_BAD_LEN;
+    }
+    *value = get_le(val, len, p->is_signed);
+    if (!p->is_signed && p->len == 8 && *value < 0) {
+        return CTRL_ST_RANGE;   /* above INT64_MAX */
+    }
+    if (*value < p->min || *value > p->max) {
+        return CTRL_ST_RANGE;
+    }
+    return CTRL_ST_OK;
+}
+
+static uint8_t item_check(const struct ctrl_batch *b, struct ctrl_item *it,
+                          const uint8_t *val, size_t len,
+                          const struct ctrl_param *params, size_t n)
+{
+    if (param_find(params, n, it->type)) {
+        for (const struct ctrl_item *prev = b->item; prev < it; prev++) {
+            if (prev->type == it->type) {
+                return CTRL_ST_DUPLICATE;
+            }
+        }
+    }
+    return ctrl_check(params, n, it->type, val, len, &it->value);
+}
+
+/* ---- Requests ----------------------------------------------------------- */
+
+uint8_t ctrl_parse(const uint8_t *req, size_t len,
+                   const struct ctrl_param *params, size_t n,
+                   struct ctrl_batch *b)
+{
+    size_t off = CTRL_HDR_LEN;
+    bool ok = true;
+
+    memset(b, 0, sizeof(*b));
+    if (len < CTRL_HDR_LEN) {
+        return b->result = CTRL_RES_MALFORMED;
+    }
+    b->op = req[0];
+    b->token = req[1];
+    if (b->op != CTRL_OP_APPLY && b->op != CTRL_OP_CHECK) {
+        return b->result = CTRL_RES_BAD_OP;
+    }
+
+    while (off < len) {
+        if (b->count == CTRL_ITEMS_MAX || len - off < 2 ||
+            len - off - 2 < req[off + 1]) {
+            b->count = 0;
+            return b->result = CTRL_RES_MALFORMED;
+        }
+        struct ctrl_item *it = &b->item[b->count++];
+        it->type = req[off];
+        it->status = item_check(b, it, &req[off + 2], req[off + 1], params,
+                                n);
+        ok = ok && it->status == CTRL_ST_OK;
+        off += 2 + req[off + 1];
+    }
+
+    if (ok) {
+        return b->result = CTRL_RES_OK;
+    }
+    /* A check reports which items would pass; an apply reports that the
+     * valid ones were not applied either. */
+    if (b->op == CTRL_OP_APPLY) {
+        for (int i = 0; i < b->count; i++) {
+            if (b->item[i].status == CTRL_ST_OK) {
+                b->item[i].status = CTRL_ST_SKIPPED;
+            }
+        }
+    }
+    return b->result = CTRL_RES_REJECTED;
+}
+
+size_t ctrl_response(const struct ctrl_batch *b, uint8_t *out)
+{
+    size_t len = CTRL_RSP_HDR_LEN;
+
+    out[0] = CTRL_OP_RESPONSE;
+    out[1] = b->token;
+    out[2] = b->op;
+    out[3] = b->result;
+    for (int i = 0; i < b->count; i++) {
+        out[len++] = b->item[i].type;
+        out[len++] = b->item[i].status;
+    }
+    return len;
+}
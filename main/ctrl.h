@@ -0,0 +1,107 @@
+#ifndef CTRL_H
+#define CTRL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Control point: several settings in one write, in the style of a Record
+ * Access Control Point.  A request is an opcode and a client-chosen token
+ * followed by TLV items; the response, sent as one indication, echoes the
+ * token and carries a status for every item.
+ *
+ *   request:   u8 op, u8 token, { u8 type, u8 len, value[len] } ...
+ *   response:  u8 CTRL_OP_RESPONSE, u8 token, u8 op, u8 result,
+ *              { u8 type, u8 status } per item, in request order
+ *
+ * Values are little-endian integers.  Every item is checked before any is
+ * applied, and CTRL_OP_APPLY applies the batch only if all of them pass, so
+ * a rejected batch changes nothing.  The accepted types and ranges come
+ * from settings.c, which host/replay.c shares with the device.
+ */
+
+#define CTRL_ITEMS_MAX      8       /* response fits the default ATT MTU */
+#define CTRL_HDR_LEN        2
+#define CTRL_RSP_HDR_LEN    4
+#define CTRL_RSP_MAX        (CTRL_RSP_HDR_LEN + 2 * CTRL_ITEMS_MAX)
+
+/* Opcodes */
+#define CTRL_OP_APPLY       0x01    /* check, then apply all or nothing */
+#define CTRL_OP_CHECK       0x02    /* check only */
+#define CTRL_OP_RESPONSE    0x80
+
+/* Item types */
+enum {
+    CTRL_T_TIME = 0x01,         /* s64, UNIX seconds */
+    CTRL_T_TZ,                  /* s8, quarter-hours from UTC */
+    CTRL_T_DISPLAY_MODE,        /* u8, DISPLAY_MODE_* */
+    CTRL_T_SAMPLE_PROFILE,      /* u8, SAMPLE_PROFILE_* */
+    CTRL_T_ADV_PROFILE,         /* u8, ADV_PROFILE_* */
+    CTRL_T_SEA_LEVEL,           /* u32, Pa */
+};
+
+/* Result of a request */
+enum {
+    CTRL_RES_OK = 0,
+    CTRL_RES_BAD_OP,            /* unknown opcode; no items reported */
+    CTRL_RES_MALFORMED,         /* truncated TLV or too many items */
+    CTRL_RES_REJECTED,          /* an item failed; nothing was applied */
+};
+
+/* Status of one item */
+enum {
+    CTRL_ST_OK = 0,
+    CTRL_ST_UNKNOWN,            /* type not supported */
+    CTRL_ST_BAD_LEN,
+    CTRL_ST_RANGE,              /* value out of range */
+    CTRL_ST_DUPLICATE,          /* type already set earlier in the batch */
+    CTRL_ST_SKIPPED,            /* valid, but the batch was rejected */
+};
+
+/** What one item type accepts. */
+struct ctrl_param {
+    uint8_t type;
+    uint8_t len;                /* 1, 2, 4 or 8 */
+    bool    is_signed;
+    int64_t min;
+    int64_t max;
+};
+
+struct ctrl_item {
+    uint8_t type;
+    uint8_t status;
+    int64_t value;
+};
+
+struct ctrl_batch {
+    uint8_t op;
+    uint8_t token;
+    uint8_t result;             /* CTRL_RES_* */
+    uint8_t count;
+    struct ctrl_item item[CTRL_ITEMS_MAX];
+};
+
+/**
+ * Check one value of a type against the n entries of params, as a request
+ * item would be.  Returns a CTRL_ST_* status; *value is the decoded value
+ * when the length is right.
+ */
+uint8_t ctrl_check(const struct ctrl_param *params, size_t n, uint8_t type,
+                   const uint8_t *val, size_t len, int64_t *value);
+
+/**
+ * Decode a request and check each item against the n entries of params.
+ * Sets every item's status and b->result, and returns the result.  Only
+ * with CTRL_RES_OK may the caller apply the items; CTRL_OP_CHECK requests
+ * stop there.
+ */
+uint8_t ctrl_parse(const uint8_t *req, size_t len,
+                   const struct ctrl_param *params, size_t n,
+                   struct ctrl_batch *b);
+
+/** Encode the response to b into out (CTRL_RSP_MAX bytes); returns its
+ *  length. */
+size_t ctrl_response(const struct ctrl_batch *b, uint8_t *out);
+
+#endif /* CTRL_H */
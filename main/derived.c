@@ -0,0 +1,293 @@
+#include "derived.h"
+
+#include <string.h>
+
+/* ---- Saturation vapour pressure ----------------------------------------- */
+
+/* Magnus formula (6.112 hPa, 17.62, 243.12 °C) over water, in 0.01 Pa, for
+ * -40..+60 °C in 1 °C steps.  Linear interpolation between entries is
+ * within 0.01 °C of the formula when inverted for the dew point. */
+#define SVP_T_MIN   (-40)
+#define SVP_COUNT   101
+
+static const uint32_t svp_table[SVP_COUNT] = {
+    1902, 2109, 2336, 2586, 2858, 3157,
+    3484, 3840, 4230, 4654, 5117, 5620,
+    6168, 6764, 7410, 8112, 8872, 9696,
+    10588, 11553, 12597, 13723, 14939, 16251,
+    17665, 19187, 20826, 22589, 24483, 26518,
+    28703, 31047, 33559, 36251, 39134, 42218,
+    45517, 49043, 52809, 56830, 61120, 65695,
+    70570, 75763, 81292, 87174, 93430, 100079,
+    107143, 114643, 122603, 131046, 139998, 149483,
+    159531, 170167, 181423, 193327, 205913, 219212,
+    233260, 248090, 263742, 280251, 297659, 316006,
+    335334, 355689, 377115, 399660, 423372, 448303,
+    474505, 502031, 530939, 561284, 593128, 626531,
+    661558, 698274, 736746, 777044, 819241, 863409,
+    909627, 957971, 1008523, 1061367, 1116588, 1174274,
+    1234516, 1297407, 1363042, 1431521, 1502945, 1577416,
+    1655043, 1735933, 1820201, 1907960, 1999329,
+};
+
+/* Saturation vapour pressure at temp (°C x 100), in 0.01 Pa. */
+static uint32_t svp(int32_t temp_c100)
+{
+    int32_t x = temp_c100 - SVP_T_MIN * 100;
+    if (x <= 0) {
+        return svp_table[0];
+    }
+    if (x >= (SVP_COUNT - 1) * 100) {
+        return svp_table[SVP_COUNT - 1];
+    }
+    int i = x / 100;
+    uint32_t f = x % 100;
+    return svp_table[i] + (svp_table[i + 1] - svp_table[i]) * f / 100;
+}
+
+/* Temperature (°C x 100) at which svp() equals e (0.01 Pa). */
+static int32_t svp_inverse(uint32_t e)
+{
+    if (e <= svp_table[0]) {
+        return SVP_T_MIN * 100;
+    }
+    if (e >= svp_table[SVP_COUNT - 1]) {
+        return (SVP_T_MIN + SVP_COUNT - 1) * 100;
+    }
+    int lo = 0, hi = SVP_COUNT - 1;     /* svp_table[lo] <= e < [hi] */
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (svp_table[mid] <= e) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t span = svp_table[hi] - svp_table[lo];
+    return (SVP_T_MIN + lo) * 100 +
+           (int32_t)(((e - svp_table[lo]) * 100 + span / 2) / span);
+}
+
+/* ---- Fixed-point log2 / exp2 (Q30) -------------------------------------- */
+
+#define Q30     (1 << 30)
+
+/* 2^(2^-i) for i = 1..30, Q30 */
+static const uint32_t exp2_frac[30] = {
+    1518500250, 1276901417, 1170923762, 1121280436, 1097253708, 1085434106,
+    1079572136, 1076653033, 1075196443, 1074468888, 1074105294, 1073923544,
+    1073832680, 1073787251, 1073764537, 1073753181, 1073747502, 1073744663,
+    1073743244, 1073742534, 1073742179, 1073742001, 1073741913, 1073741868,
+    1073741846, 1073741835, 1073741830, 1073741827, 1073741825, 1073741825,
+};
+
+/* log2(x) for x in Q30, x > 0; result in Q30. */
+static int64_t log2_q30(uint64_t x)
+{
+    int64_t r = 0;
+
+    while (x >= 2ull * Q30) {
+        x >>= 1;
+        r += Q30;
+    }
+    while (x < Q30) {
+        x <<= 1;
+        r -= Q30;
+    }
+    /* x in [1, 2): each squaring yields one fraction bit */
+    for (int bit = 29; bit >= 0; bit--) {
+        x = (x * x) >> 30;
+        if (x >= 2ull * Q30) {
+            x >>= 1;
+            r += 1ll << bit;
+        }
+    }
+    return r;
+}
+
+/* 2^y for y in Q30; result in Q30.  Valid for y < 2. */
+static uint64_t exp2_q30(int64_t y)
+{
+    int64_t n = y >> 30;                /* floor */
+    uint32_t f = (uint32_t)(y - n * Q30);
+    uint64_t r = Q30;
+
+    for (int i = 0; i < 30; i++) {
+        if (f & (1u << (29 - i))) {
+            r = (r * exp2_frac[i]) >> 30;
+        }
+    }
+    return n >= 0 ? r << n : r >> -n;
+}
+
+/* ---- Zambretti forecast ------------------------------------------------- */
+
+/* Letters indexed by Z number for each trend (Negretti & Zambra tables). */
+static const char zambretti_falling[] = "ABDHORUXZ";       /* Z 1..9 */
+static const char zambretti_steady[]  = "ABEKNPSWXZ";      /* Z 10..19 */
+static const char zambretti_rising[]  = "ABCFGIJLMQTYZ";   /* Z 20..32 */
+
+static const char *const forecast_text[26] = {
+    "Settled fine",                         /* A */
+    "Fine weather",
+    "Becoming fine",
+    "Fine, becoming less settled",
+    "Fine, possible showers",
+    "Fairly fine, improving",
+    "Fairly fine, possible showers early",
+    "Fairly fine, showery later",
+    "Showery early, improving",
+    "Changeable, mending",
+    "Fairly fine, showers likely",
+    "Rather unsettled, clearing later",
+    "Unsettled, probably improving",
+    "Showery, bright intervals",
+    "Showery, becoming less settled",
+    "Changeable, some rain",
+    "Unsettled, short fine intervals",
+    "Unsettled, rain later",
+    "Unsettled, rain at times",
+    "Very unsettled, finer at times",
+    "Rain at times, worse later",
+    "Rain at times, becoming very unsettled",
+    "Rain at frequent intervals",
+    "Very unsettled, rain",
+    "Stormy, possibly improving",
+    "Stormy, much rain",                    /* Z */
+};
+
+static int clamp(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* Z = a - b * P(hPa), with a and b x 100; P in Pa. */
+static int zambretti_z(int32_t a100, int32_t b100, uint32_t qnh_pa)
+{
+    return (int)((a100 * 100 - b100 * (int64_t)qnh_pa + 5000) / 10000);
+}
+
+static char zambretti(uint8_t trend, uint32_t qnh_pa)
+{
+    switch (trend) {
+    case DERIVED_TREND_FALLING:
+        return zambretti_falling[clamp(zambretti_z(12700, 12, qnh_pa),
+                                       1, 9) - 1];
+    case DERIVED_TREND_STEADY:
+        return zambretti_steady[clamp(zambretti_z(14400, 13, qnh_pa),
+                                      10, 19) - 10];
+    case DERIVED_TREND_RISING:
+        return zambretti_rising[clamp(zambretti_z(18500, 16, qnh_pa),
+                                      20, 32) - 20];
+    default:
+        return '?';
+    }
+}
+
+const char *derived_forecast_text(char letter)
+{
+    if (letter < 'A' || letter > 'Z') {
+        return "";
+    }
+    return forecast_text[letter - 'A'];
+}
+
+/* ---- Altitude ----------------------------------------------------------- */
+
+#define BARO_EXP_Q30    204327654   /* 1 / 5.255 */
+
+/* h = 44330 m * (1 - (p / p0)^(1/5.255)), in 0.1 m */
+static int32_t altitude_dm(uint32_t press_pa, uint32_t sea_level_pa)
+{
+    uint64_t ratio = ((uint64_t)press_pa << 30) / sea_level_pa;
+    int64_t y = (log2_q30(ratio) * BARO_EXP_Q30) >> 30;
+    int64_t pw = (int64_t)exp2_q30(y);
+    return (int32_t)((443300 * (Q30 - pw)) >> 30);
+}
+
+/* ---- Pressure window ---------------------------------------------------- */
+
+/* Close slots until now_s falls inside the one being filled.  A gap longer
+ * than the whole ring clears it rather than walking every empty slot. */
+static void window_advance(struct derived_state *s, uint32_t now_s)
+{
+    uint32_t elapsed = now_s - s->cur_start_s;
+
+    if (elapsed >= (DERIVED_BUCKETS + 1) * DERIVED_BUCKET_S) {
+        memset(s->bucket, 0, sizeof(s->bucket));
+        s->cur_start_s = now_s;
+        s->cur_sum = 0;
+        s->cur_count = 0;
+        return;
+    }
+    while (now_s - s->cur_start_s >= DERIVED_BUCKET_S) {
+        s->bucket[s->head] = s->cur_count ? s->cur_sum / s->cur_count : 0;
+        s->head = (s->head + 1) % DERIVED_BUCKETS;
+        s->cur_start_s += DERIVED_BUCKET_S;
+        s->cur_sum = 0;
+        s->cur_count = 0;
+    }
+}
+
+/* ---- Public API --------------------------------------------------------- */
+
+void derived_init(struct derived_state *s, uint32_t sea_level_pa,
+                  uint32_t qnh_scale_q16)
+{
+    memset(s, 0, sizeof(*s));
+    s->out.sea_level_pa = sea_level_pa ? sea_level_pa : DERIVED_SEA_LEVEL_PA;
+    s->out.forecast = '?';
+    s->qnh_scale_q16 = qnh_scale_q16 ? qnh_scale_q16 : 1u << 16;
+}
+
+void derived_update(struct derived_state *s, int32_t temp_c100,
+                    uint32_t hum_x100, uint32_t press_pa, uint32_t now_s)
+{
+    struct derived *o = &s->out;
+
+    /* Humidity: e = es(T) * RH; dew point is where es(Td) = e */
+    if (hum_x100 > 10000) {
+        hum_x100 = 10000;
+    }
+    uint32_t e = (uint32_t)((uint64_t)svp(temp_c100) * hum_x100 / 10000);
+    o->dew_point_c100 = (int16_t)svp_inverse(e ? e : 1);
+    /* AH = e / (Rv * T) = 2.1668 * e(Pa) / T(K) g/m^3 */
+    o->abs_hum_x100 = (uint16_t)((21668ull * e) /
+                                 (100ull * (uint32_t)(temp_c100 + 27315)));
+
+    /* Pressure tendency: current slot mean vs. the slot 3 h earlier */
+    if (s->last_press_pa == 0) {
+        s->cur_start_s = now_s;     /* first sample */
+    }
+    window_advance(s, now_s);
+    s->cur_sum += press_pa;
+    s->cur_count++;
+    s->last_press_pa = press_pa;
+
+    uint32_t oldest = s->bucket[s->head];
+    if (oldest == 0) {
+        o->tendency_pa = 0;
+        o->trend = DERIVED_TREND_UNKNOWN;
+    } else {
+        int32_t d = (int32_t)(s->cur_sum / s->cur_count) - (int32_t)oldest;
+        o->tendency_pa = (int16_t)clamp(d, INT16_MIN, INT16_MAX);
+        o->trend = d >= DERIVED_TREND_PA ? DERIVED_TREND_RISING :
+                   d <= -DERIVED_TREND_PA ? DERIVED_TREND_FALLING :
+                   DERIVED_TREND_STEADY;
+    }
+    uint32_t qnh = (uint32_t)(((uint64_t)press_pa * s->qnh_scale_q16) >> 16);
+    o->forecast = zambretti(o->trend, qnh);
+
+    o->altitude_dm = altitude_dm(press_pa, o->sea_level_pa);
+}
+
+uint32_t derived_set_sea_level(struct derived_state *s, uint32_t sea_level_pa)
+{
+    s->out.sea_level_pa = sea_level_pa;
+    if (s->last_press_pa) {
+        s->qnh_scale_q16 = (uint32_t)(((uint64_t)sea_level_pa << 16) /
+                                      s->last_press_pa);
+        s->out.altitude_dm = altitude_dm(s->last_press_pa, sea_level_pa);
+    }
+    return s->qnh_scale_q16;
+}
@@ -0,0 +1,76 @@
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include <stdint.h>
+
+/*
+ * Metrics derived from each BME280 sample, maintained incrementally in
+ * integer arithmetic so readers (GATT, display) only copy the results.
+ * The state itself lives in sample.c, which host/replay links as well.
+ *
+ * - Dew point and absolute humidity from a saturation vapour pressure
+ *   table (Magnus, 1 °C steps) with linear interpolation.
+ * - Pressure tendency over 3 hours from a ring of 10-minute means, and a
+ *   Zambretti forecast letter from it.
+ * - Altitude from the international barometric formula against a
+ *   configurable sea-level reference.
+ */
+
+#define DERIVED_BUCKET_S        600     /* pressure ring slot: 10 min */
+#define DERIVED_BUCKETS         18      /* 18 slots = 3 h */
+#define DERIVED_TREND_PA        160     /* 1.6 hPa / 3 h: rising or falling */
+#define DERIVED_SEA_LEVEL_PA    101325
+
+enum {
+    DERIVED_TREND_UNKNOWN = 0,  /* less than 3 h of data */
+    DERIVED_TREND_STEADY,
+    DERIVED_TREND_RISING,
+    DERIVED_TREND_FALLING,
+};
+
+/* Wire format of the Derived characteristic (little-endian, packed). */
+struct __attribute__((packed)) derived {
+    int16_t  dew_point_c100;    /* °C x 100 */
+    uint16_t abs_hum_x100;      /* g/m^3 x 100 */
+    int16_t  tendency_pa;       /* pressure change over the last 3 h */
+    uint8_t  trend;             /* DERIVED_TREND_* */
+    char     forecast;          /* Zambretti letter 'A'..'Z', '?' if unknown */
+    int32_t  altitude_dm;       /* 0.1 m, relative to sea_level_pa */
+    uint32_t sea_level_pa;
+};
+
+struct derived_state {
+    struct derived out;
+    uint32_t qnh_scale_q16;     /* station -> sea-level pressure factor */
+    uint32_t bucket[DERIVED_BUCKETS];   /* mean Pa of completed slots, 0 = none */
+    uint8_t  head;              /* oldest completed slot */
+    uint32_t cur_start_s;       /* start of the slot being filled */
+    uint32_t cur_sum;
+    uint16_t cur_count;
+    uint32_t last_press_pa;
+};
+
+/** Reset all state; sea_level_pa of 0 selects DERIVED_SEA_LEVEL_PA. */
+void derived_init(struct derived_state *s, uint32_t sea_level_pa,
+                  uint32_t qnh_scale_q16);
+
+/**
+ * Fold in one sample.  temp in °C x 100, hum in %RH x 100, press in Pa,
+ * now_s from a monotonic clock.  Constant time apart from skipping empty
+ * ring slots after a gap, which is bounded by DERIVED_BUCKETS.
+ */
+void derived_update(struct derived_state *s, int32_t temp_c100,
+                    uint32_t hum_x100, uint32_t press_pa, uint32_t now_s);
+
+/**
+ * Set the sea-level reference (QNH) used for altitude.  If a pressure
+ * sample has been seen, the ratio to it is kept as the factor that turns
+ * station pressure into sea-level pressure for the forecast; returns that
+ * factor (Q16) so the caller can persist it.
+ */
+uint32_t derived_set_sea_level(struct derived_state *s, uint32_t sea_level_pa);
+
+/** Short description of a Zambretti letter, or "" if unknown. */
+const char *derived_forecast_text(char letter);
+
+#endif /* DERIVED_H */
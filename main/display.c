@@ -1,8 +1,12 @@
 #include "display.h"
+#include "fb.h"
 #include "bmx280_sensor.h"
 #include "sensor_task.h"
 #include "gatt_svc.h"
 #include "button.h"
+#include "history.h"
+#include "powerstat.h"
+#include "sample.h"
 
 #include <string.h>
 #include <sys/time.h>
@@ -17,6 +21,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define BLOG_LOCAL
+#include "blog.h"
+
 #define I2C_SDA_GPIO   5
 #define I2C_SCL_GPIO   6
 #define LCD_H_RES      128
@@ -28,82 +35,101 @@ static esp_lcd_panel_handle_t panel;
 static esp_lcd_panel_io_handle_t panel_io;
 static i2c_master_bus_handle_t i2c_bus;
 
-/* ---- 8x8 font (column-major, LSB = top pixel) -------------------------- */
-
-enum {
-    GLYPH_COLON = 10,
-    GLYPH_DOT,
-    GLYPH_DEG,
-    GLYPH_F,
-    GLYPH_C,
-    GLYPH_PCT,
-    GLYPH_hP,
-    GLYPH_P,
-    GLYPH_a,
-    GLYPH_m,
-    GLYPH_V,
-    GLYPH_R,
-    GLYPH_H,
-};
-
-static const uint8_t font[][8] = {
-    { 0x3E, 0x51, 0x49, 0x45, 0x3E, 0x00, 0x00, 0x00 }, /* 0 */
-    { 0x00, 0x42, 0x7F, 0x40, 0x00, 0x00, 0x00, 0x00 }, /* 1 */
-    { 0x42, 0x61, 0x51, 0x49, 0x46, 0x00, 0x00, 0x00 }, /* 2 */
-    { 0x21, 0x41, 0x45, 0x4B, 0x31, 0x00, 0x00, 0x00 }, /* 3 */
-    { 0x18, 0x14, 0x12, 0x7F, 0x10, 0x00, 0x00, 0x00 }, /* 4 */
-    { 0x27, 0x45, 0x45, 0x45, 0x39, 0x00, 0x00, 0x00 }, /* 5 */
-    { 0x3C, 0x4A, 0x49, 0x49, 0x30, 0x00, 0x00, 0x00 }, /* 6 */
-    { 0x01, 0x71, 0x09, 0x05, 0x03, 0x00, 0x00, 0x00 }, /* 7 */
-    { 0x36, 0x49, 0x49, 0x49, 0x36, 0x00, 0x00, 0x00 }, /* 8 */
-    { 0x06, 0x49, 0x49, 0x29, 0x1E, 0x00, 0x00, 0x00 }, /* 9 */
-    { 0x00, 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* : */
-    { 0x00, 0x60, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* . */
-    { 0x06, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00, 0x00 }, /* DEG */
-    { 0x7F, 0x09, 0x09, 0x09, 0x01, 0x00, 0x00, 0x00 }, /* F */
-    { 0x3E, 0x41, 0x41, 0x41, 0x22, 0x00, 0x00, 0x00 }, /* C */
-    { 0x23, 0x13, 0x08, 0x64, 0x62, 0x00, 0x00, 0x00 }, /* % */
-    { 0x7F, 0x08, 0x04, 0x04, 0x7f, 0x09, 0x09, 0x06 }, /* hP ligature*/
-    { 0x7F, 0x09, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00 }, /* P */
-    { 0x20, 0x54, 0x54, 0x54, 0x78, 0x00, 0x00, 0x00 }, /* a */
-    { 0x7C, 0x04, 0x18, 0x04, 0x78, 0x00, 0x00, 0x00 }, /* m */
-    { 0x1F, 0x20, 0x40, 0x20, 0x1F, 0x00, 0x00, 0x00 }, /* V */
-    { 0x7F, 0x09, 0x19, 0x29, 0x46, 0x00, 0x00, 0x00 }, /* R */
-    { 0x7F, 0x08, 0x08, 0x08, 0x7F, 0x00, 0x00, 0x00 }, /* H */
-};
-
-/* ---- Framebuffer -------------------------------------------------------- */
-
-static uint8_t fb[8][LCD_H_RES]; /* 8 pages × 128 columns */
-
-static void fb_clear(void)
+/* ---- Panel flush ------------------------------------------------------- */
+
+/*
+ * Frames are drawn into one buffer while flush_task sends the other.  The
+ * I2C panel IO transmits synchronously, so the transfer runs on flush_task
+ * rather than on the caller; on_color_trans_done hands it the next frame.
+ * A frame finished while another is on the wire waits in `ready`, and is
+ * drawn over (dropped) if a newer one starts before the wire is free.
+ */
+static portMUX_TYPE flush_lock = portMUX_INITIALIZER_UNLOCKED;
+static int back;                /* fb == fb_buffers[back] */
+static int sending = -1;        /* buffer on the wire, -1 when idle */
+static int ready = -1;          /* finished frame waiting for the wire */
+static uint32_t frames_dropped;
+static TaskHandle_t flush_task_handle;
+
+/* Point fb at a buffer that is not on the wire */
+static void fb_begin(void)
 {
-    memset(fb, 0, sizeof(fb));
+    portENTER_CRITICAL(&flush_lock);
+    if (ready == back) {
+        ready = -1;             /* superseded by the frame about to be drawn */
+        frames_dropped++;
+    } else if (sending == back) {
+        back ^= 1;
+    }
+    portEXIT_CRITICAL(&flush_lock);
+    fb = fb_buffers[back];
 }
 
-static void fb_draw_glyph(int page, int col, int glyph_idx)
+static void fb_flush(void)
 {
-    const uint8_t *g = font[glyph_idx];
-    for (int x = 0; x < 8 && (col + x) < LCD_H_RES; x++)
-        fb[page][col + x] = g[x];
+    bool kick;
+
+    if (!panel) return;     /* no panel (e.g. benchmark build under QEMU) */
+    portENTER_CRITICAL(&flush_lock);
+    ready = back;
+    kick = sending < 0;
+    if (kick) {
+        sending = ready;
+        ready = -1;
+    }
+    portEXIT_CRITICAL(&flush_lock);
+    if (kick) {
+        xTaskNotifyGive(flush_task_handle);
+    }
 }
 
-static void fb_flush(void)
+/* Called by the panel IO once a frame is out: start the next one, if any */
+static bool flush_done(esp_lcd_panel_io_handle_t io,
+                       esp_lcd_panel_io_event_data_t *edata, void *ctx)
 {
-    esp_lcd_panel_draw_bitmap(panel, 0, 0, LCD_H_RES, LCD_V_RES, fb);
+    BaseType_t woken = pdFALSE;
+    bool more;
+
+    portENTER_CRITICAL_SAFE(&flush_lock);
+    sending = ready;
+    ready = -1;
+    more = sending >= 0;
+    portEXIT_CRITICAL_SAFE(&flush_lock);
+    if (more) {
+        if (xPortInIsrContext()) {
+            vTaskNotifyGiveFromISR(flush_task_handle, &woken);
+        } else {
+            xTaskNotifyGive(flush_task_handle);
+        }
+    }
+    return woken == pdTRUE;
 }
 
-/* ---- Draw a centered line of glyphs ------------------------------------- */
-
-static void fb_draw_line(int page, int start_col, const int *glyphs, int count)
+static void flush_task(void *param)
 {
-    int col = start_col;
-    for (int i = 0; i < count; i++) {
-        fb_draw_glyph(page, col, glyphs[i]);
-        col += 8;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&flush_lock);
+        int i = sending;
+        portEXIT_CRITICAL(&flush_lock);
+        if (i < 0) continue;
+        esp_err_t err = esp_lcd_panel_draw_bitmap(panel, 0, 0, LCD_H_RES,
+                                                  LCD_V_RES, fb_buffers[i]);
+        if (err != ESP_OK) {
+            /* No transfer-done callback comes for a failed transfer */
+            ESP_LOGW(TAG, "flush failed: %s", esp_err_to_name(err));
+            flush_done(panel_io, NULL, NULL);
+            continue;
+        }
+        powerstat_count(POWERSTAT_FLUSH);
     }
 }
 
+uint32_t display_frames_dropped(void)
+{
+    return frames_dropped;
+}
+
 /* ---- Display on or off -------------------------------------------------- */
 
 static bool display_is_on = false;
@@ -112,6 +138,8 @@ void display_set_enabled(bool enabled)
 {
     if (enabled == display_is_on) return;
     display_is_on = enabled;
+    if (!panel) return;
+    powerstat_level(POWERSTAT_DISPLAY, enabled);
     if (enabled) {
         ESP_LOGD(TAG, "Display enabled");
         esp_lcd_panel_disp_on_off(panel, true);
@@ -123,113 +151,42 @@ void display_set_enabled(bool enabled)
 
 /* ---- Display rendering -------------------------------------------------- */
 
-static void render_display(void)
+static struct render_loop loop = { .page = PAGE_READINGS };
+
+void render_display(void)
 {
     struct timeval tv;
     gettimeofday(&tv, NULL);
 
     time_t now = tv.tv_sec + gatt_svc_get_tz_quarter_hours() * 15 * 60;
-    struct tm tm;
-    gmtime_r(&now, &tm);
-
-    fb_clear();
-
-    switch (gatt_svc_display_mode) {
-        case DISPLAY_MODE_BLANK:
-            /* Don't draw anything, just clear the display */
-            ESP_LOGD(TAG, "Display mode: BLANK");
-            fb_flush();
-            display_set_enabled(false);
-            return;
-
-        case DISPLAY_MODE_BUTTON: {
-            int64_t uptime = esp_timer_get_time();
-            if (uptime - button_time > 60 * 1000000) {
-                ESP_LOGD(TAG,
-                        "Display mode: BUTTON (last press %lld seconds ago)",
-                        (uptime - button_time) / 1000000);
-                display_set_enabled(false);
-                fb_flush();
-                return;
-            }
-            ESP_LOGI(TAG, "Display mode: BUTTON (last press %lld seconds ago)",
-                        (uptime - button_time) / 1000000);
-            break;
-        }
-
-        case DISPLAY_MODE_NORMAL:
-            ESP_LOGD(TAG, "Display mode: NORMAL");
-        default:
-            /* Normal mode: always show sensor readings */
-            break;
-    }
-    display_set_enabled(true);
-
-    /* Page 3: HH:MM:SS */
-    int clock[] = {
-        tm.tm_hour / 10, tm.tm_hour % 10, GLYPH_COLON,
-        tm.tm_min / 10,  tm.tm_min % 10,  GLYPH_COLON,
-        tm.tm_sec / 10,  tm.tm_sec % 10,
+    int64_t since_press = esp_timer_get_time() - button_time;
+    struct render_input in = {
+        .sensors_valid = sensors_valid,
+        .pressure = gatt_svc_pressure,
+        .temperature = gatt_svc_temperature,
+        .humidity = gatt_svc_humidity,
+        .battery_mv = gatt_svc_battery_mv,
+        .rollup_get = history_rollup_get,
     };
-    fb_draw_line(3, 32, clock, 8);
-
-    if (!sensors_valid) {
+    sample_get_derived(&in.derived);
+    gmtime_r(&now, &in.local);
+
+    fb_begin();
+    if (!render_panel_on(gatt_svc_display_mode, since_press)) {
+        ESP_LOGD(TAG, "Display mode %u: off (last press %lld seconds ago)",
+                 gatt_svc_display_mode, since_press / 1000000);
+        fb_clear();
         fb_flush();
+        display_set_enabled(false);
         return;
     }
+    if (gatt_svc_display_mode == DISPLAY_MODE_BUTTON) {
+        ESP_LOGI(TAG, "Display mode: BUTTON (last press %lld seconds ago)",
+                 since_press / 1000000);
+    }
+    display_set_enabled(true);
 
-    /* Page 4: XXXX.XXhPa — pressure in hPa */
-    int press_hpa = (int)(gatt_svc_pressure / 100.0f);
-    int press_dec = (int)(gatt_svc_pressure / 1.0f) % 100;
-    if (press_dec < 0) press_dec = -press_dec;
-    int pressure[] = {
-        press_hpa / 1000 % 10, press_hpa / 100 % 10,
-        press_hpa / 10 % 10,   press_hpa % 10,
-        GLYPH_DOT,
-        press_dec / 10, press_dec % 10,
-        GLYPH_hP, GLYPH_a
-    };
-    fb_draw_line(4, 28, pressure, 9);
-
-    /* Page 5: */
-#ifdef DISPLAY_SHOW_FAHRENHEIT
-    /* XXX°F — temperature converted from °C */
-    float temp_f = gatt_svc_temperature * 9.0f / 5.0f + 32.0f;
-    int tf = (int)temp_f;
-    int temp[] = {
-        tf / 100 % 10, tf / 10 % 10, tf % 10,
-        GLYPH_DEG, GLYPH_F,
-    };
-
-    fb_draw_line(5, 28, temp, 5);
-#else
-    /* XX.X°C — temperature in °C with 0.1° resolution */
-    int tc = (int)(gatt_svc_temperature * 10.0f);
-    int temp[] = {
-        tc / 100 % 10, tc / 10 % 10, GLYPH_DOT, tc % 10,
-        GLYPH_DEG, GLYPH_C,
-    };
-
-    fb_draw_line(5, 28, temp, 6);
-#endif
-
-    /* Page 6: XX%RH — humidity */
-    int hum = (int)gatt_svc_humidity;
-    int humidity[] = {
-        hum / 10 % 10, hum % 10, GLYPH_PCT, GLYPH_R, GLYPH_H
-    };
-    fb_draw_line(6, 28, humidity, 5);
-
-    /* Page 7: Battery voltage in mV */
-    int battery_mv = gatt_svc_battery_mv * 2; // Assuming a voltage divider
-                                              // that halves the battery voltage
-    int battery[] = {
-        battery_mv / 1000 % 10, battery_mv / 100 % 10,
-        battery_mv / 10 % 10, battery_mv % 10,
-        GLYPH_m, GLYPH_V
-    };
-    fb_draw_line(7, 28, battery, 6);
-
+    render_page(loop.page, &in);
     fb_flush();
 }
 
@@ -237,29 +194,24 @@ static void render_display(void)
 
 static void display_task(void *param)
 {
-    int count = 0;
-    int64_t last_button = button_time;
-
+    render_loop_init(&loop, button_time, button_presses);
     while (1) {
         button_poll(); /* Update button state */
-        if (button_time != last_button) {
-            /* New button press — always render immediately */
-            last_button = button_time;
+        if (render_loop_step(&loop, button_time, button_presses,
+                             display_is_on)) {
             render_display();
-            count = 0;
-        } else if (display_is_on && ++count >= 3) {
-            /* Only re-render periodically while display is on */
-            render_display();
-            count = 0;
         }
-        /* Poll faster when display is on for responsive timeout,
-         * slower when off to save power (fewer CPU wakeups) */
-        vTaskDelay(pdMS_TO_TICKS(display_is_on ? 2000 : 5000));
+        vTaskDelay(pdMS_TO_TICKS(render_loop_wait_ms(display_is_on)));
     }
 }
 
 /* ---- Initialization ----------------------------------------------------- */
 
+static StackType_t display_task_stack[CONFIG_APP_DISPLAY_TASK_STACK];
+static StaticTask_t display_task_tcb;
+static StackType_t flush_task_stack[CONFIG_APP_DISPLAY_FLUSH_STACK];
+static StaticTask_t flush_task_tcb;
+
 esp_err_t display_init(void)
 {
     /* I2C master bus (new driver) */
@@ -282,6 +234,7 @@ esp_err_t display_init(void)
         .lcd_cmd_bits = 8,
         .lcd_param_bits = 8,
         .dc_bit_offset = 6,
+        .on_color_trans_done = flush_done,
     };
     ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c(i2c_bus, &io_config, &panel_io));
 
@@ -308,7 +261,13 @@ esp_err_t display_init(void)
     esp_lcd_panel_io_tx_param(panel_io, 0xDB, &vcomh, 1);
     ESP_LOGI(TAG, "SSD1306 initialized via esp_lcd");
 
-    xTaskCreate(display_task, "display_task", 4096, NULL, tskIDLE_PRIORITY + 1, NULL);
+    flush_task_handle = xTaskCreateStatic(flush_task, "lcd_flush",
+                                          CONFIG_APP_DISPLAY_FLUSH_STACK, NULL,
+                                          tskIDLE_PRIORITY + 1,
+                                          flush_task_stack, &flush_task_tcb);
+    xTaskCreateStatic(display_task, "display_task",
+                      CONFIG_APP_DISPLAY_TASK_STACK, NULL, tskIDLE_PRIORITY + 1,
+                      display_task_stack, &display_task_tcb);
     return ESP_OK;
 }
 
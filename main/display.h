@@ -2,16 +2,22 @@
 #define DISPLAY_H
 
 #include <esp_err.h>
+#include <stdbool.h>
 #include "driver/i2c_master.h"
+#include "render.h"
 
 esp_err_t display_init(void);
 i2c_master_bus_handle_t display_get_i2c_bus(void);
-extern uint8_t gatt_svc_display_mode;
+void display_set_enabled(bool enabled);
 
-enum {
-    DISPLAY_MODE_NORMAL = 0,    // Normal display mode with sensor readings ON
-    DISPLAY_MODE_BUTTON = 1,    // Display shows for 5 seconds after button
-    DISPLAY_MODE_BLANK = 2,     // Display always blanked
-};
+/** Draw the current readings into the back framebuffer and queue it for
+ *  the panel; returns without waiting for the transfer.  Safe to call
+ *  without a panel; the flush is then skipped. */
+void render_display(void);
+
+/** Frames drawn over before they reached the panel, since boot. */
+uint32_t display_frames_dropped(void);
+
+extern uint8_t gatt_svc_display_mode;   /* DISPLAY_MODE_*, see render.h */
 
 #endif  /* DISPLAY_H */
\ No newline at end of file
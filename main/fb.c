@@ -0,0 +1,76 @@
+#include "fb.h"
+
+#include <string.h>
+
+/* ---- 8x8 font (column-major, LSB = top pixel) -------------------------- */
+
+static const uint8_t font[][8] = {
+    { 0x3E, 0x51, 0x49, 0x45, 0x3E, 0x00, 0x00, 0x00 }, /* 0 */
+    { 0x00, 0x42, 0x7F, 0x40, 0x00, 0x00, 0x00, 0x00 }, /* 1 */
+    { 0x42, 0x61, 0x51, 0x49, 0x46, 0x00, 0x00, 0x00 }, /* 2 */
+    { 0x21, 0x41, 0x45, 0x4B, 0x31, 0x00, 0x00, 0x00 }, /* 3 */
+    { 0x18, 0x14, 0x12, 0x7F, 0x10, 0x00, 0x00, 0x00 }, /* 4 */
+    { 0x27, 0x45, 0x45, 0x45, 0x39, 0x00, 0x00, 0x00 }, /* 5 */
+    { 0x3C, 0x4A, 0x49, 0x49, 0x30, 0x00, 0x00, 0x00 }, /* 6 */
+    { 0x01, 0x71, 0x09, 0x05, 0x03, 0x00, 0x00, 0x00 }, /* 7 */
+    { 0x36, 0x49, 0x49, 0x49, 0x36, 0x00, 0x00, 0x00 }, /* 8 */
+    { 0x06, 0x49, 0x49, 0x29, 0x1E, 0x00, 0x00, 0x00 }, /* 9 */
+    { 0x00, 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* : */
+    { 0x00, 0x60, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* . */
+    { 0x06, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00, 0x00 }, /* DEG */
+    { 0x7F, 0x09, 0x09, 0x09, 0x01, 0x00, 0x00, 0x00 }, /* F */
+    { 0x3E, 0x41, 0x41, 0x41, 0x22, 0x00, 0x00, 0x00 }, /* C */
+    { 0x23, 0x13, 0x08, 0x64, 0x62, 0x00, 0x00, 0x00 }, /* % */
+    { 0x7F, 0x08, 0x04, 0x04, 0x7f, 0x09, 0x09, 0x06 }, /* hP ligature*/
+    { 0x7F, 0x09, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00 }, /* P */
+    { 0x20, 0x54, 0x54, 0x54, 0x78, 0x00, 0x00, 0x00 }, /* a */
+    { 0x7C, 0x04, 0x18, 0x04, 0x78, 0x00, 0x00, 0x00 }, /* m */
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F, 0x00, 0x00, 0x00 }, /* V */
+    { 0x7F, 0x09, 0x19, 0x29, 0x46, 0x00, 0x00, 0x00 }, /* R */
+    { 0x7F, 0x08, 0x08, 0x08, 0x7F, 0x00, 0x00, 0x00 }, /* H */
+    { 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00 }, /* - */
+    { 0x08, 0x08, 0x3E, 0x08, 0x08, 0x00, 0x00, 0x00 }, /* + */
+    { 0x04, 0x02, 0x7F, 0x02, 0x04, 0x00, 0x00, 0x00 }, /* UP */
+    { 0x10, 0x20, 0x7F, 0x20, 0x10, 0x00, 0x00, 0x00 }, /* DOWN */
+    { 0x08, 0x08, 0x2A, 0x1C, 0x08, 0x00, 0x00, 0x00 }, /* RIGHT */
+    { 0x30, 0x4C, 0x43, 0x4C, 0x30, 0x00, 0x00, 0x00 }, /* DROP */
+};
+
+/* ---- Framebuffer -------------------------------------------------------- */
+
+fb_page_t fb_buffers[2][FB_PAGES];
+fb_page_t *fb = fb_buffers[0];
+
+void fb_clear(void)
+{
+    memset(fb, 0, FB_BYTES);
+}
+
+void fb_draw_glyph(int page, int col, int glyph_idx)
+{
+    const uint8_t *g = font[glyph_idx];
+    for (int x = 0; x < 8 && (col + x) < FB_WIDTH; x++)
+        fb[page][col + x] = g[x];
+}
+
+/* ---- Draw a centered line of glyphs ------------------------------------- */
+
+void fb_draw_line(int page, int start_col, const int *glyphs, int count)
+{
+    int col = start_col;
+    for (int i = 0; i < count; i++) {
+        fb_draw_glyph(page, col, glyphs[i]);
+        col += 8;
+    }
+}
+
+/* ---- Vertical line ------------------------------------------------------ */
+
+void fb_draw_vline(int col, int top, int bottom)
+{
+    if (col < 0 || col >= FB_WIDTH) return;
+    if (top < 0) top = 0;
+    if (bottom > FB_PAGES * 8 - 1) bottom = FB_PAGES * 8 - 1;
+    for (int y = top; y <= bottom; y++)
+        fb[y / 8][col] |= 1u << (y % 8);
+}
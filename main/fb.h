@@ -0,0 +1,50 @@
+#ifndef FB_H
+#define FB_H
+
+#include <stdint.h>
+
+#define FB_WIDTH  128
+#define FB_PAGES  8     /* 8 pages of 8 rows = 64 rows */
+
+/* ---- Glyph indices (0-9 are the digits) --------------------------------- */
+
+enum {
+    GLYPH_COLON = 10,
+    GLYPH_DOT,
+    GLYPH_DEG,
+    GLYPH_F,
+    GLYPH_C,
+    GLYPH_PCT,
+    GLYPH_hP,
+    GLYPH_P,
+    GLYPH_a,
+    GLYPH_m,
+    GLYPH_V,
+    GLYPH_R,
+    GLYPH_H,
+    GLYPH_MINUS,
+    GLYPH_PLUS,
+    GLYPH_UP,       /* pressure rising */
+    GLYPH_DOWN,     /* pressure falling */
+    GLYPH_RIGHT,    /* pressure steady */
+    GLYPH_DROP,     /* dew point */
+};
+
+/* Page-major SSD1306 framebuffer: fb[page][column], LSB = top pixel.
+ * There are two; fb points at the one being drawn, and display.c sends the
+ * other to the panel meanwhile. */
+#define FB_BYTES  (FB_PAGES * FB_WIDTH)
+
+typedef uint8_t fb_page_t[FB_WIDTH];
+
+extern fb_page_t fb_buffers[2][FB_PAGES];
+extern fb_page_t *fb;
+
+void fb_clear(void);
+void fb_draw_glyph(int page, int col, int glyph_idx);
+void fb_draw_line(int page, int start_col, const int *glyphs, int count);
+
+/** Set the pixels of column col from row top to row bottom inclusive. */
+void fb_draw_vline(int col, int top, int bottom);
+
+#endif /* FB_H */
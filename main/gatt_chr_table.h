@@ -0,0 +1,70 @@
+#ifndef GATT_CHR_TABLE_H
+#define GATT_CHR_TABLE_H
+
+/*
+ * The characteristics of the custom service, in registration order.  This
+ * is the only place they are listed: gatt_svc.c expands the table into the
+ * NimBLE definitions, and tools/gen_gatt_bindings.py turns it into
+ * tools/gatt_chrs.py and tools/gatt_chrs.js.  Rerun it after an edit.
+ *
+ *   V(id, uuid, name, fmt, unit, scale, flags, var, on_write)
+ *       The value lives in var.  A read copies it.  A write must be exactly
+ *       sizeof(var) bytes; it is handed to on_write(const void *), or
+ *       copied into var if on_write is NULL.  Notifications send var.
+ *   F(id, uuid, name, fmt, unit, scale, flags, read, write)
+ *       read(struct os_mbuf *) appends the value; write(struct os_mbuf *)
+ *       consumes one.  Either may be NULL if the flags rule it out.  Use
+ *       it for a value whose owner keeps it behind a lock; the owner
+ *       notifies it too, as gatt_svc_notify_readings() only sends V
+ *       entries.
+ *
+ * Hooks return 0 or a BLE_ATT_ERR_* code, which goes back to the client.
+ *
+ * uuid is the second group of deadbeef-XXXX-2000-3000-aabbccddeeff.  fmt
+ * is a Python struct format of the value ("" for opaque bytes).  Clients
+ * multiply the decoded value by scale to get unit.  flags: R, RW, RN
+ * (read + notify), RI (read + indicate), WI (write + indicate).
+ *
+ * Append new entries at the end: attribute handles follow this order and
+ * bonded clients cache them (see docs/connections.md).
+ */
+
+#define GATT_CHR_TABLE(V, F)                                                   \
+    F(DATA,         0x1001, "Data",          "",         "",    1,    RW,      \
+      data_read, data_write)                                                   \
+    V(PRESSURE,     0x1002, "Pressure",      "<f",       "hPa", 0.01, RN,      \
+      gatt_svc_pressure, NULL)                                                 \
+    V(TEMPERATURE,  0x1003, "Temperature",   "<f",       "°C",  1,    RN,      \
+      gatt_svc_temperature, NULL)                                              \
+    V(HUMIDITY,     0x1004, "Humidity",      "<f",       "%",   1,    RN,      \
+      gatt_svc_humidity, NULL)                                                 \
+    V(BATTERY,      0x1007, "Battery",       "<I",       "mV",  2,    RN,      \
+      gatt_svc_battery_mv, NULL)                                               \
+    F(TIME,         0x1005, "Time",          "<q",       "s",   1,    RW,      \
+      time_read, time_write)                                                   \
+    V(TIMEZONE,     0x1006, "Timezone",      "<b",       "min", 15,   RW,      \
+      tz_quarter_hours, tz_write)                                              \
+    V(DISPLAY_MODE, 0x1008, "Display mode",  "<B",       "",    1,    RW,      \
+      gatt_svc_display_mode, display_mode_write)                               \
+    F(DERIVED,      0x100a, "Derived",       "<hHhBciI", "",    1,    RN,      \
+      derived_read, NULL)                                                      \
+    F(SEA_LEVEL,    0x100b, "Sea level",     "<I",       "hPa", 0.01, RW,      \
+      sea_level_read, sea_level_write)                                         \
+    F(MEMORY,       0x100c, "Memory report", "",         "",    1,    R,       \
+      mem_read, NULL)                                                          \
+    F(POWER,        0x100d, "Power",         "<IIIIIII", "",    1,    R,       \
+      power_read, NULL)                                                        \
+    F(RULES,        0x100e, "Rules",         "",         "",    1,    RW,      \
+      rules_read, rules_write)                                                 \
+    F(ALARM,        0x100f, "Alarm",         "<BBBBI",   "",    1,    RI,      \
+      alarm_read, NULL)                                                        \
+    F(ROLLUP,       0x1010, "Rollup",        "",         "",    1,    RW,      \
+      rollup_read, rollup_write)                                               \
+    F(CONTROL,      0x1011, "Control point", "",         "",    1,    WI,      \
+      NULL, control_write)                                                     \
+    F(SCHEDULE,     0x1012, "Schedule",      "",         "",    1,    RW,      \
+      schedule_read, schedule_write)                                           \
+    V(PROFILE,      0x1013, "Profile",       "<BBBBII",  "",    1,    RI,      \
+      gatt_svc_profile, NULL)
+
+#endif /* GATT_CHR_TABLE_H */
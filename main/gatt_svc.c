@@ -1,5 +1,17 @@
 #include "gatt_svc.h"
+#include "adv.h"
+#include "alarm.h"
+#include "ble_conn.h"
+#include "ctrl.h"
 #include "display.h"
+#include "history.h"
+#include "sensor_task.h"
+#include "memstat.h"
+#include "powerstat.h"
+#include "profile.h"
+#include "record.h"
+#include "sample.h"
+#include "settings.h"
 
 #include <string.h>
 #include <sys/time.h>
@@ -10,56 +22,30 @@
 #include "services/gap/ble_svc_gap.h"
 #include "services/gatt/ble_svc_gatt.h"
 
+#define BLOG_LOCAL
+#include "blog.h"
+
 static const char *TAG = "gatt_svc";
 
 /* ---- Custom 128-bit UUIDs ------------------------------------------------
  *
- * Service:        deadbeef-1000-2000-3000-aabbccddeeff
- * Characteristic: deadbeef-1001-2000-3000-aabbccddeeff
- * Pressure:       deadbeef-1002-2000-3000-aabbccddeeff
- * Temperature:    deadbeef-1003-2000-3000-aabbccddeeff
- * Humidity:       deadbeef-1004-2000-3000-aabbccddeeff
- * Time:           deadbeef-1005-2000-3000-aabbccddeeff
- * Timezone:       deadbeef-1006-2000-3000-aabbccddeeff
- * Battery:        deadbeef-1007-2000-3000-aabbccddeeff
+ * Service:         deadbeef-1000-2000-3000-aabbccddeeff
+ * Characteristics: deadbeef-XXXX-2000-3000-aabbccddeeff, XXXX from
+ *                  gatt_chr_table.h
  *
  * NimBLE stores UUIDs in little-endian byte order.
  */
-static const ble_uuid128_t svc_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x00, 0x10, 0xef, 0xbe, 0xad, 0xde);
-
-static const ble_uuid128_t chr_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x01, 0x10, 0xef, 0xbe, 0xad, 0xde);
-
-static const ble_uuid128_t chr_time_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x05, 0x10, 0xef, 0xbe, 0xad, 0xde);
-
-static const ble_uuid128_t chr_tz_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x06, 0x10, 0xef, 0xbe, 0xad, 0xde);
-
-static const ble_uuid128_t chr_press_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x02, 0x10, 0xef, 0xbe, 0xad, 0xde);
-
-static const ble_uuid128_t chr_temp_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x03, 0x10, 0xef, 0xbe, 0xad, 0xde);
+#define GATT_UUID(n)                                                          \
+    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,          \
+                     0x00, 0x20, (n) & 0xff, (n) >> 8, 0xef, 0xbe, 0xad, 0xde)
 
-static const ble_uuid128_t chr_hum_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x04, 0x10, 0xef, 0xbe, 0xad, 0xde);
+static const ble_uuid128_t svc_uuid = GATT_UUID(0x1000);
 
-static const ble_uuid128_t chr_batt_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x07, 0x10, 0xef, 0xbe, 0xad, 0xde);
+#define CHR_UUID(id, uuid16, ...) [GATT_CHR_##id] = GATT_UUID(uuid16),
 
-static const ble_uuid128_t chr_mode_uuid =
-    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
-                     0x00, 0x20, 0x08, 0x10, 0xef, 0xbe, 0xad, 0xde);
+static const ble_uuid128_t chr_uuids[GATT_CHR_COUNT] = {
+    GATT_CHR_TABLE(CHR_UUID, CHR_UUID)
+};
 
 /* ---- Characteristic value storage ---------------------------------------- */
 
@@ -68,7 +54,8 @@ static const ble_uuid128_t chr_mode_uuid =
 static uint8_t chr_val[CHR_VAL_MAX_LEN];
 static uint16_t chr_val_len;
 
-uint16_t gatt_svc_chr_val_handle;
+/* Filled in by ble_gatts_add_svcs() */
+static uint16_t val_handles[GATT_CHR_COUNT];
 
 /* ---- BMX Sensor values --------------------------------------------------- */
 float gatt_svc_pressure;
@@ -79,6 +66,10 @@ float gatt_svc_humidity;
 
 uint32_t gatt_svc_battery_mv;
 
+/* ---- Schedule entry in force (maintained by profile.c) ------------------ */
+
+struct sched_status gatt_svc_profile;
+
 /* ---- Display mode -------------------------------------------------------- */
 
 uint8_t gatt_svc_display_mode = DISPLAY_MODE_BUTTON;
@@ -87,170 +78,411 @@ uint8_t gatt_svc_display_mode = DISPLAY_MODE_BUTTON;
 /* Timezone offset in quarter-hours from UTC (int8_t, e.g. -20 = UTC-5, +22 = UTC+5:30) */
 static int8_t tz_quarter_hours;
 
-/* ---- Access callback ----------------------------------------------------- */
+/* ---- Read and write hooks ------------------------------------------------ */
 
-static int chr_access_cb(uint16_t conn_handle, uint16_t attr_handle,
-                         struct ble_gatt_access_ctxt *ctxt, void *arg)
-{
-    int rc;
+/* Connection of the access being handled; hooks run on the host task. */
+static uint16_t access_conn;
 
-    switch (ctxt->op) {
-    case BLE_GATT_ACCESS_OP_READ_CHR:
-        rc = os_mbuf_append(ctxt->om, chr_val, chr_val_len);
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+static int data_read(struct os_mbuf *om)
+{
+    return os_mbuf_append(om, chr_val, chr_val_len) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
 
-    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
-        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
-        if (om_len > CHR_VAL_MAX_LEN) {
-            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
-        }
-        rc = ble_hs_mbuf_to_flat(ctxt->om, chr_val, sizeof(chr_val),
-                                 &chr_val_len);
-        return rc == 0 ? 0 : BLE_ATT_ERR_UNLIKELY;
+static int data_write(struct os_mbuf *om)
+{
+    if (OS_MBUF_PKTLEN(om) > CHR_VAL_MAX_LEN) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
+    return ble_hs_mbuf_to_flat(om, chr_val, sizeof(chr_val), &chr_val_len) == 0
+               ? 0 : BLE_ATT_ERR_UNLIKELY;
+}
 
-    default:
-        return BLE_ATT_ERR_UNLIKELY;
-    }
+static int time_read(struct os_mbuf *om)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now = (int64_t)tv.tv_sec;
+    return os_mbuf_append(om, &now, sizeof(now)) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
 }
 
-/* ---- Time access callback ------------------------------------------------ */
+/* Setters for settings.c, which has checked the value */
+static void time_set(int64_t ts)
+{
+    struct timeval tv = { .tv_sec = (time_t)ts, .tv_usec = 0 };
+    settimeofday(&tv, NULL);
+    ESP_LOGI(TAG, "system time set to %lld", (long long)ts);
+}
 
-static int time_access_cb(uint16_t conn_handle, uint16_t attr_handle,
-                           struct ble_gatt_access_ctxt *ctxt, void *arg)
+static void tz_set(int8_t val)
 {
-    int rc;
+    tz_quarter_hours = val;
+    ESP_LOGI(TAG, "timezone set to %+d quarter-hours (UTC%+d:%02d)",
+             val, val / 4, abs(val % 4) * 15);
+}
 
-    switch (ctxt->op) {
-    case BLE_GATT_ACCESS_OP_READ_CHR: {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        int64_t now = (int64_t)tv.tv_sec;
-        rc = os_mbuf_append(ctxt->om, &now, sizeof(now));
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
-    }
+static void display_mode_set(uint8_t val)
+{
+    gatt_svc_display_mode = val;
+    ESP_LOGI(TAG, "display mode set to %u", val);
+}
 
-    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
-        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
-        if (om_len != sizeof(int64_t)) {
-            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
-        }
-        int64_t ts;
-        uint16_t flat_len;
-        rc = ble_hs_mbuf_to_flat(ctxt->om, &ts, sizeof(ts), &flat_len);
-        if (rc != 0) {
-            return BLE_ATT_ERR_UNLIKELY;
-        }
-        struct timeval tv = { .tv_sec = (time_t)ts, .tv_usec = 0 };
-        settimeofday(&tv, NULL);
-        ESP_LOGI(TAG, "system time set to %lld", (long long)ts);
+_Static_assert(SAMPLE_PROFILE_COUNT == SETTINGS_PROFILES &&
+               ADV_PROFILE_COUNT == SETTINGS_PROFILES,
+               "settings.c checks profiles against SETTINGS_PROFILES");
+
+static const struct settings_ops settings = {
+    .time = time_set,
+    .tz = tz_set,
+    .display_mode = display_mode_set,
+    .sample_profile = sensor_task_set_profile,
+    .adv_profile = adv_set_profile,
+    .sea_level = sensor_task_set_sea_level,
+    .schedule = profile_update,
+};
+
+static int setting_write(uint8_t type, const void *v, size_t len)
+{
+    switch (settings_write(&settings, type, v, len)) {
+    case CTRL_ST_OK:
         return 0;
+    case CTRL_ST_BAD_LEN:
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    default:
+        return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
     }
+}
 
-    default:
+static int time_write(struct os_mbuf *om)
+{
+    int64_t ts;
+
+    if (OS_MBUF_PKTLEN(om) != sizeof(ts)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, &ts, sizeof(ts), NULL) != 0) {
         return BLE_ATT_ERR_UNLIKELY;
     }
+    return setting_write(CTRL_T_TIME, &ts, sizeof(ts));
 }
 
-/* ---- Sensor access callback ---------------------------------------------- */
+static int tz_write(const void *v)
+{
+    return setting_write(CTRL_T_TZ, v, sizeof(tz_quarter_hours));
+}
 
-static int sensor_access_cb(uint16_t conn_handle, uint16_t attr_handle,
-                             struct ble_gatt_access_ctxt *ctxt, void *arg)
+static int display_mode_write(const void *v)
 {
-    const ble_uuid_t *uuid = ctxt->chr->uuid;
-    float val;
-    int rc;
+    return setting_write(CTRL_T_DISPLAY_MODE, v,
+                         sizeof(gatt_svc_display_mode));
+}
 
-    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
-        return BLE_ATT_ERR_UNLIKELY;
-    }
+/* The derived metrics live in sample.c, behind derived_lock */
+static int derived_read(struct os_mbuf *om)
+{
+    struct derived d;
+
+    sample_get_derived(&d);
+    return os_mbuf_append(om, &d, sizeof(d)) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int sea_level_read(struct os_mbuf *om)
+{
+    uint32_t pa, k;
+
+    sample_get_sea_level(&pa, &k);
+    return os_mbuf_append(om, &pa, sizeof(pa)) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int sea_level_write(struct os_mbuf *om)
+{
+    uint32_t pa;
 
-    if (ble_uuid_cmp(uuid, &chr_press_uuid.u) == 0) {
-        val = gatt_svc_pressure;
-    } else if (ble_uuid_cmp(uuid, &chr_temp_uuid.u) == 0) {
-        val = gatt_svc_temperature;
-    } else if (ble_uuid_cmp(uuid, &chr_hum_uuid.u) == 0) {
-        val = gatt_svc_humidity;
-    } else {
+    if (OS_MBUF_PKTLEN(om) != sizeof(pa)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, &pa, sizeof(pa), NULL) != 0) {
         return BLE_ATT_ERR_UNLIKELY;
     }
+    return setting_write(CTRL_T_SEA_LEVEL, &pa, sizeof(pa));
+}
+
+static int mem_read(struct os_mbuf *om)
+{
+    uint8_t report[MEMSTAT_REPORT_MAX];
 
-    rc = os_mbuf_append(ctxt->om, &val, sizeof(val));
-    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    size_t len = memstat_encode(report, sizeof(report));
+    return os_mbuf_append(om, report, len) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
 }
 
-/* ---- Battery access callback --------------------------------------------- */
+static int power_read(struct os_mbuf *om)
+{
+    struct powerstat p;
+
+    powerstat_get(&p);
+    return os_mbuf_append(om, &p, sizeof(p)) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int rules_read(struct os_mbuf *om)
+{
+    struct rule r[RULES_MAX];
+
+    size_t n = alarm_get_rules(r);
+    return os_mbuf_append(om, r, n * sizeof(r[0])) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
 
-static int batt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
-                           struct ble_gatt_access_ctxt *ctxt, void *arg)
+/* The status lives in alarm.c, behind alarm_lock */
+static int alarm_read(struct os_mbuf *om)
 {
-    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+    struct rules_status st;
+
+    alarm_get_status(&st);
+    return os_mbuf_append(om, &st, sizeof(st)) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+/* The whole table is written at once (a long write for more than one
+ * rule); an empty write removes every rule. */
+static int rules_write(struct os_mbuf *om)
+{
+    struct rule r[RULES_MAX];
+    uint16_t len = OS_MBUF_PKTLEN(om);
+
+    if (len > sizeof(r) || len % sizeof(r[0]) != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, r, sizeof(r), NULL) != 0) {
         return BLE_ATT_ERR_UNLIKELY;
     }
-
-    int rc = os_mbuf_append(ctxt->om, &gatt_svc_battery_mv, sizeof(gatt_svc_battery_mv));
-    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    return alarm_set_rules(r, len / sizeof(r[0])) == ESP_OK
+               ? 0 : BLE_ATT_ERR_VALUE_NOT_ALLOWED;
 }
 
-/* ---- Display mode access callback ---------------------------------------- */
+static int schedule_read(struct os_mbuf *om)
+{
+    struct sched_entry e[SCHED_MAX];
+
+    size_t n = profile_get_schedule(e);
+    return os_mbuf_append(om, e, n * sizeof(e[0])) == 0
+               ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
 
-static int display_mode_access_cb(uint16_t conn_handle, uint16_t attr_handle,
-                                   struct ble_gatt_access_ctxt *ctxt, void *arg)
+/* Like Rules: the whole table at once, empty to remove the schedule. */
+static int schedule_write(struct os_mbuf *om)
 {
-    int rc;
+    struct sched_entry e[SCHED_MAX];
+    uint16_t len = OS_MBUF_PKTLEN(om);
 
-    switch (ctxt->op) {
-    case BLE_GATT_ACCESS_OP_READ_CHR:
-        rc = os_mbuf_append(ctxt->om, &gatt_svc_display_mode, sizeof(gatt_svc_display_mode));
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    if (len > sizeof(e) || len % sizeof(e[0]) != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, e, sizeof(e), NULL) != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    return profile_set_schedule(e, len / sizeof(e[0])) == ESP_OK
+               ? 0 : BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+}
 
-    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
-        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
-        if (om_len != sizeof(uint8_t)) {
-            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
-        }
-        uint8_t val;
-        uint16_t flat_len;
-        rc = ble_hs_mbuf_to_flat(ctxt->om, &val, sizeof(val), &flat_len);
-        if (rc != 0) {
-            return BLE_ATT_ERR_UNLIKELY;
+/* Rollup query: write the level and time range, then read the slots.  A
+ * read returns at most ROLLUP_READ_MAX slots, oldest first, and does not
+ * move the query, so a long read (Read Blob) sees the same value.  For more,
+ * write again with from set past the last slot received.  Each connection
+ * has its own query, so centrals paging at once don't disturb each other. */
+struct __attribute__((packed)) rollup_request {
+    uint8_t  level;             /* enum rollup_level */
+    uint8_t  reserved[3];
+    uint32_t from;              /* slot start, UNIX seconds, inclusive */
+    uint32_t to;
+};
+
+struct __attribute__((packed)) rollup_reply {
+    uint8_t  level;
+    uint8_t  count;             /* slots that follow */
+    uint16_t total;             /* slots stored at this level */
+};
+
+#define ROLLUP_READ_MAX 15      /* 484 bytes, within one ATT value */
+
+static struct rollup_conn {
+    uint16_t conn;              /* BLE_HS_CONN_HANDLE_NONE when free */
+    struct rollup_request q;
+} rollup_conns[BLE_CONN_MAX];
+
+static struct rollup_conn *rollup_conn_find(uint16_t conn)
+{
+    for (int i = 0; i < BLE_CONN_MAX; i++) {
+        if (rollup_conns[i].conn == conn) {
+            return &rollup_conns[i];
         }
-        gatt_svc_display_mode = val;
-        ESP_LOGI(TAG, "display mode set to %u", val);
-        return 0;
     }
+    return NULL;
+}
 
-    default:
+static int rollup_read(struct os_mbuf *om)
+{
+    struct rollup_slot slots[ROLLUP_READ_MAX];
+    struct rollup_conn *c = rollup_conn_find(access_conn);
+    struct rollup_request q = { .to = UINT32_MAX };
+    struct rollup_reply hdr;
+
+    if (c) {
+        q = c->q;
+    }
+    hdr.level = q.level;
+    hdr.count = history_rollup_query(q.level, q.from, q.to, slots,
+                                     ROLLUP_READ_MAX);
+    hdr.total = history_rollup_count(q.level);
+    if (os_mbuf_append(om, &hdr, sizeof(hdr)) != 0 ||
+        os_mbuf_append(om, slots, hdr.count * sizeof(slots[0])) != 0) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    return 0;
+}
+
+static int rollup_write(struct os_mbuf *om)
+{
+    struct rollup_conn *c = rollup_conn_find(access_conn);
+    struct rollup_request q;
+
+    if (OS_MBUF_PKTLEN(om) != sizeof(q)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, &q, sizeof(q), NULL) != 0) {
         return BLE_ATT_ERR_UNLIKELY;
     }
+    if (q.level >= ROLLUP_LEVELS || q.from > q.to) {
+        return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+    }
+    if (!c) {
+        c = rollup_conn_find(BLE_HS_CONN_HANDLE_NONE);
+    }
+    if (!c) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    c->conn = access_conn;
+    c->q = q;
+    return 0;
+}
+
+/* Control point (ctrl.h).  Like a Record Access Control Point, the writer
+ * must have enabled indications, and the response goes to it alone. */
+#define ATT_ERR_CCCD_IMPROPER   0xfd
+
+static int control_write(struct os_mbuf *om)
+{
+    uint8_t req[CTRL_HDR_LEN + CTRL_ITEMS_MAX * (2 + 8)];
+    uint8_t rsp[CTRL_RSP_MAX];
+    uint16_t handle = val_handles[GATT_CHR_CONTROL];
+    struct ctrl_batch b;
+    uint16_t len;
+
+    if (!ble_conn_indicating(access_conn, handle)) {
+        return ATT_ERR_CCCD_IMPROPER;
+    }
+    if (OS_MBUF_PKTLEN(om) > sizeof(req)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(om, req, sizeof(req), &len) != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    settings_control(&settings, req, len, &b);
+    ESP_LOGI(TAG, "control op 0x%02x, %u item(s): result %u",
+             b.op, b.count, b.result);
+
+    struct os_mbuf *rom = ble_hs_mbuf_from_flat(rsp, ctrl_response(&b, rsp));
+    if (rom == NULL ||
+        ble_gatts_indicate_custom(access_conn, handle, rom) != 0) {
+        ESP_LOGW(TAG, "control response not sent");
+    }
+    return 0;
 }
 
-/* ---- Timezone access callback -------------------------------------------- */
+/* ---- Table expansion ----------------------------------------------------- */
+
+#define CHR_FLAGS_R     BLE_GATT_CHR_F_READ
+#define CHR_FLAGS_RW    (BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE)
+#define CHR_FLAGS_RN    (BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY)
+#define CHR_FLAGS_RI    (BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_INDICATE)
+#define CHR_FLAGS_WI    (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_INDICATE)
+
+/* What the access callback needs for one characteristic; passed as .arg so
+ * dispatch is a pointer dereference rather than a UUID search. */
+struct chr_entry {
+    uint16_t uuid16;
+    void *var;
+    uint16_t len;
+    int (*on_write)(const void *val);
+    int (*read)(struct os_mbuf *om);
+    int (*write)(struct os_mbuf *om);
+};
+
+#define CHR_ENTRY_V(id, uuid, name, fmt, unit, scale, flags, var_, wr)        \
+    [GATT_CHR_##id] = { .uuid16 = uuid, .var = &(var_),                       \
+                        .len = sizeof(var_), .on_write = wr },
+#define CHR_ENTRY_F(id, uuid, name, fmt, unit, scale, flags, rd, wr)          \
+    [GATT_CHR_##id] = { .uuid16 = uuid, .read = rd, .write = wr },
+
+static const struct chr_entry chr_entries[GATT_CHR_COUNT] = {
+    GATT_CHR_TABLE(CHR_ENTRY_V, CHR_ENTRY_F)
+};
 
-static int tz_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+/* Writes to V entries are staged on the stack so on_write can reject them */
+#define CHR_WRITE_MAX   32
+
+#define CHR_CHECK_V(id, uuid16, name, fmt, unit, scale, flags, var_, wr)      \
+    _Static_assert(sizeof(var_) <= CHR_WRITE_MAX, #id " too large");
+#define CHR_CHECK_F(id, uuid16, name, fmt, unit, scale, flags, rd, wr)
+
+GATT_CHR_TABLE(CHR_CHECK_V, CHR_CHECK_F)
+
+static int chr_access_cb(uint16_t conn_handle, uint16_t attr_handle,
                          struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
-    int rc;
+    const struct chr_entry *e = arg;
 
+    access_conn = conn_handle;
     switch (ctxt->op) {
     case BLE_GATT_ACCESS_OP_READ_CHR:
-        rc = os_mbuf_append(ctxt->om, &tz_quarter_hours, sizeof(tz_quarter_hours));
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+        if (e->read) {
+            return e->read(ctxt->om);
+        }
+        return os_mbuf_append(ctxt->om, e->var, e->len) == 0
+                   ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
 
     case BLE_GATT_ACCESS_OP_WRITE_CHR: {
-        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
-        if (om_len != sizeof(int8_t)) {
+        if (record_active()) {
+            uint8_t rec[TRACE_PAYLOAD_MAX - 2];
+            uint16_t n = OS_MBUF_PKTLEN(ctxt->om);
+            if (n > sizeof(rec)) {
+                n = sizeof(rec);
+            }
+            os_mbuf_copydata(ctxt->om, 0, n, rec);
+            record_write(e->uuid16, rec, n);
+        }
+        if (e->write) {
+            return e->write(ctxt->om);
+        }
+        if (!e->var) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+        uint8_t val[CHR_WRITE_MAX];
+        if (OS_MBUF_PKTLEN(ctxt->om) != e->len) {
             return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
         }
-        int8_t val;
-        uint16_t flat_len;
-        rc = ble_hs_mbuf_to_flat(ctxt->om, &val, sizeof(val), &flat_len);
-        if (rc != 0) {
+        if (ble_hs_mbuf_to_flat(ctxt->om, val, e->len, NULL) != 0) {
             return BLE_ATT_ERR_UNLIKELY;
         }
-        tz_quarter_hours = val;
-        ESP_LOGI(TAG, "timezone set to %+d quarter-hours (UTC%+d:%02d)",
-                 val, val / 4, abs(val % 4) * 15);
+        if (e->on_write) {
+            return e->on_write(val);
+        }
+        memcpy(e->var, val, e->len);
         return 0;
     }
 
@@ -261,52 +493,21 @@ static int tz_access_cb(uint16_t conn_handle, uint16_t attr_handle,
 
 /* ---- Service definition -------------------------------------------------- */
 
+#define CHR_DEF(id, uuid16, name, fmt, unit, scale, flags_, ...)              \
+    {                                                                         \
+        .uuid = &chr_uuids[GATT_CHR_##id].u,                                  \
+        .access_cb = chr_access_cb,                                           \
+        .arg = (void *)&chr_entries[GATT_CHR_##id],                           \
+        .flags = CHR_FLAGS_##flags_,                                          \
+        .val_handle = &val_handles[GATT_CHR_##id],                            \
+    },
+
 static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
     {
         .type = BLE_GATT_SVC_TYPE_PRIMARY,
         .uuid = &svc_uuid.u,
         .characteristics = (struct ble_gatt_chr_def[]){
-            {
-                .uuid = &chr_uuid.u,
-                .access_cb = chr_access_cb,
-                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
-                .val_handle = &gatt_svc_chr_val_handle,
-            },
-            {
-                 .uuid = &chr_press_uuid.u,
-                 .access_cb = sensor_access_cb,
-                 .flags = BLE_GATT_CHR_F_READ,
-            },
-            {
-                 .uuid = &chr_temp_uuid.u,
-                 .access_cb = sensor_access_cb,
-                 .flags = BLE_GATT_CHR_F_READ,
-            },
-            {
-                 .uuid = &chr_hum_uuid.u,
-                 .access_cb = sensor_access_cb,
-                 .flags = BLE_GATT_CHR_F_READ,
-            },
-            {
-                 .uuid = &chr_batt_uuid.u,
-                 .access_cb = batt_access_cb,
-                 .flags = BLE_GATT_CHR_F_READ,
-            },
-            {
-                .uuid = &chr_time_uuid.u,
-                .access_cb = time_access_cb,
-                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
-            },
-            {
-                .uuid = &chr_tz_uuid.u,
-                .access_cb = tz_access_cb,
-                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
-            },
-            {
-                .uuid = &chr_mode_uuid.u,
-                .access_cb = display_mode_access_cb,
-                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
-            },
+            GATT_CHR_TABLE(CHR_DEF, CHR_DEF)
             {0}, /* terminator */
         },
     },
@@ -320,10 +521,54 @@ int8_t gatt_svc_get_tz_quarter_hours(void)
     return tz_quarter_hours;
 }
 
+const ble_uuid128_t *gatt_svc_get_uuid(void)
+{
+    return &svc_uuid;
+}
+
+const struct ble_gatt_svc_def *gatt_svc_get_defs(void)
+{
+    return gatt_svr_svcs;
+}
+
+uint16_t gatt_svc_val_handle(enum gatt_chr_id id)
+{
+    return id < GATT_CHR_COUNT ? val_handles[id] : 0;
+}
+
+uint16_t gatt_svc_uuid16(enum gatt_chr_id id)
+{
+    return id < GATT_CHR_COUNT ? chr_entries[id].uuid16 : 0;
+}
+
+void gatt_svc_notify_readings(void)
+{
+    for (int i = 0; i < GATT_CHR_COUNT; i++) {
+        if (chr_entries[i].var &&
+            (gatt_svr_svcs[0].characteristics[i].flags &
+             BLE_GATT_CHR_F_NOTIFY)) {
+            ble_conn_notify(val_handles[i], chr_entries[i].var,
+                            chr_entries[i].len);
+        }
+    }
+}
+
+void gatt_svc_on_disconnect(uint16_t conn_handle)
+{
+    struct rollup_conn *c = rollup_conn_find(conn_handle);
+
+    if (c) {
+        c->conn = BLE_HS_CONN_HANDLE_NONE;
+    }
+}
+
 int gatt_svc_init(void)
 {
     int rc;
 
+    for (int i = 0; i < BLE_CONN_MAX; i++) {
+        rollup_conns[i].conn = BLE_HS_CONN_HANDLE_NONE;
+    }
     ble_svc_gap_init();
     ble_svc_gatt_init();
 
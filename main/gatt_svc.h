@@ -2,11 +2,45 @@
 
 #include <stdint.h>
 
+#include "host/ble_uuid.h"
+#include "gatt_chr_table.h"
+#include "rules.h"
+#include "sched.h"
+
+#define GATT_CHR_ID(id, ...) GATT_CHR_##id,
+
+/** Characteristics of the custom service, in gatt_chr_table.h order. */
+enum gatt_chr_id {
+    GATT_CHR_TABLE(GATT_CHR_ID, GATT_CHR_ID)
+    GATT_CHR_COUNT
+};
+
 /** Initialise the custom GATT service.  Call once before starting the host. */
 int gatt_svc_init(void);
 
-/** Attribute handle for the read/write characteristic (set after registration). */
-extern uint16_t gatt_svc_chr_val_handle;
+/** Value handle of a characteristic (0 until the host has registered it). */
+uint16_t gatt_svc_val_handle(enum gatt_chr_id id);
+
+/** The XXXX of a characteristic's UUID, as listed in gatt_chr_table.h. */
+uint16_t gatt_svc_uuid16(enum gatt_chr_id id);
+
+/** Schedule entry in force (the Profile characteristic), updated by
+ *  profile.c. */
+extern struct sched_status gatt_svc_profile;
+
+/** Notify subscribed centrals of the current sensor and battery readings. */
+void gatt_svc_notify_readings(void);
+
+/** Connection closed: forget its rollup query. */
+void gatt_svc_on_disconnect(uint16_t conn_handle);
 
 /** Return the timezone offset in quarter-hours from UTC. */
 int8_t gatt_svc_get_tz_quarter_hours(void);
+
+/** Return the 128-bit UUID of the custom service (used in advertising). */
+const ble_uuid128_t *gatt_svc_get_uuid(void);
+
+struct ble_gatt_svc_def;
+
+/** Return the registered service table (terminated by a zeroed entry). */
+const struct ble_gatt_svc_def *gatt_svc_get_defs(void);
@@ -0,0 +1,103 @@
+#include "history.h"
+#include "rollup.h"
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#define HISTORY_CAP CONFIG_APP_HISTORY_SAMPLES
+
+static struct history_sample ring[HISTORY_CAP];
+static size_t head;         /* next slot to write */
+static size_t count;
+static struct rollup rollups;
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void history_add(const struct history_sample *s)
+{
+    taskENTER_CRITICAL(&history_lock);
+    ring[head] = *s;
+    head = (head + 1) % HISTORY_CAP;
+    if (count < HISTORY_CAP) {
+        count++;
+    }
+    rollup_add(&rollups, s->time, s->temp_c100, s->hum_x100, s->press_pa);
+    taskEXIT_CRITICAL(&history_lock);
+}
+
+size_t history_count(void)
+{
+    return count;
+}
+
+size_t history_capacity(void)
+{
+    return HISTORY_CAP;
+}
+
+bool history_get(size_t i, struct history_sample *out)
+{
+    bool ok = false;
+
+    taskENTER_CRITICAL(&history_lock);
+    if (i < count) {
+        *out = ring[(head + HISTORY_CAP - count + i) % HISTORY_CAP];
+        ok = true;
+    }
+    taskEXIT_CRITICAL(&history_lock);
+    return ok;
+}
+
+size_t history_rollup_count(enum rollup_level level)
+{
+    size_t n;
+
+    taskENTER_CRITICAL(&history_lock);
+    n = rollup_count(&rollups, level);
+    taskEXIT_CRITICAL(&history_lock);
+    return n;
+}
+
+bool history_rollup_get(enum rollup_level level, size_t i,
+                        struct rollup_slot *out)
+{
+    bool ok;
+
+    taskENTER_CRITICAL(&history_lock);
+    ok = rollup_get(&rollups, level, i, out);
+    taskEXIT_CRITICAL(&history_lock);
+    return ok;
+}
+
+size_t history_rollup_query(enum rollup_level level, uint32_t from,
+                            uint32_t to, struct rollup_slot *out, size_t max)
+{
+    struct rollup_view v;
+    struct rollup_slot s;
+    size_t n;
+    bool ok;
+
+    /* Only the ring indices are taken together; each slot is copied under
+     * the lock on its own and filtered outside it.  If a slot is stored
+     * meanwhile (every 10 minutes at most) the walk starts again. */
+    do {
+        taskENTER_CRITICAL(&history_lock);
+        rollup_view(&rollups, level, &v);
+        taskEXIT_CRITICAL(&history_lock);
+
+        /* Newest to oldest index, so walk i downwards for oldest first */
+        n = 0;
+        ok = true;
+        for (size_t i = rollup_view_count(&v); i-- > 0 && n < max;) {
+            taskENTER_CRITICAL(&history_lock);
+            ok = rollup_view_get(&rollups, level, &v, i, &s);
+            taskEXIT_CRITICAL(&history_lock);
+            if (!ok) {
+                break;
+            }
+            if (s.start >= from && s.start <= to) {
+                out[n++] = s;
+            }
+        }
+    } while (!ok);
+    return n;
+}
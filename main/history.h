@@ -0,0 +1,42 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rollup.h"
+
+/*
+ * Ring buffer of recent sensor samples, statically sized by
+ * CONFIG_APP_HISTORY_SAMPLES.  Oldest samples are overwritten when full.
+ * Every sample is also folded into the rollups (rollup.h), which reach
+ * further back at lower resolution.
+ */
+
+struct history_sample {
+    uint32_t time;          /* UNIX seconds (uptime if the clock is unset) */
+    uint32_t press_pa;
+    int16_t  temp_c100;
+    uint16_t hum_x100;
+    uint16_t batt_mv;       /* as read on the ADC */
+    uint16_t reserved;
+};
+
+void   history_add(const struct history_sample *s);
+size_t history_count(void);
+size_t history_capacity(void);
+
+/** Copy sample i (0 = oldest) into *out; false if i is out of range. */
+bool   history_get(size_t i, struct history_sample *out);
+
+/** rollup_count() and rollup_get() on the history's rollups, and the
+ *  slots of a level whose start lies in [from, to], oldest first (up to
+ *  max; returns how many). */
+size_t history_rollup_count(enum rollup_level level);
+bool   history_rollup_get(enum rollup_level level, size_t i,
+                          struct rollup_slot *out);
+size_t history_rollup_query(enum rollup_level level, uint32_t from,
+                            uint32_t to, struct rollup_slot *out, size_t max);
+
+#endif /* HISTORY_H */
@@ -1,6 +1,8 @@
 #include <stdio.h>
 
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "nvs_flash.h"
 
 #if 0
@@ -15,56 +17,46 @@
 #include "host/util/util.h"
 #include "services/gap/ble_svc_gap.h"
 
+#include "adv.h"
+#include "alarm.h"
+#include "ble_conn.h"
+#include "bond.h"
+#include "boot.h"
 #include "gatt_svc.h"
+#include "ota_svc.h"
 #include "battery.h"
 #include "button.h"
 #include "power.h"
+#include "profile.h"
+#if CONFIG_APP_BENCHMARK
+#include "bench.h"
+#endif
+#if CONFIG_APP_BLOG
+#include "blog.h"
+#endif
+#if CONFIG_APP_COC
+#include "coc.h"
+#endif
+#if CONFIG_APP_CONSOLE
+#include "app_console.h"
+#endif
 
 static const char *TAG = "ble_app";
 
 #define DEVICE_NAME "ESP32-C3-BLE"
 
+/* How long app_main waits for the first advertisement before running the
+ * deferred work anyway, and for the peripheral init task to finish. */
+#define BOOT_ADV_TIMEOUT_MS     3000
+#define BOOT_PERIPH_TIMEOUT_MS  3000
+#define PERIPH_INIT_STACK       3072
+
 /* ---- Forward declarations ------------------------------------------------ */
 
 static void ble_app_on_sync(void);
 static void ble_app_on_reset(int reason);
 static int  gap_event_handler(struct ble_gap_event *event, void *arg);
 
-/* ---- Advertising --------------------------------------------------------- */
-
-static void start_advertising(void)
-{
-    struct ble_gap_adv_params adv_params;
-    struct ble_hs_adv_fields fields;
-    int rc;
-
-    memset(&fields, 0, sizeof(fields));
-    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
-    fields.tx_pwr_lvl_is_present = 1;
-    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
-    fields.name = (uint8_t *)DEVICE_NAME;
-    fields.name_len = strlen(DEVICE_NAME);
-    fields.name_is_complete = 1;
-
-    rc = ble_gap_adv_set_fields(&fields);
-    if (rc != 0) {
-        ESP_LOGE(TAG, "ble_gap_adv_set_fields failed: %d", rc);
-        return;
-    }
-
-    memset(&adv_params, 0, sizeof(adv_params));
-    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
-    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
-    adv_params.itvl_min = 3200; /* 2000ms in 0.625ms units */
-    adv_params.itvl_max = 3200;
-
-    rc = ble_gap_adv_start(BLE_OWN_ADDR_PUBLIC, NULL, BLE_HS_FOREVER,
-                           &adv_params, gap_event_handler, NULL);
-    if (rc != 0) {
-        ESP_LOGE(TAG, "ble_gap_adv_start failed: %d", rc);
-    }
-}
-
 /* ---- GAP event handler --------------------------------------------------- */
 
 static int gap_event_handler(struct ble_gap_event *event, void *arg)
@@ -74,23 +66,39 @@ static int gap_event_handler(struct ble_gap_event *event, void *arg)
         ESP_LOGI(TAG, "connection %s; handle=%d",
                  event->connect.status == 0 ? "established" : "failed",
                  event->connect.conn_handle);
-        if (event->connect.status != 0) {
-            /* Connection failed — resume advertising. */
-            start_advertising();
+        if (event->connect.status == 0) {
+            ble_conn_add(event->connect.conn_handle);
         }
+        /* Keep advertising while there is a free connection slot. */
+        adv_start();
         break;
 
     case BLE_GAP_EVENT_DISCONNECT:
         ESP_LOGI(TAG, "disconnected; reason=%d",
                  event->disconnect.reason);
-        start_advertising();
+        ble_conn_remove(event->disconnect.conn.conn_handle);
+        gatt_svc_on_disconnect(event->disconnect.conn.conn_handle);
+        ota_svc_on_disconnect(event->disconnect.conn.conn_handle);
+        adv_start();
         break;
 
     case BLE_GAP_EVENT_ADV_COMPLETE:
         ESP_LOGI(TAG, "advertising complete");
-        start_advertising();
+        adv_start();
+        break;
+
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        ble_conn_on_subscribe(event);
+        break;
+
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        ble_conn_on_update(event->conn_update.conn_handle);
         break;
 
+    case BLE_GAP_EVENT_ENC_CHANGE:
+    case BLE_GAP_EVENT_REPEAT_PAIRING:
+        return bond_on_gap_event(event);
+
     default:
         break;
     }
@@ -108,8 +116,12 @@ static void ble_app_on_sync(void)
     rc = ble_hs_util_ensure_addr(0);
     assert(rc == 0);
 
-    start_advertising();
+    bond_on_sync();
+
+    adv_start();
     ESP_LOGI(TAG, "advertising started");
+    boot_mark("advertising");
+    boot_signal(BOOT_EV_ADV);
 }
 
 static void ble_app_on_reset(int reason)
@@ -126,12 +138,84 @@ static void nimble_host_task(void *param)
     nimble_port_freertos_deinit();
 }
 
+/* ---- Peripheral init task ------------------------------------------------ */
+
+/* The display and sensor share the I2C bus the display creates, so they
+ * come up in order on their own task while app_main brings up NimBLE.  Both
+ * spend most of their init waiting on I2C transfers and panel/sensor reset
+ * delays, which is time the controller and host can use.  The stack is
+ * dynamic, unlike the long-lived tasks, so it goes back to the heap. */
+static void periph_init(void)
+{
+    if (display_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Display not available, continuing without it");
+    }
+    boot_mark("display");
+
+    if (sensor_task_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor task initialization failed, continuing without it");
+    }
+    boot_mark("sensor");
+
+    boot_signal(BOOT_EV_PERIPH);
+}
+
+static void periph_init_task(void *param)
+{
+    periph_init();
+    vTaskDelete(NULL);
+}
+
+/* ---- Deferred work ------------------------------------------------------- */
+
+/* Nothing here is needed to be discoverable, so it runs once the first
+ * advertisement is out rather than delaying it. */
+static void run_deferred(bool advertising)
+{
+    /* The stack came up, so a freshly updated image is good to keep. */
+    if (advertising) {
+        ota_svc_confirm_boot();
+        boot_mark("ota confirm");
+    } else {
+        ESP_LOGW(TAG, "not advertising after %d ms", BOOT_ADV_TIMEOUT_MS);
+    }
+
+#if CONFIG_APP_CONSOLE
+    if (app_console_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Console not available, continuing without it");
+    }
+    boot_mark("console");
+#endif
+
+    /* Light sleep last, once the I2C devices are configured */
+    if (!boot_wait(BOOT_EV_PERIPH, BOOT_PERIPH_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "peripheral init still running");
+    }
+    if (power_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Power management initialization failed, continuing "
+            "without it");
+    }
+    boot_mark("power");
+}
+
 /* ---- app_main ------------------------------------------------------------ */
 
 void app_main(void)
 {
     int rc;
 
+#if CONFIG_APP_BENCHMARK
+    /* Benchmark build: no radio, no peripherals, just the measured code. */
+    bench_run();
+    return;
+#endif
+
+    boot_init();
+
+#if CONFIG_APP_BLOG
+    blog_init();
+#endif
+
     /* Initialise NVS — required by the BT controller. */
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
@@ -140,29 +224,36 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_mark("nvs");
 
     ESP_LOGI(TAG, "starting %s", DEVICE_NAME);
-    
+    ble_conn_init();
+    adv_init(DEVICE_NAME, gap_event_handler);
+
     button_init();
     battery_init();
-
-    if (display_init() != ESP_OK) {
-        ESP_LOGW(TAG, "Display not available, continuing without it");
+    alarm_init();
+    profile_init();
+    boot_mark("button, battery, rules, schedule");
+
+    if (xTaskCreate(periph_init_task, "periph_init", PERIPH_INIT_STACK, NULL,
+                    5, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "no memory for the init task, running it inline");
+        periph_init();
     }
 
-    if (sensor_task_init() != ESP_OK) {
-        ESP_LOGW(TAG, "Sensor task initialization failed, continuing without it");
-    }
-
-
     /* Initialise the NimBLE host stack. */
     rc = nimble_port_init();
     assert(rc == 0);
+    boot_mark("controller");
 
     /* Set the host callbacks. */
     ble_hs_cfg.sync_cb  = ble_app_on_sync;
     ble_hs_cfg.reset_cb = ble_app_on_reset;
 
+    /* Pairing, bond storage and GATT caching. */
+    bond_init();
+
     /* Set the device name used by the GAP service. */
     rc = ble_svc_gap_device_name_set(DEVICE_NAME);
     assert(rc == 0);
@@ -171,12 +262,20 @@ void app_main(void)
     rc = gatt_svc_init();
     assert(rc == 0);
 
+    /* Initialise the OTA update service. */
+    rc = ota_svc_init();
+    assert(rc == 0);
+
+#if CONFIG_APP_COC
+    /* Bulk transfer channel. */
+    rc = coc_init();
+    assert(rc == 0);
+#endif
+
     /* Start the NimBLE host task. */
     nimble_port_freertos_init(nimble_host_task);
-    
-    /* Initialize power management */
-    if (power_init() != ESP_OK) {
-        ESP_LOGW(TAG, "Power management initialization failed, continuing "
-            "without it");
-    }
+    boot_mark("host started");
+
+    run_deferred(boot_wait(BOOT_EV_ADV, BOOT_ADV_TIMEOUT_MS));
+    boot_print();
 }
@@ -0,0 +1,187 @@
+#include "memstat.h"
+#include "app_console.h"
+#include "blog.h"
+#include "history.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host/ble_hs.h"
+#include "sdkconfig.h"
+
+/* Tasks reported, with their stack size where we set it.  The rest belong
+ * to ESP-IDF; their size is not exposed, only the headroom. */
+static const struct {
+    const char *name;
+    uint32_t stack_size;
+} tasks[] = {
+    { "sensor_task",  CONFIG_APP_SENSOR_TASK_STACK },
+    { "display_task", CONFIG_APP_DISPLAY_TASK_STACK },
+    { "lcd_flush",    CONFIG_APP_DISPLAY_FLUSH_STACK },
+    { "nimble_host",  CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE },
+    { "btController", 0 },
+    { "esp_timer",    CONFIG_ESP_TIMER_TASK_STACK_SIZE },
+    { "Tmr Svc",      CONFIG_FREERTOS_TIMER_TASK_STACK_DEPTH },
+    { "IDLE",         CONFIG_FREERTOS_IDLE_TASK_STACKSIZE },
+#if CONFIG_APP_CONSOLE
+    { "console_repl", APP_CONSOLE_STACK },
+#endif
+#if CONFIG_APP_BLOG
+    { "blog",         BLOG_TASK_STACK },
+#endif
+};
+
+_Static_assert(sizeof(tasks) / sizeof(tasks[0]) <= MEMSTAT_MAX_TASKS,
+               "memstat task table too long");
+
+static volatile int mbuf_min_free = INT16_MAX;
+
+/* Heap when the connection count last reached 1..MEMSTAT_CONN_MAX */
+static struct {
+    uint32_t free;
+    uint32_t min_free;
+} conn_heap[MEMSTAT_CONN_MAX];
+static portMUX_TYPE conn_heap_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ---- Sampling ----------------------------------------------------------- */
+
+void memstat_sample(void)
+{
+    int n = os_msys_num_free();
+    if (n < mbuf_min_free) {
+        mbuf_min_free = n;
+    }
+}
+
+void memstat_connected(int count)
+{
+    uint32_t free_b = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    uint32_t min_b = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+
+    if (count < 1 || count > MEMSTAT_CONN_MAX) {
+        return;
+    }
+    taskENTER_CRITICAL(&conn_heap_lock);
+    conn_heap[count - 1].free = free_b;
+    conn_heap[count - 1].min_free = min_b;
+    taskEXIT_CRITICAL(&conn_heap_lock);
+}
+
+static void conn_heap_get(int i, uint32_t *free_b, uint32_t *min_b)
+{
+    taskENTER_CRITICAL(&conn_heap_lock);
+    *free_b = conn_heap[i].free;
+    *min_b = conn_heap[i].min_free;
+    taskEXIT_CRITICAL(&conn_heap_lock);
+}
+
+/* ---- Encoding ----------------------------------------------------------- */
+
+static uint8_t *put_u16(uint8_t *p, uint32_t v)
+{
+    v = v > UINT16_MAX ? UINT16_MAX : v;
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = v >> (8 * i);
+    }
+    return p + 4;
+}
+
+size_t memstat_encode(uint8_t *buf, size_t len)
+{
+    uint8_t *p = buf;
+    uint8_t *count;
+
+    if (len < MEMSTAT_REPORT_MAX) {
+        return 0;
+    }
+    memstat_sample();
+
+    p = put_u32(p, heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    p = put_u32(p, heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    p = put_u32(p, heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    p = put_u16(p, os_msys_count());
+    p = put_u16(p, os_msys_num_free());
+    p = put_u16(p, mbuf_min_free);
+    p = put_u16(p, history_count());
+    p = put_u16(p, history_capacity());
+
+    count = p++;
+    *count = 0;
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        TaskHandle_t h = xTaskGetHandle(tasks[i].name);
+        if (h == NULL) {
+            continue;
+        }
+        memset(p, 0, MEMSTAT_NAME_LEN);
+        strncpy((char *)p, tasks[i].name, MEMSTAT_NAME_LEN);
+        p += MEMSTAT_NAME_LEN;
+        p = put_u16(p, tasks[i].stack_size);
+        /* ESP-IDF stacks are sized in bytes, so the mark is in bytes too */
+        p = put_u16(p, uxTaskGetStackHighWaterMark(h));
+        (*count)++;
+    }
+
+    *p++ = MEMSTAT_CONN_MAX;
+    for (int i = 0; i < MEMSTAT_CONN_MAX; i++) {
+        uint32_t free_b, min_b;
+        conn_heap_get(i, &free_b, &min_b);
+        p = put_u32(p, free_b);
+        p = put_u32(p, min_b);
+    }
+    return p - buf;
+}
+
+/* ---- Console output ----------------------------------------------------- */
+
+void memstat_print(void)
+{
+    memstat_sample();
+
+    printf("heap: free %u, min ever free %u, largest block %u\n",
+           (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    printf("mbufs: %d total, %d free, %d min free\n",
+           os_msys_count(), os_msys_num_free(), mbuf_min_free);
+    printf("history: %u / %u samples (%u bytes)\n",
+           (unsigned)history_count(), (unsigned)history_capacity(),
+           (unsigned)(history_capacity() * sizeof(struct history_sample)));
+
+    printf("%-14s %6s %6s %6s\n", "task", "stack", "free", "peak");
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        TaskHandle_t h = xTaskGetHandle(tasks[i].name);
+        if (h == NULL) {
+            continue;
+        }
+        unsigned free_b = uxTaskGetStackHighWaterMark(h);
+        if (tasks[i].stack_size) {
+            printf("%-14s %6u %6u %6u\n", tasks[i].name,
+                   (unsigned)tasks[i].stack_size, free_b,
+                   (unsigned)tasks[i].stack_size - free_b);
+        } else {
+            printf("%-14s %6s %6u %6s\n", tasks[i].name, "?", free_b, "?");
+        }
+    }
+
+    printf("%-14s %6s %6s\n", "connections", "heap", "min");
+    for (int i = 0; i < MEMSTAT_CONN_MAX; i++) {
+        uint32_t free_b, min_b;
+        conn_heap_get(i, &free_b, &min_b);
+        if (free_b) {
+            printf("%-14d %6u %6u\n", i + 1, (unsigned)free_b,
+                   (unsigned)min_b);
+        } else {
+            printf("%-14d %6s %6s\n", i + 1, "-", "-");
+        }
+    }
+}
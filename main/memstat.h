@@ -0,0 +1,48 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/*
+ * Memory footprint report: stack headroom of the application and stack
+ * tasks, heap free / minimum-ever-free / largest block, NimBLE msys mbuf
+ * usage, history buffer fill, and the heap as each number of centrals
+ * connected.  Used by the Memory characteristic and the `mem` console
+ * command, and the numbers behind the static stack sizes in Kconfig
+ * (APP_*_TASK_STACK) and CONFIG_BT_NIMBLE_MAX_CONNECTIONS.
+ *
+ * Characteristic layout (little-endian, packed):
+ *
+ *   u32 heap_free, u32 heap_min_free, u32 heap_largest
+ *   u16 mbuf_total, u16 mbuf_free, u16 mbuf_min_free
+ *   u16 history_used, u16 history_capacity
+ *   u8  task_count, then per task:
+ *       char name[12] (NUL padded), u16 stack_size (0 = unknown),
+ *       u16 stack_free (high-water mark, bytes never used)
+ *   u8  conn_max, then per connection count 1..conn_max:
+ *       u32 heap_free, u32 heap_min_free (both 0 = not reached since boot)
+ */
+
+#define MEMSTAT_MAX_TASKS   10
+#define MEMSTAT_NAME_LEN    12
+#define MEMSTAT_CONN_MAX    CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define MEMSTAT_REPORT_MAX  (24 + MEMSTAT_MAX_TASKS * (MEMSTAT_NAME_LEN + 4) + \
+                             MEMSTAT_CONN_MAX * 8)
+
+/** Record the current mbuf pool level; call where mbufs are allocated. */
+void memstat_sample(void);
+
+/** Record the heap now that count centrals are connected; call once the
+ *  connection is set up.  The last figures for each count are reported. */
+void memstat_connected(int count);
+
+/** Encode the report into buf; returns the number of bytes written. */
+size_t memstat_encode(uint8_t *buf, size_t len);
+
+/** Print the report as a table to stdout. */
+void memstat_print(void);
+
+#endif /* MEMSTAT_H */
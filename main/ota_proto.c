@@ -0,0 +1,267 @@
+#include "ota_proto.h"
+
+#include <string.h>
+
+#define BEGIN_REQ_LEN   (1 + 4 + OTA_SHA256_LEN + 2)
+
+/* ---- Little-endian helpers ---------------------------------------------- */
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* ---- Replies ------------------------------------------------------------ */
+
+static size_t make_rsp(uint8_t *rsp, uint8_t op, uint8_t status,
+                       uint32_t offset)
+{
+    rsp[0] = OTA_OP_RSP;
+    rsp[1] = op;
+    rsp[2] = status;
+    put_u32(&rsp[3], offset);
+    return 7;
+}
+
+static size_t make_offset_msg(uint8_t *rsp, uint8_t op, uint32_t offset)
+{
+    rsp[0] = op;
+    put_u32(&rsp[1], offset);
+    return 5;
+}
+
+/* ---- Progress ----------------------------------------------------------- */
+
+static void save_progress(struct ota_session *s, uint32_t offset)
+{
+    struct ota_progress p = {
+        .image_size = s->image_size,
+        .offset = offset,
+    };
+    memcpy(p.sha256, s->sha256, sizeof(p.sha256));
+    if (s->be->save_progress(s->be->ctx, &p) == 0) {
+        s->persisted = offset;
+    }
+}
+
+/* Save the last whole sector written.  Resuming from a sector boundary
+ * lets the backend erase before rewriting a partially written sector. */
+static void persist(struct ota_session *s)
+{
+    uint32_t aligned = s->offset & ~(uint32_t)(OTA_SECTOR_SIZE - 1);
+    if (aligned != s->persisted) {
+        save_progress(s, aligned);
+    }
+}
+
+static void drop_session(struct ota_session *s)
+{
+    if (s->active) {
+        s->be->abort(s->be->ctx);
+    }
+    s->be->clear_progress(s->be->ctx);
+    s->active = false;
+    s->offset = 0;
+    s->persisted = 0;
+}
+
+/* ---- Requests ----------------------------------------------------------- */
+
+static uint8_t handle_begin(struct ota_session *s, const uint8_t *req,
+                            size_t len)
+{
+    const struct ota_backend *be = s->be;
+
+    if (len != BEGIN_REQ_LEN) {
+        return OTA_STATUS_BAD_REQUEST;
+    }
+    uint32_t size = get_u32(&req[1]);
+    const uint8_t *sha = &req[5];
+    uint16_t window = get_u16(&req[5 + OTA_SHA256_LEN]);
+    if (size == 0 || window == 0) {
+        return OTA_STATUS_BAD_REQUEST;
+    }
+    if (size > be->max_size) {
+        return OTA_STATUS_TOO_LARGE;
+    }
+
+    s->window = window;
+    s->since_ack = 0;
+    s->nak_sent = false;
+
+    /* Same image still open (the link dropped): carry on where we were. */
+    if (s->active && s->image_size == size &&
+        memcmp(s->sha256, sha, OTA_SHA256_LEN) == 0) {
+        return OTA_STATUS_OK;
+    }
+    if (s->active) {
+        be->abort(be->ctx);
+        s->active = false;
+    }
+
+    /* Same image interrupted by a reboot: resume from the saved sector. */
+    uint32_t resume = 0;
+    struct ota_progress p;
+    if (be->load_progress(be->ctx, &p) == 0 && p.image_size == size &&
+        memcmp(p.sha256, sha, OTA_SHA256_LEN) == 0 && p.offset <= size) {
+        resume = p.offset;
+    }
+    if (be->begin(be->ctx, size, resume) != 0) {
+        if (resume == 0 || be->begin(be->ctx, size, 0) != 0) {
+            return OTA_STATUS_FLASH_ERROR;
+        }
+        resume = 0;
+    }
+
+    s->active = true;
+    s->image_size = size;
+    s->offset = resume;
+    memcpy(s->sha256, sha, OTA_SHA256_LEN);
+    save_progress(s, resume);
+    return OTA_STATUS_OK;
+}
+
+static uint8_t handle_finish(struct ota_session *s)
+{
+    const struct ota_backend *be = s->be;
+
+    if (!s->active || s->offset != s->image_size) {
+        return OTA_STATUS_BAD_STATE;
+    }
+    if (be->verify(be->ctx, s->image_size, s->sha256) != 0) {
+        drop_session(s);
+        return OTA_STATUS_HASH_MISMATCH;
+    }
+    if (be->activate(be->ctx) != 0) {
+        drop_session(s);
+        return OTA_STATUS_FLASH_ERROR;
+    }
+    be->clear_progress(be->ctx);
+    s->active = false;
+    return OTA_STATUS_OK;
+}
+
+/* ---- Public API --------------------------------------------------------- */
+
+void ota_proto_init(struct ota_session *s, const struct ota_backend *be)
+{
+    memset(s, 0, sizeof(*s));
+    s->be = be;
+    s->conn = OTA_CONN_NONE;
+}
+
+bool ota_proto_allowed(const struct ota_session *s, uint16_t conn)
+{
+    return s->conn == OTA_CONN_NONE || s->conn == conn;
+}
+
+void ota_proto_control(struct ota_session *s, uint16_t conn,
+                       const uint8_t *req, size_t len, uint8_t *rsp,
+                       size_t *rsp_len)
+{
+    uint8_t op = len > 0 ? req[0] : 0;
+    uint8_t status;
+
+    switch (op) {
+    case OTA_OP_BEGIN:
+        status = handle_begin(s, req, len);
+        break;
+    case OTA_OP_STATUS:
+        status = s->active ? OTA_STATUS_OK : OTA_STATUS_BAD_STATE;
+        break;
+    case OTA_OP_FINISH:
+        status = handle_finish(s);
+        break;
+    case OTA_OP_ABORT:
+        drop_session(s);
+        status = OTA_STATUS_OK;
+        break;
+    default:
+        status = OTA_STATUS_BAD_REQUEST;
+        break;
+    }
+    if (op == OTA_OP_BEGIN && status == OTA_STATUS_OK) {
+        s->conn = conn;
+    } else if (!s->active) {
+        s->conn = OTA_CONN_NONE;
+    }
+    *rsp_len = make_rsp(rsp, op, status, s->offset);
+}
+
+void ota_proto_data(struct ota_session *s, const uint8_t *buf, size_t len,
+                    uint8_t *rsp, size_t *rsp_len)
+{
+    *rsp_len = 0;
+
+    if (!s->active) {
+        *rsp_len = make_rsp(rsp, OTA_OP_DATA, OTA_STATUS_BAD_STATE, 0);
+        return;
+    }
+    if (len <= OTA_DATA_HDR_LEN) {
+        return;
+    }
+
+    uint32_t off = get_u32(buf);
+    const uint8_t *payload = buf + OTA_DATA_HDR_LEN;
+    uint32_t n = len - OTA_DATA_HDR_LEN;
+
+    if (off > s->offset) {
+        /* Gap: ask once for a rewind, ignore the rest of the window. */
+        if (!s->nak_sent) {
+            s->nak_sent = true;
+            *rsp_len = make_offset_msg(rsp, OTA_OP_NAK, s->offset);
+        }
+        return;
+    }
+    if (off + n <= s->offset) {
+        return;     /* duplicate of data already written */
+    }
+    if (off < s->offset) {
+        /* Overlaps the write position (chunk size changed): keep the tail */
+        payload += s->offset - off;
+        n -= s->offset - off;
+    }
+    if (s->offset + n > s->image_size) {
+        *rsp_len = make_rsp(rsp, OTA_OP_DATA, OTA_STATUS_BAD_REQUEST,
+                            s->offset);
+        return;
+    }
+    if (s->be->write(s->be->ctx, s->offset, payload, n) != 0) {
+        *rsp_len = make_rsp(rsp, OTA_OP_DATA, OTA_STATUS_FLASH_ERROR,
+                            s->offset);
+        return;
+    }
+
+    s->offset += n;
+    s->nak_sent = false;
+    if (s->offset - s->persisted >= OTA_PERSIST_EVERY) {
+        persist(s);
+    }
+    if (++s->since_ack >= s->window || s->offset == s->image_size) {
+        s->since_ack = 0;
+        *rsp_len = make_offset_msg(rsp, OTA_OP_ACK, s->offset);
+    }
+}
+
+void ota_proto_disconnect(struct ota_session *s)
+{
+    s->conn = OTA_CONN_NONE;
+    if (s->active) {
+        persist(s);
+        s->since_ack = 0;
+        s->nak_sent = false;
+    }
+}
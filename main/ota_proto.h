@@ -0,0 +1,125 @@
+#ifndef OTA_PROTO_H
+#define OTA_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * BLE OTA transfer protocol, independent of NimBLE and esp_ota so the chunk,
+ * acknowledgement and resume logic can also run on Linux against a
+ * file-backed partition (host/ota_sim.c).
+ *
+ * Control characteristic (write, notify), little-endian:
+ *   BEGIN   01 size:u32 sha256[32] window:u16   start or resume a transfer
+ *   STATUS  02                                  report committed offset
+ *   FINISH  03                                  verify hash and activate
+ *   ABORT   04                                  drop the transfer
+ *
+ *   RSP     10 op:u8 status:u8 offset:u32       reply to each request
+ *   ACK     11 offset:u32                       every `window` chunks
+ *   NAK     12 expected:u32                     chunk arrived out of order
+ *
+ * Data characteristic (write without response):
+ *   offset:u32 payload[...]
+ *
+ * Chunks are only accepted in order, so every byte below the session offset
+ * is in flash.  Progress is persisted at sector granularity so a transfer
+ * can also resume after a reboot.
+ *
+ * The link that sent the accepted BEGIN owns the session until it finishes,
+ * aborts or disconnects; writes from any other link are refused meanwhile
+ * (ota_proto_allowed()).  A dropped link's transfer can be resumed by
+ * whichever link sends the next BEGIN.
+ */
+
+#define OTA_OP_BEGIN    0x01
+#define OTA_OP_STATUS   0x02
+#define OTA_OP_FINISH   0x03
+#define OTA_OP_ABORT    0x04
+#define OTA_OP_DATA     0x05    /* only used in RSP.op */
+#define OTA_OP_RSP      0x10
+#define OTA_OP_ACK      0x11
+#define OTA_OP_NAK      0x12
+
+enum {
+    OTA_STATUS_OK = 0,
+    OTA_STATUS_BAD_REQUEST,
+    OTA_STATUS_BAD_STATE,
+    OTA_STATUS_TOO_LARGE,
+    OTA_STATUS_FLASH_ERROR,
+    OTA_STATUS_HASH_MISMATCH,
+};
+
+#define OTA_SHA256_LEN      32
+#define OTA_DATA_HDR_LEN    4
+#define OTA_SECTOR_SIZE     4096
+#define OTA_PERSIST_EVERY   (16 * OTA_SECTOR_SIZE)  /* progress save interval */
+#define OTA_RSP_MAX_LEN     7
+#define OTA_CONN_NONE       0xffff  /* no link owns the session */
+
+/* Transfer progress as persisted across reboots. */
+struct ota_progress {
+    uint32_t image_size;
+    uint32_t offset;            /* sector aligned */
+    uint8_t sha256[OTA_SHA256_LEN];
+};
+
+/* Storage backend: esp_ota on the device, a plain file on the host.
+ * All int returns are 0 on success. */
+struct ota_backend {
+    uint32_t max_size;
+    /* Prepare the inactive slot; bytes from resume_offset on are rewritten. */
+    int  (*begin)(void *ctx, uint32_t image_size, uint32_t resume_offset);
+    int  (*write)(void *ctx, uint32_t offset, const uint8_t *data, size_t len);
+    int  (*verify)(void *ctx, uint32_t image_size,
+                   const uint8_t sha256[OTA_SHA256_LEN]);
+    int  (*activate)(void *ctx);
+    void (*abort)(void *ctx);
+    int  (*save_progress)(void *ctx, const struct ota_progress *p);
+    int  (*load_progress)(void *ctx, struct ota_progress *p);
+    void (*clear_progress)(void *ctx);
+    void *ctx;
+};
+
+struct ota_session {
+    const struct ota_backend *be;
+    bool active;
+    bool nak_sent;
+    uint16_t window;            /* chunks per ACK */
+    uint16_t since_ack;
+    uint32_t image_size;
+    uint32_t offset;            /* next expected byte; all below is written */
+    uint32_t persisted;         /* offset last saved through the backend */
+    uint8_t sha256[OTA_SHA256_LEN];
+    uint16_t conn;              /* owning link, or OTA_CONN_NONE */
+};
+
+void ota_proto_init(struct ota_session *s, const struct ota_backend *be);
+
+/** True if link conn may write control or data requests now: no link owns
+ *  the session, or conn does. */
+bool ota_proto_allowed(const struct ota_session *s, uint16_t conn);
+
+/**
+ * Handle a control write from link conn, which must be allowed (see
+ * ota_proto_allowed()); an accepted BEGIN makes it the owner.  A reply is
+ * always produced in rsp (at least OTA_RSP_MAX_LEN bytes); *rsp_len is set
+ * to its length.
+ */
+void ota_proto_control(struct ota_session *s, uint16_t conn,
+                       const uint8_t *req, size_t len, uint8_t *rsp,
+                       size_t *rsp_len);
+
+/**
+ * Handle a data write.  *rsp_len is set to 0 when nothing needs to be sent,
+ * otherwise rsp holds an ACK, NAK or error RSP.
+ */
+void ota_proto_data(struct ota_session *s, const uint8_t *buf, size_t len,
+                    uint8_t *rsp, size_t *rsp_len);
+
+/** The owning link dropped: persist progress, keep the session for a later
+ *  BEGIN from any link. */
+void ota_proto_disconnect(struct ota_session *s);
+
+#endif /* OTA_PROTO_H */
@@ -0,0 +1,417 @@
+#include "ota_svc.h"
+#include "ota_proto.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "host/ble_hs.h"
+
+static const char *TAG = "ota_svc";
+
+/* ---- UUIDs ---------------------------------------------------------------
+ *
+ * OTA service:    deadbeef-2000-2000-3000-aabbccddeeff
+ * Control:        deadbeef-2001-2000-3000-aabbccddeeff  (write, notify)
+ * Data:           deadbeef-2002-2000-3000-aabbccddeeff  (write no response)
+ *
+ * Both writes need an encrypted link, so only a central that has paired
+ * can flash the device.  Pairing is Just Works (see bond.c: the board can't
+ * show or enter a passkey), so _AUTHEN, which needs MITM protection, would
+ * refuse every central.  The image is not signed: the SHA-256 only guards
+ * against a corrupted transfer; see "OTA Updates" in README.md.
+ */
+static const ble_uuid128_t ota_svc_uuid =
+    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
+                     0x00, 0x20, 0x00, 0x20, 0xef, 0xbe, 0xad, 0xde);
+
+static const ble_uuid128_t ota_ctrl_uuid =
+    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
+                     0x00, 0x20, 0x01, 0x20, 0xef, 0xbe, 0xad, 0xde);
+
+static const ble_uuid128_t ota_data_uuid =
+    BLE_UUID128_INIT(0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x30,
+                     0x00, 0x20, 0x02, 0x20, 0xef, 0xbe, 0xad, 0xde);
+
+#define OTA_NVS_NAMESPACE   "ota"
+#define OTA_NVS_KEY         "progress"
+#define OTA_DATA_MAX_LEN    (OTA_DATA_HDR_LEN + 512)    /* 517-byte ATT MTU */
+#define OTA_RESTART_DELAY_US (1000 * 1000)
+
+_Static_assert(OTA_CONN_NONE == BLE_HS_CONN_HANDLE_NONE,
+               "a free ota_session uses the no-connection handle");
+
+static uint16_t ota_ctrl_handle;
+static struct ota_session session;    /* session.conn owns the transfer */
+static esp_pm_lock_handle_t ota_pm_lock;
+static bool ota_pm_held;
+static bool ota_registered;
+
+/* ---- esp_ota backend ---------------------------------------------------- */
+
+static const esp_partition_t *ota_part;
+static esp_ota_handle_t ota_handle;
+
+static int be_begin(void *ctx, uint32_t image_size, uint32_t resume_offset)
+{
+    esp_err_t err;
+
+    ota_part = esp_ota_get_next_update_partition(NULL);
+    if (ota_part == NULL) {
+        return -1;
+    }
+    /* Sequential writes: sectors are erased as the write crosses them, so
+     * neither call blocks the host task erasing the whole slot up front. */
+    if (resume_offset == 0) {
+        err = esp_ota_begin(ota_part, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    } else {
+        err = esp_ota_resume(ota_part, OTA_WITH_SEQUENTIAL_WRITES,
+                             resume_offset, &ota_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA begin at %lu failed: %s",
+                 (unsigned long)resume_offset, esp_err_to_name(err));
+        return -1;
+    }
+    ESP_LOGI(TAG, "OTA to %s, %lu bytes, starting at %lu", ota_part->label,
+             (unsigned long)image_size, (unsigned long)resume_offset);
+    return 0;
+}
+
+static int be_write(void *ctx, uint32_t offset, const uint8_t *data,
+                    size_t len)
+{
+    return esp_ota_write(ota_handle, data, len) == ESP_OK ? 0 : -1;
+}
+
+static int be_verify(void *ctx, uint32_t image_size,
+                     const uint8_t sha256[OTA_SHA256_LEN])
+{
+    static uint8_t buf[OTA_SECTOR_SIZE];
+    uint8_t digest[OTA_SHA256_LEN];
+    mbedtls_sha256_context sha;
+    int ret = 0;
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    for (uint32_t off = 0; off < image_size; off += sizeof(buf)) {
+        size_t n = image_size - off < sizeof(buf) ? image_size - off
+                                                  : sizeof(buf);
+        if (esp_partition_read(ota_part, off, buf, n) != ESP_OK) {
+            ret = -1;
+            break;
+        }
+        mbedtls_sha256_update(&sha, buf, n);
+    }
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (ret == 0 && memcmp(digest, sha256, OTA_SHA256_LEN) != 0) {
+        ESP_LOGE(TAG, "image hash mismatch");
+        ret = -1;
+    }
+    return ret;
+}
+
+static int be_activate(void *ctx)
+{
+    esp_err_t err = esp_ota_end(ota_handle);
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(ota_part);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA activate failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    return 0;
+}
+
+static void be_abort(void *ctx)
+{
+    esp_ota_abort(ota_handle);
+}
+
+static int be_save_progress(void *ctx, const struct ota_progress *p)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return -1;
+    }
+    err = nvs_set_blob(nvs, OTA_NVS_KEY, p, sizeof(*p));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err == ESP_OK ? 0 : -1;
+}
+
+static int be_load_progress(void *ctx, struct ota_progress *p)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(*p);
+    esp_err_t err = nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return -1;
+    }
+    err = nvs_get_blob(nvs, OTA_NVS_KEY, p, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*p) ? 0 : -1;
+}
+
+static void be_clear_progress(void *ctx)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, OTA_NVS_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+static const struct ota_backend esp_backend = {
+    .begin = be_begin,
+    .write = be_write,
+    .verify = be_verify,
+    .activate = be_activate,
+    .abort = be_abort,
+    .save_progress = be_save_progress,
+    .load_progress = be_load_progress,
+    .clear_progress = be_clear_progress,
+};
+
+/* ---- Transfer helpers --------------------------------------------------- */
+
+static void ota_notify(uint16_t conn_handle, const uint8_t *msg, size_t len)
+{
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(msg, len);
+    if (om == NULL || ble_gatts_notify_custom(conn_handle, ota_ctrl_handle,
+                                              om) != 0) {
+        ESP_LOGW(TAG, "OTA notify failed");
+    }
+}
+
+static void ota_hold_awake(bool hold)
+{
+    if (hold == ota_pm_held || ota_pm_lock == NULL) {
+        return;
+    }
+    ota_pm_held = hold;
+    if (hold) {
+        esp_pm_lock_acquire(ota_pm_lock);
+    } else {
+        esp_pm_lock_release(ota_pm_lock);
+    }
+}
+
+/* Ask for the fastest link the central will give us for the transfer:
+ * short connection interval, maximum LL payload (DLE) and the 2M PHY.
+ * The central chooses the ATT MTU; ours is CONFIG_BT_NIMBLE_ATT_PREFERRED_MTU. */
+static void ota_tune_link(uint16_t conn_handle)
+{
+    struct ble_gap_upd_params params = {
+        .itvl_min = 6,                  /* 7.5 ms in 1.25 ms units */
+        .itvl_max = 12,                 /* 15 ms */
+        .latency = 0,
+        .supervision_timeout = 400,     /* 4 s in 10 ms units */
+    };
+
+    if (ble_gap_update_params(conn_handle, &params) != 0) {
+        ESP_LOGW(TAG, "connection parameter update refused");
+    }
+    if (ble_gap_set_data_len(conn_handle, 251, 2120) != 0) {
+        ESP_LOGW(TAG, "data length extension not available");
+    }
+    if (ble_gap_set_prefered_le_phy(conn_handle, BLE_GAP_LE_PHY_2M_MASK,
+                                    BLE_GAP_LE_PHY_2M_MASK,
+                                    BLE_GAP_LE_PHY_CODED_ANY) != 0) {
+        ESP_LOGW(TAG, "2M PHY not available");
+    }
+}
+
+static void ota_restart_cb(void *arg)
+{
+    esp_restart();
+}
+
+/* ---- Access callbacks --------------------------------------------------- */
+
+static int ota_ctrl_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                              struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    uint8_t req[48];
+    uint8_t rsp[OTA_RSP_MAX_LEN];
+    uint16_t len;
+    size_t rsp_len;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    if (!ota_proto_allowed(&session, conn_handle)) {
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;     /* another central's */
+    }
+    if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(req)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(ctxt->om, req, sizeof(req), &len) != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    ota_proto_control(&session, conn_handle, req, len, rsp, &rsp_len);
+    bool ok = rsp[2] == OTA_STATUS_OK;
+
+    switch (rsp[1]) {     /* request opcode, echoed in the reply */
+    case OTA_OP_BEGIN:
+        if (ok) {
+            ota_hold_awake(true);
+            ota_tune_link(conn_handle);
+        }
+        break;
+    case OTA_OP_FINISH:
+        ota_hold_awake(false);
+        if (ok) {
+            static esp_timer_handle_t restart_timer;
+            const esp_timer_create_args_t args = {
+                .callback = ota_restart_cb,
+                .name = "ota_restart",
+            };
+            ESP_LOGI(TAG, "OTA complete, restarting into new image");
+            if (esp_timer_create(&args, &restart_timer) == ESP_OK) {
+                esp_timer_start_once(restart_timer, OTA_RESTART_DELAY_US);
+            }
+        } else {
+            ESP_LOGE(TAG, "OTA finish failed: status %u", rsp[2]);
+        }
+        break;
+    case OTA_OP_ABORT:
+        ota_hold_awake(false);
+        ESP_LOGI(TAG, "OTA aborted");
+        break;
+    default:
+        break;
+    }
+
+    ota_notify(conn_handle, rsp, rsp_len);
+    return 0;
+}
+
+static int ota_data_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                              struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    static uint8_t buf[OTA_DATA_MAX_LEN];
+    uint8_t rsp[OTA_RSP_MAX_LEN];
+    uint16_t len;
+    size_t rsp_len;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    if (!ota_proto_allowed(&session, conn_handle)) {
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(buf)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    ota_proto_data(&session, buf, len, rsp, &rsp_len);
+    if (rsp_len > 0) {
+        ota_notify(conn_handle, rsp, rsp_len);
+    }
+    return 0;
+}
+
+/* ---- Service definition ------------------------------------------------- */
+
+static const struct ble_gatt_svc_def ota_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = &ota_svc_uuid.u,
+        .characteristics = (struct ble_gatt_chr_def[]){
+            {
+                .uuid = &ota_ctrl_uuid.u,
+                .access_cb = ota_ctrl_access_cb,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC |
+                         BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &ota_ctrl_handle,
+            },
+            {
+                .uuid = &ota_data_uuid.u,
+                .access_cb = ota_data_access_cb,
+                .flags = BLE_GATT_CHR_F_WRITE_NO_RSP |
+                         BLE_GATT_CHR_F_WRITE_ENC,
+            },
+            {0}, /* terminator */
+        },
+    },
+    {0}, /* terminator */
+};
+
+/* ---- Public API --------------------------------------------------------- */
+
+void ota_svc_confirm_boot(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        ESP_LOGI(TAG, "new image in %s confirmed", running->label);
+    }
+}
+
+void ota_svc_on_disconnect(uint16_t conn_handle)
+{
+    if (conn_handle != session.conn) {
+        return;
+    }
+    ota_proto_disconnect(&session);
+    ota_hold_awake(false);
+    if (session.active) {
+        ESP_LOGI(TAG, "OTA paused at %lu of %lu bytes",
+                 (unsigned long)session.offset,
+                 (unsigned long)session.image_size);
+    }
+}
+
+const struct ble_gatt_svc_def *ota_svc_get_defs(void)
+{
+    return ota_registered ? ota_svcs : NULL;
+}
+
+int ota_svc_init(void)
+{
+    static struct ota_backend backend;
+    int rc;
+
+    const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+    if (next == NULL) {
+        ESP_LOGW(TAG, "no OTA partition, service disabled");
+        return 0;
+    }
+    backend = esp_backend;
+    backend.max_size = next->size;
+    ota_proto_init(&session, &backend);
+
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "ota",
+                           &ota_pm_lock) != ESP_OK) {
+        ota_pm_lock = NULL;
+    }
+
+    rc = ble_gatts_count_cfg(ota_svcs);
+    if (rc != 0) {
+        return rc;
+    }
+    rc = ble_gatts_add_svcs(ota_svcs);
+    ota_registered = rc == 0;
+    return rc;
+}
@@ -0,0 +1,21 @@
+#ifndef OTA_SVC_H
+#define OTA_SVC_H
+
+#include <stdint.h>
+
+#include "host/ble_gatt.h"
+
+/** Register the OTA GATT service.  Call after gatt_svc_init(). */
+int ota_svc_init(void);
+
+/** The registered service table, or NULL if there is no OTA partition. */
+const struct ble_gatt_svc_def *ota_svc_get_defs(void);
+
+/** Mark a freshly updated image valid once the BLE stack is up; until then
+ *  the bootloader rolls back to the previous slot on the next reset. */
+void ota_svc_confirm_boot(void);
+
+/** Connection closed: persist progress so the transfer can resume. */
+void ota_svc_on_disconnect(uint16_t conn_handle);
+
+#endif /* OTA_SVC_H */
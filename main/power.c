@@ -6,18 +6,20 @@
 #include "freertos/task.h"
 
 static const char *TAG = "power";
+
+/* ---- Initialization ----------------------------------------------------- */
+
 esp_err_t power_init(void)
 {
-    /* Enable automatic light sleep with BLE modem sleep */
+    /* Enable automatic light sleep with BLE modem sleep.  Light sleep
+     * would drop the USB-Serial/JTAG link; the driver holds it off while a
+     * host is attached (CONFIG_USJ_NO_AUTO_LS_ON_CONNECTION). */
     esp_pm_config_t pm_config = {
         .max_freq_mhz = 160,
         .min_freq_mhz = 40,
         .light_sleep_enable = true,
     };
 
-    ESP_LOGI(TAG, "Waiting 5 seconds before enabling power management to allow initial setup...");
-    vTaskDelay(pdMS_TO_TICKS(5000));
-
     esp_err_t err = esp_pm_configure(&pm_config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure power management: %s",
@@ -29,4 +31,4 @@ esp_err_t power_init(void)
              pm_config.max_freq_mhz, pm_config.min_freq_mhz,
              pm_config.light_sleep_enable ? "enabled" : "disabled");
     return ESP_OK;
-}
\ No newline at end of file
+}
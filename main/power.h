@@ -6,9 +6,10 @@
 
 /**
  * Initialize automatic light sleep with BLE modem sleep.
- * Call after NimBLE host is started.
+ * Call after NimBLE host is started.  Light sleep is skipped while a USB
+ * host is attached to the Serial/JTAG port (see sdkconfig.defaults).
  */
 
 esp_err_t power_init(void);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,79 @@
+#include "powerstat.h"
+
+#include <stdio.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static portMUX_TYPE powerstat_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint64_t total_us[POWERSTAT_STATES];
+static int64_t since_us[POWERSTAT_STATES];
+static uint8_t level_now[POWERSTAT_STATES];
+static uint32_t events[POWERSTAT_EVENTS];
+
+void powerstat_level(enum powerstat_state state, unsigned level)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&powerstat_lock);
+    total_us[state] += (uint64_t)level_now[state] * (now - since_us[state]);
+    since_us[state] = now;
+    level_now[state] = level;
+    taskEXIT_CRITICAL(&powerstat_lock);
+}
+
+void powerstat_count(enum powerstat_event event)
+{
+    taskENTER_CRITICAL(&powerstat_lock);
+    events[event]++;
+    taskEXIT_CRITICAL(&powerstat_lock);
+}
+
+void powerstat_get(struct powerstat *out)
+{
+    int64_t now = esp_timer_get_time();
+    uint64_t us[POWERSTAT_STATES];
+    uint32_t ev[POWERSTAT_EVENTS];
+
+    taskENTER_CRITICAL(&powerstat_lock);
+    for (int i = 0; i < POWERSTAT_STATES; i++) {
+        us[i] = total_us[i] + (uint64_t)level_now[i] * (now - since_us[i]);
+    }
+    for (int i = 0; i < POWERSTAT_EVENTS; i++) {
+        ev[i] = events[i];
+    }
+    taskEXIT_CRITICAL(&powerstat_lock);
+
+    out->uptime_s = now / 1000000;
+    out->display_on_s = us[POWERSTAT_DISPLAY] / 1000000;
+    out->adv_s = us[POWERSTAT_ADV] / 1000000;
+    out->conn_s = us[POWERSTAT_CONN] / 1000000;
+    out->samples = ev[POWERSTAT_SAMPLE];
+    out->flushes = ev[POWERSTAT_FLUSH];
+    out->notifies = ev[POWERSTAT_NOTIFY];
+}
+
+void powerstat_print(void)
+{
+    struct powerstat p;
+    powerstat_get(&p);
+
+    double up = p.uptime_s ? p.uptime_s : 1;
+    double hours = up / 3600;
+
+    printf("uptime       %10lu s\n", (unsigned long)p.uptime_s);
+    printf("display on   %10lu s  %5.1f %%\n",
+           (unsigned long)p.display_on_s, 100.0 * p.display_on_s / up);
+    printf("advertising  %10lu s  %5.1f %%\n",
+           (unsigned long)p.adv_s, 100.0 * p.adv_s / up);
+    printf("connected    %10lu s  %5.2f links avg\n",
+           (unsigned long)p.conn_s, p.conn_s / up);
+    printf("samples      %10lu    %7.1f /h\n",
+           (unsigned long)p.samples, p.samples / hours);
+    printf("flushes      %10lu    %7.1f /h\n",
+           (unsigned long)p.flushes, p.flushes / hours);
+    printf("notifies     %10lu    %7.1f /h\n",
+           (unsigned long)p.notifies, p.notifies / hours);
+}
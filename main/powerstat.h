@@ -0,0 +1,61 @@
+#ifndef POWERSTAT_H
+#define POWERSTAT_H
+
+#include <stdint.h>
+
+/*
+ * Activity counters since boot for the battery-life model
+ * (tools/battery_sim.py calibrate --counters).  They record how long the
+ * power-relevant states lasted and how often the costly events happened.
+ * They do not measure current.
+ *
+ * Read through the Power characteristic and the `power` console command.
+ * Characteristic layout (little-endian, packed), struct powerstat:
+ *
+ *   u32 uptime_s
+ *   u32 display_on_s   panel on
+ *   u32 adv_s          advertising
+ *   u32 conn_s         connection-seconds, summed over all links
+ *   u32 samples        BME280 measurements
+ *   u32 flushes        frames sent to the panel over I2C
+ *   u32 notifies       notifications queued to a central
+ */
+
+enum powerstat_state {
+    POWERSTAT_DISPLAY = 0,
+    POWERSTAT_ADV,
+    POWERSTAT_CONN,
+    POWERSTAT_STATES,
+};
+
+enum powerstat_event {
+    POWERSTAT_SAMPLE = 0,
+    POWERSTAT_FLUSH,
+    POWERSTAT_NOTIFY,
+    POWERSTAT_EVENTS,
+};
+
+struct __attribute__((packed)) powerstat {
+    uint32_t uptime_s;
+    uint32_t display_on_s;
+    uint32_t adv_s;
+    uint32_t conn_s;
+    uint32_t samples;
+    uint32_t flushes;
+    uint32_t notifies;
+};
+
+/** Set the level of a state (0 = off; POWERSTAT_CONN takes the link count).
+ *  Time is accumulated as level x duration. */
+void powerstat_level(enum powerstat_state state, unsigned level);
+
+/** Count one event. */
+void powerstat_count(enum powerstat_event event);
+
+/** Totals up to now. */
+void powerstat_get(struct powerstat *out);
+
+/** Print the counters and the derived duty cycles to stdout. */
+void powerstat_print(void);
+
+#endif /* POWERSTAT_H */
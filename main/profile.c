@@ -0,0 +1,255 @@
+#include "profile.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include "adv.h"
+#include "ble_conn.h"
+#include "display.h"
+#include "gatt_svc.h"
+#include "sensor_task.h"
+
+static const char *TAG = "profile";
+
+#define PROFILE_NVS_NAMESPACE   "sched"
+#define PROFILE_NVS_KEY         "table"
+
+static const struct sched_profile limits = {
+    .display_mode = DISPLAY_MODE_BLANK,
+    .sample = SAMPLE_PROFILE_COUNT - 1,
+    .adv = ADV_PROFILE_COUNT - 1,
+};
+
+static struct sched_entry table[SCHED_MAX];
+static size_t table_len;
+static bool table_changed;      /* apply the entry in force even if unchanged */
+static portMUX_TYPE table_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t switch_timer;
+static SemaphoreHandle_t eval_lock;
+static StaticSemaphore_t eval_lock_buf;
+
+/* ---- Switching ---------------------------------------------------------- */
+
+/* Fill in the settings the entry keeps, so the status shows what is set */
+static void apply(struct sched_profile *p)
+{
+    if (p->display_mode != SCHED_KEEP) {
+        gatt_svc_display_mode = p->display_mode;
+    }
+    p->display_mode = gatt_svc_display_mode;
+    if (p->sample != SCHED_KEEP) {
+        sensor_task_set_profile(p->sample);
+    }
+    p->sample = sensor_task_get_profile();
+    if (p->adv != SCHED_KEEP) {
+        adv_set_profile(p->adv);
+    }
+    p->adv = adv_get_profile();
+}
+
+/* Runs on the esp_timer task at switch points, and on the caller's task
+ * from profile_update(); eval_lock keeps the two from interleaving. */
+static void evaluate(void)
+{
+    struct sched_entry e[SCHED_MAX];
+    struct sched_status st = { .entry = SCHED_NONE };
+    time_t now = time(NULL);
+    uint32_t next = 0;
+    size_t n;
+    bool force;
+
+    taskENTER_CRITICAL(&table_lock);
+    n = table_len;
+    for (size_t i = 0; i < n; i++) {
+        e[i] = table[i];
+    }
+    force = table_changed;
+    table_changed = false;
+    taskEXIT_CRITICAL(&table_lock);
+
+    esp_timer_stop(switch_timer);
+    st.entry = sched_eval(e, n, now, gatt_svc_get_tz_quarter_hours(), &next);
+    if (st.entry != SCHED_NONE) {
+        st.next = (uint32_t)now + next;
+        esp_timer_start_once(switch_timer, (uint64_t)next * 1000000);
+    }
+
+    if (st.entry == gatt_svc_profile.entry && !force) {
+        gatt_svc_profile.next = st.next;
+        return;
+    }
+    st.since = (uint32_t)now;
+    if (st.entry != SCHED_NONE) {
+        st.profile = e[st.entry].profile;
+        apply(&st.profile);
+        ESP_LOGI(TAG, "entry %u: display %u, sampling %u, advertising %u; "
+                 "next switch in %lu s", st.entry, st.profile.display_mode,
+                 st.profile.sample, st.profile.adv, (unsigned long)next);
+    } else {
+        st.profile = (struct sched_profile){
+            SCHED_KEEP, SCHED_KEEP, SCHED_KEEP
+        };
+        apply(&st.profile);
+    }
+    gatt_svc_profile = st;
+    ble_conn_indicate(gatt_svc_val_handle(GATT_CHR_PROFILE),
+                      &gatt_svc_profile, sizeof(gatt_svc_profile));
+}
+
+static void switch_cb(void *arg)
+{
+    xSemaphoreTake(eval_lock, portMAX_DELAY);
+    evaluate();
+    xSemaphoreGive(eval_lock);
+}
+
+void profile_update(void)
+{
+    if (!switch_timer) {
+        return;
+    }
+    switch_cb(NULL);
+}
+
+/* ---- Table -------------------------------------------------------------- */
+
+size_t profile_get_schedule(struct sched_entry *e)
+{
+    size_t n;
+
+    taskENTER_CRITICAL(&table_lock);
+    n = table_len;
+    for (size_t i = 0; i < n; i++) {
+        e[i] = table[i];
+    }
+    taskEXIT_CRITICAL(&table_lock);
+    return n;
+}
+
+esp_err_t profile_set_schedule(const struct sched_entry *e, size_t n)
+{
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    if (!sched_validate(e, n, &limits)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&table_lock);
+    for (size_t i = 0; i < n; i++) {
+        table[i] = e[i];
+    }
+    table_len = n;
+    table_changed = true;
+    taskEXIT_CRITICAL(&table_lock);
+    profile_update();
+
+    err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = n ? nvs_set_blob(nvs, PROFILE_NVS_KEY, e, n * sizeof(*e))
+                : nvs_erase_key(nvs, PROFILE_NVS_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "schedule not saved: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "%u schedule entr%s set", (unsigned)n, n == 1 ? "y" : "ies");
+    return ESP_OK;
+}
+
+/* ---- Console ------------------------------------------------------------ */
+
+static void print_setting(const char *name, uint8_t v)
+{
+    if (v == SCHED_KEEP) {
+        printf("  %s -", name);
+    } else {
+        printf("  %s %u", name, v);
+    }
+}
+
+void profile_print(void)
+{
+    static const char days[] = "SMTWTFS";
+    struct sched_entry e[SCHED_MAX];
+    size_t n = profile_get_schedule(e);
+    struct sched_status st = gatt_svc_profile;
+
+    for (size_t i = 0; i < n; i++) {
+        char d[8];
+        for (int k = 0; k < 7; k++) {
+            d[k] = (e[i].days & (1u << k)) ? days[k] : '.';
+        }
+        d[7] = '\0';
+        printf("%u: %s %02u:%02u ", (unsigned)i, d, e[i].start_min / 60,
+               e[i].start_min % 60);
+        print_setting("display", e[i].profile.display_mode);
+        print_setting("sample", e[i].profile.sample);
+        print_setting("adv", e[i].profile.adv);
+        printf("%s\n", st.entry == i ? "  ACTIVE" : "");
+    }
+    printf("%u of %u entries", (unsigned)n, SCHED_MAX);
+    if (st.entry != SCHED_NONE) {
+        long left = (long)st.next - (long)time(NULL);
+        printf(", next switch in %ld s", left > 0 ? left : 0);
+    } else if (n) {
+        printf(", waiting for the clock to be set");
+    }
+    printf("\n");
+}
+
+/* ---- Initialization ----------------------------------------------------- */
+
+void profile_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = switch_cb,
+        .name = "profile",
+    };
+    struct sched_entry e[SCHED_MAX];
+    size_t len = sizeof(e);
+    nvs_handle_t nvs;
+
+    gatt_svc_profile.entry = SCHED_NONE;
+    eval_lock = xSemaphoreCreateMutexStatic(&eval_lock_buf);
+    if (esp_timer_create(&args, &switch_timer) != ESP_OK) {
+        ESP_LOGW(TAG, "timer unavailable, schedule disabled");
+        switch_timer = NULL;
+        return;
+    }
+
+    if (nvs_open(PROFILE_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, PROFILE_NVS_KEY, e, &len) == ESP_OK) {
+        if (len % sizeof(e[0]) == 0 &&
+            sched_validate(e, len / sizeof(e[0]), &limits)) {
+            for (size_t i = 0; i < len / sizeof(e[0]); i++) {
+                table[i] = e[i];
+            }
+            table_len = len / sizeof(e[0]);
+            ESP_LOGI(TAG, "%u schedule entr%s loaded", (unsigned)table_len,
+                     table_len == 1 ? "y" : "ies");
+        } else {
+            ESP_LOGW(TAG, "stored schedule is malformed, ignoring it");
+        }
+    }
+    nvs_close(nvs);
+
+    /* The clock survives a software reset */
+    profile_update();
+}
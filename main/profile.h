@@ -0,0 +1,42 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "sched.h"
+
+/*
+ * Switches the display mode, sampling profile and advertising profile by
+ * the weekly schedule (sched.h), in local time (the Timezone
+ * characteristic).  The table is written and read through the Schedule
+ * characteristic as an array of struct sched_entry and kept in NVS.  The
+ * entry in force is the Profile characteristic (struct sched_status),
+ * indicated at every switch.
+ *
+ * Nothing runs between switch points: a one-shot timer is armed for the
+ * next one, and re-armed when the clock, the timezone or the table
+ * changes.  Settings are applied only when the entry in force changes, so
+ * one written by hand in between holds until the next switch point.
+ */
+
+/** Load the table from NVS.  Call after the sensor task and advertising
+ *  are set up; the schedule applies once the clock has been set. */
+void profile_init(void);
+
+/** The clock or the timezone changed: find the entry in force again and
+ *  apply it before returning. */
+void profile_update(void);
+
+/** Copy the table into e (SCHED_MAX entries); returns the count. */
+size_t profile_get_schedule(struct sched_entry *e);
+
+/** Validate, persist and apply a new table; the entry in force is applied
+ *  even if it was in force before.  Returns ESP_ERR_INVALID_ARG if an
+ *  entry is malformed. */
+esp_err_t profile_set_schedule(const struct sched_entry *e, size_t n);
+
+/** Print the table and the entry in force to stdout. */
+void profile_print(void);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,231 @@
+#include "record.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/base64.h"
+
+#include "alarm.h"
+#include "bme280_comp.h"
+#include "display.h"
+#include "gatt_svc.h"
+#include "profile.h"
+#include "sample.h"
+
+static const char *TAG = "record";
+
+#define BME280_ADDR         0x76
+#define BME280_ADDR_ALT     0x77
+#define BME280_REG_CALIB_A  0x88    /* 26 bytes */
+#define BME280_REG_CALIB_B  0xe1    /* 7 bytes */
+#define BME280_REG_DATA     0xf7
+#define BME280_TIMEOUT_MS   50
+
+volatile bool record_on;
+
+static uint8_t trace_mem[CONFIG_APP_TRACE_BYTES];
+static struct trace_buf trace = {
+    .buf = trace_mem,
+    .cap = sizeof(trace_mem),
+};
+static bool trace_full;
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static i2c_master_dev_handle_t bme;
+static uint8_t calib[BME280_CALIB_LEN];
+static bool calib_ok;
+
+/* ---- Records ------------------------------------------------------------ */
+
+static void put(uint8_t type, const void *data, size_t len)
+{
+    uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool stopped = false;
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (record_on && !trace_put(&trace, type, ms, data, len)) {
+        record_on = false;
+        trace_full = true;
+        stopped = true;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+
+    if (stopped) {
+        ESP_LOGW(TAG, "trace full after %u bytes, recording stopped",
+                 (unsigned)trace.len);
+    }
+}
+
+/* The bmx280 component only hands out compensated values, so the raw
+ * registers are read again through a device handle of our own.  The
+ * sensor latches a readout until the next measurement, so this sees the
+ * same conversion the component just compensated. */
+static bool bme_read(uint8_t reg, uint8_t *buf, size_t len)
+{
+    return bme && i2c_master_transmit_receive(bme, &reg, 1, buf, len,
+                                              BME280_TIMEOUT_MS) == ESP_OK;
+}
+
+void record_bme280(bool readout_ok)
+{
+    uint8_t regs[BME280_DATA_LEN];
+
+    if (!record_on) {
+        return;
+    }
+    if (readout_ok && bme_read(BME280_REG_DATA, regs, sizeof(regs))) {
+        put(TRACE_BME280, regs, sizeof(regs));
+    } else {
+        put(TRACE_BME280, NULL, 0);
+    }
+}
+
+void record_battery(int raw, int mv)
+{
+    uint16_t v[2] = { raw, mv };
+
+    if (record_on) {
+        put(TRACE_BATTERY, v, sizeof(v));
+    }
+}
+
+void record_button(int mv)
+{
+    uint16_t v = mv;
+
+    if (record_on) {
+        put(TRACE_BUTTON, &v, sizeof(v));
+    }
+}
+
+void record_write(uint16_t uuid16, const void *val, size_t len)
+{
+    uint8_t rec[TRACE_PAYLOAD_MAX];
+
+    if (!record_on) {
+        return;
+    }
+    if (len > sizeof(rec) - sizeof(uuid16)) {
+        len = sizeof(rec) - sizeof(uuid16);
+    }
+    rec[0] = uuid16 & 0xff;
+    rec[1] = uuid16 >> 8;
+    memcpy(rec + 2, val, len);
+    put(TRACE_WRITE, rec, len + 2);
+}
+
+/* ---- Control ------------------------------------------------------------ */
+
+void record_start(void)
+{
+    struct trace_start st = {
+        .time = (uint32_t)time(NULL),
+        .tz_quarter_hours = gatt_svc_get_tz_quarter_hours(),
+        .display_mode = gatt_svc_display_mode,
+    };
+    struct rule rules[RULES_MAX];
+    size_t n = alarm_get_rules(rules);
+    struct sched_entry sched[SCHED_MAX];
+    size_t n_sched = profile_get_schedule(sched);
+
+    sample_get_sea_level(&st.sea_level_pa, &st.qnh_scale_q16);
+
+    taskENTER_CRITICAL(&trace_lock);
+    trace.len = 0;
+    trace_full = false;
+    record_on = true;
+    taskEXIT_CRITICAL(&trace_lock);
+
+    put(TRACE_START, &st, sizeof(st));
+    if (calib_ok) {
+        put(TRACE_CALIB, calib, sizeof(calib));
+    }
+    /* The rules in force go in as if a central had written them */
+    record_write(gatt_svc_uuid16(GATT_CHR_RULES), rules, n * sizeof(rules[0]));
+    record_write(gatt_svc_uuid16(GATT_CHR_SCHEDULE), sched,
+                 n_sched * sizeof(sched[0]));
+    /* Writing the schedule applies the entry in force; the display mode
+     * after it puts back one set by hand since the last switch */
+    record_write(gatt_svc_uuid16(GATT_CHR_DISPLAY_MODE), &st.display_mode,
+                 sizeof(st.display_mode));
+    ESP_LOGI(TAG, "recording into %u bytes", (unsigned)trace.cap);
+}
+
+void record_stop(void)
+{
+    record_on = false;
+}
+
+void record_print(bool dump)
+{
+    /* Records are only appended while recording, and start (which
+     * empties the buffer) runs on this same console task, so everything
+     * below len is stable. */
+    size_t len = trace.len, off = 0;
+    struct trace_rec rec;
+
+    if (dump) {
+        while (trace_next(trace.buf, len, &off, &rec)) {
+            static unsigned char line[352];     /* base64 of 261 bytes */
+            size_t olen;
+            mbedtls_base64_encode(line, sizeof(line), &olen,
+                                  rec.data - TRACE_HDR_LEN,
+                                  TRACE_HDR_LEN + rec.len);
+            printf("#T:%s\n", (char *)line);
+        }
+    }
+    printf("trace %s, %u of %u bytes%s\n",
+           record_on ? "recording" : "stopped", (unsigned)len,
+           (unsigned)trace.cap, trace_full ? " (full)" : "");
+}
+
+uint32_t record_size(void)
+{
+    return trace.len;
+}
+
+size_t record_read(uint32_t off, void *buf, size_t len)
+{
+    size_t n = 0;
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (off < trace.len) {
+        n = trace.len - off < len ? trace.len - off : len;
+        memcpy(buf, trace.buf + off, n);
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+    return n;
+}
+
+/* ---- Initialization ----------------------------------------------------- */
+
+void record_init(void)
+{
+    i2c_master_bus_handle_t bus = display_get_i2c_bus();
+    i2c_device_config_t dev = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = BME280_ADDR,
+        .scl_speed_hz = 100000,
+    };
+
+    if (bus && i2c_master_probe(bus, BME280_ADDR, BME280_TIMEOUT_MS) !=
+               ESP_OK) {
+        dev.device_address = BME280_ADDR_ALT;
+    }
+    if (bus && i2c_master_bus_add_device(bus, &dev, &bme) == ESP_OK) {
+        calib_ok = bme_read(BME280_REG_CALIB_A, calib, 26) &&
+                   bme_read(BME280_REG_CALIB_B, calib + 26, 7);
+    }
+    if (!calib_ok) {
+        ESP_LOGW(TAG, "no BME280 calibration, traces will lack readouts");
+    }
+#if CONFIG_APP_TRACE_AT_BOOT
+    record_start();
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include "trace.h"
+
+/*
+ * Record mode: the inputs the firmware reads go into a RAM trace (trace.h)
+ * that the `trace dump` console command prints as "#T:<base64>" lines, one
+ * record per line, for host/replay.c.  Recording starts at boot with
+ * CONFIG_APP_TRACE_AT_BOOT, or with `trace start`, and stops when the
+ * buffer (CONFIG_APP_TRACE_BYTES) is full.
+ *
+ * The hooks below are what the input paths call.  They cost a flag test
+ * while not recording, and compile away without CONFIG_APP_TRACE.
+ */
+
+#if CONFIG_APP_TRACE
+
+extern volatile bool record_on;
+
+#define record_active() (record_on)
+
+/** Find the BME280 on the display's I2C bus and read its calibration;
+ *  starts recording with CONFIG_APP_TRACE_AT_BOOT.  Call before the first
+ *  sample. */
+void record_init(void);
+
+/** Empty the trace and start it with the current state. */
+void record_start(void);
+void record_stop(void);
+
+/** Print the status, or with dump the records, to stdout. */
+void record_print(bool dump);
+
+/** Bytes of records in the trace, and a copy of up to len of them from
+ *  offset off (the "trace" stream of coc.h). */
+uint32_t record_size(void);
+size_t record_read(uint32_t off, void *buf, size_t len);
+
+void record_bme280(bool readout_ok);
+void record_battery(int raw, int mv);
+void record_button(int mv);
+void record_write(uint16_t uuid16, const void *val, size_t len);
+
+#else
+
+#define record_active() (false)
+
+static inline void record_init(void) {}
+static inline void record_bme280(bool readout_ok) {}
+static inline void record_battery(int raw, int mv) {}
+static inline void record_button(int mv) {}
+static inline void record_write(uint16_t uuid16, const void *val,
+                                size_t len) {}
+
+#endif
+
+#endif /* RECORD_H */
@@ -0,0 +1,279 @@
+#include "render.h"
+#include "fb.h"
+
+/* ---- Sparkline pages ---------------------------------------------------- */
+
+/* Value in tenths as glyphs, e.g. -12.3; returns the glyph count. */
+static int format_tenths(int *line, int32_t tenths)
+{
+    int n = 0;
+
+    if (tenths < 0) {
+        line[n++] = GLYPH_MINUS;
+        tenths = -tenths;
+    }
+    if (tenths >= 10000) line[n++] = tenths / 10000 % 10;
+    if (tenths >= 1000)  line[n++] = tenths / 1000 % 10;
+    if (tenths >= 100)   line[n++] = tenths / 100 % 10;
+    line[n++] = tenths / 10 % 10;
+    line[n++] = GLYPH_DOT;
+    line[n++] = tenths % 10;
+    return n;
+}
+
+/* Scale label: value in hundredths (Pa for pressure, °C x 100) */
+static void draw_scale_label(int page, int metric, int32_t v)
+{
+    int line[10];
+    int n = format_tenths(line, (v + (v >= 0 ? 5 : -5)) / 10);
+
+    if (metric == ROLLUP_PRESS) {
+        line[n++] = GLYPH_hP;
+        line[n++] = GLYPH_a;
+    } else {
+        line[n++] = GLYPH_DEG;
+        line[n++] = GLYPH_C;
+    }
+    fb_draw_line(page, 0, line, n);
+}
+
+/* Sparkline of the 10-minute rollups, one column per slot with the newest
+ * on the right (about 21 hours), each column spanning the slot's min..max.
+ * Rows 8-55 hold the plot; pages 0 and 7 label the top and bottom of the
+ * scale.  Missing slots leave gaps. */
+#define SPARK_TOP       8
+#define SPARK_BOTTOM    55
+
+static void render_sparkline(int metric, const struct render_input *in)
+{
+    const uint32_t span = rollup_span(ROLLUP_10MIN);
+    const int32_t min_range = metric == ROLLUP_PRESS ? 200 : 100;
+    struct rollup_slot s;
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+    uint32_t newest;
+    size_t n = 0;
+
+    if (!in->rollup_get(ROLLUP_10MIN, 0, &s)) {
+        return;
+    }
+    newest = s.start;
+
+    for (; in->rollup_get(ROLLUP_10MIN, n, &s); n++) {
+        if ((newest - s.start) / span >= FB_WIDTH) {
+            break;
+        }
+        int32_t smin = rollup_slot_value(&s, metric, ROLLUP_MIN);
+        int32_t smax = rollup_slot_value(&s, metric, ROLLUP_MAX);
+        if (smin < lo) lo = smin;
+        if (smax > hi) hi = smax;
+    }
+
+    /* Don't blow sensor noise up to full height: at least 2 hPa or 1 °C */
+    if (hi - lo < min_range) {
+        lo -= (min_range - (hi - lo)) / 2;
+        hi = lo + min_range;
+    }
+
+    for (size_t i = 0; i < n && in->rollup_get(ROLLUP_10MIN, i, &s);
+         i++) {
+        int col = FB_WIDTH - 1 - (int)((newest - s.start) / span);
+        int32_t smin = rollup_slot_value(&s, metric, ROLLUP_MIN);
+        int32_t smax = rollup_slot_value(&s, metric, ROLLUP_MAX);
+        int top = SPARK_BOTTOM - (int)((int64_t)(smax - lo) *
+                                       (SPARK_BOTTOM - SPARK_TOP) / (hi - lo));
+        int bottom = SPARK_BOTTOM - (int)((int64_t)(smin - lo) *
+                                          (SPARK_BOTTOM - SPARK_TOP) /
+                                          (hi - lo));
+        fb_draw_vline(col, top, bottom);
+    }
+
+    draw_scale_label(0, metric, hi);
+    draw_scale_label(7, metric, lo);
+}
+
+/* ---- Readings page ------------------------------------------------------ */
+
+static void render_readings(const struct render_input *in)
+{
+    /* Page 3: HH:MM:SS */
+    int clock[] = {
+        in->local.tm_hour / 10, in->local.tm_hour % 10, GLYPH_COLON,
+        in->local.tm_min / 10,  in->local.tm_min % 10,  GLYPH_COLON,
+        in->local.tm_sec / 10,  in->local.tm_sec % 10,
+    };
+    fb_draw_line(3, 32, clock, 8);
+
+    if (!in->sensors_valid) {
+        return;
+    }
+
+    /* Pages 0-2 come from the derived metrics sensor_task keeps up to
+     * date; only formatting happens here. */
+    const struct derived *d = &in->derived;
+    int line[10];
+    int n;
+
+    /* Page 0: altitude in metres, e.g. -12m or 1234m */
+    int alt_m = (d->altitude_dm + (d->altitude_dm >= 0 ? 5 : -5)) / 10;
+    n = 0;
+    if (alt_m < 0) {
+        line[n++] = GLYPH_MINUS;
+        alt_m = -alt_m;
+    }
+    if (alt_m >= 1000) line[n++] = alt_m / 1000 % 10;
+    if (alt_m >= 100)  line[n++] = alt_m / 100 % 10;
+    if (alt_m >= 10)   line[n++] = alt_m / 10 % 10;
+    line[n++] = alt_m % 10;
+    line[n++] = GLYPH_m;
+    fb_draw_line(0, 28, line, n);
+
+    /* Page 1: 3 h pressure trend, e.g. ↑+1.2hPa */
+    if (d->trend != DERIVED_TREND_UNKNOWN) {
+        int tend = d->tendency_pa < 0 ? -d->tendency_pa : d->tendency_pa;
+        tend = (tend + 5) / 10;     /* 0.1 hPa */
+        n = 0;
+        line[n++] = d->trend == DERIVED_TREND_RISING ? GLYPH_UP :
+                    d->trend == DERIVED_TREND_FALLING ? GLYPH_DOWN :
+                    GLYPH_RIGHT;
+        line[n++] = d->tendency_pa < 0 ? GLYPH_MINUS : GLYPH_PLUS;
+        if (tend >= 100) line[n++] = tend / 100 % 10;
+        line[n++] = tend / 10 % 10;
+        line[n++] = GLYPH_DOT;
+        line[n++] = tend % 10;
+        line[n++] = GLYPH_hP;
+        line[n++] = GLYPH_a;
+        fb_draw_line(1, 28, line, n);
+    }
+
+    /* Page 2: dew point, e.g. ◊12.3°C */
+    int dp = d->dew_point_c100 / 10;
+    n = 0;
+    line[n++] = GLYPH_DROP;
+    if (dp < 0) {
+        line[n++] = GLYPH_MINUS;
+        dp = -dp;
+    }
+    if (dp >= 100) line[n++] = dp / 100 % 10;
+    line[n++] = dp / 10 % 10;
+    line[n++] = GLYPH_DOT;
+    line[n++] = dp % 10;
+    line[n++] = GLYPH_DEG;
+    line[n++] = GLYPH_C;
+    fb_draw_line(2, 28, line, n);
+
+    /* Page 4: XXXX.XXhPa — pressure in hPa */
+    int press_hpa = (int)(in->pressure / 100.0f);
+    int press_dec = (int)(in->pressure / 1.0f) % 100;
+    if (press_dec < 0) press_dec = -press_dec;
+    int pressure[] = {
+        press_hpa / 1000 % 10, press_hpa / 100 % 10,
+        press_hpa / 10 % 10,   press_hpa % 10,
+        GLYPH_DOT,
+        press_dec / 10, press_dec % 10,
+        GLYPH_hP, GLYPH_a
+    };
+    fb_draw_line(4, 28, pressure, 9);
+
+    /* Page 5: */
+#ifdef DISPLAY_SHOW_FAHRENHEIT
+    /* XXX°F — temperature converted from °C */
+    float temp_f = in->temperature * 9.0f / 5.0f + 32.0f;
+    int tf = (int)temp_f;
+    int temp[] = {
+        tf / 100 % 10, tf / 10 % 10, tf % 10,
+        GLYPH_DEG, GLYPH_F,
+    };
+
+    fb_draw_line(5, 28, temp, 5);
+#else
+    /* XX.X°C — temperature in °C with 0.1° resolution */
+    int tc = (int)(in->temperature * 10.0f);
+    int temp[] = {
+        tc / 100 % 10, tc / 10 % 10, GLYPH_DOT, tc % 10,
+        GLYPH_DEG, GLYPH_C,
+    };
+
+    fb_draw_line(5, 28, temp, 6);
+#endif
+
+    /* Page 6: XX%RH — humidity */
+    int hum = (int)in->humidity;
+    int humidity[] = {
+        hum / 10 % 10, hum % 10, GLYPH_PCT, GLYPH_R, GLYPH_H
+    };
+    fb_draw_line(6, 28, humidity, 5);
+
+    /* Page 7: Battery voltage in mV */
+    int battery_mv = in->battery_mv * 2; // Assuming a voltage divider
+                                              // that halves the battery voltage
+    int battery[] = {
+        battery_mv / 1000 % 10, battery_mv / 100 % 10,
+        battery_mv / 10 % 10, battery_mv % 10,
+        GLYPH_m, GLYPH_V
+    };
+    fb_draw_line(7, 28, battery, 6);
+}
+
+/* ---- Pages -------------------------------------------------------------- */
+
+bool render_panel_on(uint8_t mode, int64_t since_press_us)
+{
+    switch (mode) {
+    case DISPLAY_MODE_BLANK:
+        return false;
+    case DISPLAY_MODE_BUTTON:
+        return since_press_us <= DISPLAY_BUTTON_ON_US;
+    default:
+        return true;
+    }
+}
+
+void render_page(int page, const struct render_input *in)
+{
+    fb_clear();
+    if (page == PAGE_READINGS) {
+        render_readings(in);
+    } else {
+        render_sparkline(page == PAGE_PRESSURE ? ROLLUP_PRESS : ROLLUP_TEMP,
+                         in);
+    }
+}
+
+/* ---- Display loop ------------------------------------------------------- */
+
+void render_loop_init(struct render_loop *l, int64_t press_us,
+                      uint32_t presses)
+{
+    l->page = PAGE_READINGS;
+    l->idle = 0;
+    l->last_press_us = press_us;
+    l->last_presses = presses;
+}
+
+bool render_loop_step(struct render_loop *l, int64_t press_us,
+                      uint32_t presses, bool on)
+{
+    if (presses != l->last_presses) {
+        l->last_presses = presses;
+        l->page = on ? (l->page + 1) % PAGE_COUNT : PAGE_READINGS;
+    }
+    if (press_us != l->last_press_us) {
+        /* New button press: always draw at once */
+        l->last_press_us = press_us;
+        l->idle = 0;
+        return true;
+    }
+    /* Otherwise only redraw periodically while the panel is on */
+    if (on && ++l->idle >= RENDER_LOOP_REDRAW) {
+        l->idle = 0;
+        return true;
+    }
+    return false;
+}
+
+uint32_t render_loop_wait_ms(bool on)
+{
+    /* Poll faster when on for a responsive timeout, slower when off to
+     * save power (fewer CPU wakeups) */
+    return on ? 2000 : 5000;
+}
@@ -0,0 +1,83 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "derived.h"
+#include "rollup.h"
+
+/*
+ * The display pages, drawn into the framebuffer (fb.h) from a snapshot of
+ * the readings, and the loop that decides when to draw them.  display.c
+ * takes the snapshot from the live values and flushes the result to the
+ * panel; host/replay.c takes it from a recorded trace, so both draw the
+ * same frames at the same moments.
+ */
+
+enum {
+    DISPLAY_MODE_NORMAL = 0,    // Normal display mode with sensor readings ON
+    DISPLAY_MODE_BUTTON = 1,    // Display shows for 60 seconds after button
+    DISPLAY_MODE_BLANK = 2,     // Display always blanked
+};
+
+#define DISPLAY_BUTTON_ON_US    (60 * 1000000LL)
+
+/* A button press while the display is on moves to the next page; one that
+ * wakes it starts on the readings. */
+enum {
+    PAGE_READINGS = 0,
+    PAGE_PRESSURE,
+    PAGE_TEMPERATURE,
+    PAGE_COUNT,
+};
+
+struct render_input {
+    struct tm local;            /* wall clock in the configured timezone */
+    bool     sensors_valid;
+    struct derived derived;
+    float    pressure;          /* Pa */
+    float    temperature;       /* °C */
+    float    humidity;          /* %RH */
+    uint32_t battery_mv;        /* as read on the ADC */
+    /* Slot i of a rollup level, 0 = newest; for the sparkline pages */
+    bool   (*rollup_get)(enum rollup_level level, size_t i,
+                         struct rollup_slot *out);
+};
+
+/** Whether a display mode shows anything, since_press_us after the last
+ *  button press. */
+bool render_panel_on(uint8_t mode, int64_t since_press_us);
+
+/** Clear the framebuffer and draw one page (PAGE_*). */
+void render_page(int page, const struct render_input *in);
+
+/* What display_task carries from one pass to the next.  Each pass polls
+ * the button, then asks render_loop_step() whether to draw. */
+struct render_loop {
+    int      page;              /* PAGE_* on show */
+    int      idle;              /* passes since the last draw */
+    int64_t  last_press_us;     /* button_time at the last pass */
+    uint32_t last_presses;      /* button_presses at the last pass */
+};
+
+#define RENDER_LOOP_REDRAW      3   /* passes between redraws while on */
+
+/** Start on the readings page, with the button as it is now. */
+void render_loop_init(struct render_loop *l, int64_t press_us,
+                      uint32_t presses);
+
+/**
+ * One pass, given button_time, button_presses and whether the panel is on:
+ * a press turns the page (or wakes the panel on the readings).  Returns
+ * true if l->page should be drawn now.
+ */
+bool render_loop_step(struct render_loop *l, int64_t press_us,
+                      uint32_t presses, bool on);
+
+/** How long to wait before the next pass, with the panel left on or off. */
+uint32_t render_loop_wait_ms(bool on);
+
+#endif /* RENDER_H */
@@ -0,0 +1,222 @@
+#include "rollup.h"
+
+#include <string.h>
+
+static const uint32_t spans[ROLLUP_LEVELS] = { 600, 3600, 86400 };
+static const uint16_t caps[ROLLUP_LEVELS] = {
+    ROLLUP_10MIN_SLOTS, ROLLUP_HOUR_SLOTS, ROLLUP_DAY_SLOTS,
+};
+
+uint32_t rollup_span(enum rollup_level level)
+{
+    return spans[level];
+}
+
+/* ---- Accumulators ------------------------------------------------------- */
+
+static void acc_reset(struct rollup_acc *a, uint32_t start)
+{
+    a->start = start;
+    a->count = 0;
+    for (int m = 0; m < ROLLUP_METRICS; m++) {
+        a->min[m] = INT32_MAX;
+        a->max[m] = INT32_MIN;
+        a->sum[m] = 0;
+    }
+}
+
+/* Fold n samples with the given min/mean/max (one sample: all equal). */
+static void acc_merge(struct rollup_acc *a, uint32_t n, const int32_t *min,
+                      const int32_t *mean, const int32_t *max)
+{
+    for (int m = 0; m < ROLLUP_METRICS; m++) {
+        if (min[m] < a->min[m]) {
+            a->min[m] = min[m];
+        }
+        if (max[m] > a->max[m]) {
+            a->max[m] = max[m];
+        }
+        a->sum[m] += (int64_t)mean[m] * n;
+    }
+    a->count += n;
+}
+
+static int32_t div_round(int64_t sum, uint32_t n)
+{
+    return (int32_t)((sum >= 0 ? sum + n / 2 : sum - n / 2) / (int64_t)n);
+}
+
+static void acc_to_slot(const struct rollup_acc *a, struct rollup_slot *s)
+{
+    int32_t mean[ROLLUP_METRICS];
+
+    for (int m = 0; m < ROLLUP_METRICS; m++) {
+        mean[m] = div_round(a->sum[m], a->count);
+    }
+    memset(s, 0, sizeof(*s));
+    s->start = a->start;
+    s->count = a->count > UINT16_MAX ? UINT16_MAX : a->count;
+    s->temp_c100[ROLLUP_MIN] = a->min[ROLLUP_TEMP];
+    s->temp_c100[ROLLUP_MEAN] = mean[ROLLUP_TEMP];
+    s->temp_c100[ROLLUP_MAX] = a->max[ROLLUP_TEMP];
+    s->hum_x100[ROLLUP_MIN] = a->min[ROLLUP_HUM];
+    s->hum_x100[ROLLUP_MEAN] = mean[ROLLUP_HUM];
+    s->hum_x100[ROLLUP_MAX] = a->max[ROLLUP_HUM];
+    s->press_pa[ROLLUP_MIN] = a->min[ROLLUP_PRESS];
+    s->press_pa[ROLLUP_MEAN] = mean[ROLLUP_PRESS];
+    s->press_pa[ROLLUP_MAX] = a->max[ROLLUP_PRESS];
+}
+
+int32_t rollup_slot_value(const struct rollup_slot *s, int metric, int stat)
+{
+    switch (metric) {
+    case ROLLUP_TEMP:
+        return s->temp_c100[stat];
+    case ROLLUP_HUM:
+        return s->hum_x100[stat];
+    default:
+        return (int32_t)s->press_pa[stat];
+    }
+}
+
+/* ---- Levels ------------------------------------------------------------- */
+
+static struct rollup_slot *ring_slots(struct rollup *r, int level)
+{
+    return level == ROLLUP_10MIN ? r->slots_10min :
+           level == ROLLUP_HOUR ? r->slots_hour : r->slots_day;
+}
+
+static void fold(struct rollup *r, int level, const struct rollup_slot *s);
+
+/* Store the open slot of a level and pass it up to the next one. */
+static void close_slot(struct rollup *r, int level)
+{
+    struct rollup_ring *ring = &r->ring[level];
+    struct rollup_slot *s = &ring_slots(r, level)[ring->head];
+
+    acc_to_slot(&r->acc[level], s);
+    r->acc[level].count = 0;
+    ring->head = (ring->head + 1) % caps[level];
+    if (ring->count < caps[level]) {
+        ring->count++;
+    }
+    if (level + 1 < ROLLUP_LEVELS) {
+        fold(r, level + 1, s);
+    }
+}
+
+/* Fold a closed slot of the level below into this level. */
+static void fold(struct rollup *r, int level, const struct rollup_slot *s)
+{
+    struct rollup_acc *a = &r->acc[level];
+    uint32_t start = s->start - s->start % spans[level];
+    int32_t min[ROLLUP_METRICS], mean[ROLLUP_METRICS], max[ROLLUP_METRICS];
+
+    if (a->count && a->start != start) {
+        close_slot(r, level);
+    }
+    if (a->count == 0) {
+        acc_reset(a, start);
+    }
+    for (int m = 0; m < ROLLUP_METRICS; m++) {
+        min[m] = rollup_slot_value(s, m, ROLLUP_MIN);
+        mean[m] = rollup_slot_value(s, m, ROLLUP_MEAN);
+        max[m] = rollup_slot_value(s, m, ROLLUP_MAX);
+    }
+    acc_merge(a, s->count, min, mean, max);
+}
+
+void rollup_init(struct rollup *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+void rollup_add(struct rollup *r, uint32_t time, int32_t temp_c100,
+                int32_t hum_x100, int32_t press_pa)
+{
+    struct rollup_acc *a = &r->acc[ROLLUP_10MIN];
+    uint32_t start = time - time % spans[ROLLUP_10MIN];
+    const int32_t v[ROLLUP_METRICS] = { temp_c100, hum_x100, press_pa };
+
+    if (a->count && start < a->start) {
+        rollup_init(r);
+    }
+    if (a->count && start != a->start) {
+        close_slot(r, ROLLUP_10MIN);
+    }
+    if (a->count == 0) {
+        acc_reset(a, start);
+    }
+    acc_merge(a, 1, v, v, v);
+}
+
+/* ---- Queries ------------------------------------------------------------ */
+
+size_t rollup_count(const struct rollup *r, enum rollup_level level)
+{
+    return r->ring[level].count + (r->acc[level].count ? 1 : 0);
+}
+
+bool rollup_get(const struct rollup *r, enum rollup_level level, size_t i,
+                struct rollup_slot *out)
+{
+    const struct rollup_ring *ring = &r->ring[level];
+
+    if (r->acc[level].count) {
+        if (i == 0) {
+            acc_to_slot(&r->acc[level], out);
+            return true;
+        }
+        i--;
+    }
+    if (i >= ring->count) {
+        return false;
+    }
+    const struct rollup_slot *slots =
+        level == ROLLUP_10MIN ? r->slots_10min :
+        level == ROLLUP_HOUR ? r->slots_hour : r->slots_day;
+    *out = slots[(ring->head + caps[level] - 1 - i) % caps[level]];
+    return true;
+}
+
+void rollup_view(const struct rollup *r, enum rollup_level level,
+                 struct rollup_view *v)
+{
+    v->ring = r->ring[level];
+    v->has_open = r->acc[level].count != 0;
+    if (v->has_open) {
+        acc_to_slot(&r->acc[level], &v->open);
+    }
+}
+
+size_t rollup_view_count(const struct rollup_view *v)
+{
+    return v->ring.count + (v->has_open ? 1 : 0);
+}
+
+bool rollup_view_get(const struct rollup *r, enum rollup_level level,
+                     const struct rollup_view *v, size_t i,
+                     struct rollup_slot *out)
+{
+    const struct rollup_ring *ring = &r->ring[level];
+
+    if (ring->head != v->ring.head || ring->count != v->ring.count) {
+        return false;
+    }
+    if (v->has_open) {
+        if (i == 0) {
+            *out = v->open;
+            return true;
+        }
+        i--;
+    }
+    if (i >= ring->count) {
+        return false;
+    }
+    const struct rollup_slot *slots =
+        level == ROLLUP_10MIN ? r->slots_10min :
+        level == ROLLUP_HOUR ? r->slots_hour : r->slots_day;
+    *out = slots[(ring->head + caps[level] - 1 - i) % caps[level]];
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Min/mean/max rollups of the sample history at three resolutions, each a
+ * fixed ring: 10-minute slots for a day, hourly slots for a week and daily
+ * slots for about two months, 32 bytes a slot (12 KB in all).  Each sample
+ * is folded into the open 10-minute slot; closing a slot folds it into the
+ * open slot of the next level, so an update touches at most one slot per
+ * level.  Slot boundaries are aligned to UTC.  history.c keeps the
+ * device's rollups; host/replay.c draws the sparkline pages from them.
+ */
+
+enum rollup_level {
+    ROLLUP_10MIN = 0,
+    ROLLUP_HOUR,
+    ROLLUP_DAY,
+    ROLLUP_LEVELS,
+};
+
+#define ROLLUP_10MIN_SLOTS  144     /* 24 h */
+#define ROLLUP_HOUR_SLOTS   168     /* 7 days */
+#define ROLLUP_DAY_SLOTS    62
+
+enum {
+    ROLLUP_TEMP = 0,            /* °C x 100 */
+    ROLLUP_HUM,                 /* %RH x 100 */
+    ROLLUP_PRESS,               /* Pa */
+    ROLLUP_METRICS,
+};
+
+enum {
+    ROLLUP_MIN = 0,
+    ROLLUP_MEAN,
+    ROLLUP_MAX,
+};
+
+/* One slot; also the wire format of the Rollup characteristic. */
+struct __attribute__((packed)) rollup_slot {
+    uint32_t start;             /* UNIX seconds, aligned to the level */
+    uint16_t count;             /* samples folded in */
+    int16_t  temp_c100[3];      /* min, mean, max */
+    uint16_t hum_x100[3];
+    uint32_t press_pa[3];
+    uint16_t reserved;
+};
+
+/* The slot being filled at one level. */
+struct rollup_acc {
+    uint32_t start;
+    uint32_t count;
+    int32_t  min[ROLLUP_METRICS];
+    int32_t  max[ROLLUP_METRICS];
+    int64_t  sum[ROLLUP_METRICS];
+};
+
+struct rollup_ring {
+    uint16_t head;              /* next slot to write */
+    uint16_t count;
+};
+
+/* A level as of one moment (rollup_view()): which ring slots hold data and
+ * the open slot, so the slots can be read one at a time afterwards. */
+struct rollup_view {
+    struct rollup_ring ring;
+    bool has_open;
+    struct rollup_slot open;
+};
+
+struct rollup {
+    struct rollup_acc acc[ROLLUP_LEVELS];
+    struct rollup_ring ring[ROLLUP_LEVELS];
+    struct rollup_slot slots_10min[ROLLUP_10MIN_SLOTS];
+    struct rollup_slot slots_hour[ROLLUP_HOUR_SLOTS];
+    struct rollup_slot slots_day[ROLLUP_DAY_SLOTS];
+};
+
+/** Empty every level.  A zero-initialised struct rollup is empty too. */
+void rollup_init(struct rollup *r);
+
+/**
+ * Fold in one sample taken at time (UNIX seconds).  A time before the open
+ * 10-minute slot means the clock was set back; the rings no longer sort by
+ * time then, so they are emptied first.
+ */
+void rollup_add(struct rollup *r, uint32_t time, int32_t temp_c100,
+                int32_t hum_x100, int32_t press_pa);
+
+/** Slots stored at a level, counting the open one. */
+size_t rollup_count(const struct rollup *r, enum rollup_level level);
+
+/** Copy slot i of a level, 0 being the newest (the open slot while it has
+ *  samples); false if there is no such slot. */
+bool rollup_get(const struct rollup *r, enum rollup_level level, size_t i,
+                struct rollup_slot *out);
+
+/** Take a view of a level; rollup_count() slots as of now. */
+void rollup_view(const struct rollup *r, enum rollup_level level,
+                 struct rollup_view *v);
+
+/** Slots in a view. */
+size_t rollup_view_count(const struct rollup_view *v);
+
+/**
+ * Copy slot i of a view, 0 being the newest, as rollup_get() would have
+ * when the view was taken.  False if i is out of range or a slot has been
+ * stored since, which makes the view stale.
+ */
+bool rollup_view_get(const struct rollup *r, enum rollup_level level,
+                     const struct rollup_view *v, size_t i,
+                     struct rollup_slot *out);
+
+/** One statistic (ROLLUP_MIN/MEAN/MAX) of one metric of a slot. */
+int32_t rollup_slot_value(const struct rollup_slot *s, int metric, int stat);
+
+/** Length of a slot at a level, in seconds. */
+uint32_t rollup_span(enum rollup_level level);
+
+#endif /* ROLLUP_H */
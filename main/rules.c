@@ -0,0 +1,130 @@
+#include "rules.h"
+
+#include <string.h>
+
+/* ---- Table -------------------------------------------------------------- */
+
+void rules_init(struct rules_state *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+bool rules_validate(const struct rule *r, size_t n)
+{
+    if (n > RULES_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (r[i].metric >= RULES_METRIC_COUNT || r[i].op >= RULES_OP_COUNT ||
+            (r[i].actions & ~RULES_ACT_ALL) ||
+            (r[i].flags & ~RULES_F_ENABLED) ||
+            r[i].hysteresis > INT32_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void rules_set(struct rules_state *s, const struct rule *r, size_t n)
+{
+    memset(s->rule, 0, sizeof(s->rule));
+    memcpy(s->rule, r, n * sizeof(*r));
+    s->count = n;
+    s->active = 0;
+    s->pending = 0;
+}
+
+/* ---- Evaluation --------------------------------------------------------- */
+
+/* Track the last value and a smoothed rate per hour.  Rates over gaps
+ * shorter than RULES_RATE_MIN_S are dominated by quantisation, so such
+ * samples are skipped and the next one measures over the longer gap. */
+static void metric_update(struct rules_metric *m, int32_t v, uint32_t now_s)
+{
+    if (!m->seen) {
+        m->last = v;
+        m->last_s = now_s;
+        m->seen = true;
+        return;
+    }
+
+    uint32_t dt = now_s - m->last_s;
+    if (dt < RULES_RATE_MIN_S) {
+        return;
+    }
+
+    int32_t inst = (int32_t)(((int64_t)v - m->last) * 3600 / dt);
+    if (m->rate_valid) {
+        m->rate += (inst - m->rate) / 4;
+    } else {
+        m->rate = inst;
+        m->rate_valid = true;
+    }
+    m->last = v;
+    m->last_s = now_s;
+}
+
+void rules_eval(struct rules_state *s, const struct rules_input *in,
+                uint32_t now_s, struct rules_status *out)
+{
+    uint8_t was_active = s->active;
+
+    for (int i = 0; i < RULES_METRIC_COUNT; i++) {
+        if (in->valid & (1u << i)) {
+            metric_update(&s->metric[i], in->value[i], now_s);
+        }
+    }
+
+    out->actions = 0;
+    for (int i = 0; i < RULES_MAX; i++) {
+        const struct rule *r = &s->rule[i];
+        const struct rules_metric *m = &s->metric[r->metric];
+        uint8_t bit = 1u << i;
+        bool rate = r->op >= RULES_OP_RATE_ABOVE;
+        bool above = r->op == RULES_OP_ABOVE || r->op == RULES_OP_RATE_ABOVE;
+        int64_t x, limit;
+
+        if (i >= s->count || !(r->flags & RULES_F_ENABLED)) {
+            s->active &= ~bit;
+            s->pending &= ~bit;
+            continue;
+        }
+        if (rate ? !m->rate_valid : !(in->valid & (1u << r->metric))) {
+            if (s->active & bit) {
+                out->actions |= r->actions;
+            }
+            continue;
+        }
+        x = rate ? m->rate : in->value[r->metric];
+
+        if (s->active & bit) {
+            /* Clear only once the value is back past the hysteresis band */
+            limit = above ? (int64_t)r->threshold - r->hysteresis
+                          : (int64_t)r->threshold + r->hysteresis;
+            if (above ? x <= limit : x >= limit) {
+                s->active &= ~bit;
+            } else {
+                out->actions |= r->actions;
+            }
+            continue;
+        }
+
+        if (above ? x <= r->threshold : x >= r->threshold) {
+            s->pending &= ~bit;
+            continue;
+        }
+        if (!(s->pending & bit)) {
+            s->pending |= bit;
+            s->since_s[i] = now_s;
+        }
+        if (now_s - s->since_s[i] >= r->min_duration_s) {
+            s->pending &= ~bit;
+            s->active |= bit;
+            out->actions |= r->actions;
+        }
+    }
+
+    out->active = s->active;
+    out->fired = s->active & ~was_active;
+    out->cleared = was_active & ~s->active;
+}
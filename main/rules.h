@@ -0,0 +1,113 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Threshold rules evaluated on the device once per sample.  A rule compares
+ * one metric (or its rate of change) with a threshold, with hysteresis and
+ * a minimum duration, and names the actions to take while it is active.
+ * Evaluation is a fixed loop over RULES_METRIC_COUNT metrics and RULES_MAX
+ * rules, so it costs the same whatever the table holds.  sample.c keeps
+ * the table; host/replay.c runs it over recorded traces.
+ */
+
+#define RULES_MAX           8
+#define RULES_RATE_MIN_S    60      /* shorter gaps don't update rates */
+
+/* Metrics, in the units the GATT characteristics use. */
+enum {
+    RULES_METRIC_TEMP = 0,      /* °C x 100 */
+    RULES_METRIC_HUM,           /* %RH x 100 */
+    RULES_METRIC_PRESS,         /* Pa */
+    RULES_METRIC_BATT,          /* mV as read on the ADC */
+    RULES_METRIC_DEW_POINT,     /* °C x 100 */
+    RULES_METRIC_TENDENCY,      /* Pa over the last 3 h */
+    RULES_METRIC_ALTITUDE,      /* dm */
+    RULES_METRIC_COUNT,
+};
+
+enum {
+    RULES_OP_ABOVE = 0,         /* value > threshold */
+    RULES_OP_BELOW,             /* value < threshold */
+    RULES_OP_RATE_ABOVE,        /* change per hour > threshold */
+    RULES_OP_RATE_BELOW,        /* change per hour < threshold */
+    RULES_OP_COUNT,
+};
+
+/* Action bits */
+#define RULES_ACT_DISPLAY   0x01    /* wake the display when the rule fires */
+#define RULES_ACT_ADV       0x02    /* fast advertising with the alarm flag */
+#define RULES_ACT_LED       0x04    /* blink the LED while active */
+#define RULES_ACT_INDICATE  0x08    /* indicate Alarm on fire and clear */
+#define RULES_ACT_ALL       0x0f
+
+#define RULES_F_ENABLED     0x01
+
+/* Wire format of one entry of the Rules characteristic (little-endian). */
+struct __attribute__((packed)) rule {
+    uint8_t  metric;            /* RULES_METRIC_* */
+    uint8_t  op;                /* RULES_OP_* */
+    uint8_t  actions;           /* RULES_ACT_* */
+    uint8_t  flags;             /* RULES_F_* */
+    int32_t  threshold;         /* metric units, or metric units per hour */
+    uint32_t hysteresis;        /* how far back the value must go to clear */
+    uint16_t min_duration_s;    /* condition must hold this long to fire */
+    uint16_t reserved;
+};
+
+/* Wire format of the Alarm characteristic. */
+struct __attribute__((packed)) rules_status {
+    uint8_t  active;            /* bit per rule */
+    uint8_t  fired;             /* rules that became active on this sample */
+    uint8_t  cleared;           /* rules that cleared on this sample */
+    uint8_t  actions;           /* RULES_ACT_* of the active rules */
+    uint32_t time;              /* UNIX time of the sample */
+};
+
+struct rules_metric {
+    int32_t  last;
+    uint32_t last_s;
+    int32_t  rate;              /* smoothed change per hour */
+    bool     seen;
+    bool     rate_valid;
+};
+
+struct rules_state {
+    struct rule rule[RULES_MAX];
+    uint8_t count;
+    uint8_t active;
+    uint8_t pending;            /* condition true, waiting for min_duration */
+    uint32_t since_s[RULES_MAX];
+    struct rules_metric metric[RULES_METRIC_COUNT];
+};
+
+/** One sample: values indexed by RULES_METRIC_*, and a bit per valid one. */
+struct rules_input {
+    int32_t  value[RULES_METRIC_COUNT];
+    uint32_t valid;
+};
+
+/** Clear the table and all state. */
+void rules_init(struct rules_state *s);
+
+/** Check a candidate table; returns false if any entry is malformed. */
+bool rules_validate(const struct rule *r, size_t n);
+
+/**
+ * Replace the table (n <= RULES_MAX, already validated).  Rules start
+ * inactive; metric history is kept so rates stay available.
+ */
+void rules_set(struct rules_state *s, const struct rule *r, size_t n);
+
+/**
+ * Fold in one sample and evaluate every rule.  now_s is a monotonic clock.
+ * A rule whose metric (or rate) is not valid keeps its state.  Fills the
+ * active/fired/cleared/actions fields of out; time is left to the caller.
+ */
+void rules_eval(struct rules_state *s, const struct rules_input *in,
+                uint32_t now_s, struct rules_status *out);
+
+#endif /* RULES_H */
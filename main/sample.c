@@ -0,0 +1,209 @@
+#include "sample.h"
+
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "history.h"
+
+/* The locks only cover copying the state in and out: the maths runs on a
+ * copy with interrupts enabled, and the copy is stored back only if the
+ * generation is unchanged.  Otherwise another writer got in first, and
+ * the update starts over from its result. */
+static struct derived_state derived;
+static uint32_t derived_gen;
+static portMUX_TYPE derived_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static struct rules_state rules;
+static uint32_t rules_gen;
+static portMUX_TYPE rules_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t derived_copy(struct derived_state *d)
+{
+    uint32_t gen;
+
+    taskENTER_CRITICAL(&derived_lock);
+    *d = derived;
+    gen = derived_gen;
+    taskEXIT_CRITICAL(&derived_lock);
+    return gen;
+}
+
+static bool derived_store(const struct derived_state *d, uint32_t gen)
+{
+    bool stored;
+
+    taskENTER_CRITICAL(&derived_lock);
+    stored = gen == derived_gen;
+    if (stored) {
+        derived = *d;
+        derived_gen++;
+    }
+    taskEXIT_CRITICAL(&derived_lock);
+    return stored;
+}
+
+static uint32_t rules_copy(struct rules_state *r)
+{
+    uint32_t gen;
+
+    taskENTER_CRITICAL(&rules_lock);
+    *r = rules;
+    gen = rules_gen;
+    taskEXIT_CRITICAL(&rules_lock);
+    return gen;
+}
+
+static bool rules_store(const struct rules_state *r, uint32_t gen)
+{
+    bool stored;
+
+    taskENTER_CRITICAL(&rules_lock);
+    stored = gen == rules_gen;
+    if (stored) {
+        rules = *r;
+        rules_gen++;
+    }
+    taskEXIT_CRITICAL(&rules_lock);
+    return stored;
+}
+
+/* ---- Per sample --------------------------------------------------------- */
+
+static void rules_input(const struct sample *s, const struct derived *d,
+                        struct rules_input *in)
+{
+    in->value[RULES_METRIC_BATT] = s->battery_mv;
+    in->valid = 1u << RULES_METRIC_BATT;
+    if (!s->ok) {
+        return;
+    }
+    in->value[RULES_METRIC_TEMP] = lroundf(s->temperature * 100.0f);
+    in->value[RULES_METRIC_HUM] = lroundf(s->humidity * 100.0f);
+    in->value[RULES_METRIC_PRESS] = lroundf(s->pressure);
+    in->value[RULES_METRIC_DEW_POINT] = d->dew_point_c100;
+    in->value[RULES_METRIC_ALTITUDE] = d->altitude_dm;
+    in->valid |= 1u << RULES_METRIC_TEMP | 1u << RULES_METRIC_HUM |
+                 1u << RULES_METRIC_PRESS | 1u << RULES_METRIC_DEW_POINT |
+                 1u << RULES_METRIC_ALTITUDE;
+    if (d->trend != DERIVED_TREND_UNKNOWN) {
+        in->value[RULES_METRIC_TENDENCY] = d->tendency_pa;
+        in->valid |= 1u << RULES_METRIC_TENDENCY;
+    }
+}
+
+void sample_process(const struct sample *s, struct sample_result *out)
+{
+    struct derived_state d;
+    struct rules_state r;
+    struct rules_input in;
+    uint32_t gen;
+
+    /* Derived metrics are updated here, once per sample, so readers only
+     * copy the results. */
+    if (s->ok) {
+        do {
+            gen = derived_copy(&d);
+            derived_update(&d, lroundf(s->temperature * 100.0f),
+                           lroundf(s->humidity * 100.0f),
+                           lroundf(s->pressure), s->uptime_s);
+        } while (!derived_store(&d, gen));
+        out->derived = d.out;
+    } else {
+        sample_get_derived(&out->derived);
+    }
+
+    if (s->ok) {
+        struct history_sample h = {
+            .time = s->time,
+            .press_pa = lroundf(s->pressure),
+            .temp_c100 = lroundf(s->temperature * 100.0f),
+            .hum_x100 = lroundf(s->humidity * 100.0f),
+            .batt_mv = s->battery_mv,
+        };
+        history_add(&h);
+    }
+
+    rules_input(s, &out->derived, &in);
+    do {
+        gen = rules_copy(&r);
+        rules_eval(&r, &in, s->uptime_s, &out->alarm);
+    } while (!rules_store(&r, gen));
+    out->fired = out->edge = out->adv = 0;
+    for (int i = 0; i < RULES_MAX; i++) {
+        uint8_t act = r.rule[i].actions;
+        if (out->alarm.fired & (1u << i)) {
+            out->fired |= act;
+        }
+        if ((out->alarm.fired | out->alarm.cleared) & (1u << i)) {
+            out->edge |= act;
+        }
+        if ((out->alarm.active & (1u << i)) && (act & RULES_ACT_ADV)) {
+            out->adv |= 1u << i;
+        }
+    }
+    out->alarm.time = s->time;
+}
+
+/* ---- Derived metrics ---------------------------------------------------- */
+
+void sample_init(uint32_t sea_level_pa, uint32_t qnh_scale_q16)
+{
+    taskENTER_CRITICAL(&derived_lock);
+    derived_init(&derived, sea_level_pa, qnh_scale_q16);
+    derived_gen++;
+    taskEXIT_CRITICAL(&derived_lock);
+}
+
+void sample_get_derived(struct derived *out)
+{
+    taskENTER_CRITICAL(&derived_lock);
+    *out = derived.out;
+    taskEXIT_CRITICAL(&derived_lock);
+}
+
+uint32_t sample_set_sea_level(uint32_t pa)
+{
+    struct derived_state d;
+    uint32_t gen, k;
+
+    do {
+        gen = derived_copy(&d);
+        k = derived_set_sea_level(&d, pa);
+    } while (!derived_store(&d, gen));
+    return k;
+}
+
+void sample_get_sea_level(uint32_t *pa, uint32_t *qnh_scale_q16)
+{
+    taskENTER_CRITICAL(&derived_lock);
+    *pa = derived.out.sea_level_pa;
+    *qnh_scale_q16 = derived.qnh_scale_q16;
+    taskEXIT_CRITICAL(&derived_lock);
+}
+
+/* ---- Rules -------------------------------------------------------------- */
+
+size_t sample_get_rules(struct rule *r)
+{
+    size_t n;
+
+    taskENTER_CRITICAL(&rules_lock);
+    n = rules.count;
+    for (size_t i = 0; i < n; i++) {
+        r[i] = rules.rule[i];
+    }
+    taskEXIT_CRITICAL(&rules_lock);
+    return n;
+}
+
+uint8_t sample_set_rules(const struct rule *r, size_t n)
+{
+    uint8_t was_active;
+
+    taskENTER_CRITICAL(&rules_lock);
+    was_active = rules.active;
+    rules_set(&rules, r, n);
+    rules_gen++;
+    taskEXIT_CRITICAL(&rules_lock);
+    return was_active;
+}
@@ -0,0 +1,62 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "derived.h"
+#include "rules.h"
+
+/*
+ * What becomes of each sample between the sensor read and the GATT
+ * publish: the derived metrics, the history and the rule engine.  Their
+ * state lives here, each part behind its own lock, so sensor_task, the
+ * GATT hooks and the console share one copy.  Publishing the result and
+ * carrying out the rules' actions are left to the caller (sensor_task.c
+ * and alarm.c on the device, host/replay.c on a recorded trace).
+ */
+
+struct sample {
+    bool     ok;                /* the BME280 readout succeeded */
+    float    temperature;       /* °C; the three are unset unless ok */
+    float    pressure;          /* Pa */
+    float    humidity;          /* %RH */
+    uint32_t battery_mv;        /* as read on the ADC */
+    uint32_t uptime_s;          /* monotonic, for rates and durations */
+    uint32_t time;              /* UNIX seconds, for history and Alarm */
+};
+
+/* What sample_process() made of one sample. */
+struct sample_result {
+    struct derived derived;
+    struct rules_status alarm;  /* the new Alarm value, time filled in */
+    uint8_t fired;              /* RULES_ACT_* of the rules that fired */
+    uint8_t edge;               /* ... of those that fired or cleared */
+    uint8_t adv;                /* active rules asking for RULES_ACT_ADV */
+};
+
+/** Reset the derived metrics (see derived_init()).  Call before the first
+ *  sample. */
+void sample_init(uint32_t sea_level_pa, uint32_t qnh_scale_q16);
+
+/** Fold in one sample: derived metrics, history (if s->ok), then rules. */
+void sample_process(const struct sample *s, struct sample_result *out);
+
+/** The derived metrics as of the last sample or sea-level change. */
+void sample_get_derived(struct derived *out);
+
+/** Set the sea-level reference; returns the QNH factor to persist (see
+ *  derived_set_sea_level()). */
+uint32_t sample_set_sea_level(uint32_t pa);
+
+void sample_get_sea_level(uint32_t *pa, uint32_t *qnh_scale_q16);
+
+/** Copy the rule table into r (RULES_MAX entries); returns the count. */
+size_t sample_get_rules(struct rule *r);
+
+/** Replace the rule table (already validated, see rules_set()).  Returns
+ *  the rules that were active, which are now cleared. */
+uint8_t sample_set_rules(const struct rule *r, size_t n);
+
+#endif /* SAMPLE_H */
@@ -0,0 +1,93 @@
+#include "sched.h"
+
+static bool setting_ok(uint8_t v, uint8_t max)
+{
+    return v == SCHED_KEEP || v <= max;
+}
+
+bool sched_validate(const struct sched_entry *e, size_t n,
+                    const struct sched_profile *max)
+{
+    if (n > SCHED_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (e[i].days == 0 || (e[i].days & ~SCHED_EVERY_DAY) ||
+            e[i].start_min >= 24 * 60 ||
+            !setting_ok(e[i].profile.display_mode, max->display_mode) ||
+            !setting_ok(e[i].profile.sample, max->sample) ||
+            !setting_ok(e[i].profile.adv, max->adv)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t sched_week_s(int64_t local)
+{
+    /* 1970-01-01 was a Thursday */
+    int64_t s = (local + 4 * 86400) % SCHED_WEEK_S;
+
+    return (uint32_t)(s < 0 ? s + SCHED_WEEK_S : s);
+}
+
+/* Seconds from a to b going forward round the week, 0 to SCHED_WEEK_S - 1 */
+static uint32_t ahead(uint32_t a, uint32_t b)
+{
+    return (b + SCHED_WEEK_S - a) % SCHED_WEEK_S;
+}
+
+int sched_active(const struct sched_entry *e, size_t n, uint32_t week_s)
+{
+    uint32_t best = SCHED_WEEK_S;
+    int active = -1;
+
+    for (size_t i = 0; i < n; i++) {
+        for (int d = 0; d < 7; d++) {
+            if (!(e[i].days & (1u << d))) {
+                continue;
+            }
+            uint32_t back = ahead(d * 86400 + e[i].start_min * 60, week_s);
+            if (back <= best) {
+                best = back;
+                active = (int)i;
+            }
+        }
+    }
+    return active;
+}
+
+uint32_t sched_next(const struct sched_entry *e, size_t n, uint32_t week_s)
+{
+    uint32_t best = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        for (int d = 0; d < 7; d++) {
+            if (!(e[i].days & (1u << d))) {
+                continue;
+            }
+            uint32_t to = ahead(week_s, d * 86400 + e[i].start_min * 60);
+            if (to == 0) {
+                to = SCHED_WEEK_S;
+            }
+            if (best == 0 || to < best) {
+                best = to;
+            }
+        }
+    }
+    return best;
+}
+
+uint8_t sched_eval(const struct sched_entry *e, size_t n, int64_t now,
+                   int tz_quarter_hours, uint32_t *next_s)
+{
+    uint32_t week_s;
+
+    *next_s = 0;
+    if (n == 0 || now < SCHED_CLOCK_MIN) {
+        return SCHED_NONE;
+    }
+    week_s = sched_week_s(now + tz_quarter_hours * 15 * 60);
+    *next_s = sched_next(e, n, week_s);
+    return (uint8_t)sched_active(e, n, week_s);
+}
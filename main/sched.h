@@ -0,0 +1,90 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Weekly power schedule.  Each entry is a switch point: from its start time
+ * on the days it names, its profile holds until the next switch point of
+ * the week, whichever entry that belongs to.  So "22:00 every day: blank,
+ * slow, slow" and "07:00 Mon-Fri: button, normal, normal" give quiet
+ * nights, and weekends keep the night profile until 22:00 comes round
+ * again.  Times are local; the caller adds the timezone.  profile.c on
+ * the device and host/replay.c on a trace both go through sched_eval().
+ */
+
+#define SCHED_MAX           8
+#define SCHED_WEEK_S        (7 * 86400)
+#define SCHED_KEEP          0xff    /* leave this setting as it is */
+#define SCHED_NONE          0xff    /* no entry in force */
+#define SCHED_CLOCK_MIN     1704067200  /* 2024-01-01; earlier = never set */
+
+/* Day bits, tm_wday order */
+#define SCHED_SUN           0x01
+#define SCHED_MON           0x02
+#define SCHED_TUE           0x04
+#define SCHED_WED           0x08
+#define SCHED_THU           0x10
+#define SCHED_FRI           0x20
+#define SCHED_SAT           0x40
+#define SCHED_WEEKDAYS      0x3e
+#define SCHED_EVERY_DAY     0x7f
+
+/* What an entry sets: DISPLAY_MODE_*, SAMPLE_PROFILE_*, ADV_PROFILE_*, or
+ * SCHED_KEEP for each. */
+struct __attribute__((packed)) sched_profile {
+    uint8_t display_mode;
+    uint8_t sample;
+    uint8_t adv;
+};
+
+/* Wire format of one entry of the Schedule characteristic (little-endian). */
+struct __attribute__((packed)) sched_entry {
+    uint8_t  days;              /* SCHED_SUN... */
+    uint8_t  reserved;
+    uint16_t start_min;         /* minutes after local midnight */
+    struct sched_profile profile;
+    uint8_t  reserved2;
+};
+
+/* Wire format of the Profile characteristic. */
+struct __attribute__((packed)) sched_status {
+    uint8_t  entry;             /* index of the entry in force, SCHED_NONE
+                                 * with an empty table or an unset clock */
+    struct sched_profile profile;   /* the settings it switched to */
+    uint32_t since;             /* UNIX time of that switch */
+    uint32_t next;              /* UNIX time of the next one, 0 if none */
+};
+
+/** Check a candidate table against the highest value of each setting;
+ *  returns false if any entry is malformed. */
+bool sched_validate(const struct sched_entry *e, size_t n,
+                    const struct sched_profile *max);
+
+/** Seconds since local Sunday 00:00 for a local UNIX time. */
+uint32_t sched_week_s(int64_t local);
+
+/**
+ * The entry in force at week_s (sched_week_s()), that is the one with the
+ * latest switch point at or before it, counting back across the start of
+ * the week.  Returns -1 for an empty table.  When two entries switch at the
+ * same moment the later one in the table wins.
+ */
+int sched_active(const struct sched_entry *e, size_t n, uint32_t week_s);
+
+/** Seconds from week_s to the next switch point (1 to SCHED_WEEK_S), or 0
+ *  for an empty table. */
+uint32_t sched_next(const struct sched_entry *e, size_t n, uint32_t week_s);
+
+/**
+ * The entry in force at UNIX time now on a clock tz_quarter_hours from
+ * UTC, and in *next_s the seconds to the next switch point, when to ask
+ * again.  SCHED_NONE (and 0) for an empty table or a clock that has not
+ * been set.
+ */
+uint8_t sched_eval(const struct sched_entry *e, size_t n, int64_t now,
+                   int tz_quarter_hours, uint32_t *next_s);
+
+#endif /* SCHED_H */
@@ -1,27 +1,125 @@
 #include <stdio.h>
+#include <time.h>
 #include "esp_pm.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "sensor_task.h"
+#include "sample.h"
 #include "bmx280.h"
 #include "bmx280_sensor.h"
 #include "battery.h"
+#include "gatt_svc.h"
+#include "adv.h"
+#include "alarm.h"
+#include "ble_conn.h"
+#include "powerstat.h"
+#include "record.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define BLOG_LOCAL
+#include "blog.h"
+
 static const char *TAG = "sensor_task";
 
 /* ---- Sensors validity flags --------------------------------------------- */
 
 bool sensors_valid = false;
 
+/* ---- Derived metrics ---------------------------------------------------- */
+
+#define DERIVED_NVS_NAMESPACE   "derived"
+
+static void derived_load(void)
+{
+    uint32_t p0 = CONFIG_APP_SEA_LEVEL_PA;
+    uint32_t k = 0;
+    nvs_handle_t nvs;
+
+    if (nvs_open(DERIVED_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u32(nvs, "p0", &p0);
+        nvs_get_u32(nvs, "qnh_k", &k);
+        nvs_close(nvs);
+    }
+    sample_init(p0, k);
+}
+
+void sensor_task_set_sea_level(uint32_t pa)
+{
+    uint32_t k = sample_set_sea_level(pa);
+    struct derived d;
+
+    nvs_handle_t nvs;
+    if (nvs_open(DERIVED_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_u32(nvs, "p0", pa);
+        nvs_set_u32(nvs, "qnh_k", k);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    sample_get_derived(&d);
+    ESP_LOGI(TAG, "sea-level reference %lu Pa, altitude %ld dm",
+             (unsigned long)pa, (long)d.altitude_dm);
+}
+
+/* ---- Sampling profile --------------------------------------------------- */
+
+static const uint32_t sample_period_ms[SAMPLE_PROFILE_COUNT] = {
+    [SAMPLE_PROFILE_NORMAL] = 120000,
+    [SAMPLE_PROFILE_FAST] = 30000,
+    [SAMPLE_PROFILE_SLOW] = 600000,
+};
+
+static volatile uint8_t sample_profile = SAMPLE_PROFILE_NORMAL;
+static TaskHandle_t sensor_task_handle;
+
+void sensor_task_set_profile(uint8_t profile)
+{
+    if (profile >= SAMPLE_PROFILE_COUNT || profile == sample_profile) {
+        return;
+    }
+    sample_profile = profile;
+    ESP_LOGI(TAG, "sampling every %lu s",
+             (unsigned long)(sample_period_ms[profile] / 1000));
+    sensor_task_wake();
+}
+
+uint8_t sensor_task_get_profile(void)
+{
+    return sample_profile;
+}
+
+void sensor_task_wake(void)
+{
+    if (sensor_task_handle) {
+        xTaskNotifyGive(sensor_task_handle);
+    }
+}
+
+/* Wait until a period has passed since last; a profile change or a new
+ * rule table wakes the task, and the wait goes on with the new period. */
+static void sample_wait(TickType_t last)
+{
+    for (;;) {
+        TickType_t period = pdMS_TO_TICKS(sample_period_ms[sample_profile]);
+        TickType_t elapsed = xTaskGetTickCount() - last;
+        if (elapsed >= period) {
+            return;
+        }
+        ulTaskNotifyTake(pdTRUE, period - elapsed);
+        alarm_poll();
+    }
+}
+
 /* ---- Sensor reading task ------------------------------------------------ */
 
 static void sensor_task(void *param)
 {
     while (1) {
+        TickType_t start = xTaskGetTickCount();
         /* Read sensor data and update GATT service variables */
-        float temperature, pressure, humidity;
+        float temperature = 0, pressure = 0, humidity = 0;
         bmx280_t *bmx = bmx280_sensor_get_handle();
         if (!bmx) { vTaskDelay(pdMS_TO_TICKS(1000)); continue; }
 
@@ -32,6 +130,20 @@ static void sensor_task(void *param)
         } while (bmx280_isSampling(bmx));
 
         esp_err_t err = bmx280_readoutFloat(bmx, &temperature, &pressure, &humidity);
+        record_bme280(err == ESP_OK);
+        struct sample smp = {
+            .ok = err == ESP_OK,
+            .temperature = temperature,
+            .pressure = pressure,
+            .humidity = humidity,
+            .battery_mv = battery_get_voltage_mv(),
+            .uptime_s = (uint32_t)(esp_timer_get_time() / 1000000),
+            .time = (uint32_t)time(NULL),
+        };
+        struct sample_result res;
+        alarm_poll();
+        sample_process(&smp, &res);
+
         if (err == ESP_OK) {
             gatt_svc_temperature = temperature;
             gatt_svc_pressure = pressure;
@@ -39,24 +151,38 @@ static void sensor_task(void *param)
             ESP_LOGD(TAG, "Temperature: %.2f °C, Pressure: %.2f hPa, Humidity: %.2f %%", temperature, pressure / 100.0, humidity);
             
             sensors_valid = true; // Mark sensor readings as valid
+            powerstat_count(POWERSTAT_SAMPLE);
         } else {
             ESP_LOGE(TAG, "Failed to read from bmx280: %s", esp_err_to_name(err));
         }
+        gatt_svc_battery_mv = smp.battery_mv;
+        alarm_apply(&res);
+        gatt_svc_notify_readings();
+        ble_conn_notify(gatt_svc_val_handle(GATT_CHR_DERIVED), &res.derived,
+                        sizeof(res.derived));
+        adv_update();
         
-        gatt_svc_battery_mv = battery_get_voltage_mv(); // Update battery 
-                                                        // voltage reading
-        
-        vTaskDelay(pdMS_TO_TICKS(120000));
+        sample_wait(start);
     }
 }
 
 /* ---- Initialization ----------------------------------------------------- */
 
+/* Static so the stack is accounted for at link time; size it from the
+ * high-water mark the `mem` command reports (see Kconfig). */
+static StackType_t sensor_task_stack[CONFIG_APP_SENSOR_TASK_STACK];
+static StaticTask_t sensor_task_tcb;
+
 esp_err_t sensor_task_init(void)
 {
     bmx280_sensor_init(); // Initialize the sensor (e.g., I2C setup, sensor config)
+    derived_load();
+    record_init();
     // battery_init() called earlier in app_main before display_init
     
-    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, NULL);
+    sensor_task_handle = xTaskCreateStatic(sensor_task, "sensor_task",
+                                           CONFIG_APP_SENSOR_TASK_STACK, NULL,
+                                           5, sensor_task_stack,
+                                           &sensor_task_tcb);
     return ESP_OK;
 }
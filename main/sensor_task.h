@@ -1,6 +1,8 @@
 #ifndef SENSOR_TASK_H
 #define SENSOR_TASK_H
 
+#include <stdint.h>
+
 #include "esp_err.h"
 
 extern int32_t gatt_svc_battery_mv; // Battery voltage in millivolts   
@@ -8,4 +10,26 @@ extern int32_t gatt_svc_battery_mv; // Battery voltage in millivolts
 esp_err_t sensor_task_init(void);
 extern bool sensors_valid; // Flag indicating if sensor readings are valid
 
+/* Sampling profiles: how often the sensor task takes a sample. */
+enum {
+    SAMPLE_PROFILE_NORMAL = 0,  /* 2 min */
+    SAMPLE_PROFILE_FAST,        /* 30 s */
+    SAMPLE_PROFILE_SLOW,        /* 10 min */
+    SAMPLE_PROFILE_COUNT,
+};
+
+/** Select a sampling profile.  The next sample is due one new interval
+ *  after the last one, or at once if that has already passed. */
+void sensor_task_set_profile(uint8_t profile);
+
+uint8_t sensor_task_get_profile(void);
+
+/** Wake the sensor task to pick up work handed to it (alarm_poll()).  The
+ *  next sample stays due when it was. */
+void sensor_task_wake(void);
+
+/** Set and persist the sea-level pressure (Pa) used for altitude and the
+ *  forecast. */
+void sensor_task_set_sea_level(uint32_t pa);
+
 #endif /* SENSOR_TASK_H */
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "settings.h"
+
+#include <stdbool.h>
+
+#include "render.h"
+
+const struct ctrl_param settings_params[] = {
+    { CTRL_T_TIME,           8, true,  0,     UINT32_MAX },
+    { CTRL_T_TZ,             1, true,  SETTINGS_TZ_MIN, SETTINGS_TZ_MAX },
+    { CTRL_T_DISPLAY_MODE,   1, false, 0,     DISPLAY_MODE_BLANK },
+    { CTRL_T_SAMPLE_PROFILE, 1, false, 0,     SETTINGS_PROFILES - 1 },
+    { CTRL_T_ADV_PROFILE,    1, false, 0,     SETTINGS_PROFILES - 1 },
+    { CTRL_T_SEA_LEVEL,      4, false, SETTINGS_SEA_LEVEL_MIN,
+                                       SETTINGS_SEA_LEVEL_MAX },
+};
+
+const size_t settings_param_count =
+    sizeof(settings_params) / sizeof(settings_params[0]);
+
+/* Time and timezone move the local clock the schedule runs on */
+static bool moves_clock(uint8_t type)
+{
+    return type == CTRL_T_TIME || type == CTRL_T_TZ;
+}
+
+static void apply(const struct settings_ops *ops, const struct ctrl_item *it)
+{
+    switch (it->type) {
+    case CTRL_T_TIME:
+        if (ops->time) {
+            ops->time(it->value);
+        }
+        break;
+    case CTRL_T_TZ:
+        if (ops->tz) {
+            ops->tz((int8_t)it->value);
+        }
+        break;
+    case CTRL_T_DISPLAY_MODE:
+        if (ops->display_mode) {
+            ops->display_mode((uint8_t)it->value);
+        }
+        break;
+    case CTRL_T_SAMPLE_PROFILE:
+        if (ops->sample_profile) {
+            ops->sample_profile((uint8_t)it->value);
+        }
+        break;
+    case CTRL_T_ADV_PROFILE:
+        if (ops->adv_profile) {
+            ops->adv_profile((uint8_t)it->value);
+        }
+        break;
+    case CTRL_T_SEA_LEVEL:
+        if (ops->sea_level) {
+            ops->sea_level((uint32_t)it->value);
+        }
+        break;
+    }
+}
+
+uint8_t settings_write(const struct settings_ops *ops, uint8_t type,
+                       const void *val, size_t len)
+{
+    struct ctrl_item it = { .type = type };
+
+    it.status = ctrl_check(settings_params, settings_param_count, type, val,
+                           len, &it.value);
+    if (it.status == CTRL_ST_OK) {
+        apply(ops, &it);
+        if (moves_clock(type) && ops->schedule) {
+            ops->schedule();
+        }
+    }
+    return it.status;
+}
+
+uint8_t settings_control(const struct settings_ops *ops, const uint8_t *req,
+                         size_t len, struct ctrl_batch *b)
+{
+    bool clock = false;
+
+    /* Every item has been range-checked, and none of the setters can
+     * fail, so the batch is applied whole or (on any error) not at all.
+     * The schedule is evaluated once, on the new clock, and the explicit
+     * settings of the batch go on top of whatever entry it applied. */
+    if (ctrl_parse(req, len, settings_params, settings_param_count,
+                   b) != CTRL_RES_OK || b->op != CTRL_OP_APPLY) {
+        return b->result;
+    }
+    for (int i = 0; i < b->count; i++) {
+        if (moves_clock(b->item[i].type)) {
+            apply(ops, &b->item[i]);
+            clock = true;
+        }
+    }
+    if (clock && ops->schedule) {
+        ops->schedule();
+    }
+    for (int i = 0; i < b->count; i++) {
+        if (!moves_clock(b->item[i].type)) {
+            apply(ops, &b->item[i]);
+        }
+    }
+    return b->result;
+}
@@ -0,0 +1,62 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctrl.h"
+
+/*
+ * The settings a central writes, one per characteristic (Time, Timezone,
+ * Display mode, Sea level) or several at once through the control point:
+ * the range each accepts and the order a write applies them in.
+ * gatt_svc.c hands every such write to settings_write() or
+ * settings_control() with setters that act on the device; host/replay
+ * (see host/CMakeLists.txt) passes its own, so a replayed write is
+ * accepted or refused exactly as the device did.
+ */
+
+#define SETTINGS_TZ_MIN         (-48)   /* quarter-hours: UTC-12 */
+#define SETTINGS_TZ_MAX         56      /* UTC+14 */
+#define SETTINGS_SEA_LEVEL_MIN  80000   /* Pa */
+#define SETTINGS_SEA_LEVEL_MAX  110000
+#define SETTINGS_PROFILES       3       /* SAMPLE_PROFILE_COUNT and
+                                         * ADV_PROFILE_COUNT */
+
+/** What the settings become; each is called with a value already checked.
+ *  A NULL setter leaves that setting as it is (the write still succeeds).
+ *  schedule is called once after the clock or the timezone has changed, to
+ *  apply the schedule entry now in force before any other setting of the
+ *  same write, which therefore wins over it. */
+struct settings_ops {
+    void (*time)(int64_t unix_s);
+    void (*tz)(int8_t quarter_hours);
+    void (*display_mode)(uint8_t mode);
+    void (*sample_profile)(uint8_t profile);
+    void (*adv_profile)(uint8_t profile);
+    void (*sea_level)(uint32_t pa);
+    void (*schedule)(void);
+};
+
+/** Accepted values per CTRL_T_* type, for ctrl_parse() and ctrl_check(). */
+extern const struct ctrl_param settings_params[];
+extern const size_t settings_param_count;
+
+/**
+ * A value written to the characteristic of one setting (CTRL_T_*, in the
+ * control point's encoding): check it and, if it passes, apply it.
+ * Returns a CTRL_ST_* status.
+ */
+uint8_t settings_write(const struct settings_ops *ops, uint8_t type,
+                       const void *val, size_t len);
+
+/**
+ * A control point request: check every item and, for CTRL_OP_APPLY, apply
+ * the batch if they all pass: time and timezone first, then the schedule,
+ * then the rest.  b receives what the response needs (see
+ * ctrl_response()); returns b->result.
+ */
+uint8_t settings_control(const struct settings_ops *ops, const uint8_t *req,
+                         size_t len, struct ctrl_batch *b);
+
+#endif /* SETTINGS_H */
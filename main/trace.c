@@ -0,0 +1,50 @@
+#include "trace.h"
+
+#include <string.h>
+
+void trace_init(struct trace_buf *t, uint8_t *buf, size_t cap)
+{
+    t->buf = buf;
+    t->cap = cap;
+    t->len = 0;
+}
+
+bool trace_put(struct trace_buf *t, uint8_t type, uint32_t time_ms,
+               const void *data, size_t len)
+{
+    uint8_t *p;
+
+    if (len > TRACE_PAYLOAD_MAX || t->cap - t->len < TRACE_HDR_LEN + len) {
+        return false;
+    }
+    p = t->buf + t->len;
+    p[0] = type;
+    p[1] = (uint8_t)len;
+    p[2] = time_ms & 0xff;
+    p[3] = time_ms >> 8 & 0xff;
+    p[4] = time_ms >> 16 & 0xff;
+    p[5] = time_ms >> 24;
+    if (len) {
+        memcpy(p + TRACE_HDR_LEN, data, len);
+    }
+    t->len += TRACE_HDR_LEN + len;
+    return true;
+}
+
+bool trace_next(const uint8_t *buf, size_t len, size_t *off,
+                struct trace_rec *rec)
+{
+    const uint8_t *p = buf + *off;
+
+    if (len - *off < TRACE_HDR_LEN ||
+        len - *off < (size_t)TRACE_HDR_LEN + p[1]) {
+        return false;
+    }
+    rec->type = p[0];
+    rec->len = p[1];
+    rec->time_ms = (uint32_t)p[2] | (uint32_t)p[3] << 8 |
+                   (uint32_t)p[4] << 16 | (uint32_t)p[5] << 24;
+    rec->data = p + TRACE_HDR_LEN;
+    *off += TRACE_HDR_LEN + rec->len;
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Input traces: the values the firmware read from its sensors, the button
+ * and GATT clients, with the uptime they were read at, so a run can be
+ * replayed on the host (host/replay.c).  Records are appended to a flat
+ * buffer; when it is full recording stops rather than wrapping, since a
+ * replay needs an unbroken trace from its start record.
+ *
+ * Record layout (little-endian):
+ *
+ *   u8  type       TRACE_*
+ *   u8  len        payload bytes
+ *   u32 time_ms    esp_timer uptime
+ *   ... payload
+ *
+ * Payloads:
+ *
+ *   START    struct trace_start, the state a replay starts from
+ *   CALIB    BME280 calibration registers (BME280_CALIB_LEN bytes)
+ *   BME280   BME280 data registers (BME280_DATA_LEN), empty if the
+ *            readout failed
+ *   BATTERY  u16 raw, u16 mV as returned by battery_get_voltage_mv();
+ *            follows the BME280 record of the same sample
+ *   BUTTON   u16 mV, written when button_poll() sees the button change
+ *   WRITE    u16 characteristic UUID (gatt_chr_table.h), then the value
+ *            as written, whether or not the hook accepted it
+ */
+
+#define TRACE_HDR_LEN       6
+#define TRACE_PAYLOAD_MAX   255
+
+enum trace_type {
+    TRACE_START = 1,
+    TRACE_CALIB,
+    TRACE_BME280,
+    TRACE_BATTERY,
+    TRACE_BUTTON,
+    TRACE_WRITE,
+    TRACE_TYPES,
+};
+
+struct __attribute__((packed)) trace_start {
+    uint32_t time;              /* UNIX seconds (uptime if the clock is unset) */
+    int8_t   tz_quarter_hours;
+    uint8_t  display_mode;
+    uint16_t reserved;
+    uint32_t sea_level_pa;
+    uint32_t qnh_scale_q16;     /* see derived_init() */
+};
+
+struct trace_buf {
+    uint8_t *buf;
+    size_t   cap;
+    size_t   len;
+};
+
+struct trace_rec {
+    uint8_t  type;
+    uint8_t  len;
+    uint32_t time_ms;
+    const uint8_t *data;
+};
+
+/** Use buf (cap bytes) for records, starting empty. */
+void trace_init(struct trace_buf *t, uint8_t *buf, size_t cap);
+
+/** Append one record; false if it doesn't fit or len > TRACE_PAYLOAD_MAX. */
+bool trace_put(struct trace_buf *t, uint8_t type, uint32_t time_ms,
+               const void *data, size_t len);
+
+/**
+ * Parse the record at *off in buf (len bytes) and advance *off past it.
+ * rec->data points into buf.  False at the end or on a truncated record.
+ */
+bool trace_next(const uint8_t *buf, size_t len, size_t *off,
+                struct trace_rec *rec);
+
+#endif /* TRACE_H */
@@ -0,0 +1,353 @@
+#include "tscodec.h"
+
+#include <string.h>
+
+/* ---- Little-endian helpers ---------------------------------------------- */
+
+static void put_u16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ---- CRC-32 ------------------------------------------------------------- */
+
+/* Reflected polynomial 0xEDB88320, a nibble at a time. */
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t tsc_crc32(uint32_t crc, const uint8_t *p, size_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+    }
+    return ~crc;
+}
+
+static uint32_t block_crc(const uint8_t *block, size_t payload_bytes)
+{
+    uint32_t crc = tsc_crc32(0, block, 4);
+    return tsc_crc32(crc, block + TSC_HDR_LEN, payload_bytes);
+}
+
+/* ---- Bit writer --------------------------------------------------------- */
+
+struct bitw {
+    uint8_t *p;             /* zeroed payload */
+    size_t bit;
+    size_t cap;             /* bits */
+    int overflow;
+};
+
+static void put_bits(struct bitw *w, uint32_t v, unsigned n)
+{
+    if (w->bit + n > w->cap) {
+        w->overflow = 1;
+        return;
+    }
+    while (n) {
+        unsigned free = 8 - (w->bit & 7);
+        unsigned take = n < free ? n : free;
+        uint32_t bits = (v >> (n - take)) & ((1u << take) - 1);
+
+        w->p[w->bit >> 3] |= bits << (free - take);
+        w->bit += take;
+        n -= take;
+    }
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void put_varint(struct bitw *w, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_bits(w, 0x80 | (v & 0x7f), 8);
+        v >>= 7;
+    }
+    put_bits(w, v, 8);
+}
+
+static void put_dod(struct bitw *w, int32_t dod)
+{
+    uint32_t z = zigzag(dod);
+
+    if (z == 0) {
+        put_bits(w, 0, 1);
+    } else if (z < (1u << 7)) {
+        put_bits(w, 0x2, 2);
+        put_bits(w, z, 7);
+    } else if (z < (1u << 9)) {
+        put_bits(w, 0x6, 3);
+        put_bits(w, z, 9);
+    } else if (z < (1u << 12)) {
+        put_bits(w, 0xe, 4);
+        put_bits(w, z, 12);
+    } else {
+        put_bits(w, 0xf, 4);
+        put_bits(w, z, 32);
+    }
+}
+
+static unsigned clz32(uint32_t v)
+{
+    return v ? __builtin_clz(v) : 32;
+}
+
+static unsigned ctz32(uint32_t v)
+{
+    return v ? __builtin_ctz(v) : 32;
+}
+
+/* ---- Encoder ------------------------------------------------------------ */
+
+void tsc_enc_init(struct tsc_encoder *e, const struct tsc_schema *schema,
+                  uint8_t *block, size_t block_size)
+{
+    memset(e, 0, sizeof(*e));
+    e->schema = schema;
+    e->block = block;
+    e->block_size = block_size;
+    memset(block, 0, block_size);
+}
+
+int tsc_enc_append(struct tsc_encoder *e, const uint32_t *values)
+{
+    const struct tsc_schema *s = e->schema;
+    struct bitw w = {
+        .p = e->block + TSC_HDR_LEN,
+        .bit = e->bit,
+        .cap = (e->block_size - TSC_HDR_LEN) * 8,
+    };
+    uint32_t delta[TSC_MAX_COLS];
+    uint8_t lead[TSC_MAX_COLS], trail[TSC_MAX_COLS];
+
+    if (e->count == UINT16_MAX) {
+        return -1;
+    }
+    memcpy(delta, e->delta, sizeof(delta));
+    memcpy(lead, e->lead, sizeof(lead));
+    memcpy(trail, e->trail, sizeof(trail));
+
+    for (int c = 0; c < s->n_cols; c++) {
+        uint32_t v = values[c];
+
+        if (e->count == 0) {
+            put_bits(&w, v, 32);
+            continue;
+        }
+        switch (s->kind[c]) {
+        case TSC_TIME: {
+            uint32_t d = v - e->prev[c];
+            put_dod(&w, (int32_t)(d - delta[c]));
+            delta[c] = d;
+            break;
+        }
+        case TSC_INT:
+            put_varint(&w, zigzag((int32_t)(v - e->prev[c])));
+            break;
+        case TSC_F32: {
+            uint32_t x = v ^ e->prev[c];
+            if (x == 0) {
+                put_bits(&w, 0, 1);
+                break;
+            }
+            unsigned l = clz32(x), t = ctz32(x), len = 32 - l - t;
+            /* Reuse the window when it fits and is not dearer than
+             * opening a new one (which costs 10 bits of header). */
+            if (l >= lead[c] && t >= trail[c] &&
+                32u - lead[c] - trail[c] <= len + 10) {
+                put_bits(&w, 0x2, 2);
+                put_bits(&w, x >> trail[c], 32 - lead[c] - trail[c]);
+            } else {
+                put_bits(&w, 0x3, 2);
+                put_bits(&w, l, 5);
+                put_bits(&w, len - 1, 5);
+                put_bits(&w, x >> t, len);
+                lead[c] = l;
+                trail[c] = t;
+            }
+            break;
+        }
+        }
+    }
+
+    if (w.overflow) {
+        /* Undo the partial sample: clear every bit written past e->bit. */
+        size_t first = e->bit >> 3;
+        if (e->bit & 7) {
+            w.p[first] &= 0xff00 >> (e->bit & 7);
+            first++;
+        }
+        if (w.bit > e->bit) {
+            memset(w.p + first, 0, ((w.bit + 7) >> 3) - first);
+        }
+        return -1;
+    }
+
+    e->bit = w.bit;
+    memcpy(e->prev, values, s->n_cols * sizeof(uint32_t));
+    memcpy(e->delta, delta, sizeof(delta));
+    memcpy(e->lead, lead, sizeof(lead));
+    memcpy(e->trail, trail, sizeof(trail));
+    e->count++;
+    return 0;
+}
+
+size_t tsc_enc_finish(struct tsc_encoder *e)
+{
+    size_t bytes = (e->bit + 7) >> 3;
+
+    put_u16(e->block, e->count);
+    put_u16(e->block + 2, bytes);
+    put_u32(e->block + 4, block_crc(e->block, bytes));
+    return bytes;
+}
+
+/* ---- Decoder ------------------------------------------------------------ */
+
+struct bitr {
+    const uint8_t *p;
+    size_t bit;
+    size_t end;             /* bits */
+    int error;
+};
+
+static uint32_t get_bits(struct bitr *r, unsigned n)
+{
+    uint32_t v = 0;
+
+    if (r->bit + n > r->end) {
+        r->error = 1;
+        return 0;
+    }
+    while (n) {
+        unsigned avail = 8 - (r->bit & 7);
+        unsigned take = n < avail ? n : avail;
+        uint32_t byte = r->p[r->bit >> 3];
+
+        v = (v << take) | ((byte >> (avail - take)) & ((1u << take) - 1));
+        r->bit += take;
+        n -= take;
+    }
+    return v;
+}
+
+static uint32_t get_varint(struct bitr *r)
+{
+    uint32_t v = 0;
+
+    for (unsigned shift = 0; shift < 35 && !r->error; shift += 7) {
+        uint32_t b = get_bits(r, 8);
+        v |= (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->error = 1;
+    return 0;
+}
+
+static int32_t get_dod(struct bitr *r)
+{
+    static const uint8_t width[4] = { 7, 9, 12, 32 };
+    unsigned ones = 0;
+
+    if (get_bits(r, 1) == 0) {
+        return 0;
+    }
+    while (ones < 3 && get_bits(r, 1)) {
+        ones++;
+    }
+    return unzigzag(get_bits(r, width[ones]));
+}
+
+int tsc_dec_block(const struct tsc_schema *schema, const uint8_t *block,
+                  size_t block_size, uint32_t *out, size_t max_samples)
+{
+    size_t count = get_u16(block);
+    size_t bytes = get_u16(block + 2);
+    int n = schema->n_cols;
+    uint32_t delta[TSC_MAX_COLS] = { 0 };
+    uint8_t lead[TSC_MAX_COLS] = { 0 }, trail[TSC_MAX_COLS] = { 0 };
+
+    if (block_size < TSC_HDR_LEN || bytes > block_size - TSC_HDR_LEN ||
+        count > max_samples ||
+        get_u32(block + 4) != block_crc(block, bytes)) {
+        return -1;
+    }
+
+    struct bitr r = { .p = block + TSC_HDR_LEN, .end = bytes * 8 };
+
+    for (size_t i = 0; i < count && !r.error; i++) {
+        uint32_t *v = out + i * n;
+        const uint32_t *prev = v - n;
+
+        for (int c = 0; c < n; c++) {
+            if (i == 0) {
+                v[c] = get_bits(&r, 32);
+                continue;
+            }
+            switch (schema->kind[c]) {
+            case TSC_TIME:
+                delta[c] += (uint32_t)get_dod(&r);
+                v[c] = prev[c] + delta[c];
+                break;
+            case TSC_INT:
+                v[c] = prev[c] + (uint32_t)unzigzag(get_varint(&r));
+                break;
+            case TSC_F32:
+                if (get_bits(&r, 1) == 0) {
+                    v[c] = prev[c];
+                } else if (get_bits(&r, 1) == 0) {
+                    v[c] = prev[c] ^ (get_bits(&r, 32 - lead[c] - trail[c])
+                                      << trail[c]);
+                } else {
+                    lead[c] = get_bits(&r, 5);
+                    unsigned len = get_bits(&r, 5) + 1;
+                    if (lead[c] + len > 32) {
+                        return -1;
+                    }
+                    trail[c] = 32 - lead[c] - len;
+                    v[c] = prev[c] ^ (get_bits(&r, len) << trail[c]);
+                }
+                break;
+            default:
+                return -1;
+            }
+        }
+    }
+    return r.error ? -1 : (int)count;
+}
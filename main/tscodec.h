@@ -0,0 +1,86 @@
+#ifndef TSCODEC_H
+#define TSCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Time-series compression for sensor samples.  Portable C with no ESP-IDF
+ * dependencies; builds on the host too (host/tsc_bench.c), and
+ * tools/tscodec.py decodes the same format.
+ *
+ * A sample is up to TSC_MAX_COLS 32-bit values, each column coded by kind:
+ *
+ *   TSC_TIME   delta-of-delta, zig-zag, in prefix buckets:
+ *              0 -> '0'; <128 -> '10'+7 bits; <512 -> '110'+9;
+ *              <4096 -> '1110'+12; else '1111'+32
+ *   TSC_INT    zig-zag delta as a varint: 7-bit groups, high bit = more
+ *   TSC_F32    Gorilla XOR with the previous value (IEEE-754 bits):
+ *              '0' same; '10'+bits inside the previous window;
+ *              '11'+lead:5+(len-1):5+len bits for a new window
+ *
+ * The first sample of a block is stored as raw 32-bit values, so every
+ * block decodes on its own.  Blocks have a fixed size, and block i of a
+ * stream starts at i * block_size, which gives random access by index.
+ * All bit fields are MSB first.
+ *
+ * Block layout:
+ *   u16 count      samples in the block
+ *   u16 bytes      payload bytes used
+ *   u32 crc        CRC-32 (IEEE, as zlib) of count, bytes and the payload
+ *   payload        bit stream, zero padded to block_size
+ */
+
+#define TSC_MAX_COLS    8
+#define TSC_HDR_LEN     8
+
+enum tsc_kind {
+    TSC_TIME = 0,
+    TSC_INT,
+    TSC_F32,
+};
+
+struct tsc_schema {
+    uint8_t n_cols;
+    uint8_t kind[TSC_MAX_COLS];
+};
+
+struct tsc_encoder {
+    const struct tsc_schema *schema;
+    uint8_t *block;
+    size_t block_size;
+    size_t bit;                         /* next payload bit */
+    uint16_t count;
+    uint32_t prev[TSC_MAX_COLS];
+    uint32_t delta[TSC_MAX_COLS];       /* TSC_TIME: previous delta */
+    uint8_t lead[TSC_MAX_COLS];         /* TSC_F32: previous window */
+    uint8_t trail[TSC_MAX_COLS];
+};
+
+/** Start an empty block in block[block_size] (at least 64 bytes). */
+void tsc_enc_init(struct tsc_encoder *e, const struct tsc_schema *schema,
+                  uint8_t *block, size_t block_size);
+
+/**
+ * Append one sample.  Returns 0 on success, or -1 if the block is full: the
+ * sample was not added, so finish the block, start the next one and append
+ * the sample again.
+ */
+int tsc_enc_append(struct tsc_encoder *e, const uint32_t *values);
+
+/** Write the header and checksum and zero the unused tail.  The whole
+ *  block_size bytes are the block; returns the payload bytes used. */
+size_t tsc_enc_finish(struct tsc_encoder *e);
+
+/**
+ * Decode one block into out[count][n_cols].  Returns the sample count, or
+ * -1 if the checksum or the structure is wrong, or more than max_samples
+ * samples would be written.
+ */
+int tsc_dec_block(const struct tsc_schema *schema, const uint8_t *block,
+                  size_t block_size, uint32_t *out, size_t max_samples);
+
+/** CRC-32 as computed by zlib, chained through crc (start with 0). */
+uint32_t tsc_crc32(uint32_t crc, const uint8_t *p, size_t len);
+
+#endif /* TSCODEC_H */
@@ -6,12 +6,23 @@ Usage:
     python battery_life.py -i 300           # log every 5 minutes
     python battery_life.py -o my_test.csv   # custom output file
     python battery_life.py --cutoff 3000    # stop at 3000 mV
+    python battery_life.py --persistent     # stay connected, log notifications
+
+Persistent mode scans once, caches the device address and characteristic
+handles (--cache), then keeps a single connection open and logs every
+sample the device notifies.  After a disconnect it reconnects to the cached
+address with exponential backoff, without scanning or restarting BlueZ.
+Reconnects are logged to <output>.events.csv with the reconnect latency and
+the gap between the last sample before and the first sample after.
+Delete the cache file if the board is replaced.
 """
 
 import argparse
 import asyncio
 import csv
+import json
 import os
+import random
 import subprocess
 import sys
 import time
@@ -23,17 +34,21 @@ except ImportError:
     print("Install bleak: pip install bleak")
     sys.exit(1)
 
-import struct
+import gatt_chrs as chrs
+from c3ble import codec
+from c3ble.codec import DEVICE_NAME
 
-DEVICE_NAME = "ESP32-C3-BLE"
-BATT_UUID = "deadbeef-1007-2000-3000-aabbccddeeff"
-TEMP_UUID = "deadbeef-1003-2000-3000-aabbccddeeff"
-PRESS_UUID = "deadbeef-1002-2000-3000-aabbccddeeff"
-HUM_UUID = "deadbeef-1004-2000-3000-aabbccddeeff"
+BATT_UUID = chrs.BATTERY.uuid
+TEMP_UUID = chrs.TEMPERATURE.uuid
+PRESS_UUID = chrs.PRESSURE.uuid
+HUM_UUID = chrs.HUMIDITY.uuid
 
 BT_SCAN_TIMEOUT = 30
 BT_CONNECT_TIMEOUT = 30
 
+BACKOFF_MIN = 1         # seconds before the first reconnect attempt
+BACKOFF_MAX = 120       # cap for the exponential backoff
+
 
 def ts_now():
     return datetime.now().strftime("%Y-%m-%d %H:%M:%S")
@@ -60,20 +75,243 @@ async def read_sensors():
     if not device:
         return None
     async with BleakClient(device, timeout=BT_CONNECT_TIMEOUT) as client:
-        data = await client.read_gatt_char(BATT_UUID)
-        mv = struct.unpack("<I", data)[0] * 2  # voltage divider
+        mv, temp, press, hum = [
+            codec.decode(c, await client.read_gatt_char(c.uuid))
+            for c in (chrs.BATTERY, chrs.TEMPERATURE, chrs.PRESSURE,
+                      chrs.HUMIDITY)]
+
+        return mv, temp, press, hum
 
-        data = await client.read_gatt_char(TEMP_UUID)
-        temp = struct.unpack("<f", data)[0]
 
-        data = await client.read_gatt_char(PRESS_UUID)
-        press = struct.unpack("<f", data)[0] / 100.0  # Pa to hPa
+class CsvLog:
+    """Sample CSV shared by both modes."""
 
-        data = await client.read_gatt_char(HUM_UUID)
-        hum = struct.unpack("<f", data)[0]
+    def __init__(self, path):
+        file_exists = os.path.exists(path)
+        self.f = open(path, "a", newline="")
+        self.writer = csv.writer(self.f)
+        if not file_exists:
+            self.writer.writerow(["timestamp", "elapsed_min", "mv", "volts",
+                                  "temp_c", "press_hpa", "humidity"])
+            self.f.flush()
+        self.start = time.time()
+        self.reading = 0
 
-        return mv, temp, press, hum
+    def write(self, mv, temp, press, hum):
+        self.reading += 1
+        elapsed = (time.time() - self.start) / 60.0
+        volts = mv / 1000.0
+        ts = ts_now()
+
+        self.writer.writerow([ts, f"{elapsed:.1f}", mv, f"{volts:.3f}",
+                              f"{temp:.2f}", f"{press:.2f}", f"{hum:.1f}"])
+        self.f.flush()
+
+        print(f"[{ts}] #{self.reading}  {elapsed:6.1f} min  "
+              f"{mv} mV  {volts:.3f} V  "
+              f"{temp:.1f}°C  {press:.1f} hPa  {hum:.0f}%")
+
+    def close(self):
+        self.f.close()
+
+
+# ---- Persistent connection mode ----------------------------------------------
+
+def load_cache(path):
+    try:
+        with open(path) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+def save_cache(path, cache):
+    tmp = path + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump(cache, f, indent=2)
+    os.replace(tmp, path)
+
+
+def cache_handles(client):
+    """Map characteristic UUID to value handle for the ones we use."""
+    handles = {}
+    for uuid in (BATT_UUID, TEMP_UUID, PRESS_UUID, HUM_UUID):
+        char = client.services.get_characteristic(uuid)
+        if char is None:
+            raise RuntimeError(f"characteristic {uuid} not found")
+        handles[uuid] = char.handle
+    return handles
+
+
+def handles_valid(client, handles):
+    """True if every cached handle still points at the same characteristic
+    (a firmware update may move them)."""
+    for uuid, handle in handles.items():
+        char = client.services.get_characteristic(handle)
+        if char is None or char.uuid.lower() != uuid:
+            return False
+    return True
+
+
+class PersistentLogger:
+    def __init__(self, args, log):
+        self.args = args
+        self.log = log
+        self.values = {}
+        self.disconnected = asyncio.Event()
+        self.stop = asyncio.Event()
+        self.last_sample = None     # wall clock of the last logged sample
+        self.events = None
+
+    def open_events(self):
+        path = os.path.splitext(self.args.output)[0] + ".events.csv"
+        exists = os.path.exists(path)
+        self.events = open(path, "a", newline="")
+        self.events_writer = csv.writer(self.events)
+        if not exists:
+            self.events_writer.writerow(["timestamp", "event", "attempts",
+                                         "reconnect_s", "gap_s"])
+        self.events_path = path
 
+    def event(self, name, attempts="", reconnect_s="", gap_s=""):
+        self.events_writer.writerow([ts_now(), name, attempts,
+                                     reconnect_s, gap_s])
+        self.events.flush()
+
+    def on_notify(self, uuid, data):
+        self.values[uuid] = data
+        # Battery is the last of these four notified in each sample
+        # (gatt_chr_table.h order).
+        if uuid == BATT_UUID and len(self.values) == 4:
+            self.emit()
+
+    def emit(self):
+        mv = codec.decode(chrs.BATTERY, self.values[BATT_UUID])
+        temp = codec.decode(chrs.TEMPERATURE, self.values[TEMP_UUID])
+        press = codec.decode(chrs.PRESSURE, self.values[PRESS_UUID])
+        hum = codec.decode(chrs.HUMIDITY, self.values[HUM_UUID])
+        self.log.write(mv, temp, press, hum)
+        self.last_sample = time.time()
+        if self.args.cutoff and mv < self.args.cutoff:
+            print(f"Voltage {mv} mV below cutoff {self.args.cutoff} mV "
+                  "— stopping.")
+            self.stop.set()
+
+    async def discover(self):
+        """Scan once by name and build the cache."""
+        print(f"[{ts_now()}] Scanning for {DEVICE_NAME}...")
+        device = await BleakScanner.find_device_by_name(
+            DEVICE_NAME, timeout=BT_SCAN_TIMEOUT)
+        if not device:
+            return None
+        async with BleakClient(device, timeout=BT_CONNECT_TIMEOUT) as client:
+            cache = {"address": device.address,
+                     "handles": cache_handles(client)}
+        save_cache(self.args.cache, cache)
+        print(f"[{ts_now()}] Cached {device.address} in {self.args.cache}")
+        return cache
+
+    async def session(self, cache):
+        """Connect to the cached address, check the cached handles and
+        subscribe.  Returns the connected client."""
+        self.disconnected.clear()
+        client = BleakClient(cache["address"], timeout=BT_CONNECT_TIMEOUT,
+                             disconnected_callback=lambda c:
+                             self.disconnected.set())
+        await client.connect()
+        try:
+            handles = cache["handles"]
+            if not handles_valid(client, handles):
+                handles = cache["handles"] = cache_handles(client)
+                save_cache(self.args.cache, cache)
+                print(f"[{ts_now()}] GATT handles changed, cache updated")
+
+            # Read once so the first row does not wait a full sample period.
+            self.values = {}
+            for uuid in (TEMP_UUID, PRESS_UUID, HUM_UUID, BATT_UUID):
+                self.values[uuid] = await client.read_gatt_char(handles[uuid])
+            for uuid in (TEMP_UUID, PRESS_UUID, HUM_UUID, BATT_UUID):
+                await client.start_notify(
+                    handles[uuid],
+                    lambda _, data, uuid=uuid: self.on_notify(uuid, data))
+            return client
+        except Exception:
+            await client.disconnect()
+            raise
+
+    async def run(self):
+        self.open_events()
+        cache = load_cache(self.args.cache)
+        if cache is None:
+            cache = await self.discover()
+            if cache is None:
+                print(f"[{ts_now()}] {DEVICE_NAME} not found")
+                return
+
+        backoff = BACKOFF_MIN
+        attempts = 0
+        lost_at = None          # monotonic time of the disconnect
+        gap_from = None         # last sample before the disconnect
+        reconnects = []
+
+        while not self.stop.is_set():
+            attempts += 1
+            try:
+                client = await self.session(cache)
+            except Exception as e:
+                delay = backoff * random.uniform(0.8, 1.2)
+                print(f"[{ts_now()}] Connect failed ({attempts}): {e}; "
+                      f"retry in {delay:.1f}s")
+                backoff = min(backoff * 2, BACKOFF_MAX)
+                if lost_at is None:
+                    lost_at = time.monotonic()
+                try:
+                    await asyncio.wait_for(self.stop.wait(), delay)
+                except asyncio.TimeoutError:
+                    pass
+                continue
+
+            if lost_at is None:
+                print(f"[{ts_now()}] Connected to {cache['address']}, "
+                      "logging notifications")
+                self.event("connect", attempts)
+            else:
+                latency = time.monotonic() - lost_at
+                gap = time.time() - gap_from if gap_from else ""
+                reconnects.append(latency)
+                print(f"[{ts_now()}] Reconnected after {latency:.1f}s "
+                      f"({attempts} attempts)")
+                self.event("reconnect", attempts, f"{latency:.2f}",
+                           f"{gap:.1f}" if gap != "" else "")
+            self.emit()
+            backoff = BACKOFF_MIN
+            attempts = 0
+
+            stop = asyncio.ensure_future(self.stop.wait())
+            lost = asyncio.ensure_future(self.disconnected.wait())
+            await asyncio.wait({stop, lost},
+                               return_when=asyncio.FIRST_COMPLETED)
+            stop.cancel()
+            lost.cancel()
+            if self.stop.is_set():
+                await client.disconnect()
+                break
+
+            lost_at = time.monotonic()
+            gap_from = self.last_sample
+            print(f"[{ts_now()}] Disconnected, reconnecting...")
+            self.event("disconnect")
+
+        self.events.close()
+        if reconnects:
+            print(f"Reconnects: {len(reconnects)}, latency "
+                  f"min {min(reconnects):.1f}s "
+                  f"avg {sum(reconnects) / len(reconnects):.1f}s "
+                  f"max {max(reconnects):.1f}s "
+                  f"(events in {self.events_path})")
+
+
+# ---- Main --------------------------------------------------------------------
 
 def main():
     parser = argparse.ArgumentParser(description="Battery life logger")
@@ -83,22 +321,37 @@ def main():
                         help="output CSV file (default: battery_log.csv)")
     parser.add_argument("--cutoff", type=int, default=0,
                         help="stop when voltage drops below this mV (0 = never)")
+    parser.add_argument("--persistent", action="store_true",
+                        help="keep one connection and log notified samples "
+                             "(the device sets the sample rate; -i is ignored)")
+    parser.add_argument("--cache", default=os.path.expanduser(
+                            "~/.cache/esp32c3ble.json"),
+                        help="address/handle cache for --persistent "
+                             "(default: ~/.cache/esp32c3ble.json)")
     args = parser.parse_args()
 
-    file_exists = os.path.exists(args.output)
-    f = open(args.output, "a", newline="")
-    writer = csv.writer(f)
-    if not file_exists:
-        writer.writerow(["timestamp", "elapsed_min", "mv", "volts",
-                         "temp_c", "press_hpa", "humidity"])
-        f.flush()
+    log = CsvLog(args.output)
+
+    if args.persistent:
+        os.makedirs(os.path.dirname(os.path.abspath(args.cache)),
+                    exist_ok=True)
+        print(f"Logging to {args.output} over a persistent connection"
+              + (f", cutoff {args.cutoff} mV" if args.cutoff else ""))
+        try:
+            asyncio.run(PersistentLogger(args, log).run())
+        except KeyboardInterrupt:
+            print("\nStopped.")
+        finally:
+            log.close()
+            elapsed = (time.time() - log.start) / 60.0
+            print(f"Total: {log.reading} readings over {elapsed:.1f} minutes")
+            print(f"Log saved to {args.output}")
+        return
 
     if os.geteuid() != 0:
         print("Warning: not running as root — bluetooth auto-restart "
               "requires sudo")
 
-    start = time.time()
-    reading = 0
     consecutive_errors = 0
     last_bt_restart = 0
     print(f"Logging to {args.output} every {args.interval}s"
@@ -130,18 +383,7 @@ def main():
 
             mv, temp, press, hum = result
             consecutive_errors = 0
-            reading += 1
-            elapsed = (time.time() - start) / 60.0
-            volts = mv / 1000.0
-            ts = ts_now()
-
-            writer.writerow([ts, f"{elapsed:.1f}", mv, f"{volts:.3f}",
-                             f"{temp:.2f}", f"{press:.2f}", f"{hum:.1f}"])
-            f.flush()
-
-            print(f"[{ts}] #{reading}  {elapsed:6.1f} min  "
-                  f"{mv} mV  {volts:.3f} V  "
-                  f"{temp:.1f}°C  {press:.1f} hPa  {hum:.0f}%")
+            log.write(mv, temp, press, hum)
 
             if args.cutoff and mv < args.cutoff:
                 print(f"Voltage {mv} mV below cutoff {args.cutoff} mV — stopping.")
@@ -151,9 +393,9 @@ def main():
     except KeyboardInterrupt:
         print("\nStopped.")
     finally:
-        f.close()
-        elapsed = (time.time() - start) / 60.0
-        print(f"Total: {reading} readings over {elapsed:.1f} minutes")
+        log.close()
+        elapsed = (time.time() - log.start) / 60.0
+        print(f"Total: {log.reading} readings over {elapsed:.1f} minutes")
         print(f"Log saved to {args.output}")
 
 
@@ -0,0 +1,502 @@
+#!/usr/bin/env python3
+"""Predict battery life from a power model instead of a multi-week run.
+
+The model combines a per-state current profile (power_profile.json) with
+the firmware settings (advertising and sample intervals, display mode,
+contrast, light sleep, connections).  It steps through days of operation
+in 10-minute slots, with button presses spread over the waking hours, and
+drains a battery pack until the voltage under a radio peak falls below
+the cutoff.
+
+calibrate fits the profile's overall scale (and an ADC offset) to a
+battery_life.py discharge log.  It can also take the device's activity
+counters (ble_test.py --power) in place of the activity the settings
+imply.  sweep evaluates a grid of settings and marks the Pareto front of
+battery life against responsiveness.
+
+Usage:
+    python battery_sim.py simulate                      # defaults, 4xAA
+    python battery_sim.py simulate --pack 4xAA-nimh --set display_mode=blank
+    python battery_sim.py simulate --counters power.json
+    python battery_sim.py simulate --csv predicted.csv  # battery_log format
+    python battery_sim.py calibrate battery_log.csv \\
+        --set display_mode=normal --counters power.json --save cal.json
+    python battery_sim.py sweep --grid adv_interval_ms=500,1000,2000 \\
+        --grid sample_interval_s=30,120,600 --grid display_mode=normal,button
+    python battery_sim.py packs
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import math
+import os
+import sys
+from datetime import datetime, timedelta
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_PROFILE = os.path.join(HERE, "power_profile.json")
+
+STEP_S = 600                    # simulation slot
+SLOTS_PER_DAY = 86400 // STEP_S
+MAX_DAYS = 5 * 365
+
+
+# ---- Firmware settings ------------------------------------------------------
+
+# name: (default, type, better) where better says which way improves the
+# device for its user: "low", "high", an ordering best-first, or None.
+SETTINGS = {
+    "adv_interval_ms":   (2000, float, "low"),      # adv_itvls in adv.c
+    "sample_interval_s": (120, float, "low"),       # sensor_task.c
+    "display_mode":      ("button", str, ("normal", "button", "blank")),
+    "button_presses":    (10, float, None),         # per day
+    "display_timeout_s": (60, float, "high"),       # button mode, display.c
+    "refresh_s":         (2, float, "low"),         # display_task, panel on
+    "poll_s":            (5, float, None),          # display_task, panel off
+    "contrast":          (255, float, "high"),      # SSD1306 0x81
+    "lit_fraction":      (0.15, float, None),       # share of pixels lit
+    "light_sleep":       (1, int, None),
+    "conn_links":        (0.0, float, None),        # average open links
+    "conn_interval_ms":  (75, float, "low"),        # ble_conn.c request
+    "conn_latency":      (4, int, "low"),
+    "waking_hours":      ("7-23", str, None),       # when buttons get pressed
+}
+
+NOTIFIES_PER_SAMPLE = 5         # notifiable entries in gatt_chr_table.h
+
+
+def default_settings():
+    return {k: v[0] for k, v in SETTINGS.items()}
+
+
+def parse_assignment(text):
+    if "=" not in text:
+        raise argparse.ArgumentTypeError(f"expected NAME=VALUE: {text}")
+    name, value = text.split("=", 1)
+    if name not in SETTINGS:
+        raise argparse.ArgumentTypeError(
+            f"unknown setting {name}; one of {', '.join(SETTINGS)}")
+    return name, value
+
+
+def convert(name, value):
+    default, kind, better = SETTINGS[name]
+    if isinstance(better, tuple) and value not in better:
+        raise ValueError(f"{name} must be one of {', '.join(better)}")
+    return kind(value)
+
+
+def waking_hours(spec):
+    start, end = (int(x) for x in spec.split("-"))
+    return [h for h in range(24)
+            if (start <= h < end if start <= end else h >= start or h < end)]
+
+
+# ---- Battery packs ----------------------------------------------------------
+
+# Open-circuit cell voltage against depth of discharge, at light load.
+CURVES = {
+    "alkaline": [(0, 1.58), (0.05, 1.50), (0.2, 1.40), (0.4, 1.30),
+                 (0.6, 1.22), (0.8, 1.12), (0.9, 1.05), (0.95, 1.00),
+                 (1, 0.90)],
+    "nimh": [(0, 1.40), (0.05, 1.30), (0.2, 1.26), (0.5, 1.22),
+             (0.8, 1.18), (0.9, 1.12), (0.95, 1.05), (1, 0.95)],
+    "lithium-fes2": [(0, 1.75), (0.05, 1.60), (0.5, 1.50), (0.85, 1.40),
+                     (0.95, 1.25), (1, 1.00)],
+    "lipo": [(0, 4.20), (0.1, 4.00), (0.3, 3.85), (0.6, 3.75),
+             (0.85, 3.60), (0.95, 3.40), (1, 3.00)],
+}
+
+PACKS = {
+    # name: cells in series, chemistry, mAh, ohm per cell, self-discharge %/yr
+    "4xAA-alkaline": (4, "alkaline", 2500, 0.15, 3),
+    "4xAA-nimh":     (4, "nimh", 2000, 0.03, 15),
+    "4xAA-lithium":  (4, "lithium-fes2", 3000, 0.10, 1),
+    "3xAA-alkaline": (3, "alkaline", 2500, 0.15, 3),
+    "4xAAA-alkaline": (4, "alkaline", 1000, 0.25, 3),
+    "1S-lipo-2000":  (1, "lipo", 2000, 0.08, 30),
+}
+
+DEFAULT_CUTOFF_V = 3.5          # where the baseline run browned out
+
+
+def ocv(curve, dod):
+    if dod <= 0:
+        return curve[0][1]
+    for (d0, v0), (d1, v1) in zip(curve, curve[1:]):
+        if dod <= d1:
+            return v0 + (v1 - v0) * (dod - d0) / (d1 - d0)
+    return curve[-1][1]
+
+
+# ---- Power model ------------------------------------------------------------
+
+def load_profile(path):
+    with open(path) as f:
+        return {k: v for k, v in json.load(f).items() if not k.startswith("_")}
+
+
+def load_counters(path):
+    """Activity rates measured on the device (struct powerstat)."""
+    with open(path) as f:
+        c = json.load(f)
+    up = max(c["uptime_s"], 1)
+    return {
+        "display_frac": c["display_on_s"] / up,
+        "adv_frac": c["adv_s"] / up,
+        "conn_links": c["conn_s"] / up,
+        "samples_per_s": c["samples"] / up,
+        "flushes_per_s": c["flushes"] / up,
+        "notifies_per_s": c["notifies"] / up,
+    }
+
+
+def activity(s, counters=None):
+    """Activity rates per slot of the day: a list of SLOTS_PER_DAY dicts."""
+    if s["display_mode"] == "normal":
+        on = [1.0] * 24
+    elif s["display_mode"] == "blank":
+        on = [0.0] * 24
+    else:
+        hours = waking_hours(s["waking_hours"]) or list(range(24))
+        per_hour = s["button_presses"] / len(hours)
+        frac = min(1.0, per_hour * s["display_timeout_s"] / 3600)
+        on = [frac if h in hours else 0.0 for h in range(24)]
+
+    samples = 1 / s["sample_interval_s"]
+    slots = []
+    for slot in range(SLOTS_PER_DAY):
+        d = on[slot * STEP_S // 3600]
+        slots.append({
+            "display_frac": d,
+            "adv_frac": 1.0,
+            "conn_links": s["conn_links"],
+            "samples_per_s": samples,
+            "flushes_per_s": d / s["refresh_s"],
+            "notifies_per_s": samples * NOTIFIES_PER_SAMPLE * s["conn_links"],
+        })
+    if counters:
+        slots = [dict(counters) for _ in range(SLOTS_PER_DAY)]
+    return slots
+
+
+def breakdown(p, s, a):
+    """Average current per component in mA for one slot's activity."""
+    d = a["display_frac"]
+    conn_events = a["conn_links"] * 1000 / (
+        s["conn_interval_ms"] * (s["conn_latency"] + 1))
+    return {
+        "floor": (p["sleep_ma"] if s["light_sleep"] else p["active_ma"])
+        + p["quiescent_ma"],
+        "advertising": a["adv_frac"] * p["adv_event_uc"]
+        / s["adv_interval_ms"],
+        "connections": conn_events * p["conn_event_uc"] / 1000,
+        "sampling": a["samples_per_s"] * p["sample_uc"] / 1000,
+        "notifications": a["notifies_per_s"] * p["notify_uc"] / 1000,
+        "display panel": d * (p["oled_on_ma"] + p["oled_pixel_ma"]
+                              * s["lit_fraction"] * s["contrast"] / 255),
+        "display I2C": a["flushes_per_s"] * p["flush_uc"] / 1000,
+        "display polling": (1 - d) * p["wake_uc"] / (s["poll_s"] * 1000),
+    }
+
+
+def day_currents(p, s, counters=None):
+    return [p["scale"] * sum(breakdown(p, s, a).values())
+            for a in activity(s, counters)]
+
+
+def simulate(p, s, pack, cutoff, counters=None, max_days=MAX_DAYS,
+             start_dod=0.0, trace_every=None):
+    """Run until cutoff.  Returns (life_days, trace) where trace holds
+    (hours, logged_volts, dod) every trace_every slots."""
+    cells, chem, mah, r_cell, self_pct = PACKS[pack]
+    curve = CURVES[chem]
+    currents = day_currents(p, s, counters)
+    self_ma = mah * self_pct / 100 / 8760
+    # Logged voltage is read with the CPU awake; cutoff is checked at the
+    # radio's peak draw, where a weak pack browns out first.
+    log_drop = p["active_ma"] / 1000 * r_cell
+    peak_drop = p["peak_ma"] / 1000 * r_cell
+    dod = start_dod
+    trace = []
+
+    for n in range(max_days * SLOTS_PER_DAY):
+        i = currents[n % SLOTS_PER_DAY] + self_ma
+        v = ocv(curve, dod)
+        if trace_every and n % trace_every == 0:
+            trace.append((n * STEP_S / 3600, cells * (v - log_drop), dod))
+        if cells * (v - peak_drop - i / 1000 * r_cell) < cutoff or dod >= 1:
+            return n * STEP_S / 86400, trace
+        dod += i * STEP_S / 3600 / mah
+    return float("inf"), trace
+
+
+def average_ma(p, s, counters=None):
+    c = day_currents(p, s, counters)
+    return sum(c) / len(c)
+
+
+# ---- Commands ---------------------------------------------------------------
+
+def resolve(args):
+    s = default_settings()
+    for name, value in args.set or []:
+        s[name] = convert(name, value)
+    counters = load_counters(args.counters) if args.counters else None
+    cutoff = args.cutoff if args.cutoff is not None else DEFAULT_CUTOFF_V
+    return load_profile(args.profile), s, counters, cutoff
+
+
+def cmd_simulate(args):
+    p, s, counters, cutoff = resolve(args)
+    days, trace = simulate(p, s, args.pack, cutoff, counters,
+                           trace_every=SLOTS_PER_DAY)
+
+    acts = activity(s, counters)
+    parts = {}
+    for a in acts:
+        for k, v in breakdown(p, s, a).items():
+            parts[k] = parts.get(k, 0) + p["scale"] * v / len(acts)
+    total = sum(parts.values())
+    print(f"pack {args.pack}, cutoff {cutoff:.2f} V, scale {p['scale']:.3f}"
+          + (", activity from counters" if counters else ""))
+    for k, v in sorted(parts.items(), key=lambda kv: -kv[1]):
+        print(f"  {k:16} {v * 1000:9.1f} uA  {100 * v / total:5.1f} %")
+    print(f"  {'total':16} {total * 1000:9.1f} uA")
+    for day in (0, 7, 30, 90, 180, 365):
+        if day < len(trace):
+            print(f"  day {day:4}: {trace[day][1]:.3f} V, "
+                  f"{100 * trace[day][2]:.0f} % used")
+    life = "more than 5 years" if math.isinf(days) else f"{days:.1f} days"
+    print(f"battery life: {life}")
+
+    if args.csv:
+        write_csv(args.csv, p, s, args.pack, cutoff, counters)
+
+
+def write_csv(path, p, s, pack, cutoff, counters):
+    """Predicted run in battery_log.csv format (volts only)."""
+    _, trace = simulate(p, s, pack, cutoff, counters, trace_every=1)
+    t0 = datetime.now().replace(microsecond=0)
+    with open(path, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["timestamp", "elapsed_min", "mv", "volts", "temp_c",
+                    "press_hpa", "humidity"])
+        for hours, volts, _ in trace:
+            mv = round(volts * 1000)
+            w.writerow([(t0 + timedelta(hours=hours)).strftime(
+                "%Y-%m-%d %H:%M:%S"), f"{hours * 60:.1f}", mv,
+                f"{mv / 1000:.3f}", "", "", ""])
+    print(f"wrote {path}")
+
+
+def load_log(path):
+    """(hours since start, volts) from a battery_life.py CSV."""
+    rows = []
+    with open(path, newline="") as f:
+        for row in csv.DictReader(f):
+            try:
+                rows.append((float(row["elapsed_min"]) / 60,
+                             int(row["mv"]) / 1000))
+            except (KeyError, TypeError, ValueError):
+                continue
+    return rows
+
+
+def fit_error(p, s, pack, cutoff, counters, log, scale, offset_fit):
+    q = dict(p, scale=scale)
+    hours = log[-1][0]
+    _, trace = simulate(q, s, pack, 0.0, counters,
+                        max_days=int(hours / 24) + 2, trace_every=1)
+    # Interpolate the predicted trace at each logged time
+    step_h = STEP_S / 3600
+    resid = []
+    for h, v in log:
+        k = min(int(h / step_h), len(trace) - 2)
+        f = h / step_h - k
+        resid.append(trace[k][1] + (trace[k + 1][1] - trace[k][1]) * f - v)
+    offset = sum(resid) / len(resid) if offset_fit else 0.0
+    rms = math.sqrt(sum((r - offset) ** 2 for r in resid) / len(resid))
+    return rms, offset
+
+
+def cmd_calibrate(args):
+    p, s, counters, cutoff = resolve(args)
+    log = load_log(args.log)
+    if len(log) < 10:
+        print(f"{args.log}: too few samples", file=sys.stderr)
+        return 1
+
+    # Golden-section search over log(scale)
+    def err(x):
+        return fit_error(p, s, args.pack, cutoff, counters, log, math.exp(x),
+                         not args.no_offset)[0]
+
+    lo, hi = math.log(0.05), math.log(20)
+    g = (math.sqrt(5) - 1) / 2
+    a, b = hi - g * (hi - lo), lo + g * (hi - lo)
+    fa, fb = err(a), err(b)
+    for _ in range(40):
+        if fa < fb:
+            hi, b, fb = b, a, fa
+            a = hi - g * (hi - lo)
+            fa = err(a)
+        else:
+            lo, a, fa = a, b, fb
+            b = lo + g * (hi - lo)
+            fb = err(b)
+    scale = math.exp((lo + hi) / 2)
+    rms, offset = fit_error(p, s, args.pack, cutoff, counters, log, scale,
+                            not args.no_offset)
+
+    p["scale"] = scale
+    print(f"{args.log}: {len(log)} samples over {log[-1][0] / 24:.1f} days")
+    print(f"scale {scale:.3f}, ADC offset {offset * 1000:+.0f} mV, "
+          f"rms error {rms * 1000:.1f} mV")
+    print(f"average current {average_ma(p, s, counters) * 1000:.1f} uA")
+    days, _ = simulate(p, s, args.pack, cutoff, counters)
+    print(f"predicted life on {args.pack}: "
+          + ("more than 5 years" if math.isinf(days) else f"{days:.1f} days"))
+    if args.save:
+        with open(args.profile) as f:
+            out = json.load(f)
+        out["scale"] = round(scale, 4)
+        with open(args.save, "w") as f:
+            json.dump(out, f, indent=2)
+            f.write("\n")
+        print(f"wrote {args.save}")
+    return 0
+
+
+def dominates(a, b, dims, tol):
+    """a is at least as good as b everywhere and better somewhere.  Lives
+    within tol (a fraction) of each other count as equal."""
+    if a["days"] < b["days"] * (1 - tol):
+        return False
+    better = a["days"] > b["days"] * (1 + tol)
+    for name in dims:
+        rule = SETTINGS[name][2]
+        x, y = a["s"][name], b["s"][name]
+        if isinstance(rule, tuple):
+            x, y = -rule.index(x), -rule.index(y)
+        elif rule == "low":
+            x, y = -x, -y
+        if x < y:
+            return False
+        better |= x > y
+    return better
+
+
+def cmd_sweep(args):
+    p, base, counters, cutoff = resolve(args)
+    grid = {}
+    for name, values in args.grid:
+        grid[name] = [convert(name, v) for v in values.split(",")]
+    if not grid:
+        print("nothing to sweep; add --grid NAME=V1,V2,...", file=sys.stderr)
+        return 1
+
+    results = []
+    for combo in itertools.product(*grid.values()):
+        s = dict(base, **dict(zip(grid, combo)))
+        days, _ = simulate(p, s, args.pack, cutoff, counters)
+        results.append({"s": s, "days": days,
+                        "ua": average_ma(p, s, counters) * 1000})
+
+    # Settings without a direction are not traded off against life
+    dims = [n for n in grid if SETTINGS[n][2] is not None]
+    for r in results:
+        r["front"] = not any(dominates(o, r, dims, args.tolerance / 100)
+                             for o in results)
+
+    shown = [r for r in results if r["front"] or not args.front_only]
+    shown.sort(key=lambda r: -r["days"])
+    names = list(grid)
+    width = [max(len(n), 8) for n in names]
+    print("  ".join(f"{n:>{w}}" for n, w in zip(names, width))
+          + "   avg uA   life d  front")
+    for r in shown:
+        life = "   >5y" if math.isinf(r["days"]) else f"{r['days']:6.0f}"
+        print("  ".join(f"{r['s'][n]:>{w}g}" if isinstance(r['s'][n], float)
+                        else f"{r['s'][n]:>{w}}" for n, w in zip(names, width))
+              + f" {r['ua']:8.0f}   {life}  {'*' if r['front'] else ''}")
+    print(f"{sum(r['front'] for r in results)} of {len(results)} settings "
+          f"on the Pareto front ({args.pack}, cutoff {cutoff:.2f} V)")
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            w = csv.writer(f)
+            w.writerow(names + ["avg_ua", "life_days", "pareto"])
+            for r in results:
+                w.writerow([r["s"][n] for n in names]
+                           + [f"{r['ua']:.1f}", f"{r['days']:.1f}",
+                              int(r["front"])])
+        print(f"wrote {args.csv}")
+    return 0
+
+
+def cmd_packs(args):
+    for name, (cells, chem, mah, r, self_pct) in PACKS.items():
+        curve = CURVES[chem]
+        print(f"{name:15} {cells} x {chem:12} {mah:5} mAh  "
+              f"{cells * curve[0][1]:.2f}-{cells * curve[-1][1]:.2f} V  "
+              f"{cells * r * 1000:4.0f} mOhm  {self_pct}%/yr")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Battery-life simulator for the ESP32-C3 BLE sensor")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    def common(sp):
+        sp.add_argument("--profile", default=DEFAULT_PROFILE,
+                        help="current profile JSON (default: %(default)s)")
+        sp.add_argument("--pack", default="4xAA-alkaline", choices=PACKS)
+        sp.add_argument("--cutoff", type=float,
+                        help=f"pack voltage at brown-out "
+                             f"(default {DEFAULT_CUTOFF_V})")
+        sp.add_argument("--set", type=parse_assignment, action="append",
+                        metavar="NAME=VALUE",
+                        help="firmware setting: " + ", ".join(SETTINGS))
+        sp.add_argument("--counters", metavar="JSON",
+                        help="activity from ble_test.py --power output")
+
+    sp = sub.add_parser("simulate", help="predict life for one setting")
+    common(sp)
+    sp.add_argument("--csv", help="write the predicted discharge curve")
+    sp.set_defaults(func=cmd_simulate)
+
+    sp = sub.add_parser("calibrate", help="fit the profile to a log")
+    sp.add_argument("log", help="battery_life.py CSV")
+    common(sp)
+    sp.add_argument("--no-offset", action="store_true",
+                    help="do not fit an ADC offset")
+    sp.add_argument("--save", help="write the calibrated profile here")
+    sp.set_defaults(func=cmd_calibrate)
+
+    sp = sub.add_parser("sweep", help="grid search with a Pareto front")
+    common(sp)
+    sp.add_argument("--grid", type=parse_assignment, action="append",
+                    metavar="NAME=V1,V2,...", required=True)
+    sp.add_argument("--tolerance", type=float, default=2, metavar="PCT",
+                    help="lives this close count as equal (default 2%%)")
+    sp.add_argument("--front-only", action="store_true")
+    sp.add_argument("--csv", help="write all results")
+    sp.set_defaults(func=cmd_sweep)
+
+    sp = sub.add_parser("packs", help="list battery packs")
+    sp.set_defaults(func=cmd_packs)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args) or 0
+    except (OSError, ValueError, KeyError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
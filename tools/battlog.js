@@ -0,0 +1,370 @@
+// Sample storage, CSV export and chart downsampling for battery_life.html
+// and battery_bench.html.  Plain script (no modules) so the pages still
+// work when opened from disk.
+//
+// Samples are kept twice: append-only in IndexedDB (the record of the run)
+// and as typed-array columns in memory (what the chart draws).  Records are
+// stored as arrays, [t, mv, temp, press, hum], with t in ms since the epoch,
+// under auto-incremented keys so reads can resume from the last key.
+
+'use strict';
+
+const BattLog = (() => {
+
+const DB_NAME = 'battmon';
+const DB_VERSION = 1;
+const SAMPLES = 'samples';
+const META = 'meta';
+const FLUSH_AT = 512;         // queued records that force a write
+const READ_CHUNK = 20000;     // records per getAll() while loading/exporting
+
+function req(r) {
+  return new Promise((resolve, reject) => {
+    r.onsuccess = () => resolve(r.result);
+    r.onerror = () => reject(r.error);
+  });
+}
+
+function done(tx) {
+  return new Promise((resolve, reject) => {
+    tx.oncomplete = () => resolve();
+    tx.onerror = tx.onabort = () => reject(tx.error);
+  });
+}
+
+// ---- IndexedDB store -------------------------------------------------------
+
+class Store {
+  constructor(name = DB_NAME) {
+    this.name = name;
+    this.db = null;
+    this.queue = [];
+    this.flushing = null;
+    this.inflight = Promise.resolve();
+  }
+
+  async open() {
+    const r = indexedDB.open(this.name, DB_VERSION);
+    r.onupgradeneeded = () => {
+      r.result.createObjectStore(SAMPLES, { autoIncrement: true });
+      r.result.createObjectStore(META);
+    };
+    this.db = await req(r);
+    return this;
+  }
+
+  // Queue a record; written with its neighbours in one transaction.
+  append(rec) {
+    this.queue.push(rec);
+    if (this.queue.length >= FLUSH_AT) return this.flush();
+    if (!this.flushing) this.flushing = Promise.resolve().then(() => this.flush());
+    return this.flushing;
+  }
+
+  // Write everything queued; resolves once all earlier writes completed.
+  async flush() {
+    const batch = this.queue;
+    this.queue = [];
+    this.flushing = null;
+    if (batch.length > 0) {
+      const tx = this.db.transaction(SAMPLES, 'readwrite');
+      const os = tx.objectStore(SAMPLES);
+      for (const rec of batch) os.add(rec);
+      this.inflight = done(tx);
+    }
+    await this.inflight;
+  }
+
+  async count() {
+    const tx = this.db.transaction(SAMPLES);
+    return req(tx.objectStore(SAMPLES).count());
+  }
+
+  // Call fn(records) for successive chunks in insertion order, yielding to
+  // the event loop between chunks so the page stays responsive.
+  async forEach(fn, chunk = READ_CHUNK) {
+    let last = null;
+    for (;;) {
+      const tx = this.db.transaction(SAMPLES);
+      const os = tx.objectStore(SAMPLES);
+      const range = last === null ? null : IDBKeyRange.lowerBound(last, true);
+      const [keys, values] = await Promise.all([
+        req(os.getAllKeys(range, chunk)), req(os.getAll(range, chunk))]);
+      if (values.length === 0) return;
+      await fn(values);
+      last = keys[keys.length - 1];
+      await new Promise(r => setTimeout(r, 0));
+    }
+  }
+
+  async getMeta(key) {
+    const tx = this.db.transaction(META);
+    return req(tx.objectStore(META).get(key));
+  }
+
+  async setMeta(key, value) {
+    const tx = this.db.transaction(META, 'readwrite');
+    tx.objectStore(META).put(value, key);
+    await done(tx);
+  }
+
+  async clear() {
+    this.queue = [];
+    const tx = this.db.transaction([SAMPLES, META], 'readwrite');
+    tx.objectStore(SAMPLES).clear();
+    tx.objectStore(META).clear();
+    await done(tx);
+  }
+
+  async destroy() {
+    this.db.close();
+    await req(indexedDB.deleteDatabase(this.name));
+  }
+}
+
+// ---- In-memory columns -----------------------------------------------------
+
+const FIELDS = ['mv', 'temp', 'press', 'hum'];
+
+class Series {
+  constructor(capacity = 1024) {
+    this.length = 0;
+    this.alloc(capacity);
+  }
+
+  alloc(capacity) {
+    const t = new Float64Array(capacity);
+    if (this.t) t.set(this.t.subarray(0, this.length));
+    this.t = t;
+    for (const f of FIELDS) {
+      const col = new Float32Array(capacity);
+      if (this[f]) col.set(this[f].subarray(0, this.length));
+      this[f] = col;
+    }
+  }
+
+  push(rec) {
+    if (this.length === this.t.length) this.alloc(this.t.length * 2);
+    const i = this.length++;
+    this.t[i] = rec[0];
+    this.mv[i] = rec[1];
+    this.temp[i] = rec[2];
+    this.press[i] = rec[3];
+    this.hum[i] = rec[4];
+  }
+
+  clear() {
+    this.length = 0;
+  }
+}
+
+// ---- CSV export ------------------------------------------------------------
+
+const CSV_HEADER = 'timestamp,elapsed_min,mv,volts,temp_c,press_hpa,humidity\n';
+
+const pad2 = n => (n < 10 ? '0' : '') + n;
+
+// Local time as "YYYY-MM-DD HH:MM:SS", the format battery_life.py writes.
+function fmtTime(t) {
+  const d = new Date(t);
+  return d.getFullYear() + '-' + pad2(d.getMonth() + 1) + '-' +
+         pad2(d.getDate()) + ' ' + pad2(d.getHours()) + ':' +
+         pad2(d.getMinutes()) + ':' + pad2(d.getSeconds());
+}
+
+function csvChunk(records, start) {
+  let s = '';
+  for (const [t, mv, temp, press, hum] of records) {
+    s += fmtTime(t) + ',' +
+         ((t - start) / 60000).toFixed(1) + ',' + mv + ',' +
+         (mv / 1000).toFixed(3) + ',' + temp.toFixed(2) + ',' +
+         press.toFixed(2) + ',' + hum.toFixed(1) + '\n';
+  }
+  return s;
+}
+
+// Write the whole store as CSV one chunk at a time.  With the File System
+// Access API the chunks go straight to disk; otherwise they become the parts
+// of a Blob, which avoids building one huge string.
+async function exportCSV(store, filename) {
+  const start = (await store.getMeta('start')) || 0;
+  await store.flush();
+
+  if (window.showSaveFilePicker) {
+    let handle;
+    try {
+      handle = await window.showSaveFilePicker({
+        suggestedName: filename,
+        types: [{ description: 'CSV', accept: { 'text/csv': ['.csv'] } }],
+      });
+    } catch (e) {
+      if (e.name === 'AbortError') return;
+      throw e;
+    }
+    const out = await handle.createWritable();
+    await out.write(CSV_HEADER);
+    await store.forEach(recs => out.write(csvChunk(recs, start || recs[0][0])));
+    await out.close();
+    return;
+  }
+
+  const parts = [CSV_HEADER];
+  await store.forEach(recs => { parts.push(csvChunk(recs, start || recs[0][0])); });
+  const a = document.createElement('a');
+  a.href = URL.createObjectURL(new Blob(parts, { type: 'text/csv' }));
+  a.download = filename;
+  a.click();
+  setTimeout(() => URL.revokeObjectURL(a.href), 10000);
+}
+
+// ---- Downsampling ----------------------------------------------------------
+
+// Min/max per pixel column over x[lo, hi) (x sorted).  Returns a Float64Array
+// of [x, first, min, max, last] per non-empty column; drawing every column
+// as first -> min -> max -> last keeps every spike and every step.  O(n).
+function minMax(x, y, lo, hi, x0, x1, width) {
+  const out = new Float64Array(width * 5);
+  const scale = width / (x1 - x0 || 1);
+  let n = 0;
+  let col = -1;
+  for (let i = lo; i < hi; i++) {
+    const c = Math.min(width - 1, Math.floor((x[i] - x0) * scale));
+    const v = y[i];
+    if (c !== col) {
+      col = c;
+      const o = n++ * 5;
+      out[o] = x[i];
+      out[o + 1] = out[o + 2] = out[o + 3] = out[o + 4] = v;
+    } else {
+      const o = (n - 1) * 5;
+      if (v < out[o + 2]) out[o + 2] = v;
+      if (v > out[o + 3]) out[o + 3] = v;
+      out[o + 4] = v;
+    }
+  }
+  return out.subarray(0, n * 5);
+}
+
+// Largest-Triangle-Three-Buckets over x[lo, hi).  Returns the indices of the
+// `threshold` points that best preserve the visual shape.  O(n).
+function lttb(x, y, lo, hi, threshold) {
+  const n = hi - lo;
+  if (threshold >= n || threshold < 3) {
+    const all = new Int32Array(n);
+    for (let i = 0; i < n; i++) all[i] = lo + i;
+    return all;
+  }
+
+  const out = new Int32Array(threshold);
+  const every = (n - 2) / (threshold - 2);
+  let a = lo;
+  out[0] = lo;
+
+  for (let b = 0; b < threshold - 2; b++) {
+    // Average of the next bucket is the third triangle vertex.
+    let avgStart = lo + Math.floor((b + 1) * every) + 1;
+    let avgEnd = Math.min(lo + Math.floor((b + 2) * every) + 1, hi);
+    let avgX = 0, avgY = 0;
+    for (let i = avgStart; i < avgEnd; i++) { avgX += x[i]; avgY += y[i]; }
+    const cnt = avgEnd - avgStart || 1;
+    avgX /= cnt;
+    avgY /= cnt;
+
+    const start = lo + Math.floor(b * every) + 1;
+    const end = lo + Math.floor((b + 1) * every) + 1;
+    const ax = x[a], ay = y[a];
+    let best = start, bestArea = -1;
+    for (let i = start; i < end; i++) {
+      const area = Math.abs((ax - avgX) * (y[i] - ay) - (ax - x[i]) * (avgY - ay));
+      if (area > bestArea) { bestArea = area; best = i; }
+    }
+    out[b + 1] = a = best;
+  }
+  out[threshold - 1] = hi - 1;
+  return out;
+}
+
+// ---- Chart -----------------------------------------------------------------
+
+// Line chart of one Series field.  Redraws are coalesced to one per frame,
+// and only the downsampled points are handed to the canvas.
+class Chart {
+  constructor(canvas, series, opts = {}) {
+    this.canvas = canvas;
+    this.series = series;
+    this.field = opts.field || 'mv';
+    this.mode = opts.mode || 'minmax';     // 'minmax' or 'lttb'
+    this.color = opts.color || '#50fa7b';
+    this.pending = false;
+    this.lastDrawMs = 0;
+  }
+
+  invalidate() {
+    if (this.pending) return;
+    this.pending = true;
+    requestAnimationFrame(() => { this.pending = false; this.draw(); });
+  }
+
+  draw() {
+    const t0 = performance.now();
+    const c = this.canvas;
+    const dpr = window.devicePixelRatio || 1;
+    const w = Math.max(1, Math.round(c.clientWidth * dpr));
+    const h = Math.max(1, Math.round(c.clientHeight * dpr));
+    if (c.width !== w || c.height !== h) { c.width = w; c.height = h; }
+    const g = c.getContext('2d');
+    g.clearRect(0, 0, w, h);
+
+    const s = this.series;
+    const n = s.length;
+    if (n < 2) return;
+    const x = s.t, y = s[this.field];
+    const x0 = x[0], x1 = x[n - 1];
+    const pad = 4 * dpr;
+
+    let lo = Infinity, hi = -Infinity;
+    let pts;
+    if (this.mode === 'lttb') {
+      const idx = lttb(x, y, 0, n, w);
+      pts = new Float64Array(idx.length * 2);
+      for (let i = 0; i < idx.length; i++) {
+        pts[2 * i] = x[idx[i]];
+        pts[2 * i + 1] = y[idx[i]];
+      }
+      for (let i = 1; i < pts.length; i += 2) {
+        if (pts[i] < lo) lo = pts[i];
+        if (pts[i] > hi) hi = pts[i];
+      }
+    } else {
+      const cols = minMax(x, y, 0, n, x0, x1, w);
+      pts = new Float64Array(cols.length / 5 * 8);
+      for (let i = 0, j = 0; i < cols.length; i += 5) {
+        if (cols[i + 2] < lo) lo = cols[i + 2];
+        if (cols[i + 3] > hi) hi = cols[i + 3];
+        for (const k of [1, 2, 3, 4]) { pts[j++] = cols[i]; pts[j++] = cols[i + k]; }
+      }
+    }
+    if (hi === lo) { hi += 1; lo -= 1; }
+
+    const sx = (w - 2 * pad) / (x1 - x0 || 1);
+    const sy = (h - 2 * pad) / (hi - lo);
+    g.strokeStyle = this.color;
+    g.lineWidth = dpr;
+    g.beginPath();
+    g.moveTo(pad + (pts[0] - x0) * sx, h - pad - (pts[1] - lo) * sy);
+    for (let i = 2; i < pts.length; i += 2) {
+      g.lineTo(pad + (pts[i] - x0) * sx, h - pad - (pts[i + 1] - lo) * sy);
+    }
+    g.stroke();
+
+    g.fillStyle = '#888';
+    g.font = (10 * dpr) + 'px monospace';
+    g.fillText(hi.toFixed(1), pad, pad + 10 * dpr);
+    g.fillText(lo.toFixed(1), pad, h - pad);
+    this.lastDrawMs = performance.now() - t0;
+  }
+}
+
+return { Store, Series, Chart, exportCSV, csvChunk, fmtTime, minMax, lttb, FIELDS };
+
+})();
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Build and run the microbenchmark app under QEMU at each optimisation level.
+
+Each level is built into its own directory with bench/sdkconfig.bench and
+bench/sdkconfig.<level> layered over sdkconfig.defaults, then booted in
+Espressif's QEMU (esp32c3).  The app prints one "BENCH {json}" line per case;
+these are collected into a single JSON file.
+
+Usage (inside the ESP-IDF environment):
+    python tools/bench.py                       # all levels -> bench_results.json
+    python tools/bench.py -l Og -l O2           # selected levels only
+    python tools/bench.py --no-build            # rerun existing builds
+    python tools/bench.py --baseline old.json   # fail on regressions > 5%
+    python tools/bench.py --baseline old.json --threshold 10
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+LEVELS = ["Og", "Os", "O2", "O0"]
+RUN_TIMEOUT = 300   # seconds per QEMU run
+
+
+def build_dir(level):
+    return os.path.join(REPO, "build", f"bench-{level}")
+
+
+def build(level):
+    """Configure and build the benchmark app for one optimisation level."""
+    bdir = build_dir(level)
+    defaults = ";".join([
+        os.path.join(REPO, "sdkconfig.defaults"),
+        os.path.join(REPO, "bench", "sdkconfig.bench"),
+        os.path.join(REPO, "bench", f"sdkconfig.{level}"),
+    ])
+    cmd = ["idf.py", "-C", REPO, "-B", bdir,
+           "-D", f"SDKCONFIG={os.path.join(bdir, 'sdkconfig')}",
+           "-D", f"SDKCONFIG_DEFAULTS={defaults}",
+           "set-target", "esp32c3", "build"]
+    print(f"[{level}] building in {bdir}")
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+
+
+def run(level):
+    """Boot the image in QEMU and collect its BENCH lines."""
+    # -icount makes the virtual cycle counter deterministic from run to run
+    cmd = ["idf.py", "-C", REPO, "-B", build_dir(level), "qemu",
+           "--qemu-extra-args", "-icount 3"]
+    print(f"[{level}] running under QEMU")
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, text=True)
+    results = []
+    deadline = time.time() + RUN_TIMEOUT
+    try:
+        for line in proc.stdout:
+            line = line.strip()
+            if line.startswith("BENCH {"):
+                results.append(json.loads(line[len("BENCH "):]))
+            elif line == "BENCH_DONE":
+                break
+            if time.time() > deadline:
+                raise TimeoutError(f"{level}: no BENCH_DONE after "
+                                   f"{RUN_TIMEOUT}s")
+    finally:
+        proc.terminate()
+        proc.wait()
+    return results
+
+
+def compare(results, baseline, threshold):
+    """Return a list of (case, opt, old, new, pct) regressions."""
+    old = {(r["case"], r["opt"]): r["median"] for r in baseline}
+    regressions = []
+    for r in results:
+        key = (r["case"], r["opt"])
+        if key not in old or old[key] == 0:
+            continue
+        pct = (r["median"] - old[key]) * 100.0 / old[key]
+        if pct > threshold:
+            regressions.append((r["case"], r["opt"], old[key],
+                                r["median"], pct))
+    return regressions
+
+
+def print_table(results):
+    levels = [lvl for lvl in LEVELS if any(r["opt"] == lvl for r in results)]
+    cases = []
+    for r in results:
+        if r["case"] not in cases:
+            cases.append(r["case"])
+    median = {(r["case"], r["opt"]): r["median"] for r in results}
+
+    print(f"\n{'case':<20}" + "".join(f"{lvl:>12}" for lvl in levels))
+    for case in cases:
+        row = "".join(f"{median.get((case, lvl), '-'):>12}" for lvl in levels)
+        print(f"{case:<20}{row}")
+    print("(median CPU cycles per call)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="QEMU microbenchmark runner")
+    parser.add_argument("-l", "--level", action="append", choices=LEVELS,
+                        help="optimisation level (repeatable, default: all)")
+    parser.add_argument("-o", "--output", default="bench_results.json",
+                        help="output JSON file (default: bench_results.json)")
+    parser.add_argument("--no-build", action="store_true",
+                        help="run existing builds without rebuilding")
+    parser.add_argument("--baseline", metavar="JSON",
+                        help="previous results to check for regressions")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="regression threshold in percent (default: 5)")
+    args = parser.parse_args()
+
+    results = []
+    for level in args.level or LEVELS:
+        if not args.no_build:
+            build(level)
+        results.extend(run(level))
+
+    with open(args.output, "w") as f:
+        json.dump(results, f, indent=1)
+    print_table(results)
+    print(f"Results saved to {args.output}")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, args.threshold)
+        for case, opt, old, new, pct in regressions:
+            print(f"REGRESSION {case} -{opt}: {old} -> {new} cycles "
+                  f"(+{pct:.1f}%)")
+        if regressions:
+            sys.exit(1)
+        print(f"No regressions above {args.threshold}%")
+
+
+if __name__ == "__main__":
+    main()
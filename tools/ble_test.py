@@ -10,17 +10,42 @@ Usage:
     python ble_test.py --get-tz     # read device timezone
     python ble_test.py --local-time # print device local time (UTC + TZ)
     python ble_test.py --set-local  # set time and timezone from host clock
+    python ble_test.py --control time=now tz=local mode=button sample=slow \
+                                 adv=normal sea=1021.5  # one atomic batch
+    python ble_test.py --control sample=fast --check  # validate only
     python ble_test.py --sensor     # read temperature, pressure, humidity
     python ble_test.py --battery    # read battery voltage in mV
+    python ble_test.py --derived    # dew point, pressure trend, altitude
+    python ble_test.py --sea-level 1021.5  # set sea-level pressure (hPa)
     python ble_test.py --display-mode normal  # set display mode
     python ble_test.py --display-mode button  # display on button press (5s)
     python ble_test.py --display-mode blank   # blank display
+    python ble_test.py --power      # activity counters (JSON)
+    python ble_test.py --power > power.json  # for battery_sim.py calibrate
+    python ble_test.py --rules      # alarm rules and which are active
+    python ble_test.py --set-rules "temp > 30 hyst=0.5 for=300 do=led,adv" \
+                                   "press rate< -2 do=indicate,display"
+    python ble_test.py --set-rules  # remove all rules
+    python ble_test.py --watch-alarm  # print Alarm indications
+    python ble_test.py --rollup hour --hours 48  # min/mean/max per hour
+    python ble_test.py --schedule   # power schedule and the entry in force
+    python ble_test.py --set-schedule \
+        "22:00 daily display=blank sample=slow adv=slow" \
+        "07:00 mon-fri display=button sample=normal adv=normal" \
+        "09:00 sat,sun display=button sample=normal adv=normal"
+    python ble_test.py --set-schedule  # remove the schedule
+    python ble_test.py --pair       # bond (LE Secure Connections)
+    python ble_test.py --reconnect-bench 20   # time reconnect to first data
+    python ble_test.py --reconnect-bench 20 --cached  # reuse cached GATT
+
+Each option is one connection.  For several operations in a row use the
+shell, which keeps one: python -m c3ble --help.
 """
 
 import argparse
 import asyncio
+import json
 from datetime import datetime, timezone, timedelta
-import struct
 import sys
 import time
 
@@ -30,17 +55,21 @@ except ImportError:
     print("Install bleak: pip install bleak")
     sys.exit(1)
 
-DEVICE_NAME = "ESP32-C3-BLE"
-CHR_UUID = "deadbeef-1001-2000-3000-aabbccddeeff"
-TIME_UUID = "deadbeef-1005-2000-3000-aabbccddeeff"
-TZ_UUID = "deadbeef-1006-2000-3000-aabbccddeeff"
-PRESS_UUID = "deadbeef-1002-2000-3000-aabbccddeeff"
-TEMP_UUID = "deadbeef-1003-2000-3000-aabbccddeeff"
-HUM_UUID = "deadbeef-1004-2000-3000-aabbccddeeff"
-BATT_UUID = "deadbeef-1007-2000-3000-aabbccddeeff"
-MODE_UUID = "deadbeef-1008-2000-3000-aabbccddeeff"
+import gatt_chrs as chrs
+from c3ble import codec
+from c3ble.codec import (DEVICE_NAME, DISPLAY_MODES, ROLLUP_LEVELS,
+                         format_tz, host_tz, parse_tz)
 
-DISPLAY_MODES = {"normal": 0, "button": 1, "blank": 2}
+CHR_UUID = chrs.DATA.uuid
+TIME_UUID = chrs.TIME.uuid
+TZ_UUID = chrs.TIMEZONE.uuid
+PRESS_UUID = chrs.PRESSURE.uuid
+TEMP_UUID = chrs.TEMPERATURE.uuid
+HUM_UUID = chrs.HUMIDITY.uuid
+BATT_UUID = chrs.BATTERY.uuid
+MODE_UUID = chrs.DISPLAY_MODE.uuid
+DERIVED_UUID = chrs.DERIVED.uuid
+SEA_LEVEL_UUID = chrs.SEA_LEVEL.uuid
 
 
 async def connect():
@@ -76,13 +105,13 @@ async def set_time():
         print(f"Connected: {client.is_connected}")
 
         now = int(time.time())
-        payload = struct.pack("<q", now)
+        payload = codec.encode(chrs.TIME, now)
         print(f"Setting device time to {now} ({time.ctime(now)})")
         await client.write_gatt_char(TIME_UUID, payload)
 
         # Read it back
         data = await client.read_gatt_char(TIME_UUID)
-        readback = struct.unpack("<q", data)[0]
+        readback = codec.decode(chrs.TIME, data)
         print(f"Device time readback: {readback} ({time.ctime(readback)})")
         print(f"OK — delta {readback - now}s")
 
@@ -93,55 +122,29 @@ async def get_time():
         print(f"Connected: {client.is_connected}")
 
         data = await client.read_gatt_char(TIME_UUID)
-        device_time = struct.unpack("<q", data)[0]
+        device_time = codec.decode(chrs.TIME, data)
         now = int(time.time())
         print(f"Device time: {device_time} ({time.ctime(device_time)})")
         print(f"Host time:   {now} ({time.ctime(now)})")
         print(f"Delta: {device_time - now}s")
 
 
-def parse_tz(s):
-    """Parse a timezone string like '+5', '-4:30', '+5:45' into quarter-hours."""
-    s = s.strip()
-    if ":" in s:
-        hours_s, mins_s = s.split(":", 1)
-        hours = int(hours_s)
-        mins = int(mins_s)
-        if hours < 0:
-            mins = -mins
-    else:
-        hours = int(s)
-        mins = 0
-    total_minutes = hours * 60 + mins
-    if total_minutes % 15 != 0:
-        print(f"Warning: {s} is not a multiple of 15 minutes, rounding")
-    return total_minutes // 15
-
-
-def format_tz(quarter_hours):
-    """Format quarter-hours as UTC offset string."""
-    total_minutes = quarter_hours * 15
-    sign = "+" if total_minutes >= 0 else "-"
-    total_minutes = abs(total_minutes)
-    hours = total_minutes // 60
-    mins = total_minutes % 60
-    if mins:
-        return f"UTC{sign}{hours}:{mins:02d}"
-    return f"UTC{sign}{hours}"
-
-
 async def set_tz(tz_str):
     """Write timezone offset to the device."""
-    qh = parse_tz(tz_str)
+    try:
+        qh = parse_tz(tz_str)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
     async with await connect() as client:
         print(f"Connected: {client.is_connected}")
 
-        payload = struct.pack("<b", qh)
+        payload = codec.encode(chrs.TIMEZONE, qh * 15)
         print(f"Setting timezone to {format_tz(qh)} ({qh} quarter-hours)")
         await client.write_gatt_char(TZ_UUID, payload)
 
         data = await client.read_gatt_char(TZ_UUID)
-        readback = struct.unpack("<b", data)[0]
+        readback = codec.decode(chrs.TIMEZONE, data) // 15
         print(f"Readback: {format_tz(readback)}")
 
 
@@ -151,7 +154,7 @@ async def get_tz():
         print(f"Connected: {client.is_connected}")
 
         data = await client.read_gatt_char(TZ_UUID)
-        qh = struct.unpack("<b", data)[0]
+        qh = codec.decode(chrs.TIMEZONE, data) // 15
         print(f"Device timezone: {format_tz(qh)} ({qh} quarter-hours)")
 
 
@@ -161,10 +164,10 @@ async def local_time():
         print(f"Connected: {client.is_connected}")
 
         data = await client.read_gatt_char(TIME_UUID)
-        device_time = struct.unpack("<q", data)[0]
+        device_time = codec.decode(chrs.TIME, data)
 
         data = await client.read_gatt_char(TZ_UUID)
-        qh = struct.unpack("<b", data)[0]
+        qh = codec.decode(chrs.TIMEZONE, data) // 15
 
         tz_offset = timedelta(minutes=qh * 15)
         tz_info = timezone(tz_offset)
@@ -175,29 +178,51 @@ async def local_time():
 
 async def set_local():
     """Set device time and timezone from the host's local clock."""
+    now, qh = int(time.time()), host_tz()
     async with await connect() as client:
         print(f"Connected: {client.is_connected}")
-
-        # Set UNIX time
-        now = int(time.time())
-        await client.write_gatt_char(TIME_UUID, struct.pack("<q", now))
-        print(f"Time set to {now} ({time.ctime(now)})")
-
-        # Determine host UTC offset in quarter-hours
-        local_dt = datetime.now(timezone.utc).astimezone()
-        utc_offset_sec = local_dt.utcoffset().total_seconds()
-        qh = int(utc_offset_sec // 900)
-        await client.write_gatt_char(TZ_UUID, struct.pack("<b", qh))
-        print(f"Timezone set to {format_tz(qh)} ({qh} quarter-hours)")
-
-        # Read back local time
-        data = await client.read_gatt_char(TIME_UUID)
-        device_time = struct.unpack("<q", data)[0]
-        data = await client.read_gatt_char(TZ_UUID)
-        readback_qh = struct.unpack("<b", data)[0]
-        tz_info = timezone(timedelta(minutes=readback_qh * 15))
-        dt = datetime.fromtimestamp(device_time, tz=tz_info)
-        print(f"Device local time: {dt.strftime('%H:%M:%S %Z')} ({format_tz(readback_qh)})")
+        # One write and one indication instead of a round trip per value
+        ok = await control(client, [("time", now), ("tz", qh)])
+    if ok:
+        print(f"Time set to {now} ({time.ctime(now)}), "
+              f"timezone {format_tz(qh)} ({qh} quarter-hours)")
+
+
+async def control(client, items, op=codec.CTRL_OP_APPLY):
+    """Send one control point request and print the response."""
+    token = int(time.monotonic() * 1000) & 0xFF
+    req = codec.control_request(items, op, token)
+    reply = asyncio.get_running_loop().create_future()
+
+    def on_reply(_, data):
+        r = codec.decode_control(bytes(data))
+        if r and r["token"] == token and not reply.done():
+            reply.set_result(r)
+
+    await client.start_notify(chrs.CONTROL.uuid, on_reply)
+    t0 = time.perf_counter()
+    await client.write_gatt_char(chrs.CONTROL.uuid, req, response=True)
+    r = await asyncio.wait_for(reply, timeout=5)
+    ms = (time.perf_counter() - t0) * 1000
+    await client.stop_notify(chrs.CONTROL.uuid)
+
+    print(f"{codec.format_control(r)} ({len(req)} bytes, "
+          f"reply in {ms:.0f} ms)")
+    return r["result"] == 0
+
+
+async def set_control(specs, check):
+    """Apply (or only check) a batch of settings in one request."""
+    try:
+        items = [codec.parse_control(s) for s in specs]
+    except ValueError as e:
+        print(f"bad value: {e}")
+        sys.exit(1)
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        ok = await control(client, items, codec.CTRL_OP_CHECK if check
+                           else codec.CTRL_OP_APPLY)
+    sys.exit(0 if ok else 1)
 
 
 async def read_sensor():
@@ -206,16 +231,16 @@ async def read_sensor():
         print(f"Connected: {client.is_connected}")
 
         data = await client.read_gatt_char(TEMP_UUID)
-        temp = struct.unpack("<f", data)[0]
+        temp = codec.decode(chrs.TEMPERATURE, data)
 
         data = await client.read_gatt_char(PRESS_UUID)
-        press = struct.unpack("<f", data)[0]
+        press = codec.decode(chrs.PRESSURE, data)
 
         data = await client.read_gatt_char(HUM_UUID)
-        hum = struct.unpack("<f", data)[0]
+        hum = codec.decode(chrs.HUMIDITY, data)
 
         print(f"Temperature: {temp:.2f} °C")
-        print(f"Pressure:    {press / 100.0:.2f} hPa")
+        print(f"Pressure:    {press:.2f} hPa")
         print(f"Humidity:    {hum:.2f} %")
 
 
@@ -225,23 +250,199 @@ async def read_battery():
         print(f"Connected: {client.is_connected}")
 
         data = await client.read_gatt_char(BATT_UUID)
-        mv = struct.unpack("<I", data)[0] * 2  # voltage divider halves battery voltage
+        mv = codec.decode(chrs.BATTERY, data)
         print(f"Battery: {mv} mV ({mv / 1000.0:.3f} V)")
 
 
+async def read_derived():
+    """Read the metrics the device derives from each sample."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        print(codec.describe(chrs.DERIVED,
+                             await client.read_gatt_char(DERIVED_UUID)))
+
+
+async def set_sea_level(hpa):
+    """Set the sea-level pressure used for altitude and the forecast."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+
+        await client.write_gatt_char(SEA_LEVEL_UUID,
+                                     codec.encode(chrs.SEA_LEVEL, hpa))
+        print(f"Sea-level pressure set to {hpa:.2f} hPa")
+        print(codec.describe(chrs.DERIVED,
+                             await client.read_gatt_char(DERIVED_UUID)))
+
+
 async def set_display_mode(mode_name):
     """Set the display mode on the device."""
     mode = DISPLAY_MODES[mode_name]
     async with await connect() as client:
         print(f"Connected: {client.is_connected}")
 
-        await client.write_gatt_char(MODE_UUID, struct.pack("<B", mode))
+        await client.write_gatt_char(MODE_UUID,
+                                     codec.encode(chrs.DISPLAY_MODE, mode))
         print(f"Display mode set to '{mode_name}' ({mode})")
 
         data = await client.read_gatt_char(MODE_UUID)
-        readback = struct.unpack("<B", data)[0]
-        names = {v: k for k, v in DISPLAY_MODES.items()}
-        print(f"Readback: '{names.get(readback, '?')}' ({readback})")
+        print(f"Readback: '{codec.decode(chrs.DISPLAY_MODE, data)}'")
+
+
+async def read_rules():
+    """Print the rule table and the last evaluation."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        rules = codec.decode_rules(await client.read_gatt_char(
+            chrs.RULES.uuid))
+        for i, r in enumerate(rules):
+            print(f"{i}: {codec.format_rule(r)}")
+        print(f"{len(rules)} rule(s)")
+        data = await client.read_gatt_char(chrs.ALARM.uuid)
+        print(f"Alarm: {codec.describe(chrs.ALARM, data)}")
+
+
+async def set_rules(specs):
+    """Replace the rule table; an empty list removes every rule."""
+    try:
+        payload = codec.encode(chrs.RULES, specs)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        await client.write_gatt_char(chrs.RULES.uuid, payload, response=True)
+        print(f"{len(specs)} rule(s) written")
+        data = await client.read_gatt_char(chrs.RULES.uuid)
+        print(codec.describe(chrs.RULES, data))
+
+
+async def watch_alarm():
+    """Print Alarm indications until interrupted."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        data = await client.read_gatt_char(chrs.ALARM.uuid)
+        print(f"Alarm: {codec.describe(chrs.ALARM, data)}")
+
+        def on_alarm(_, data):
+            print(f"[{time.strftime('%H:%M:%S')}] "
+                  f"{codec.describe(chrs.ALARM, data)}")
+
+        await client.start_notify(chrs.ALARM.uuid, on_alarm)
+        print("Waiting for indications (Ctrl-C to stop)...")
+        while client.is_connected:
+            await asyncio.sleep(1)
+
+
+async def read_schedule():
+    """Print the schedule and the entry in force."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        entries = codec.decode_schedule(await client.read_gatt_char(
+            chrs.SCHEDULE.uuid))
+        for i, e in enumerate(entries):
+            print(f"{i}: {codec.format_schedule(e)}")
+        print(f"{len(entries)} entr{'y' if len(entries) == 1 else 'ies'}")
+        data = await client.read_gatt_char(chrs.PROFILE.uuid)
+        print(f"Profile: {codec.describe(chrs.PROFILE, data)}")
+
+
+async def set_schedule(specs):
+    """Replace the schedule; an empty list removes it."""
+    try:
+        payload = codec.encode(chrs.SCHEDULE, specs)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        await client.write_gatt_char(chrs.SCHEDULE.uuid, payload,
+                                     response=True)
+        print(f"{len(specs)} entr{'y' if len(specs) == 1 else 'ies'} "
+              f"written")
+        await asyncio.sleep(0.2)    # the switch runs on a timer
+        data = await client.read_gatt_char(chrs.PROFILE.uuid)
+        print(f"Profile: {codec.describe(chrs.PROFILE, data)}")
+
+
+async def read_rollup(level_name, hours):
+    """Print the min/mean/max slots of one rollup level."""
+    level = ROLLUP_LEVELS[level_name]
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        now = codec.decode(chrs.TIME, await client.read_gatt_char(TIME_UUID))
+        start = max(0, now - int(hours * 3600))
+        print(f"{'start (device time)':19}  {'n':>4}  "
+              f"{'temp min/mean/max °C':>20}  {'hum mean %':>10}  "
+              f"{'press min/mean/max hPa':>24}")
+        while True:
+            await client.write_gatt_char(
+                chrs.ROLLUP.uuid, codec.rollup_request(level, start),
+                response=True)
+            r = codec.decode_rollup(await client.read_gatt_char(
+                chrs.ROLLUP.uuid))
+            for s in r["slots"]:
+                stamp = datetime.fromtimestamp(s["start"], timezone.utc)
+                t, p = s["temp"], s["press"]
+                print(f"{stamp:%Y-%m-%d %H:%M:%S}  {s['count']:4}  "
+                      f"{t[0]:6.2f} {t[1]:6.2f} {t[2]:6.2f}  "
+                      f"{s['hum'][1]:10.1f}  "
+                      f"{p[0]:7.2f} {p[1]:7.2f} {p[2]:7.2f}")
+                start = s["start"] + 1
+            if len(r["slots"]) < codec.ROLLUP_READ_MAX:
+                break
+        print(f"{r['total']} slot(s) stored at this level")
+
+
+async def read_power():
+    """Print the device's activity counters as JSON on stdout."""
+    print(f"Scanning for {DEVICE_NAME}...", file=sys.stderr)
+    device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=20)
+    if not device:
+        print("Device not found. Is it advertising?", file=sys.stderr)
+        sys.exit(1)
+    async with BleakClient(device, timeout=20) as client:
+        values = codec.decode(chrs.POWER, await client.read_gatt_char(
+            chrs.POWER.uuid))
+    print(json.dumps(values, indent=2))
+
+
+async def pair():
+    """Pair and bond so later connections can skip service discovery."""
+    async with await connect() as client:
+        print(f"Connected: {client.is_connected}")
+        await client.pair()
+        print("Paired; keys are kept on both sides")
+
+
+async def reconnect_bench(count, cached):
+    """Time short sessions: connect, read one value, disconnect."""
+    print(f"Scanning for {DEVICE_NAME}...")
+    device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=20)
+    if not device:
+        print("Device not found. Is it advertising?")
+        sys.exit(1)
+    # BlueZ only: trust the services cached from an earlier connection
+    # instead of waiting for discovery.  Meant for bonded devices, whose
+    # cache the Service Changed indication keeps valid.
+    kwargs = {"dangerous_use_bleak_cache": True} if cached else {}
+
+    connect_ms, data_ms = [], []
+    for i in range(count):
+        t0 = time.perf_counter()
+        async with BleakClient(device, timeout=20, **kwargs) as client:
+            t1 = time.perf_counter()
+            await client.read_gatt_char(BATT_UUID)
+            t2 = time.perf_counter()
+        connect_ms.append((t1 - t0) * 1000)
+        data_ms.append((t2 - t0) * 1000)
+        print(f"{i + 1:3}: connected {connect_ms[-1]:6.0f} ms, "
+              f"first data {data_ms[-1]:6.0f} ms")
+        await asyncio.sleep(1)      # let the device advertise again
+
+    data_ms.sort()
+    print(f"Reconnect to first data ({'cached' if cached else 'discovery'}): "
+          f"median {data_ms[len(data_ms) // 2]:.0f} ms, "
+          f"min {data_ms[0]:.0f} ms, max {data_ms[-1]:.0f} ms")
 
 
 def main():
@@ -258,17 +459,78 @@ def main():
                         help="print device local time (UTC + TZ)")
     parser.add_argument("--set-local", action="store_true",
                         help="set time and timezone from host clock")
+    parser.add_argument("--control", nargs="+", metavar="NAME=VALUE",
+                        help="set several values in one request: time=now, "
+                             "tz=+5:30|local, mode=normal|button|blank, "
+                             "sample=normal|fast|slow, adv=normal|fast|slow, "
+                             "sea=HPA")
+    parser.add_argument("--check", action="store_true",
+                        help="with --control: validate without applying")
     parser.add_argument("--sensor", action="store_true",
                         help="read temperature, pressure, humidity")
     parser.add_argument("--battery", action="store_true",
                         help="read battery voltage in mV")
+    parser.add_argument("--derived", action="store_true",
+                        help="read dew point, pressure trend and altitude")
+    parser.add_argument("--sea-level", type=float, metavar="HPA",
+                        help="set sea-level pressure (QNH) in hPa")
     parser.add_argument("--display-mode", choices=DISPLAY_MODES.keys(),
                         metavar="MODE",
                         help="set display mode: normal, button, blank")
+    parser.add_argument("--power", action="store_true",
+                        help="print activity counters as JSON")
+    parser.add_argument("--rules", action="store_true",
+                        help="print alarm rules and the active ones")
+    parser.add_argument("--set-rules", nargs="*", metavar="RULE",
+                        help="replace alarm rules, e.g. "
+                             "'temp > 30 hyst=0.5 for=300 do=led,adv'")
+    parser.add_argument("--watch-alarm", action="store_true",
+                        help="print Alarm indications as they arrive")
+    parser.add_argument("--schedule", action="store_true",
+                        help="print the power schedule and the entry in "
+                             "force")
+    parser.add_argument("--set-schedule", nargs="*", metavar="ENTRY",
+                        help="replace the power schedule, e.g. "
+                             "'22:00 daily display=blank sample=slow'")
+    parser.add_argument("--rollup", choices=ROLLUP_LEVELS.keys(),
+                        metavar="LEVEL",
+                        help="print rollups: 10min, hour or day")
+    parser.add_argument("--hours", type=float, default=24,
+                        help="with --rollup: how far back (default 24)")
+    parser.add_argument("--pair", action="store_true",
+                        help="pair and bond with the device")
+    parser.add_argument("--reconnect-bench", type=int, metavar="N",
+                        help="time N connect/read/disconnect cycles")
+    parser.add_argument("--cached", action="store_true",
+                        help="with --reconnect-bench: reuse cached services")
     args = parser.parse_args()
 
-    if args.display_mode:
+    if args.control:
+        asyncio.run(set_control(args.control, args.check))
+    elif args.power:
+        asyncio.run(read_power())
+    elif args.rules:
+        asyncio.run(read_rules())
+    elif args.set_rules is not None:
+        asyncio.run(set_rules(args.set_rules))
+    elif args.watch_alarm:
+        asyncio.run(watch_alarm())
+    elif args.schedule:
+        asyncio.run(read_schedule())
+    elif args.set_schedule is not None:
+        asyncio.run(set_schedule(args.set_schedule))
+    elif args.rollup:
+        asyncio.run(read_rollup(args.rollup, args.hours))
+    elif args.pair:
+        asyncio.run(pair())
+    elif args.reconnect_bench:
+        asyncio.run(reconnect_bench(args.reconnect_bench, args.cached))
+    elif args.display_mode:
         asyncio.run(set_display_mode(args.display_mode))
+    elif args.derived:
+        asyncio.run(read_derived())
+    elif args.sea_level:
+        asyncio.run(set_sea_level(args.sea_level))
     elif args.battery:
         asyncio.run(read_battery())
     elif args.sensor:
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Decode the firmware's binary log (main/blog.c) back into text.
+
+Modules built with BLOG_LOCAL send "#B:<base64>" lines instead of formatted
+ESP_LOG output.  Each record holds the addresses of its format string and
+tag; this tool reads those strings from the ELF the image was built from and
+formats the arguments the way printf would.  Every other line is passed
+through unchanged, so ordinary log output and the console still show up.
+
+Usage:
+    python blog_decode.py build/esp32_c3_ble.elf --port /dev/ttyACM0
+    python blog_decode.py build/esp32_c3_ble.elf capture.txt
+    idf.py monitor 2>&1 | python blog_decode.py build/esp32_c3_ble.elf
+"""
+
+import argparse
+import base64
+import hashlib
+import re
+import struct
+import sys
+
+from c3ble.codec import BLOG_HDR_FMT, BLOG_LEVELS, BLOG_TRUNCATED
+
+HDR = struct.Struct(BLOG_HDR_FMT)
+
+# printf conversion: flags, width, precision, length modifier, conversion
+SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?"
+                  r"(hh|h|ll|l|j|z|t|L)?([diouxXeEfFgGaAcspn%])")
+
+
+class Elf:
+    """Just enough ELF to read bytes at a virtual address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF":
+            raise ValueError(f"{path}: not an ELF file")
+        is64 = d[4] == 2
+        end = "<" if d[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from(end + "Q", d, 0x28)
+            shentsize, shnum = struct.unpack_from(end + "HH", d, 0x3A)
+            sh = struct.Struct(end + "IIQQQQIIQQ")
+        else:
+            shoff, = struct.unpack_from(end + "I", d, 0x20)
+            shentsize, shnum = struct.unpack_from(end + "HH", d, 0x2E)
+            sh = struct.Struct(end + "IIIIIIIIII")
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset,
+             size) = sh.unpack_from(d, shoff + i * shentsize)[:6]
+            # SHF_ALLOC and not SHT_NOBITS (.bss has no bytes in the file)
+            if flags & 0x2 and sh_type != 8 and addr:
+                self.sections.append((addr, size, offset))
+        self.strings = {}
+
+    def string(self, addr):
+        if addr in self.strings:
+            return self.strings[addr]
+        s = None
+        for base, size, offset in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.find(b"\0", start, offset + size)
+                if end >= 0:
+                    s = self.data[start:end].decode("utf-8", "replace")
+                break
+        self.strings[addr] = s
+        return s
+
+
+class Args:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        v, = struct.unpack_from("<" + fmt, self.data, self.pos)
+        self.pos += struct.calcsize(fmt)
+        return v
+
+    def string(self):
+        n = self.data[self.pos]
+        s = self.data[self.pos + 1:self.pos + 1 + n]
+        self.pos += 1 + n
+        return s.decode("utf-8", "replace")
+
+
+def format_c(fmt, args):
+    """printf(fmt, ...) with arguments in the blog.h encoding."""
+    out = []
+    last = 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            if width == "*":
+                width = str(args.take("i"))
+            if prec == "*":
+                prec = str(args.take("i"))
+            spec = "%" + flags + (width or "") + \
+                ("." + prec if prec is not None else "")
+            wide = length in ("ll", "j")
+            if conv == "s":
+                out.append((spec + "s") % args.string())
+            elif conv in "eEfFgGaA":
+                v = args.take("d")
+                out.append(v.hex() if conv in "aA" else (spec + conv) % v)
+            elif conv in "di":
+                out.append((spec + "d") % args.take("q" if wide else "i"))
+            elif conv == "c":
+                out.append((spec + "c") % chr(args.take("I") & 0xFF))
+            elif conv == "p":
+                out.append("0x%x" % args.take("I"))
+            elif conv == "n":
+                pass
+            else:
+                v = args.take("Q" if wide else "I")
+                out.append((spec + ("d" if conv == "u" else conv)) % v)
+        except (struct.error, IndexError):
+            out.append("<?>")
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def decode(elf, payload):
+    rec = base64.b64decode(payload)
+    length, level, fmt_addr, tag_addr, ms = HDR.unpack_from(rec)
+    fmt = elf.string(fmt_addr)
+    tag = elf.string(tag_addr) or "0x%08x" % tag_addr
+    letter = BLOG_LEVELS.get(level & ~BLOG_TRUNCATED, "?")
+    if fmt is None:
+        msg = "<unknown format 0x%08x, wrong ELF?>" % fmt_addr
+    else:
+        msg = format_c(fmt, Args(rec[HDR.size:length]))
+    if level & BLOG_TRUNCATED:
+        msg += " <truncated>"
+    return f"{letter} ({ms}) {tag}: {msg}"
+
+
+def lines_from(args):
+    if args.port:
+        try:
+            import serial
+        except ImportError:
+            print("Install pyserial: pip install pyserial")
+            sys.exit(1)
+        with serial.Serial(args.port, args.baud, timeout=1) as port:
+            while True:
+                raw = port.readline()
+                if raw:
+                    yield raw.decode("utf-8", "replace")
+    else:
+        with (open(args.input, errors="replace") if args.input
+              else sys.stdin) as f:
+            yield from f
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Binary log decoder")
+    parser.add_argument("elf", help="ELF of the running firmware")
+    parser.add_argument("input", nargs="?",
+                        help="captured output (default: stdin)")
+    parser.add_argument("-p", "--port", help="read from a serial port")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    elf_id = hashlib.sha256(elf.data).hexdigest()
+
+    for line in lines_from(args):
+        line = line.rstrip("\r\n")
+        # Tolerate a prefix, e.g. timestamps added by a terminal program
+        pos = line.find("#B:")
+        if pos < 0:
+            print(line, flush=True)
+            continue
+        body = line[pos + 3:]
+        if body.startswith("elf="):
+            if not elf_id.startswith(body[4:]):
+                print(f"blog_decode: device runs ELF {body[4:]}, "
+                      f"{args.elf} is {elf_id[:16]}", file=sys.stderr)
+        elif body.startswith("dropped="):
+            print(f"blog_decode: {body[8:]} records lost (ring full)",
+                  file=sys.stderr)
+        else:
+            try:
+                print(decode(elf, body), flush=True)
+            except (ValueError, struct.error):
+                print(line, flush=True)
+
+
+if __name__ == "__main__":
+    main()
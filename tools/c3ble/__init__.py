@@ -0,0 +1,23 @@
+"""Python client for the ESP32-C3-BLE custom service.
+
+    import asyncio, c3ble
+
+    async def main():
+        async with c3ble.connect() as dev:      # or connect(mock=True)
+            print(await dev.get_many(["temperature", "pressure", "battery"]))
+            await dev.set("display_mode", "blank")
+
+    asyncio.run(main())
+
+codec decodes and encodes every characteristic, Client keeps one
+connection for any number of operations, and `python -m c3ble` is a shell
+on top of it.  Run from tools/, or with tools/ on PYTHONPATH, so the
+generated gatt_chrs module is found.
+"""
+
+from .client import Client, connect
+from .mock import MockTransport
+from .transport import BleakTransport, Transport
+
+__all__ = ["Client", "connect", "MockTransport", "BleakTransport",
+           "Transport"]
@@ -0,0 +1,82 @@
+"""python -m c3ble: run commands over one connection.
+
+    python -m c3ble get temperature pressure battery\; set mode blank
+    python -m c3ble "get temperature battery; set mode blank"
+    python -m c3ble -f setup.txt          # one command per line
+    python -m c3ble                       # interactive
+    python -m c3ble --mock bench 20       # no adapter needed
+"""
+
+import argparse
+import asyncio
+import shlex
+import sys
+
+from . import connect
+from .shell import HELP, Shell
+
+
+def join(words):
+    """argv -> command text, keeping quoted arguments whole.  A ';' is a
+    word of its own or ends one ('get battery;')."""
+    out = []
+    for w in words:
+        if w.rstrip(";"):
+            out.append(shlex.quote(w.rstrip(";")))
+        if w.endswith(";"):
+            out.append(";")
+    return " ".join(out)
+
+
+async def run(args):
+    kwargs = {"interval_ms": args.interval} if args.mock else \
+        {"cached": args.cached}
+    async with connect(args.address, mock=args.mock, **kwargs) as client:
+        print(f"Connected to {client.address}", file=sys.stderr)
+        shell = Shell(client)
+        if len(args.command) == 1:
+            text = args.command[0]
+        elif args.command:
+            text = join(args.command)
+        elif args.file:
+            with open(args.file) as f:
+                text = f.read()
+        elif not sys.stdin.isatty():
+            text = sys.stdin.read()
+        else:
+            await shell.interact()
+            return 0
+        return 1 if await shell.run_text(text, args.keep_going) else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        prog="python -m c3ble",
+        description="Run commands on ESP32-C3-BLE over one connection.",
+        epilog="commands (separate several with ';'):\n" + HELP,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--address", help="device address (default: scan "
+                                          "for the device name)")
+    parser.add_argument("--mock", action="store_true",
+                        help="talk to a simulated device")
+    parser.add_argument("--interval", type=float, default=30,
+                        help="with --mock: connection interval in ms "
+                             "(default 30)")
+    parser.add_argument("--cached", action="store_true",
+                        help="BlueZ: reuse cached services (bonded only)")
+    parser.add_argument("-f", "--file", help="read commands from a file")
+    parser.add_argument("-k", "--keep-going", action="store_true",
+                        help="carry on after a command fails")
+    parser.add_argument("command", nargs=argparse.REMAINDER,
+                        help="commands to run instead of reading them")
+    args = parser.parse_args()
+    try:
+        sys.exit(asyncio.run(run(args)))
+    except KeyboardInterrupt:
+        sys.exit(130)
+    except (ConnectionError, RuntimeError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+
+main()
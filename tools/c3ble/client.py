@@ -0,0 +1,161 @@
+"""One connection to the device, shared by any number of operations."""
+
+import asyncio
+import time
+
+import gatt_chrs as chrs
+
+from . import codec
+from .transport import BleakTransport
+
+
+def _chr(c):
+    return codec.find(c) if isinstance(c, str) else c
+
+
+class Client:
+    """Reads, writes and subscriptions over one connection.
+
+    Use as an async context manager.  Characteristics are given as
+    gatt_chrs entries or by name ("battery", "display-mode").  The *_many
+    methods issue their requests together: ATT still serves one at a time,
+    but the next is already queued when the previous response arrives, so
+    the host's turnaround between them no longer costs a connection event.
+    """
+
+    def __init__(self, transport):
+        self.transport = transport
+        self._listeners = {}        # uuid: [callback(bytes)]
+        self._token = int(time.monotonic() * 1000) & 0xFF
+
+    async def __aenter__(self):
+        await self.transport.connect()
+        return self
+
+    async def __aexit__(self, *exc):
+        await self.transport.disconnect()
+        self._listeners.clear()
+
+    @property
+    def address(self):
+        return self.transport.address
+
+    @property
+    def is_connected(self):
+        return self.transport.is_connected
+
+    # ---- Values -------------------------------------------------------------
+
+    async def read(self, c):
+        """The raw bytes of c."""
+        return await self.transport.read(_chr(c).uuid)
+
+    async def get(self, c):
+        """The decoded value of c (see codec.decode)."""
+        c = _chr(c)
+        return codec.decode(c, await self.transport.read(c.uuid))
+
+    async def read_many(self, cs):
+        """The raw bytes of each of cs, read in one pipelined batch."""
+        return await asyncio.gather(*(self.read(c) for c in cs))
+
+    async def get_many(self, cs):
+        """{id: decoded value} for each of cs, read in one batch."""
+        cs = [_chr(c) for c in cs]
+        data = await self.read_many(cs)
+        return {c.id: codec.decode(c, d) for c, d in zip(cs, data)}
+
+    async def write(self, c, data, response=True):
+        await self.transport.write(_chr(c).uuid, data, response=response)
+
+    async def set(self, c, value):
+        """Encode value (see codec.encode) and write it to c."""
+        c = _chr(c)
+        await self.transport.write(c.uuid, codec.encode(c, value))
+
+    # ---- Notifications ------------------------------------------------------
+
+    def _dispatch(self, uuid, data):
+        for cb in list(self._listeners.get(uuid, ())):
+            cb(data)
+
+    async def _listen(self, c, cb):
+        """Add a listener; the first one subscribes, and the subscription
+        then stays for the rest of the session."""
+        if c.uuid not in self._listeners:
+            self._listeners[c.uuid] = []
+            await self.transport.start_notify(c.uuid, self._dispatch)
+        self._listeners[c.uuid].append(cb)
+
+    def _unlisten(self, c, cb):
+        self._listeners[c.uuid].remove(cb)
+
+    async def notifications(self, c):
+        """Yield the decoded value of every notification or indication of
+        c until the caller stops iterating."""
+        c = _chr(c)
+        queue = asyncio.Queue()
+        await self._listen(c, queue.put_nowait)
+        try:
+            while True:
+                yield codec.decode(c, await queue.get())
+        finally:
+            self._unlisten(c, queue.put_nowait)
+
+    # ---- Control point ------------------------------------------------------
+
+    async def control(self, items, check=False, timeout=5):
+        """Send (name, device value) pairs, or 'NAME=VALUE' strings, as one
+        control point request; returns the decoded response."""
+        items = [codec.parse_control(i) if isinstance(i, str) else i
+                 for i in items]
+        op = codec.CTRL_OP_CHECK if check else codec.CTRL_OP_APPLY
+        self._token = (self._token + 1) & 0xFF
+        token = self._token
+        reply = asyncio.get_running_loop().create_future()
+
+        def on_reply(data):
+            r = codec.decode_control(data)
+            if r and r["token"] == token and not reply.done():
+                reply.set_result(r)
+
+        await self._listen(chrs.CONTROL, on_reply)
+        try:
+            await self.transport.write(
+                chrs.CONTROL.uuid, codec.control_request(items, op, token))
+            return await asyncio.wait_for(reply, timeout)
+        finally:
+            self._unlisten(chrs.CONTROL, on_reply)
+
+    async def sync_time(self):
+        """Set the clock and timezone from the host in one request."""
+        return await self.control([("time", int(time.time())),
+                                   ("tz", codec.host_tz())])
+
+    # ---- Rollup -------------------------------------------------------------
+
+    async def rollup(self, level, start, end=0xFFFFFFFF):
+        """Yield the slots of one rollup level from start to end, a page
+        per write and read."""
+        if isinstance(level, str):
+            level = codec.ROLLUP_LEVELS[level]
+        while True:
+            await self.transport.write(chrs.ROLLUP.uuid,
+                                       codec.rollup_request(level, start,
+                                                            end))
+            r = codec.decode(chrs.ROLLUP,
+                             await self.transport.read(chrs.ROLLUP.uuid))
+            for s in r["slots"]:
+                yield s
+            if len(r["slots"]) < codec.ROLLUP_READ_MAX:
+                return
+            start = r["slots"][-1]["start"] + 1
+
+
+def connect(address=None, mock=False, **kwargs):
+    """A Client for the device at address (or the first advertising
+    ESP32-C3-BLE), or for a simulated one; use with async with."""
+    if mock:
+        from .mock import MockTransport
+        return Client(MockTransport(**kwargs))
+    return Client(BleakTransport(address, **kwargs))
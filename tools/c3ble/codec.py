@@ -0,0 +1,628 @@
+"""Wire formats of the device: decoding, encoding and formatting.
+
+Every tool decodes through here, so the struct formats, enums and scaling
+(the battery's voltage divider, pressure in Pa, the timezone in
+quarter-hours) live in one place next to the generated gatt_chrs table:
+the custom service's characteristics, the advertised manufacturer data,
+the L2CAP bulk channel, the binary log and the OTA service.  The
+compressed history blocks are the one exception: tscodec.py decodes them,
+as the reference for main/tscodec.c.
+
+decode() returns plain Python values -- a number in the characteristic's
+unit, a dict for structured values, a list of dicts for tables -- and
+encode() takes what a user types.
+"""
+
+import base64
+import struct
+import time
+from datetime import datetime, timezone
+
+import gatt_chrs as chrs
+
+DEVICE_NAME = "ESP32-C3-BLE"
+
+DISPLAY_MODES = {"normal": 0, "button": 1, "blank": 2}
+PROFILES = {"normal": 0, "fast": 1, "slow": 2}  # sampling and advertising
+
+
+def _name(names, value):
+    return next((k for k, v in names.items() if v == value), value)
+
+
+# ---- Time and timezone ------------------------------------------------------
+
+def parse_tz(s):
+    """Parse a timezone string like '+5', '-4:30', '+5:45' into quarter-hours."""
+    s = s.strip()
+    if ":" in s:
+        hours_s, mins_s = s.split(":", 1)
+        hours = int(hours_s)
+        mins = int(mins_s)
+        if hours < 0 or hours_s.startswith("-"):
+            mins = -mins
+    else:
+        hours = int(s)
+        mins = 0
+    total_minutes = hours * 60 + mins
+    if total_minutes % 15 != 0:
+        raise ValueError(f"{s} is not a multiple of 15 minutes")
+    return total_minutes // 15
+
+
+def format_tz(quarter_hours):
+    """Format quarter-hours as UTC offset string."""
+    total_minutes = quarter_hours * 15
+    sign = "+" if total_minutes >= 0 else "-"
+    total_minutes = abs(total_minutes)
+    hours = total_minutes // 60
+    mins = total_minutes % 60
+    if mins:
+        return f"UTC{sign}{hours}:{mins:02d}"
+    return f"UTC{sign}{hours}"
+
+
+def host_tz():
+    """The host's UTC offset in quarter-hours."""
+    local_dt = datetime.now(timezone.utc).astimezone()
+    return int(local_dt.utcoffset().total_seconds() // 900)
+
+
+# ---- Derived ----------------------------------------------------------------
+
+# struct derived in main/derived.h
+TRENDS = ["unknown (<3 h of data)", "steady", "rising", "falling"]
+FORECASTS = {
+    "A": "Settled fine", "B": "Fine weather", "C": "Becoming fine",
+    "D": "Fine, becoming less settled", "E": "Fine, possible showers",
+    "F": "Fairly fine, improving",
+    "G": "Fairly fine, possible showers early",
+    "H": "Fairly fine, showery later", "I": "Showery early, improving",
+    "J": "Changeable, mending", "K": "Fairly fine, showers likely",
+    "L": "Rather unsettled, clearing later",
+    "M": "Unsettled, probably improving", "N": "Showery, bright intervals",
+    "O": "Showery, becoming less settled", "P": "Changeable, some rain",
+    "Q": "Unsettled, short fine intervals", "R": "Unsettled, rain later",
+    "S": "Unsettled, rain at times", "T": "Very unsettled, finer at times",
+    "U": "Rain at times, worse later",
+    "V": "Rain at times, becoming very unsettled",
+    "W": "Rain at frequent intervals", "X": "Very unsettled, rain",
+    "Y": "Stormy, possibly improving", "Z": "Stormy, much rain",
+}
+
+
+def decode_derived(data):
+    dew, ah, tend, trend, fc, alt, p0 = struct.unpack(chrs.DERIVED.fmt, data)
+    return {"dew_point": dew / 100, "abs_humidity": ah / 100,
+            "tendency": tend / 100, "trend": trend,
+            "forecast": fc.decode(errors="replace"),
+            "altitude": alt / 10, "sea_level": p0 / 100}
+
+
+def format_derived(d):
+    trend = d["trend"]
+    fc = d["forecast"]
+    return "\n".join([
+        f"Dew point:     {d['dew_point']:.2f} °C",
+        f"Abs humidity:  {d['abs_humidity']:.2f} g/m³",
+        f"Trend (3 h):   {TRENDS[trend] if trend < len(TRENDS) else trend}"
+        + (f", {d['tendency']:+.1f} hPa" if trend else ""),
+        f"Forecast:      {fc} {FORECASTS.get(fc, '')}",
+        f"Altitude:      {d['altitude']:.1f} m "
+        f"(sea level {d['sea_level']:.2f} hPa)",
+    ])
+
+
+# ---- Control point ----------------------------------------------------------
+
+# main/ctrl.h.  Items are applied all or nothing, and the one indication in
+# reply has a status per item.
+CTRL_OP_APPLY, CTRL_OP_CHECK, CTRL_OP_RESPONSE = 0x01, 0x02, 0x80
+CTRL_ITEMS = {              # name: (type, value format)
+    "time": (0x01, "<q"), "tz": (0x02, "<b"), "mode": (0x03, "<B"),
+    "sample": (0x04, "<B"), "adv": (0x05, "<B"), "sea": (0x06, "<I"),
+}
+CTRL_RESULTS = ["ok", "unknown opcode", "malformed request",
+                "rejected, nothing changed"]
+CTRL_STATUS = ["ok", "unknown type", "bad length", "out of range",
+               "duplicate", "not applied"]
+
+
+def parse_control(spec):
+    """'NAME=VALUE' -> (name, device value)."""
+    name, _, val = spec.partition("=")
+    if name not in CTRL_ITEMS or not val:
+        raise ValueError(f"bad item {spec!r}: expected NAME=VALUE with NAME "
+                         f"in {', '.join(CTRL_ITEMS)}")
+    try:
+        if name == "time":
+            return name, int(time.time()) if val == "now" else int(val)
+        if name == "tz":
+            return name, host_tz() if val == "local" else parse_tz(val)
+        if name == "mode":
+            return name, DISPLAY_MODES[val]
+        if name in ("sample", "adv"):
+            return name, PROFILES[val]
+        return name, round(float(val) * 100)     # sea, hPa
+    except KeyError:
+        raise ValueError(f"bad value {val!r} for {name}") from None
+
+
+def control_request(items, op, token):
+    """Encode (name, device value) pairs as one control point request."""
+    req = bytes([op, token])
+    for name, value in items:
+        kind, fmt = CTRL_ITEMS[name]
+        val = struct.pack(fmt, value)
+        req += bytes([kind, len(val)]) + val
+    return req
+
+
+def decode_control(data):
+    """A control point response -> dict, or None if it is not one."""
+    if len(data) < 4 or data[0] != CTRL_OP_RESPONSE:
+        return None
+    names = {v[0]: k for k, v in CTRL_ITEMS.items()}
+    return {"token": data[1], "op": data[2], "result": data[3],
+            "items": [(names.get(data[i], data[i]), data[i + 1])
+                      for i in range(4, len(data) - 1, 2)]}
+
+
+def format_control(r):
+    lines = [f"  {name}: {CTRL_STATUS[st] if st < len(CTRL_STATUS) else st}"
+             for name, st in r["items"]]
+    res = r["result"]
+    lines.append(f"{'Check' if r['op'] == CTRL_OP_CHECK else 'Apply'}: "
+                 f"{CTRL_RESULTS[res] if res < len(CTRL_RESULTS) else res}")
+    return "\n".join(lines)
+
+
+# ---- Rules and alarm --------------------------------------------------------
+
+# struct rule and the RULES_* constants in main/rules.h.  Thresholds are
+# given in display units and scaled to what the device compares.
+RULE_FMT = "<BBBBiIHH"
+RULE_SIZE = struct.calcsize(RULE_FMT)
+RULE_METRICS = {            # name: (index, device units per display unit)
+    "temp": (0, 100), "hum": (1, 100), "press": (2, 100), "batt": (3, 1),
+    "dew": (4, 100), "tendency": (5, 100), "alt": (6, 10),
+}
+RULE_UNITS = {"temp": "°C", "hum": "%", "press": "hPa", "batt": "mV",
+              "dew": "°C", "tendency": "hPa", "alt": "m"}
+RULE_OPS = [">", "<", "rate>", "rate<"]
+RULE_ACTIONS = {"display": 0x01, "adv": 0x02, "led": 0x04, "indicate": 0x08}
+RULE_ENABLED = 0x01
+
+
+def parse_rule(spec):
+    """'METRIC OP VALUE [hyst=H] [for=S] [do=A,B] [off]' -> packed rule."""
+    words = spec.split()
+    if len(words) < 3 or words[0] not in RULE_METRICS \
+            or words[1] not in RULE_OPS:
+        raise ValueError(f"bad rule {spec!r}: expected METRIC OP VALUE with "
+                         f"METRIC in {', '.join(RULE_METRICS)} and OP in "
+                         f"{' '.join(RULE_OPS)}")
+    metric, scale = RULE_METRICS[words[0]]
+    threshold = round(float(words[2]) * scale)
+    hyst, duration, actions, flags = 0, 0, 0, RULE_ENABLED
+    for w in words[3:]:
+        key, _, val = w.partition("=")
+        if key == "hyst":
+            hyst = round(float(val) * scale)
+        elif key == "for":
+            duration = int(val)
+        elif key == "do":
+            for a in val.split(","):
+                if a not in RULE_ACTIONS:
+                    raise ValueError(f"unknown action {a!r}")
+                actions |= RULE_ACTIONS[a]
+        elif key == "off":
+            flags = 0
+        else:
+            raise ValueError(f"unknown option {w!r}")
+    return struct.pack(RULE_FMT, metric, RULE_OPS.index(words[1]), actions,
+                       flags, threshold, hyst, duration, 0)
+
+
+def decode_rules(data):
+    out = []
+    for off in range(0, len(data) - RULE_SIZE + 1, RULE_SIZE):
+        metric, op, actions, flags, threshold, hyst, duration, _ = \
+            struct.unpack_from(RULE_FMT, data, off)
+        name = _name({k: v[0] for k, v in RULE_METRICS.items()}, metric)
+        scale = RULE_METRICS[name][1] if name in RULE_METRICS else 1
+        out.append({"metric": name,
+                    "op": RULE_OPS[op] if op < len(RULE_OPS) else op,
+                    "threshold": threshold / scale, "hyst": hyst / scale,
+                    "for": duration,
+                    "do": [k for k, v in RULE_ACTIONS.items() if actions & v],
+                    "enabled": bool(flags & RULE_ENABLED)})
+    return out
+
+
+def format_rule(r):
+    if r["metric"] not in RULE_METRICS or r["op"] not in RULE_OPS:
+        return f"<unknown metric {r['metric']} op {r['op']}>"
+    unit = RULE_UNITS[r["metric"]] + ("/h" if r["op"].startswith("rate")
+                                      else "")
+    return (f"{r['metric']} {r['op']} {r['threshold']:g} {unit}"
+            f", hyst {r['hyst']:g}, for {r['for']} s"
+            f", do {','.join(r['do']) or '-'}"
+            + ("" if r["enabled"] else ", disabled"))
+
+
+def decode_alarm(data):
+    active, fired, cleared, actions, t = chrs.ALARM.decode(data)
+    return {"active": active, "fired": fired, "cleared": cleared,
+            "actions": actions, "time": t}
+
+
+def format_alarm(a):
+    when = time.ctime(a["time"]) if a["time"] else "never"
+    return (f"active 0x{a['active']:02x} fired 0x{a['fired']:02x} "
+            f"cleared 0x{a['cleared']:02x} actions 0x{a['actions']:02x} "
+            f"({when})")
+
+
+# ---- Schedule and profile ---------------------------------------------------
+
+# struct sched_entry and struct sched_status in main/sched.h
+SCHED_FMT = "<BxH4B"
+SCHED_SIZE = struct.calcsize(SCHED_FMT)
+SCHED_KEEP = 0xFF
+SCHED_DAYS = ["sun", "mon", "tue", "wed", "thu", "fri", "sat"]
+SCHED_DAY_SETS = {"daily": 0x7F, "weekdays": 0x3E, "weekends": 0x41}
+SCHED_SETTINGS = {"display": DISPLAY_MODES, "sample": PROFILES,
+                  "adv": PROFILES}
+
+
+def parse_days(spec):
+    """'daily', 'weekdays', 'weekends' or 'mon-fri,sun' -> day bits."""
+    if spec in SCHED_DAY_SETS:
+        return SCHED_DAY_SETS[spec]
+    bits = 0
+    for part in spec.split(","):
+        first, _, last = part.partition("-")
+        a, b = SCHED_DAYS.index(first), SCHED_DAYS.index(last or first)
+        for d in range(a, b + 1 if b >= a else b + 8):
+            bits |= 1 << (d % 7)
+    return bits
+
+
+def parse_schedule(spec):
+    """'HH:MM DAYS [display=M] [sample=P] [adv=P]' -> packed entry."""
+    words = spec.split()
+    try:
+        hh, mm = (int(x) for x in words[0].split(":"))
+        days = parse_days(words[1])
+    except (IndexError, ValueError):
+        raise ValueError(f"bad entry {spec!r}: expected HH:MM DAYS with DAYS "
+                         f"daily, weekdays, weekends or e.g. mon-fri,sun")
+    settings = dict.fromkeys(SCHED_SETTINGS, SCHED_KEEP)
+    for w in words[2:]:
+        key, _, val = w.partition("=")
+        if key not in SCHED_SETTINGS or val not in SCHED_SETTINGS[key]:
+            raise ValueError(f"bad setting {w!r}: expected "
+                             + ", ".join(f"{k}={'|'.join(v)}"
+                                         for k, v in SCHED_SETTINGS.items()))
+        settings[key] = SCHED_SETTINGS[key][val]
+    return struct.pack(SCHED_FMT, days, hh * 60 + mm, settings["display"],
+                       settings["sample"], settings["adv"], 0)
+
+
+def _settings(display, sample, adv):
+    """Setting values -> names, None for those an entry keeps."""
+    return {key: None if v == SCHED_KEEP else _name(names, v)
+            for (key, names), v in zip(SCHED_SETTINGS.items(),
+                                       (display, sample, adv))}
+
+
+def format_settings(s):
+    return " ".join(f"{k}={v}" for k, v in s.items()
+                    if v is not None) or "(no change)"
+
+
+def decode_schedule(data):
+    out = []
+    for off in range(0, len(data) - SCHED_SIZE + 1, SCHED_SIZE):
+        days, start, display, sample, adv, _ = \
+            struct.unpack_from(SCHED_FMT, data, off)
+        out.append({"days": [d for i, d in enumerate(SCHED_DAYS)
+                             if days & (1 << i)],
+                    "start": f"{start // 60:02}:{start % 60:02}",
+                    **_settings(display, sample, adv)})
+    return out
+
+
+def format_schedule(e):
+    s = {k: e[k] for k in SCHED_SETTINGS}
+    return f"{e['start']} {','.join(e['days'])}  {format_settings(s)}"
+
+
+def decode_profile(data):
+    entry, display, sample, adv, since, nxt = chrs.PROFILE.decode(data)
+    return {"entry": None if entry == SCHED_KEEP else entry,
+            **_settings(display, sample, adv), "since": since, "next": nxt}
+
+
+def format_profile(p):
+    if p["entry"] is None:
+        return "no entry in force (empty schedule or clock not set)"
+    s = {k: p[k] for k in SCHED_SETTINGS}
+    return (f"entry {p['entry']}: {format_settings(s)} since "
+            f"{time.ctime(p['since'])}, next switch {time.ctime(p['next'])}")
+
+
+# ---- Rollup -----------------------------------------------------------------
+
+# struct rollup_request / rollup_reply in main/gatt_svc.c, struct
+# rollup_slot in main/rollup.h
+ROLLUP_LEVELS = {"10min": 0, "hour": 1, "day": 2}
+ROLLUP_REQ_FMT = "<B3xII"
+ROLLUP_REPLY_FMT = "<BBH"
+ROLLUP_SLOT_FMT = "<IH3h3H3I2x"
+ROLLUP_SLOT_SIZE = struct.calcsize(ROLLUP_SLOT_FMT)
+ROLLUP_READ_MAX = 15        # slots per read
+
+
+def rollup_request(level, start, end=0xFFFFFFFF):
+    return struct.pack(ROLLUP_REQ_FMT, level, start, end)
+
+
+def decode_rollup(data):
+    level, count, total = struct.unpack_from(ROLLUP_REPLY_FMT, data)
+    off = struct.calcsize(ROLLUP_REPLY_FMT)
+    slots = []
+    for i in range(count):
+        t, n, *v = struct.unpack_from(ROLLUP_SLOT_FMT, data,
+                                      off + i * ROLLUP_SLOT_SIZE)
+        slots.append({"start": t, "count": n,
+                      "temp": [x / 100 for x in v[0:3]],
+                      "hum": [x / 100 for x in v[3:6]],
+                      "press": [x / 100 for x in v[6:9]]})
+    return {"level": level, "total": total, "slots": slots}
+
+
+# ---- Power ------------------------------------------------------------------
+
+# struct powerstat in main/powerstat.h
+POWER_FIELDS = ("uptime_s", "display_on_s", "adv_s", "conn_s", "samples",
+                "flushes", "notifies")
+
+
+# ---- Advertising ------------------------------------------------------------
+
+# Manufacturer data in the scan response (main/adv.h)
+COMPANY_ID = 0xFFFF
+MFG_VERSION = 1
+MFG_FMT = "<BBhHBH"         # version, seq, temp, press, hum, batt
+MFG_LEN = struct.calcsize(MFG_FMT)
+MFG_ALARM = MFG_LEN         # optional byte: bit per active alarm rule
+
+
+def decode_mfg(data):
+    """Manufacturer data -> (seq, sample dict, alarm bits), or None if it
+    isn't ours.  The sample has the keys fleet_collector.py stores."""
+    if len(data) < MFG_LEN or data[0] != MFG_VERSION:
+        return None
+    _, seq, temp, press, hum, batt = struct.unpack_from(MFG_FMT, data)
+    return seq, {
+        "temp_c": None if temp == -0x8000 else temp / 100.0,
+        "press_hpa": None if press == 0xFFFF else press / 10.0,
+        "humidity": None if hum == 0xFF else float(hum),
+        "batt_mv": batt * chrs.BATTERY.scale,
+    }, data[MFG_ALARM] if len(data) > MFG_ALARM else 0
+
+
+# ---- Bulk transfer ----------------------------------------------------------
+
+# Frames on the L2CAP channel (main/coc_proto.h)
+COC_PSM = 0x80              # CONFIG_APP_COC_PSM
+COC_SDU_MAX = 1024          # largest frame the device sends (main/coc.c)
+COC_OP_LIST, COC_OP_GET, COC_OP_LINK, COC_OP_ABORT = 0x01, 0x02, 0x03, 0x04
+COC_OP_STREAMS, COC_OP_BEGIN, COC_OP_DATA = 0x81, 0x82, 0x83
+COC_OP_END, COC_OP_RSP = 0x84, 0x85
+COC_STATUS = ["ok", "bad request", "unknown stream", "busy", "aborted",
+              "failed"]
+COC_PHYS = {"1m": 1, "2m": 2, "coded": 4}     # LINK request bits
+COC_PHY_NAMES = {1: "1M", 2: "2M", 3: "coded"}  # END fields
+COC_GET_FMT = "<BII"        # op, offset, length; the name follows
+COC_LINK_FMT = "<BHB"       # op, interval (1.25 ms), PHY bits
+COC_END_FMT = "<BIIIHBB"    # after the op: status, sent, crc, ms, itvl, phys
+COC_END_FIELDS = ("status", "sent", "crc", "ms", "itvl", "tx_phy", "rx_phy")
+TRACE_HDR_FMT = "<BBI"      # struct trace_rec header (main/trace.h)
+TRACE_HDR_SIZE = struct.calcsize(TRACE_HDR_FMT)
+
+
+def coc_status(status):
+    return COC_STATUS[status] if status < len(COC_STATUS) else str(status)
+
+
+def coc_get(name, offset=0, length=0xFFFFFFFF):
+    return struct.pack(COC_GET_FMT, COC_OP_GET, offset, length) + name.encode()
+
+
+def coc_link(itvl, phys):
+    return struct.pack(COC_LINK_FMT, COC_OP_LINK, itvl, phys)
+
+
+def decode_streams(frame):
+    """A STREAMS frame -> [(name, size)]."""
+    streams, pos = [], 2
+    for _ in range(frame[1]):
+        n = frame[pos]
+        name = frame[pos + 1:pos + 1 + n].decode()
+        size, = struct.unpack_from("<I", frame, pos + 1 + n)
+        streams.append((name, size))
+        pos += 1 + n + 4
+    return streams
+
+
+def decode_begin(frame):
+    """A BEGIN frame -> (status, announced size)."""
+    size, = struct.unpack_from("<I", frame, 2) if len(frame) >= 6 else (0,)
+    return frame[1], size
+
+
+def decode_end(frame):
+    return dict(zip(COC_END_FIELDS,
+                    struct.unpack_from(COC_END_FMT, frame, 1)))
+
+
+def trace_lines(data):
+    """The trace stream as "#T:" lines for host/replay."""
+    pos = 0
+    while pos + TRACE_HDR_SIZE <= len(data):
+        _, n, _ = struct.unpack_from(TRACE_HDR_FMT, data, pos)
+        rec = data[pos:pos + TRACE_HDR_SIZE + n]
+        yield "#T:" + base64.b64encode(rec).decode()
+        pos += len(rec)
+
+
+def log_lines(data):
+    """The logs stream as "#B:" lines for blog_decode.py: the ELF hash,
+    then one line per record."""
+    yield "#B:elf=" + data[:16].decode()
+    pos = 16
+    while pos < len(data) and data[pos]:
+        yield "#B:" + base64.b64encode(data[pos:pos + data[pos]]).decode()
+        pos += data[pos]
+
+
+# ---- Binary log -------------------------------------------------------------
+
+# Record header written by blog_begin() (main/blog.c)
+BLOG_HDR_FMT = "<BBIII"     # length, level, format, tag, ms
+BLOG_HDR_SIZE = struct.calcsize(BLOG_HDR_FMT)
+BLOG_LEVELS = {1: "E", 2: "W", 3: "I", 4: "D", 5: "V"}
+BLOG_TRUNCATED = 0x80       # level flag: arguments cut short
+
+
+# ---- OTA --------------------------------------------------------------------
+
+# The OTA service (main/ota_svc.c, main/ota_proto.h) is outside the
+# generated table.
+OTA_CTRL_UUID = "deadbeef-2001-2000-3000-aabbccddeeff"
+OTA_DATA_UUID = "deadbeef-2002-2000-3000-aabbccddeeff"
+OTA_OP_BEGIN, OTA_OP_STATUS, OTA_OP_FINISH, OTA_OP_ABORT = 1, 2, 3, 4
+OTA_OP_RSP, OTA_OP_ACK, OTA_OP_NAK = 0x10, 0x11, 0x12
+OTA_STATUS = ["ok", "bad request", "bad state", "too large", "flash error",
+              "hash mismatch"]
+OTA_BEGIN_FMT = "<BI32sH"   # op, size, sha256, window
+OTA_RSP_FMT = "<BBBI"       # RSP, request op, status, offset
+OTA_DATA_HDR = 4            # u32 offset in front of each chunk
+
+
+def ota_status(status):
+    return OTA_STATUS[status] if status < len(OTA_STATUS) else str(status)
+
+
+def ota_begin(size, sha, window):
+    return struct.pack(OTA_BEGIN_FMT, OTA_OP_BEGIN, size, sha, window)
+
+
+def ota_data(offset, chunk):
+    return struct.pack("<I", offset) + chunk
+
+
+def decode_ota(msg):
+    """A control notification -> dict with op, and status and offset (RSP)
+    or offset (ACK, NAK)."""
+    if msg[0] == OTA_OP_RSP:
+        _, req, status, offset = struct.unpack_from(OTA_RSP_FMT, msg)
+        return {"op": msg[0], "req": req, "status": status,
+                "offset": offset}
+    return {"op": msg[0], "offset": struct.unpack_from("<I", msg, 1)[0]}
+
+
+# ---- Any characteristic -----------------------------------------------------
+
+_DECODERS = {
+    chrs.DERIVED: decode_derived,
+    chrs.ALARM: decode_alarm,
+    chrs.PROFILE: decode_profile,
+    chrs.POWER: lambda d: dict(zip(POWER_FIELDS, chrs.POWER.decode(d))),
+    chrs.RULES: decode_rules,
+    chrs.SCHEDULE: decode_schedule,
+    chrs.ROLLUP: decode_rollup,
+    chrs.CONTROL: decode_control,
+    chrs.DISPLAY_MODE: lambda d: _name(DISPLAY_MODES,
+                                       chrs.DISPLAY_MODE.decode(d)),
+}
+
+
+def decode(c, data):
+    """The value of characteristic c from its bytes."""
+    if c in _DECODERS:
+        return _DECODERS[c](bytes(data))
+    return c.decode(data)
+
+
+def encode(c, value):
+    """Bytes to write to c.  Numbers are in c's unit; strings and lists of
+    strings are parsed the way the shell and ble_test.py take them."""
+    if c is chrs.RULES:
+        return b"".join(parse_rule(s) for s in value)
+    if c is chrs.SCHEDULE:
+        return b"".join(parse_schedule(s) for s in value)
+    if isinstance(value, str):
+        if c is chrs.DISPLAY_MODE and value in DISPLAY_MODES:
+            value = DISPLAY_MODES[value]
+        elif c is chrs.TIME and value == "now":
+            value = int(time.time())
+        elif c is chrs.TIMEZONE:
+            value = (host_tz() if value == "local" else parse_tz(value)) * 15
+        elif not c.fmt:
+            return value.encode()
+        else:
+            value = float(value)
+    return c.encode(value)
+
+
+def format_value(c, value):
+    """value (from decode()) as text for people."""
+    if c is chrs.DERIVED:
+        return format_derived(value)
+    if c is chrs.ALARM:
+        return format_alarm(value)
+    if c is chrs.PROFILE:
+        return format_profile(value)
+    if c is chrs.RULES:
+        return "\n".join(f"{i}: {format_rule(r)}"
+                         for i, r in enumerate(value)) or "(no rules)"
+    if c is chrs.SCHEDULE:
+        return "\n".join(f"{i}: {format_schedule(e)}"
+                         for i, e in enumerate(value)) or "(no schedule)"
+    if c is chrs.TIME:
+        return f"{value} ({time.ctime(value)})"
+    if c is chrs.TIMEZONE:
+        return format_tz(value // 15)
+    if isinstance(value, dict):
+        return " ".join(f"{k}={v}" for k, v in value.items())
+    if isinstance(value, bytes):
+        return value.hex(" ") if value else "(empty)"
+    if isinstance(value, float):
+        return f"{value:.2f} {c.unit}".rstrip()
+    return f"{value} {c.unit}".rstrip()
+
+
+def describe(c, data):
+    """Decode and format in one go."""
+    return format_value(c, decode(c, data))
+
+
+ALIASES = {"temp": "temperature", "hum": "humidity", "press": "pressure",
+           "batt": "battery", "tz": "timezone", "mode": "display_mode",
+           "sea": "sea_level"}
+
+
+def find(name):
+    """A characteristic by its id or a short alias, case- and
+    dash-insensitive."""
+    key = name.lower().replace("-", "_")
+    key = ALIASES.get(key, key).upper()
+    c = getattr(chrs, key, None)
+    if not isinstance(c, chrs.Chr):
+        raise ValueError(f"unknown characteristic {name!r}; one of "
+                         + ", ".join(c.id.lower() for c in chrs.ALL))
+    return c
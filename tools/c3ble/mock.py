@@ -0,0 +1,260 @@
+"""A simulated device, for working on the tools without an adapter.
+
+MockTransport keeps the characteristic values the firmware would and
+applies writes the way main/gatt_svc.c does: the clock, timezone, display
+mode and sea level, the control point (answered with an indication), the
+rule and schedule tables and rollup queries.  Values it doesn't model read
+as their last write.
+
+Timing follows one ATT bearer on a connection with the given interval.
+ATT allows one outstanding request, which goes out at a connection event
+and is answered one interval later.  A request that was already queued
+when the previous response arrived goes out in that same event; one the
+host issues only after seeing the response waits for the next event.
+Every call also costs host_ms outside the bearer, the D-Bus round trip of
+a real stack.  So a loop of reads costs about two intervals each, and the
+same reads issued together about one.
+"""
+
+import asyncio
+import math
+import struct
+import time
+
+import gatt_chrs as chrs
+
+from . import codec
+from .transport import Transport
+
+ATT_ERR_VALUE_NOT_ALLOWED = 0x13
+ATT_ERR_INVALID_LEN = 0x0d
+
+
+class AttError(Exception):
+    """A write the device refuses, with its ATT error code."""
+
+    def __init__(self, code, uuid):
+        super().__init__(f"ATT error 0x{code:02x} writing {uuid}")
+        self.code = code
+
+
+class MockTransport(Transport):
+    address = "mock"
+
+    def __init__(self, interval_ms=30, host_ms=2):
+        self.interval = interval_ms / 1000
+        self.host = host_ms / 1000
+        self.requests = 0           # ATT requests served, for benchmarks
+        self._connected = False
+        self._bearer = asyncio.Lock()
+        self._t0 = 0.0
+        self._last_response = -math.inf
+        self._callbacks = {}
+        self._clock_offset = 0
+        self._tz = 0
+        self._rules = b""
+        self._schedule = b""
+        self._rollup = codec.rollup_request(0, 0)
+        self._values = {
+            chrs.DATA.uuid: b"",
+            chrs.PRESSURE.uuid: struct.pack("<f", 101325.0),
+            chrs.TEMPERATURE.uuid: struct.pack("<f", 21.5),
+            chrs.HUMIDITY.uuid: struct.pack("<f", 45.0),
+            chrs.BATTERY.uuid: chrs.BATTERY.encode(3900),
+            chrs.DISPLAY_MODE.uuid: b"\x00",
+            chrs.SEA_LEVEL.uuid: struct.pack("<I", 101325),
+            chrs.MEMORY.uuid: b"",
+            chrs.POWER.uuid: struct.pack("<7I", 3600, 120, 3600, 60, 360,
+                                         12, 720),
+            chrs.ALARM.uuid: struct.pack("<BBBBI", 0, 0, 0, 0, 0),
+            chrs.PROFILE.uuid: struct.pack("<BBBBII", codec.SCHED_KEEP,
+                                           0, 0, 0, 0, 0),
+        }
+
+    # ---- Bearer -------------------------------------------------------------
+
+    def _next_event(self, t):
+        k = math.ceil((t - self._t0) / self.interval - 1e-9)
+        return self._t0 + k * self.interval
+
+    async def _transact(self):
+        """Wait for the bearer, then one request/response exchange."""
+        loop = asyncio.get_running_loop()
+        await asyncio.sleep(self.host)
+        queued = loop.time()
+        async with self._bearer:
+            if queued <= self._last_response:
+                send = self._last_response
+            else:
+                send = self._next_event(loop.time())
+            response = send + self.interval
+            await asyncio.sleep(max(0.0, response - loop.time()))
+            self._last_response = response
+            self.requests += 1
+
+    # ---- Transport ----------------------------------------------------------
+
+    async def connect(self):
+        await asyncio.sleep(0.1)
+        self._t0 = asyncio.get_running_loop().time()
+        self._last_response = -math.inf
+        self._connected = True
+
+    async def disconnect(self):
+        self._connected = False
+        self._callbacks.clear()
+
+    @property
+    def is_connected(self):
+        return self._connected
+
+    async def read(self, uuid):
+        self._check(uuid)
+        await self._transact()
+        return self._value(uuid)
+
+    async def write(self, uuid, data, response=True):
+        self._check(uuid)
+        if response:
+            await self._transact()
+        else:
+            await asyncio.sleep(self.host)
+        self._apply(uuid, bytes(data))
+
+    async def start_notify(self, uuid, callback):
+        self._check(uuid)
+        await self._transact()      # the CCCD write
+        self._callbacks[uuid] = callback
+
+    async def stop_notify(self, uuid):
+        await self._transact()
+        self._callbacks.pop(uuid, None)
+
+    def notify(self, uuid, data):
+        """Send a notification or indication to the subscriber, if any."""
+        cb = self._callbacks.get(uuid)
+        if cb:
+            asyncio.get_running_loop().call_later(self.interval, cb, uuid,
+                                                  bytes(data))
+
+    def _check(self, uuid):
+        if not self._connected:
+            raise ConnectionError("not connected")
+        if uuid not in chrs.BY_UUID:
+            raise KeyError(f"no characteristic {uuid}")
+
+    # ---- Device -------------------------------------------------------------
+
+    def _value(self, uuid):
+        if uuid == chrs.TIME.uuid:
+            return struct.pack("<q", int(time.time()) + self._clock_offset)
+        if uuid == chrs.TIMEZONE.uuid:
+            return struct.pack("<b", self._tz)
+        if uuid == chrs.RULES.uuid:
+            return self._rules
+        if uuid == chrs.SCHEDULE.uuid:
+            return self._schedule
+        if uuid == chrs.DERIVED.uuid:
+            p0 = struct.unpack("<I", self._values[chrs.SEA_LEVEL.uuid])[0]
+            return struct.pack(chrs.DERIVED.fmt, 1003, 864, 0, 0, b"?", 0,
+                               p0)
+        if uuid == chrs.ROLLUP.uuid:
+            level = self._rollup[0]
+            return struct.pack(codec.ROLLUP_REPLY_FMT, level, 0, 0)
+        return self._values.get(uuid, b"")
+
+    def _apply(self, uuid, data):
+        def refuse(code=ATT_ERR_VALUE_NOT_ALLOWED):
+            raise AttError(code, uuid)
+
+        if uuid == chrs.TIME.uuid:
+            if len(data) != 8:
+                refuse(ATT_ERR_INVALID_LEN)
+            self._clock_offset = struct.unpack("<q", data)[0] \
+                - int(time.time())
+        elif uuid == chrs.TIMEZONE.uuid:
+            if len(data) != 1:
+                refuse(ATT_ERR_INVALID_LEN)
+            tz = struct.unpack("<b", data)[0]
+            if not -48 <= tz <= 56:
+                refuse()
+            self._tz = tz
+        elif uuid == chrs.DISPLAY_MODE.uuid:
+            if len(data) != 1:
+                refuse(ATT_ERR_INVALID_LEN)
+            if data[0] > codec.DISPLAY_MODES["blank"]:
+                refuse()
+            self._values[uuid] = data
+        elif uuid == chrs.SEA_LEVEL.uuid:
+            if len(data) != 4:
+                refuse(ATT_ERR_INVALID_LEN)
+            if not 80000 <= struct.unpack("<I", data)[0] <= 110000:
+                refuse()
+            self._values[uuid] = data
+        elif uuid == chrs.RULES.uuid:
+            if len(data) % codec.RULE_SIZE:
+                refuse(ATT_ERR_INVALID_LEN)
+            self._rules = data
+        elif uuid == chrs.SCHEDULE.uuid:
+            if len(data) % codec.SCHED_SIZE:
+                refuse(ATT_ERR_INVALID_LEN)
+            self._schedule = data
+        elif uuid == chrs.ROLLUP.uuid:
+            if len(data) != struct.calcsize(codec.ROLLUP_REQ_FMT):
+                refuse(ATT_ERR_INVALID_LEN)
+            self._rollup = data
+        elif uuid == chrs.CONTROL.uuid:
+            self._control(data)
+        elif uuid == chrs.DATA.uuid:
+            self._values[uuid] = data
+        else:
+            refuse()
+
+    def _control(self, req):
+        """ctrl_parse() and ctrl_apply() for the types codec knows."""
+        if len(req) < 2:
+            raise AttError(ATT_ERR_INVALID_LEN, chrs.CONTROL.uuid)
+        op, token = req[0], req[1]
+        types = {v[0]: (k, v[1]) for k, v in codec.CTRL_ITEMS.items()}
+        limits = {"time": (0, 0xFFFFFFFF), "tz": (-48, 56), "mode": (0, 2),
+                  "sample": (0, 2), "adv": (0, 2), "sea": (80000, 110000)}
+        items, seen, i = [], set(), 2
+        result = 0 if op in (codec.CTRL_OP_APPLY, codec.CTRL_OP_CHECK) else 1
+        while result == 0 and i < len(req):
+            if i + 2 > len(req) or i + 2 + req[i + 1] > len(req):
+                result = 2
+                break
+            kind, n = req[i], req[i + 1]
+            val = req[i + 2:i + 2 + n]
+            i += 2 + n
+            if kind not in types:
+                items.append([kind, 1, None])
+                continue
+            name, fmt = types[kind]
+            if n != struct.calcsize(fmt):
+                items.append([kind, 2, None])
+                continue
+            v = struct.unpack(fmt, val)[0]
+            lo, hi = limits[name]
+            st = 4 if kind in seen else 0 if lo <= v <= hi else 3
+            seen.add(kind)
+            items.append([kind, st, (name, v)])
+        if result == 0 and any(st for _, st, _ in items):
+            result = 3
+            for it in items:
+                if it[1] == 0:
+                    it[1] = 5
+        if result == 0 and op == codec.CTRL_OP_APPLY:
+            for _, _, (name, v) in items:
+                if name == "time":
+                    self._clock_offset = v - int(time.time())
+                elif name == "tz":
+                    self._tz = v
+                elif name == "mode":
+                    self._values[chrs.DISPLAY_MODE.uuid] = bytes([v])
+                elif name == "sea":
+                    self._values[chrs.SEA_LEVEL.uuid] = struct.pack("<I", v)
+        rsp = bytes([codec.CTRL_OP_RESPONSE, token, op, result])
+        for kind, st, _ in items if result != 1 else []:
+            rsp += bytes([kind, st])
+        self.notify(chrs.CONTROL.uuid, rsp)
@@ -0,0 +1,206 @@
+"""Commands over one connection, typed or scripted.
+
+Commands are separated by newlines or ';', and '#' starts a comment:
+
+    get temperature pressure battery; set mode blank
+    set rules "temp > 30 do=led" "press rate< -2 do=indicate"
+    control time=now tz=local sample=slow
+"""
+
+import asyncio
+import shlex
+import sys
+import time
+
+import gatt_chrs as chrs
+
+from . import codec
+
+HELP = """\
+get NAME...               read and decode (several are read together)
+set NAME VALUE...         encode and write; rules and schedule take one
+                          quoted entry per argument, none to clear
+control NAME=VALUE...     one control point request (time=now, tz=local,
+                          mode=, sample=, adv=, sea=HPA)
+check NAME=VALUE...       as control, validate only
+sync-time                 set clock and timezone from the host
+watch NAME [SECONDS]      print notifications (until Ctrl-C)
+rollup LEVEL [HOURS]      min/mean/max slots: 10min, hour or day
+chrs                      list the characteristics
+bench [N]                 time N reads one by one, then together
+sleep SECONDS
+help"""
+
+
+def split(text):
+    """Text -> a list of commands, each a list of words."""
+    cmds = []
+    for line in text.splitlines():
+        lex = shlex.shlex(line, posix=True, punctuation_chars=";")
+        lex.whitespace_split = True
+        cur = []
+        for tok in lex:
+            if tok.strip(";"):
+                cur.append(tok)
+            elif cur:
+                cmds.append(cur)
+                cur = []
+        if cur:
+            cmds.append(cur)
+    return cmds
+
+
+def _indent(text):
+    return text.replace("\n", "\n  ")
+
+
+class Shell:
+    def __init__(self, client, out=sys.stdout):
+        self.client = client
+        self.out = out
+
+    def print(self, *args):
+        print(*args, file=self.out, flush=True)
+
+    async def run(self, words):
+        """Run one command; raises on errors."""
+        name, args = words[0], words[1:]
+        fn = getattr(self, "cmd_" + name.replace("-", "_"), None)
+        if fn is None:
+            raise ValueError(f"unknown command {name!r}; try help")
+        await fn(*args)
+
+    async def run_text(self, text, keep_going=False):
+        """Run every command in text; returns the number that failed."""
+        failed = 0
+        for words in split(text):
+            try:
+                await self.run(words)
+            except Exception as e:
+                self.print(f"{' '.join(words)}: {e}")
+                failed += 1
+                if not keep_going:
+                    break
+        return failed
+
+    async def interact(self):
+        """Read commands from the terminal until EOF."""
+        try:
+            import readline  # noqa: F401 (line editing for input())
+        except ImportError:
+            pass
+        loop = asyncio.get_running_loop()
+        while True:
+            try:
+                line = await loop.run_in_executor(None, input, "c3ble> ")
+            except EOFError:
+                self.print()
+                return
+            try:
+                await self.run_text(line)
+            except KeyboardInterrupt:
+                pass
+
+    # ---- Commands -----------------------------------------------------------
+
+    async def cmd_help(self):
+        self.print(HELP)
+
+    async def cmd_chrs(self):
+        for c in chrs.ALL:
+            self.print(f"{c.id.lower():13} {c.flags:3} {c.uuid}  {c.name}")
+
+    async def cmd_get(self, *names):
+        if not names:
+            raise ValueError("get NAME...")
+        cs = [codec.find(n) for n in names]
+        values = await self.client.get_many(cs)
+        for c in cs:
+            text = codec.format_value(c, values[c.id])
+            if "\n" in text:
+                self.print(f"{c.name}:\n  {_indent(text)}")
+            else:
+                self.print(f"{c.name}: {text}")
+
+    async def cmd_set(self, name=None, *values):
+        if name is None:
+            raise ValueError("set NAME VALUE...")
+        c = codec.find(name)
+        if c is chrs.CONTROL:
+            return await self.cmd_control(*values)
+        if c in (chrs.RULES, chrs.SCHEDULE):
+            await self.client.set(c, values)
+        elif len(values) != 1:
+            raise ValueError(f"set {name} takes one value")
+        else:
+            await self.client.set(c, values[0])
+        if "r" in c.flags:
+            await self.cmd_get(c.id)
+
+    async def cmd_control(self, *items, check=False):
+        if not items:
+            raise ValueError("control NAME=VALUE...")
+        t0 = time.perf_counter()
+        r = await self.client.control(items, check=check)
+        ms = (time.perf_counter() - t0) * 1000
+        self.print(f"{codec.format_control(r)} (reply in {ms:.0f} ms)")
+        if r["result"]:
+            raise RuntimeError("control point request not applied")
+
+    async def cmd_check(self, *items):
+        await self.cmd_control(*items, check=True)
+
+    async def cmd_sync_time(self):
+        r = await self.client.sync_time()
+        if r["result"]:
+            raise RuntimeError(codec.format_control(r))
+        self.print(f"Time set to {time.ctime()}, timezone "
+                   f"{codec.format_tz(codec.host_tz())}")
+
+    async def cmd_watch(self, name=None, seconds=None):
+        if name is None:
+            raise ValueError("watch NAME [SECONDS]")
+        c = codec.find(name)
+
+        async def loop():
+            async for value in self.client.notifications(c):
+                self.print(f"[{time.strftime('%H:%M:%S')}] {c.name}: "
+                           f"{_indent(codec.format_value(c, value))}")
+
+        try:
+            await asyncio.wait_for(loop(), seconds and float(seconds))
+        except asyncio.TimeoutError:
+            pass
+
+    async def cmd_rollup(self, level=None, hours="24"):
+        if level not in codec.ROLLUP_LEVELS:
+            raise ValueError("rollup 10min|hour|day [HOURS]")
+        now = await self.client.get(chrs.TIME)
+        start = max(0, now - int(float(hours) * 3600))
+        n = 0
+        async for s in self.client.rollup(level, start):
+            t, p = s["temp"], s["press"]
+            stamp = time.strftime("%Y-%m-%d %H:%M", time.gmtime(s["start"]))
+            self.print(f"{stamp}  {s['count']:4}"
+                       f"  temp {t[0]:.2f}/{t[1]:.2f}/{t[2]:.2f}"
+                       f"  hum {s['hum'][1]:.1f}"
+                       f"  press {p[0]:.2f}/{p[1]:.2f}/{p[2]:.2f}")
+            n += 1
+        self.print(f"{n} slot(s)")
+
+    async def cmd_bench(self, n="10"):
+        n = int(n)
+        cs = [chrs.BATTERY] * n
+        t0 = time.perf_counter()
+        for c in cs:
+            await self.client.read(c)
+        t1 = time.perf_counter()
+        await self.client.read_many(cs)
+        t2 = time.perf_counter()
+        self.print(f"{n} reads: one by one {(t1 - t0) * 1000:.0f} ms "
+                   f"({(t1 - t0) * 1000 / n:.1f} ms each), together "
+                   f"{(t2 - t1) * 1000:.0f} ms "
+                   f"({(t2 - t1) * 1000 / n:.1f} ms each)")
+
+    async def cmd_sleep(self, seconds):
+        await asyncio.sleep(float(seconds))
@@ -0,0 +1,111 @@
+"""How a Client reaches the device.
+
+A transport is one connection: read, write and subscribe by characteristic
+UUID.  BleakTransport is the real one; mock.MockTransport stands in for it
+on machines without an adapter.
+"""
+
+import gatt_chrs as chrs
+
+from .codec import DEVICE_NAME
+
+
+class Transport:
+    """The operations a Client needs.  Callbacks get (uuid, bytes)."""
+
+    address = None
+
+    async def connect(self):
+        raise NotImplementedError
+
+    async def disconnect(self):
+        raise NotImplementedError
+
+    @property
+    def is_connected(self):
+        raise NotImplementedError
+
+    async def read(self, uuid):
+        raise NotImplementedError
+
+    async def write(self, uuid, data, response=True):
+        raise NotImplementedError
+
+    async def start_notify(self, uuid, callback):
+        raise NotImplementedError
+
+    async def stop_notify(self, uuid):
+        raise NotImplementedError
+
+
+class BleakTransport(Transport):
+    """A bleak connection to the device, found by address or by name.
+
+    Characteristics are resolved once after discovery and the bleak objects
+    kept, so an operation goes straight to its handle instead of searching
+    the service collection by UUID each time.
+    """
+
+    def __init__(self, address=None, name=DEVICE_NAME, timeout=20,
+                 cached=False):
+        self.address = address
+        self.name = name
+        self.timeout = timeout
+        # BlueZ only: trust services cached from an earlier connection
+        # instead of waiting for discovery; meant for bonded devices.
+        self.cached = cached
+        self._client = None
+        self._handles = {}
+
+    async def connect(self):
+        try:
+            from bleak import BleakClient, BleakScanner
+        except ImportError:
+            raise RuntimeError("Install bleak: pip install bleak") from None
+
+        if self.address:
+            device = await BleakScanner.find_device_by_address(
+                self.address, timeout=self.timeout)
+        else:
+            device = await BleakScanner.find_device_by_name(
+                self.name, timeout=self.timeout)
+        if not device:
+            raise ConnectionError(f"{self.address or self.name} not found. "
+                                  f"Is it advertising?")
+        kwargs = {"dangerous_use_bleak_cache": True} if self.cached else {}
+        # Only the custom service is needed; back ends that can limit
+        # discovery to it do.
+        self._client = BleakClient(device, timeout=self.timeout,
+                                   services=[chrs.SERVICE_UUID], **kwargs)
+        await self._client.connect()
+        self.address = device.address
+        self._handles = {}
+        for c in chrs.ALL:
+            obj = self._client.services.get_characteristic(c.uuid)
+            if obj is not None:
+                self._handles[c.uuid] = obj
+
+    async def disconnect(self):
+        if self._client:
+            await self._client.disconnect()
+
+    @property
+    def is_connected(self):
+        return bool(self._client and self._client.is_connected)
+
+    def _handle(self, uuid):
+        return self._handles.get(uuid, uuid)
+
+    async def read(self, uuid):
+        return bytes(await self._client.read_gatt_char(self._handle(uuid)))
+
+    async def write(self, uuid, data, response=True):
+        await self._client.write_gatt_char(self._handle(uuid), data,
+                                           response=response)
+
+    async def start_notify(self, uuid, callback):
+        await self._client.start_notify(
+            self._handle(uuid), lambda _, data: callback(uuid, bytes(data)))
+
+    async def stop_notify(self, uuid):
+        await self._client.stop_notify(self._handle(uuid))
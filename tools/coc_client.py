@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""Bulk transfers from ESP32-C3-BLE over its L2CAP channel (main/coc.h).
+
+Opens an LE connection-oriented channel with a BlueZ socket, so Linux
+only.  `get` reads a stream: the trace is written as "#T:" lines for
+host/replay, the binary log as "#B:" lines for blog_decode.py, anything
+else as raw bytes.  `bench` reads the bench stream at several connection
+intervals and PHYs and prints the throughput of each, with the interval
+and PHY the device reports it actually ran at.
+
+Usage:
+    python coc_client.py list
+    python coc_client.py get trace -o trace.txt
+    python coc_client.py get logs | python blog_decode.py build/app.elf
+    python coc_client.py get history -o history.bin
+    python coc_client.py bench
+    python coc_client.py bench --itvl 7.5 15 30 --phy 1m 2m
+    python coc_client.py --address AA:BB:CC:DD:EE:FF list
+"""
+
+import argparse
+import asyncio
+import ctypes
+import socket
+import sys
+import time
+import zlib
+
+from c3ble import codec
+from c3ble.codec import DEVICE_NAME, coc_status, log_lines, trace_lines
+
+# <bluetooth/bluetooth.h>, <bluetooth/l2cap.h>; not every Python build
+# has the socket constants
+AF_BLUETOOTH = getattr(socket, "AF_BLUETOOTH", 31)
+BTPROTO_L2CAP = getattr(socket, "BTPROTO_L2CAP", 0)
+SOL_BLUETOOTH = 274
+BT_RCVMTU = 13
+BDADDR_LE_PUBLIC, BDADDR_LE_RANDOM = 1, 2
+
+
+class CocError(Exception):
+    pass
+
+
+class sockaddr_l2(ctypes.Structure):
+    _fields_ = [("family", ctypes.c_ushort), ("psm", ctypes.c_ushort),
+                ("bdaddr", ctypes.c_ubyte * 6), ("cid", ctypes.c_ushort),
+                ("bdaddr_type", ctypes.c_ubyte)]
+
+
+def l2_addr(address, psm, addr_type):
+    """Python's L2CAP addresses have no LE address type; build our own."""
+    le16 = int.from_bytes(psm.to_bytes(2, "little"), sys.byteorder)
+    sa = sockaddr_l2(family=AF_BLUETOOTH, psm=le16,
+                     bdaddr_type=addr_type)
+    octets = bytes.fromhex(address.replace(":", "")) if address else bytes(6)
+    sa.bdaddr[:] = octets[::-1]
+    return sa
+
+
+def open_channel(address, addr_type):
+    libc = ctypes.CDLL(None, use_errno=True)
+    sock = socket.socket(AF_BLUETOOTH, socket.SOCK_SEQPACKET, BTPROTO_L2CAP)
+    sock.setsockopt(SOL_BLUETOOTH, BT_RCVMTU, codec.COC_SDU_MAX)
+    for call, sa in ((libc.bind, l2_addr(None, 0, BDADDR_LE_PUBLIC)),
+                     (libc.connect, l2_addr(address, codec.COC_PSM,
+                                            addr_type))):
+        if call(sock.fileno(), ctypes.byref(sa), ctypes.sizeof(sa)) != 0:
+            err = ctypes.get_errno()
+            sock.close()
+            raise OSError(err, f"{address}: {call.__name__}")
+    return sock
+
+
+async def find_device(address):
+    if address:
+        return address
+    try:
+        from bleak import BleakScanner
+    except ImportError:
+        raise CocError("give --address, or install bleak to scan")
+    print(f"Scanning for {DEVICE_NAME}...", file=sys.stderr)
+    device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=20)
+    if not device:
+        raise CocError("device not found")
+    print(f"Found: {device.name} [{device.address}]", file=sys.stderr)
+    return device.address
+
+
+class Channel:
+    def __init__(self, sock, timeout):
+        self.sock = sock
+        self.sock.settimeout(timeout)
+
+    def recv(self):
+        frame = self.sock.recv(codec.COC_SDU_MAX)
+        if not frame:
+            raise CocError("channel closed")
+        return frame
+
+    def list(self):
+        self.sock.send(bytes([codec.COC_OP_LIST]))
+        frame = self.recv()
+        if frame[0] != codec.COC_OP_STREAMS:
+            raise CocError(f"unexpected frame 0x{frame[0]:02x}")
+        return codec.decode_streams(frame)
+
+    def link(self, itvl, phys):
+        self.sock.send(codec.coc_link(itvl, phys))
+        frame = self.recv()
+        if frame[0] != codec.COC_OP_RSP or frame[2] != 0:
+            raise CocError(f"LINK refused: {coc_status(frame[2])}")
+
+    def get(self, name, offset=0, length=0xffffffff):
+        """Returns (data, end) with end the fields of the END frame."""
+        self.sock.send(codec.coc_get(name, offset, length))
+        frame = self.recv()
+        status, size = codec.decode_begin(frame)
+        if frame[0] != codec.COC_OP_BEGIN or status != 0:
+            raise CocError(f"GET {name}: {coc_status(status)}")
+        chunks, seq = [], 0
+        while True:
+            frame = self.recv()
+            if frame[0] == codec.COC_OP_END:
+                break
+            if frame[0] != codec.COC_OP_DATA:
+                raise CocError(f"unexpected frame 0x{frame[0]:02x}")
+            if frame[1] != seq:
+                raise CocError(f"frame {frame[1]} where {seq} was due")
+            seq = (seq + 1) & 0xff
+            chunks.append(frame[2:])
+        data = b"".join(chunks)
+        end = codec.decode_end(frame)
+        if end["status"] != 0:
+            raise CocError(f"GET {name} ended: {coc_status(end['status'])}")
+        if end["sent"] != len(data) or zlib.crc32(data) != end["crc"]:
+            raise CocError(f"GET {name}: {len(data)} bytes received, device "
+                           f"sent {end['sent']}, CRC mismatch")
+        if len(data) < size:
+            print(f"{name}: {size - len(data)} bytes fewer than announced",
+                  file=sys.stderr)
+        return data, end
+
+
+def cmd_get(ch, args):
+    data, _ = ch.get(args.stream, args.offset, args.length)
+    lines = {"trace": trace_lines, "logs": log_lines}.get(args.stream)
+    if lines:
+        text = "".join(line + "\n" for line in lines(data))
+        if args.output:
+            with open(args.output, "w") as f:
+                f.write(text)
+        else:
+            sys.stdout.write(text)
+    elif args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        sys.stdout.buffer.write(data)
+    print(f"{args.stream}: {len(data)} bytes", file=sys.stderr)
+
+
+def cmd_bench(ch, args):
+    print(f"{'asked':>16}  {'got':>16}  {'kB/s':>6}  {'device':>6}")
+    for itvl_ms in args.itvl:
+        itvl = round(itvl_ms / 1.25)
+        for phy in args.phy:
+            ch.link(itvl, codec.COC_PHYS[phy])
+            time.sleep(args.settle)     # let the update procedures finish
+            start = time.monotonic()
+            data, end = ch.get("bench")
+            secs = time.monotonic() - start
+            got = (f"{end['itvl'] * 1.25:g} ms "
+                   f"{codec.COC_PHY_NAMES.get(end['tx_phy'], '?')}")
+            print(f"{f'{itvl_ms:g} ms {phy.upper()}':>16}  {got:>16}  "
+                  f"{len(data) / 1024 / secs:6.1f}  "
+                  f"{len(data) / 1024 / max(end['ms'], 1) * 1000:6.1f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="L2CAP bulk transfer client")
+    parser.add_argument("--address", help="skip the scan")
+    parser.add_argument("--random", action="store_true",
+                        help="the device uses a random address")
+    parser.add_argument("--timeout", type=float, default=10.0,
+                        help="seconds to wait for a frame")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("list", help="streams and their sizes")
+    get = sub.add_parser("get", help="read a stream")
+    get.add_argument("stream")
+    get.add_argument("-o", "--output")
+    get.add_argument("--offset", type=int, default=0)
+    get.add_argument("--length", type=int, default=0xffffffff)
+    bench = sub.add_parser("bench", help="throughput per interval and PHY")
+    bench.add_argument("--itvl", type=float, nargs="+",
+                       default=[7.5, 15, 30, 50], help="intervals in ms")
+    bench.add_argument("--phy", nargs="+", choices=codec.COC_PHYS,
+                       default=["1m", "2m"])
+    bench.add_argument("--settle", type=float, default=1.0,
+                       help="seconds to wait after a LINK request")
+    args = parser.parse_args()
+
+    try:
+        address = asyncio.run(find_device(args.address))
+        addr_type = BDADDR_LE_RANDOM if args.random else BDADDR_LE_PUBLIC
+        with open_channel(address, addr_type) as sock:
+            ch = Channel(sock, args.timeout)
+            if args.cmd == "list":
+                for name, size in ch.list():
+                    print(f"{name:10} {size:8} bytes")
+            elif args.cmd == "get":
+                cmd_get(ch, args)
+            else:
+                cmd_bench(ch, args)
+    except (CocError, OSError) as e:
+        print(f"coc_client: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
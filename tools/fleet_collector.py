@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+"""Collect readings from many ESP32-C3-BLE boards into SQLite.
+
+Devices are discovered by the custom service UUID (or an explicit address
+list).  Firmware that puts its readings in the scan response is ingested
+passively from advertisements; any device that advertises without them is
+polled over GATT, with at most --max-connections connections in flight.
+
+Every device gets its own samples table, indexed by timestamp, plus a row in
+the `devices` table.  A status line with the ingestion rate and per-device
+staleness is printed every --report seconds.
+
+Usage:
+    python fleet_collector.py                        # all boards, fleet.db
+    python fleet_collector.py -a AA:BB:CC:DD:EE:FF   # only these addresses
+    python fleet_collector.py --poll 300 -j 2        # GATT poll every 5 min,
+                                                     # 2 connections at most
+    python fleet_collector.py --duration 3600        # stop after an hour
+
+Query example:
+    sqlite3 fleet.db "SELECT * FROM devices"
+    sqlite3 fleet.db "SELECT * FROM samples_aabbccddeeff ORDER BY ts DESC LIMIT 5"
+"""
+
+import argparse
+import asyncio
+import sqlite3
+import sys
+import time
+from datetime import datetime
+
+try:
+    from bleak import BleakClient, BleakScanner
+except ImportError:
+    print("Install bleak: pip install bleak")
+    sys.exit(1)
+
+import gatt_chrs as chrs
+from c3ble import codec
+
+SVC_UUID = chrs.SERVICE_UUID
+
+BT_CONNECT_TIMEOUT = 20
+COMMIT_EVERY = 2.0      # seconds between SQLite commits
+
+
+def ts_now():
+    return datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+
+
+# ---- Storage ---------------------------------------------------------------
+
+class Store:
+    """SQLite store: one `devices` row and one samples table per device."""
+
+    def __init__(self, path):
+        self.db = sqlite3.connect(path)
+        self.db.execute("PRAGMA journal_mode=WAL")
+        self.db.execute("PRAGMA synchronous=NORMAL")
+        self.db.execute(
+            "CREATE TABLE IF NOT EXISTS devices ("
+            " address TEXT PRIMARY KEY, name TEXT, tbl TEXT NOT NULL,"
+            " first_seen REAL, last_seen REAL, last_sample REAL,"
+            " samples INTEGER DEFAULT 0)")
+        self.tables = {}
+        for addr, tbl in self.db.execute("SELECT address, tbl FROM devices"):
+            self.tables[addr] = tbl
+        self.last_commit = time.monotonic()
+
+    @staticmethod
+    def table_name(address):
+        # Addresses are MACs on Linux and UUIDs on macOS; keep [0-9a-z].
+        return "samples_" + "".join(c for c in address.lower() if c.isalnum())
+
+    def device(self, address, name, now):
+        tbl = self.tables.get(address)
+        if tbl is None:
+            tbl = self.table_name(address)
+            self.db.execute(
+                f"CREATE TABLE IF NOT EXISTS {tbl} ("
+                " ts REAL NOT NULL, seq INTEGER, source TEXT NOT NULL,"
+                " rssi INTEGER, temp_c REAL, press_hpa REAL,"
+                " humidity REAL, batt_mv INTEGER)")
+            self.db.execute(
+                f"CREATE INDEX IF NOT EXISTS {tbl}_ts ON {tbl} (ts)")
+            self.db.execute(
+                "INSERT OR IGNORE INTO devices (address, name, tbl, first_seen)"
+                " VALUES (?, ?, ?, ?)", (address, name, tbl, now))
+            self.tables[address] = tbl
+        self.db.execute(
+            "UPDATE devices SET last_seen = ?, name = COALESCE(?, name)"
+            " WHERE address = ?", (now, name, address))
+        return tbl
+
+    def insert(self, address, name, now, seq, source, rssi, s):
+        tbl = self.device(address, name, now)
+        self.db.execute(
+            f"INSERT INTO {tbl} VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+            (now, seq, source, rssi, s["temp_c"], s["press_hpa"],
+             s["humidity"], s["batt_mv"]))
+        self.db.execute(
+            "UPDATE devices SET last_sample = ?, samples = samples + 1"
+            " WHERE address = ?", (now, address))
+        self.maybe_commit()
+
+    def maybe_commit(self, force=False):
+        now = time.monotonic()
+        if force or now - self.last_commit >= COMMIT_EVERY:
+            self.db.commit()
+            self.last_commit = now
+
+    def close(self):
+        self.db.commit()
+        self.db.close()
+
+
+# ---- Collector -------------------------------------------------------------
+
+class Device:
+    def __init__(self, ble_device):
+        self.ble_device = ble_device
+        self.name = ble_device.name
+        self.last_seen = 0.0        # any advertisement
+        self.last_sample = 0.0      # any stored sample
+        self.last_seq = None
+        self.passive = False        # advertises readings, no polling needed
+        self.next_poll = 0.0
+        self.polling = False
+        self.failures = 0
+        self.alarm = 0
+
+
+class Collector:
+    def __init__(self, args, store):
+        self.args = args
+        self.store = store
+        self.addresses = {a.upper() for a in args.address}
+        self.devices = {}
+        self.sem = asyncio.Semaphore(args.max_connections)
+        self.tasks = set()
+        self.total = 0
+        self.window = 0
+        self.window_start = time.monotonic()
+        self.start = self.window_start
+
+    def record(self, dev, seq, source, rssi, sample):
+        now = time.time()
+        self.store.insert(dev.ble_device.address, dev.name, now, seq,
+                          source, rssi, sample)
+        dev.last_sample = now
+        self.total += 1
+        self.window += 1
+
+    # -- Passive ingestion --
+
+    def on_advertisement(self, ble_device, adv):
+        addr = ble_device.address.upper()
+        if self.addresses and addr not in self.addresses:
+            return
+        if not self.addresses and SVC_UUID not in [u.lower() for u in
+                                                   adv.service_uuids]:
+            return
+
+        dev = self.devices.get(addr)
+        if dev is None:
+            dev = self.devices[addr] = Device(ble_device)
+            print(f"[{ts_now()}] found {addr} ({ble_device.name})")
+        dev.ble_device = ble_device
+        dev.name = ble_device.name or adv.local_name or dev.name
+        dev.last_seen = time.time()
+
+        mfg = adv.manufacturer_data.get(codec.COMPANY_ID)
+        parsed = codec.decode_mfg(mfg) if mfg else None
+        if parsed is None:
+            self.schedule_poll(dev)
+            return
+
+        seq, sample, alarm = parsed
+        dev.passive = True
+        if alarm != dev.alarm:
+            dev.alarm = alarm
+            print(f"[{ts_now()}] {addr} alarm rules "
+                  + (f"0x{alarm:02x} active" if alarm else "cleared"))
+        # The same scan response is repeated on every advertising event.
+        if seq != dev.last_seq:
+            dev.last_seq = seq
+            self.record(dev, seq, "adv", adv.rssi, sample)
+
+    # -- Active polling --
+
+    def schedule_poll(self, dev):
+        if dev.passive or dev.polling or time.time() < dev.next_poll:
+            return
+        dev.polling = True
+        task = asyncio.get_running_loop().create_task(self.poll(dev))
+        self.tasks.add(task)
+        task.add_done_callback(self.tasks.discard)
+
+    async def poll(self, dev):
+        try:
+            async with self.sem:
+                sample = await self.read_gatt(dev)
+            self.record(dev, None, "gatt", None, sample)
+            dev.failures = 0
+            dev.next_poll = time.time() + self.args.poll
+        except Exception as e:
+            dev.failures += 1
+            backoff = min(self.args.poll, 5 * 2 ** dev.failures)
+            dev.next_poll = time.time() + backoff
+            print(f"[{ts_now()}] {dev.ble_device.address}: {e!r}; "
+                  f"retry in {backoff}s")
+        finally:
+            dev.polling = False
+
+    async def read_gatt(self, dev):
+        async with BleakClient(dev.ble_device,
+                               timeout=BT_CONNECT_TIMEOUT) as client:
+            press, temp, hum, batt = await asyncio.gather(
+                client.read_gatt_char(chrs.PRESSURE.uuid),
+                client.read_gatt_char(chrs.TEMPERATURE.uuid),
+                client.read_gatt_char(chrs.HUMIDITY.uuid),
+                client.read_gatt_char(chrs.BATTERY.uuid))
+        return {
+            "temp_c": codec.decode(chrs.TEMPERATURE, temp),
+            "press_hpa": codec.decode(chrs.PRESSURE, press),
+            "humidity": codec.decode(chrs.HUMIDITY, hum),
+            "batt_mv": codec.decode(chrs.BATTERY, batt),
+        }
+
+    # -- Reporting --
+
+    def report(self):
+        now = time.time()
+        mono = time.monotonic()
+        rate = self.window / max(mono - self.window_start, 1e-9)
+        avg = self.total / max(mono - self.start, 1e-9)
+        self.window = 0
+        self.window_start = mono
+
+        stale = [d for d in self.devices.values()
+                 if now - d.last_sample > self.args.stale]
+        print(f"[{ts_now()}] {len(self.devices)} devices, "
+              f"{self.total} samples, {rate:.2f}/s now, {avg:.2f}/s avg, "
+              f"{len(stale)} stale, {len(self.tasks)} polls in flight")
+        for addr in sorted(self.devices):
+            d = self.devices[addr]
+            age = now - d.last_sample if d.last_sample else float("inf")
+            mark = "  STALE" if d in stale else ""
+            mode = "adv" if d.passive else "gatt"
+            print(f"    {addr}  {d.name or '?':16s} {mode:4s} "
+                  f"last sample {age:7.0f}s ago  "
+                  f"seen {now - d.last_seen:5.0f}s ago{mark}")
+
+    async def run(self):
+        scanner = BleakScanner(detection_callback=self.on_advertisement)
+        await scanner.start()
+        print(f"[{ts_now()}] scanning for "
+              + (", ".join(sorted(self.addresses)) or SVC_UUID)
+              + f"; up to {self.args.max_connections} connections")
+        try:
+            end = time.monotonic() + self.args.duration \
+                if self.args.duration else None
+            while end is None or time.monotonic() < end:
+                await asyncio.sleep(self.args.report)
+                self.store.maybe_commit(force=True)
+                self.report()
+                # Devices that went quiet still get polled when due.
+                for dev in self.devices.values():
+                    self.schedule_poll(dev)
+        finally:
+            await scanner.stop()
+            for task in list(self.tasks):
+                task.cancel()
+            await asyncio.gather(*self.tasks, return_exceptions=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fleet data collector")
+    parser.add_argument("-a", "--address", action="append", default=[],
+                        help="collect only from this address (repeatable)")
+    parser.add_argument("-o", "--db", default="fleet.db",
+                        help="SQLite database (default: fleet.db)")
+    parser.add_argument("-j", "--max-connections", type=int, default=3,
+                        help="parallel GATT connections (default: 3)")
+    parser.add_argument("--poll", type=int, default=120,
+                        help="seconds between GATT polls of devices without "
+                             "advertised readings (default: 120)")
+    parser.add_argument("--stale", type=int, default=300,
+                        help="flag devices with no sample for this many "
+                             "seconds (default: 300)")
+    parser.add_argument("--report", type=int, default=30,
+                        help="seconds between status reports (default: 30)")
+    parser.add_argument("--duration", type=int, default=0,
+                        help="stop after this many seconds (0 = never)")
+    args = parser.parse_args()
+
+    store = Store(args.db)
+    collector = Collector(args, store)
+    try:
+        asyncio.run(collector.run())
+    except KeyboardInterrupt:
+        print("\nStopped.")
+    finally:
+        store.close()
+        print(f"Total: {collector.total} samples from "
+              f"{len(collector.devices)} devices, saved to {args.db}")
+
+
+if __name__ == "__main__":
+    main()
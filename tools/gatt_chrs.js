@@ -0,0 +1,69 @@
+// Characteristics of the custom service.
+// Generated by tools/gen_gatt_bindings.py from main/gatt_chr_table.h.
+// Do not edit; regenerate instead.
+
+const GattChrs = (() => {
+  const SIZES = { b: 1, B: 1, c: 1, h: 2, H: 2, i: 4, I: 4, q: 8, Q: 8, f: 4, d: 8 };
+
+  // Unpack a little-endian struct format ("<hHhBciI") from a DataView.
+  function unpack(fmt, view) {
+    const out = [];
+    let off = 0;
+    for (const t of fmt.replace(/^[<=]/, '')) {
+      switch (t) {
+        case 'b': out.push(view.getInt8(off)); break;
+        case 'B': out.push(view.getUint8(off)); break;
+        case 'c': out.push(String.fromCharCode(view.getUint8(off))); break;
+        case 'h': out.push(view.getInt16(off, true)); break;
+        case 'H': out.push(view.getUint16(off, true)); break;
+        case 'i': out.push(view.getInt32(off, true)); break;
+        case 'I': out.push(view.getUint32(off, true)); break;
+        case 'q': out.push(Number(view.getBigInt64(off, true))); break;
+        case 'Q': out.push(Number(view.getBigUint64(off, true))); break;
+        case 'f': out.push(view.getFloat32(off, true)); break;
+        case 'd': out.push(view.getFloat64(off, true)); break;
+        default: throw new Error(`unsupported format ${t}`);
+      }
+      off += SIZES[t];
+    }
+    return out;
+  }
+
+  // Value in chr.unit (an array for multi-field formats).
+  function decode(chr, view) {
+    if (!chr.fmt) return new Uint8Array(view.buffer, view.byteOffset, view.byteLength);
+    const v = unpack(chr.fmt, view);
+    return v.length > 1 ? v : v[0] * chr.scale;
+  }
+
+  const chrs = {
+    DATA: { id: 'DATA', uuid: 'deadbeef-1001-2000-3000-aabbccddeeff', name: 'Data', fmt: '', unit: '', scale: 1, flags: 'rw' },
+    PRESSURE: { id: 'PRESSURE', uuid: 'deadbeef-1002-2000-3000-aabbccddeeff', name: 'Pressure', fmt: '<f', unit: 'hPa', scale: 0.01, flags: 'rn' },
+    TEMPERATURE: { id: 'TEMPERATURE', uuid: 'deadbeef-1003-2000-3000-aabbccddeeff', name: 'Temperature', fmt: '<f', unit: '°C', scale: 1, flags: 'rn' },
+    HUMIDITY: { id: 'HUMIDITY', uuid: 'deadbeef-1004-2000-3000-aabbccddeeff', name: 'Humidity', fmt: '<f', unit: '%', scale: 1, flags: 'rn' },
+    BATTERY: { id: 'BATTERY', uuid: 'deadbeef-1007-2000-3000-aabbccddeeff', name: 'Battery', fmt: '<I', unit: 'mV', scale: 2, flags: 'rn' },
+    TIME: { id: 'TIME', uuid: 'deadbeef-1005-2000-3000-aabbccddeeff', name: 'Time', fmt: '<q', unit: 's', scale: 1, flags: 'rw' },
+    TIMEZONE: { id: 'TIMEZONE', uuid: 'deadbeef-1006-2000-3000-aabbccddeeff', name: 'Timezone', fmt: '<b', unit: 'min', scale: 15, flags: 'rw' },
+    DISPLAY_MODE: { id: 'DISPLAY_MODE', uuid: 'deadbeef-1008-2000-3000-aabbccddeeff', name: 'Display mode', fmt: '<B', unit: '', scale: 1, flags: 'rw' },
+    DERIVED: { id: 'DERIVED', uuid: 'deadbeef-100a-2000-3000-aabbccddeeff', name: 'Derived', fmt: '<hHhBciI', unit: '', scale: 1, flags: 'rn' },
+    SEA_LEVEL: { id: 'SEA_LEVEL', uuid: 'deadbeef-100b-2000-3000-aabbccddeeff', name: 'Sea level', fmt: '<I', unit: 'hPa', scale: 0.01, flags: 'rw' },
+    MEMORY: { id: 'MEMORY', uuid: 'deadbeef-100c-2000-3000-aabbccddeeff', name: 'Memory report', fmt: '', unit: '', scale: 1, flags: 'r' },
+    POWER: { id: 'POWER', uuid: 'deadbeef-100d-2000-3000-aabbccddeeff', name: 'Power', fmt: '<IIIIIII', unit: '', scale: 1, flags: 'r' },
+    RULES: { id: 'RULES', uuid: 'deadbeef-100e-2000-3000-aabbccddeeff', name: 'Rules', fmt: '', unit: '', scale: 1, flags: 'rw' },
+    ALARM: { id: 'ALARM', uuid: 'deadbeef-100f-2000-3000-aabbccddeeff', name: 'Alarm', fmt: '<BBBBI', unit: '', scale: 1, flags: 'ri' },
+    ROLLUP: { id: 'ROLLUP', uuid: 'deadbeef-1010-2000-3000-aabbccddeeff', name: 'Rollup', fmt: '', unit: '', scale: 1, flags: 'rw' },
+    CONTROL: { id: 'CONTROL', uuid: 'deadbeef-1011-2000-3000-aabbccddeeff', name: 'Control point', fmt: '', unit: '', scale: 1, flags: 'wi' },
+    SCHEDULE: { id: 'SCHEDULE', uuid: 'deadbeef-1012-2000-3000-aabbccddeeff', name: 'Schedule', fmt: '', unit: '', scale: 1, flags: 'rw' },
+    PROFILE: { id: 'PROFILE', uuid: 'deadbeef-1013-2000-3000-aabbccddeeff', name: 'Profile', fmt: '<BBBBII', unit: '', scale: 1, flags: 'ri' },
+  };
+
+  return {
+    SERVICE_UUID: 'deadbeef-1000-2000-3000-aabbccddeeff',
+    ...chrs,
+    ALL: Object.values(chrs),
+    unpack,
+    decode,
+  };
+})();
+
+if (typeof module !== 'undefined') module.exports = GattChrs;
@@ -0,0 +1,63 @@
+"""Characteristics of the custom service.
+
+Generated by tools/gen_gatt_bindings.py from main/gatt_chr_table.h.
+Do not edit; regenerate instead.
+"""
+
+import struct
+from typing import NamedTuple
+
+
+class Chr(NamedTuple):
+    id: str
+    uuid: str
+    name: str
+    fmt: str        # struct format of the value, "" for raw bytes
+    unit: str
+    scale: float    # decoded value * scale is in unit
+    flags: str      # "r", "rw", "rn" (read + notify), "ri" (+ indicate),
+                    # "wi" (write + indicate)
+
+    def decode(self, data):
+        """Return the value in unit; a tuple for multi-field formats."""
+        if not self.fmt:
+            return bytes(data)
+        values = struct.unpack(self.fmt, data)
+        if len(values) > 1:
+            return values
+        return values[0] * self.scale if self.scale != 1 else values[0]
+
+    def encode(self, value):
+        """Inverse of decode() for single-field formats."""
+        if not self.fmt:
+            return bytes(value)
+        if self.scale != 1:
+            value = value / self.scale
+        if self.fmt[-1] not in "fd":
+            value = int(round(value))
+        return struct.pack(self.fmt, value)
+
+
+SERVICE_UUID = "deadbeef-1000-2000-3000-aabbccddeeff"
+
+DATA = Chr('DATA', 'deadbeef-1001-2000-3000-aabbccddeeff', 'Data', '', '', 1, 'rw')
+PRESSURE = Chr('PRESSURE', 'deadbeef-1002-2000-3000-aabbccddeeff', 'Pressure', '<f', 'hPa', 0.01, 'rn')
+TEMPERATURE = Chr('TEMPERATURE', 'deadbeef-1003-2000-3000-aabbccddeeff', 'Temperature', '<f', '°C', 1, 'rn')
+HUMIDITY = Chr('HUMIDITY', 'deadbeef-1004-2000-3000-aabbccddeeff', 'Humidity', '<f', '%', 1, 'rn')
+BATTERY = Chr('BATTERY', 'deadbeef-1007-2000-3000-aabbccddeeff', 'Battery', '<I', 'mV', 2, 'rn')
+TIME = Chr('TIME', 'deadbeef-1005-2000-3000-aabbccddeeff', 'Time', '<q', 's', 1, 'rw')
+TIMEZONE = Chr('TIMEZONE', 'deadbeef-1006-2000-3000-aabbccddeeff', 'Timezone', '<b', 'min', 15, 'rw')
+DISPLAY_MODE = Chr('DISPLAY_MODE', 'deadbeef-1008-2000-3000-aabbccddeeff', 'Display mode', '<B', '', 1, 'rw')
+DERIVED = Chr('DERIVED', 'deadbeef-100a-2000-3000-aabbccddeeff', 'Derived', '<hHhBciI', '', 1, 'rn')
+SEA_LEVEL = Chr('SEA_LEVEL', 'deadbeef-100b-2000-3000-aabbccddeeff', 'Sea level', '<I', 'hPa', 0.01, 'rw')
+MEMORY = Chr('MEMORY', 'deadbeef-100c-2000-3000-aabbccddeeff', 'Memory report', '', '', 1, 'r')
+POWER = Chr('POWER', 'deadbeef-100d-2000-3000-aabbccddeeff', 'Power', '<IIIIIII', '', 1, 'r')
+RULES = Chr('RULES', 'deadbeef-100e-2000-3000-aabbccddeeff', 'Rules', '', '', 1, 'rw')
+ALARM = Chr('ALARM', 'deadbeef-100f-2000-3000-aabbccddeeff', 'Alarm', '<BBBBI', '', 1, 'ri')
+ROLLUP = Chr('ROLLUP', 'deadbeef-1010-2000-3000-aabbccddeeff', 'Rollup', '', '', 1, 'rw')
+CONTROL = Chr('CONTROL', 'deadbeef-1011-2000-3000-aabbccddeeff', 'Control point', '', '', 1, 'wi')
+SCHEDULE = Chr('SCHEDULE', 'deadbeef-1012-2000-3000-aabbccddeeff', 'Schedule', '', '', 1, 'rw')
+PROFILE = Chr('PROFILE', 'deadbeef-1013-2000-3000-aabbccddeeff', 'Profile', '<BBBBII', '', 1, 'ri')
+
+ALL = (DATA, PRESSURE, TEMPERATURE, HUMIDITY, BATTERY, TIME, TIMEZONE, DISPLAY_MODE, DERIVED, SEA_LEVEL, MEMORY, POWER, RULES, ALARM, ROLLUP, CONTROL, SCHEDULE, PROFILE,)
+BY_UUID = {c.uuid: c for c in ALL}
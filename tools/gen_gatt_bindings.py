@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""Generate client bindings from main/gatt_chr_table.h.
+
+Writes tools/gatt_chrs.py and tools/gatt_chrs.js with the UUID, value
+format, unit and scale of every characteristic, so the host tools and the
+web pages never carry their own copies.  Rerun after editing the table.
+
+Usage:
+    python gen_gatt_bindings.py            # regenerate both files
+    python gen_gatt_bindings.py --check    # exit 1 if they are out of date
+"""
+
+import argparse
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TABLE = os.path.join(HERE, "..", "main", "gatt_chr_table.h")
+PY_OUT = os.path.join(HERE, "gatt_chrs.py")
+JS_OUT = os.path.join(HERE, "gatt_chrs.js")
+
+UUID_FMT = "deadbeef-{:04x}-2000-3000-aabbccddeeff"
+SERVICE = 0x1000
+
+ENTRY_RE = re.compile(
+    r'\b([VF])\(\s*(\w+)\s*,\s*(0x[0-9a-fA-F]+)\s*,\s*"([^"]*)"\s*,'
+    r'\s*"([^"]*)"\s*,\s*"([^"]*)"\s*,\s*([0-9.eE+-]+)\s*,\s*(\w+)\s*,')
+
+FLAGS = {"R": "r", "RW": "rw", "RN": "rn", "RI": "ri", "WI": "wi"}
+
+
+def parse(path):
+    with open(path, encoding="utf-8") as f:
+        src = f.read()
+    src = re.sub(r"/\*.*?\*/", "", src, flags=re.S)
+    body = src[src.index("#define GATT_CHR_TABLE"):]
+    chrs = []
+    for m in ENTRY_RE.finditer(body):
+        kind, ident, uuid, name, fmt, unit, scale, flags = m.groups()
+        if flags not in FLAGS:
+            raise ValueError(f"{ident}: unknown flags {flags}")
+        scale = float(scale)
+        chrs.append({
+            "id": ident, "uuid": UUID_FMT.format(int(uuid, 16)),
+            "name": name, "fmt": fmt, "unit": unit,
+            "scale": int(scale) if scale.is_integer() else scale,
+            "flags": FLAGS[flags],
+        })
+    if not chrs:
+        raise ValueError(f"{path}: no GATT_CHR_TABLE entries")
+    return chrs
+
+
+HEADER = "Generated by tools/gen_gatt_bindings.py from main/gatt_chr_table.h."
+
+PY_TEMPLATE = '''"""Characteristics of the custom service.
+
+{header}
+Do not edit; regenerate instead.
+"""
+
+import struct
+from typing import NamedTuple
+
+
+class Chr(NamedTuple):
+    id: str
+    uuid: str
+    name: str
+    fmt: str        # struct format of the value, "" for raw bytes
+    unit: str
+    scale: float    # decoded value * scale is in unit
+    flags: str      # "r", "rw", "rn" (read + notify), "ri" (+ indicate),
+                    # "wi" (write + indicate)
+
+    def decode(self, data):
+        """Return the value in unit; a tuple for multi-field formats."""
+        if not self.fmt:
+            return bytes(data)
+        values = struct.unpack(self.fmt, data)
+        if len(values) > 1:
+            return values
+        return values[0] * self.scale if self.scale != 1 else values[0]
+
+    def encode(self, value):
+        """Inverse of decode() for single-field formats."""
+        if not self.fmt:
+            return bytes(value)
+        if self.scale != 1:
+            value = value / self.scale
+        if self.fmt[-1] not in "fd":
+            value = int(round(value))
+        return struct.pack(self.fmt, value)
+
+
+SERVICE_UUID = "{service}"
+
+{entries}
+
+ALL = ({all_ids})
+BY_UUID = {{c.uuid: c for c in ALL}}
+'''
+
+JS_TEMPLATE = '''// Characteristics of the custom service.
+// {header}
+// Do not edit; regenerate instead.
+
+const GattChrs = (() => {{
+  const SIZES = {{ b: 1, B: 1, c: 1, h: 2, H: 2, i: 4, I: 4, q: 8, Q: 8, f: 4, d: 8 }};
+
+  // Unpack a little-endian struct format ("<hHhBciI") from a DataView.
+  function unpack(fmt, view) {{
+    const out = [];
+    let off = 0;
+    for (const t of fmt.replace(/^[<=]/, '')) {{
+      switch (t) {{
+        case 'b': out.push(view.getInt8(off)); break;
+        case 'B': out.push(view.getUint8(off)); break;
+        case 'c': out.push(String.fromCharCode(view.getUint8(off))); break;
+        case 'h': out.push(view.getInt16(off, true)); break;
+        case 'H': out.push(view.getUint16(off, true)); break;
+        case 'i': out.push(view.getInt32(off, true)); break;
+        case 'I': out.push(view.getUint32(off, true)); break;
+        case 'q': out.push(Number(view.getBigInt64(off, true))); break;
+        case 'Q': out.push(Number(view.getBigUint64(off, true))); break;
+        case 'f': out.push(view.getFloat32(off, true)); break;
+        case 'd': out.push(view.getFloat64(off, true)); break;
+        default: throw new Error(`unsupported format ${{t}}`);
+      }}
+      off += SIZES[t];
+    }}
+    return out;
+  }}
+
+  // Value in chr.unit (an array for multi-field formats).
+  function decode(chr, view) {{
+    if (!chr.fmt) return new Uint8Array(view.buffer, view.byteOffset, view.byteLength);
+    const v = unpack(chr.fmt, view);
+    return v.length > 1 ? v : v[0] * chr.scale;
+  }}
+
+  const chrs = {{
+{entries}
+  }};
+
+  return {{
+    SERVICE_UUID: '{service}',
+    ...chrs,
+    ALL: Object.values(chrs),
+    unpack,
+    decode,
+  }};
+}})();
+
+if (typeof module !== 'undefined') module.exports = GattChrs;
+'''
+
+
+def render_py(chrs):
+    entries = "\n".join(
+        f'{c["id"]} = Chr({c["id"]!r}, {c["uuid"]!r}, {c["name"]!r}, '
+        f'{c["fmt"]!r}, {c["unit"]!r}, {c["scale"]!r}, {c["flags"]!r})'
+        for c in chrs)
+    return PY_TEMPLATE.format(header=HEADER, service=UUID_FMT.format(SERVICE),
+                              entries=entries,
+                              all_ids=", ".join(c["id"] for c in chrs) + ",")
+
+
+def render_js(chrs):
+    def js_str(s):
+        return "'" + s.replace("\\", "\\\\").replace("'", "\\'") + "'"
+
+    entries = "\n".join(
+        f'    {c["id"]}: {{ id: {js_str(c["id"])}, uuid: {js_str(c["uuid"])}, '
+        f'name: {js_str(c["name"])}, fmt: {js_str(c["fmt"])}, '
+        f'unit: {js_str(c["unit"])}, scale: {c["scale"]}, '
+        f'flags: {js_str(c["flags"])} }},'
+        for c in chrs)
+    return JS_TEMPLATE.format(header=HEADER, service=UUID_FMT.format(SERVICE),
+                              entries=entries)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--check", action="store_true",
+                        help="compare instead of writing; exit 1 on a diff")
+    args = parser.parse_args()
+
+    try:
+        chrs = parse(TABLE)
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    stale = []
+    for path, text in ((PY_OUT, render_py(chrs)), (JS_OUT, render_js(chrs))):
+        try:
+            with open(path, encoding="utf-8") as f:
+                current = f.read()
+        except FileNotFoundError:
+            current = None
+        if current == text:
+            continue
+        if args.check:
+            stale.append(os.path.basename(path))
+        else:
+            with open(path, "w", encoding="utf-8") as f:
+                f.write(text)
+            print(f"wrote {os.path.relpath(path)}")
+    if stale:
+        print(f"out of date: {', '.join(stale)}; run gen_gatt_bindings.py",
+              file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
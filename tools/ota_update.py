@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""Update ESP32-C3-BLE firmware over BLE.
+
+Streams the image through the OTA data characteristic with write-without-
+response, keeps at most `window` chunks unacknowledged, and resumes from the
+device's committed offset if the link drops.  The device verifies the
+SHA-256, switches boot slot and restarts; a bad image is rolled back by the
+bootloader.  The OTA writes need an encrypted link, so each connection
+pairs first (a no-op once bonded).
+
+Usage:
+    python ota_update.py build/esp32_c3_ble.bin
+    python ota_update.py image.bin --window 32     # chunks per acknowledgement
+    python ota_update.py image.bin --chunk 240     # override MTU-derived size
+    python ota_update.py image.bin --address AA:BB:CC:DD:EE:FF
+    python ota_update.py --abort                   # drop a half-done transfer
+"""
+
+import argparse
+import asyncio
+import hashlib
+import sys
+import time
+
+try:
+    from bleak import BleakClient, BleakScanner
+    from bleak.exc import BleakError
+except ImportError:
+    print("Install bleak: pip install bleak")
+    sys.exit(1)
+
+from c3ble import codec
+from c3ble.codec import DEVICE_NAME, OTA_CTRL_UUID, OTA_DATA_UUID, ota_status
+
+ACK_TIMEOUT = 3.0       # seconds without a notification before STATUS
+MAX_ATTEMPTS = 20       # connections (initial + resumes)
+FINISH_TIMEOUT = 30.0   # hashing 2 MB takes a while
+
+
+class OtaError(Exception):
+    pass
+
+
+async def find_device(address):
+    if address:
+        return address
+    print(f"Scanning for {DEVICE_NAME}...")
+    device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=20)
+    if not device:
+        raise OtaError("device not found")
+    print(f"Found: {device.name} [{device.address}]")
+    return device
+
+
+async def request(client, queue, payload, timeout=ACK_TIMEOUT):
+    """Write a control request and wait for its RSP notification."""
+    await client.write_gatt_char(OTA_CTRL_UUID, payload, response=True)
+    deadline = time.monotonic() + timeout
+    while True:
+        msg = await asyncio.wait_for(queue.get(),
+                                     max(0.1, deadline - time.monotonic()))
+        if msg[0] == codec.OTA_OP_RSP and msg[1] == payload[0]:
+            r = codec.decode_ota(msg)
+            return r["status"], r["offset"]
+
+
+async def session(target, image, sha, args, stats):
+    """One connection's worth of transfer.  Returns True when finished."""
+    size = len(image)
+    async with BleakClient(target, timeout=20) as client:
+        await client.pair()
+        queue = asyncio.Queue()
+        await client.start_notify(OTA_CTRL_UUID,
+                                  lambda _, data: queue.put_nowait(bytes(data)))
+
+        chunk = args.chunk or min(512,
+                                  client.mtu_size - 3 - codec.OTA_DATA_HDR)
+        status, offset = await request(
+            client, queue, codec.ota_begin(size, sha, args.window))
+        if status != 0:
+            raise OtaError(f"BEGIN refused: {ota_status(status)}")
+        if offset:
+            print(f"Resuming at {offset} of {size} bytes")
+        print(f"MTU {client.mtu_size}, chunk {chunk}, window {args.window}")
+
+        acked = sent = offset
+        last_report = 0
+        while acked < size:
+            # Keep the window full
+            while sent < size and sent - acked < args.window * chunk:
+                n = min(chunk, size - sent)
+                await client.write_gatt_char(
+                    OTA_DATA_UUID,
+                    codec.ota_data(sent, image[sent:sent + n]),
+                    response=False)
+                sent += n
+                stats["sent"] += n
+                if not queue.empty():
+                    break
+
+            try:
+                msg = await asyncio.wait_for(queue.get(), ACK_TIMEOUT)
+            except asyncio.TimeoutError:
+                stats["timeouts"] += 1
+                status, acked = await request(client, queue,
+                                              bytes([codec.OTA_OP_STATUS]))
+                if status != 0:
+                    raise OtaError(f"STATUS: {ota_status(status)}")
+                sent = acked
+                continue
+
+            r = codec.decode_ota(msg)
+            if r["op"] == codec.OTA_OP_ACK:
+                acked = r["offset"]
+            elif r["op"] == codec.OTA_OP_NAK:
+                stats["naks"] += 1
+                acked = sent = r["offset"]
+            elif r["op"] == codec.OTA_OP_RSP and r["status"] != 0:
+                raise OtaError(f"data rejected: {ota_status(r['status'])}")
+
+            if acked - last_report >= 64 * 1024 or acked == size:
+                last_report = acked
+                elapsed = time.monotonic() - stats["start"]
+                print(f"  {acked:8d}/{size} bytes  "
+                      f"{acked * 100 // size:3d}%  "
+                      f"{stats['sent'] / 1024 / elapsed:6.1f} kB/s")
+
+        print("Verifying...")
+        status, _ = await request(client, queue, bytes([codec.OTA_OP_FINISH]),
+                                  timeout=FINISH_TIMEOUT)
+        if status != 0:
+            raise OtaError(f"FINISH failed: {ota_status(status)}")
+        return True
+
+
+async def update(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    sha = hashlib.sha256(image).digest()
+    print(f"Image {args.image}: {len(image)} bytes, sha256 {sha.hex()[:16]}...")
+
+    stats = {"sent": 0, "naks": 0, "timeouts": 0, "resumes": 0,
+             "start": time.monotonic()}
+    target = await find_device(args.address)
+    for attempt in range(MAX_ATTEMPTS):
+        try:
+            if await session(target, image, sha, args, stats):
+                break
+        except (BleakError, asyncio.TimeoutError, EOFError) as e:
+            stats["resumes"] += 1
+            delay = min(2 ** attempt, 30)
+            print(f"Link lost ({e}); resuming in {delay}s")
+            await asyncio.sleep(delay)
+    else:
+        raise OtaError("too many connection failures")
+
+    elapsed = time.monotonic() - stats["start"]
+    print(f"OK — {len(image)} bytes in {elapsed:.1f}s "
+          f"({len(image) / 1024 / elapsed:.1f} kB/s effective, "
+          f"{stats['sent'] / 1024 / elapsed:.1f} kB/s on air)")
+    print(f"Resent {stats['sent'] - len(image)} bytes, NAKs {stats['naks']}, "
+          f"timeouts {stats['timeouts']}, resumes {stats['resumes']}")
+    print("Device is restarting into the new image.")
+
+
+async def abort(args):
+    target = await find_device(args.address)
+    async with BleakClient(target, timeout=20) as client:
+        await client.pair()
+        queue = asyncio.Queue()
+        await client.start_notify(OTA_CTRL_UUID,
+                                  lambda _, data: queue.put_nowait(bytes(data)))
+        status, _ = await request(client, queue, bytes([codec.OTA_OP_ABORT]))
+        print(f"Abort: {ota_status(status)}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32-C3-BLE OTA update")
+    parser.add_argument("image", nargs="?", help="application .bin to send")
+    parser.add_argument("--address", help="connect to this address, no scan")
+    parser.add_argument("--window", type=int, default=16,
+                        help="chunks per acknowledgement (default: 16)")
+    parser.add_argument("--chunk", type=int, default=0,
+                        help="payload bytes per write (default: from MTU)")
+    parser.add_argument("--abort", action="store_true",
+                        help="abort a pending transfer on the device")
+    args = parser.parse_args()
+
+    try:
+        if args.abort:
+            asyncio.run(abort(args))
+        elif args.image:
+            asyncio.run(update(args))
+        else:
+            parser.error("an image is required")
+    except OtaError as e:
+        print(f"OTA failed: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Tests for the c3ble package: Client against MockTransport, and the
+codec's formats outside the GATT table.
+
+Usage (from tools/, or through ctest in the host build):
+    python -m unittest test_c3ble
+"""
+
+import asyncio
+import base64
+import struct
+import time
+import unittest
+import zlib
+
+import gatt_chrs as chrs
+from c3ble import Client, MockTransport, codec
+from c3ble.mock import AttError
+
+
+class ClientTest(unittest.IsolatedAsyncioTestCase):
+    async def asyncSetUp(self):
+        self.mock = MockTransport(interval_ms=5, host_ms=0)
+        self.client = Client(self.mock)
+        await self.client.__aenter__()
+
+    async def asyncTearDown(self):
+        await self.client.__aexit__(None, None, None)
+
+    async def test_get_decodes(self):
+        v = await self.client.get_many(["battery", "temp", "pressure",
+                                        "mode"])
+        self.assertEqual(v["BATTERY"], 3900)
+        self.assertAlmostEqual(v["TEMPERATURE"], 21.5)
+        self.assertAlmostEqual(v["PRESSURE"], 1013.25)
+        self.assertEqual(v["DISPLAY_MODE"], "normal")
+        power = await self.client.get(chrs.POWER)
+        self.assertEqual(set(power), set(codec.POWER_FIELDS))
+
+    async def test_set_reads_back(self):
+        await self.client.set("mode", "blank")
+        self.assertEqual(await self.client.get("mode"), "blank")
+        await self.client.set("sea", 1021.5)
+        self.assertAlmostEqual(await self.client.get("sea"), 1021.5)
+        self.assertAlmostEqual(
+            (await self.client.get(chrs.DERIVED))["sea_level"], 1021.5)
+        await self.client.set("tz", "-4:30")
+        self.assertEqual(await self.client.get("tz"), -270)
+        await self.client.set("time", "now")
+        self.assertLessEqual(abs(await self.client.get("time")
+                                 - time.time()), 1)
+
+    async def test_refused_write(self):
+        with self.assertRaises(AttError) as e:
+            await self.client.write(chrs.TIMEZONE, b"\x64")
+        self.assertEqual(e.exception.code, 0x13)
+        with self.assertRaises(AttError):
+            await self.client.write(chrs.DISPLAY_MODE, b"\x00\x00")
+        with self.assertRaises(AttError):
+            await self.client.set("sea", 700)
+        self.assertEqual(await self.client.get("mode"), "normal")
+
+    async def test_control_applies_batch(self):
+        r = await self.client.control(["mode=button", "sea=1015",
+                                       "tz=+5:45"])
+        self.assertEqual(r["result"], 0)
+        self.assertEqual(r["items"], [("mode", 0), ("sea", 0), ("tz", 0)])
+        v = await self.client.get_many(["mode", "sea", "tz"])
+        self.assertEqual(v["DISPLAY_MODE"], "button")
+        self.assertAlmostEqual(v["SEA_LEVEL"], 1015)
+        self.assertEqual(v["TIMEZONE"], 345)
+
+    async def test_control_all_or_nothing(self):
+        r = await self.client.control([("mode", 2), ("sea", 50000),
+                                       ("mode", 1)])
+        self.assertEqual(r["result"], 3)
+        self.assertEqual(r["items"], [("mode", 5), ("sea", 3), ("mode", 4)])
+        self.assertEqual(await self.client.get("mode"), "normal")
+
+    async def test_control_check_changes_nothing(self):
+        r = await self.client.control(["mode=blank"], check=True)
+        self.assertEqual((r["op"], r["result"]), (codec.CTRL_OP_CHECK, 0))
+        self.assertEqual(await self.client.get("mode"), "normal")
+
+    async def test_sync_time(self):
+        await self.client.set("time", 0)
+        r = await self.client.sync_time()
+        self.assertEqual(r["result"], 0)
+        self.assertLessEqual(abs(await self.client.get("time")
+                                 - time.time()), 1)
+        self.assertEqual(await self.client.get("tz"),
+                         codec.host_tz() * 15)
+
+    async def test_rules_round_trip(self):
+        rules = ["temp > 30 hyst=0.5 for=300 do=led,adv",
+                 "press rate< -2 do=indicate"]
+        await self.client.set("rules", rules)
+        got = await self.client.get("rules")
+        self.assertEqual([(r["metric"], r["op"], r["threshold"], r["do"])
+                          for r in got],
+                         [("temp", ">", 30, ["adv", "led"]),
+                          ("press", "rate<", -2, ["indicate"])])
+        await self.client.set("rules", [])
+        self.assertEqual(await self.client.get("rules"), [])
+
+    async def test_schedule_round_trip(self):
+        await self.client.set("schedule",
+                              ["22:00 daily display=blank sample=slow",
+                               "07:00 mon-fri display=button"])
+        got = await self.client.get("schedule")
+        self.assertEqual([(e["start"], len(e["days"]), e["display"])
+                          for e in got],
+                         [("22:00", 7, "blank"), ("07:00", 5, "button")])
+
+    async def test_notifications(self):
+        alarm = struct.pack("<BBBBI", 0x01, 0x01, 0, 0x04, 1700000000)
+
+        async def first():
+            async for a in self.client.notifications("alarm"):
+                return a
+
+        task = asyncio.create_task(first())
+        while chrs.ALARM.uuid not in self.mock._callbacks:
+            await asyncio.sleep(0.001)
+        self.mock.notify(chrs.ALARM.uuid, alarm)
+        a = await asyncio.wait_for(task, 1)
+        self.assertEqual((a["active"], a["actions"], a["time"]),
+                         (0x01, 0x04, 1700000000))
+        # The subscription outlives the iterator; the control point's
+        # listener shares the dispatch
+        r = await self.client.control(["mode=blank"])
+        self.assertEqual(r["result"], 0)
+
+    async def test_rollup_pages(self):
+        slots = [s async for s in self.client.rollup("hour", 0)]
+        self.assertEqual(slots, [])
+        self.assertEqual(self.mock._rollup[0], codec.ROLLUP_LEVELS["hour"])
+
+    async def test_requests_pipeline(self):
+        self.mock.interval = 0.02
+        n = 8
+        before = self.mock.requests
+        t0 = time.perf_counter()
+        for _ in range(n):
+            await self.client.read(chrs.BATTERY)
+        t1 = time.perf_counter()
+        data = await self.client.read_many([chrs.BATTERY] * n)
+        t2 = time.perf_counter()
+        self.assertEqual(self.mock.requests - before, 2 * n)
+        self.assertEqual(len(set(data)), 1)
+        # one by one costs about two intervals each, together about one
+        self.assertLess(t2 - t1, 0.75 * (t1 - t0))
+
+    async def test_disconnected(self):
+        await self.client.__aexit__(None, None, None)
+        with self.assertRaises(ConnectionError):
+            await self.client.get("battery")
+        await self.client.__aenter__()
+
+
+class CodecTest(unittest.TestCase):
+    def test_mfg(self):
+        data = struct.pack(codec.MFG_FMT, codec.MFG_VERSION, 7, 2150,
+                           10132, 45, 1950)
+        seq, s, alarm = codec.decode_mfg(data)
+        self.assertEqual((seq, alarm), (7, 0))
+        self.assertEqual(s, {"temp_c": 21.5, "press_hpa": 1013.2,
+                             "humidity": 45.0, "batt_mv": 3900})
+        _, s, alarm = codec.decode_mfg(
+            struct.pack(codec.MFG_FMT, codec.MFG_VERSION, 8, -0x8000,
+                        0xFFFF, 0xFF, 0) + b"\x05")
+        self.assertEqual(alarm, 5)
+        self.assertIsNone(s["temp_c"])
+        self.assertIsNone(s["press_hpa"])
+        self.assertIsNone(s["humidity"])
+        self.assertIsNone(codec.decode_mfg(b"\x02" + data[1:]))
+        self.assertIsNone(codec.decode_mfg(data[:-1]))
+
+    def test_coc_frames(self):
+        self.assertEqual(codec.coc_get("trace", 4, 100),
+                         b"\x02\x04\0\0\0\x64\0\0\0trace")
+        streams = bytes([codec.COC_OP_STREAMS, 2, 5]) + b"trace" \
+            + struct.pack("<I", 300) + bytes([4]) + b"logs" \
+            + struct.pack("<I", 0)
+        self.assertEqual(codec.decode_streams(streams),
+                         [("trace", 300), ("logs", 0)])
+        self.assertEqual(codec.decode_begin(b"\x82\x00\x10\0\0\0"), (0, 16))
+        self.assertEqual(codec.decode_begin(b"\x82\x02"), (2, 0))
+        crc = zlib.crc32(b"abc")
+        end = codec.decode_end(bytes([codec.COC_OP_END]) + struct.pack(
+            codec.COC_END_FMT, 0, 3, crc, 12, 24, 2, 2))
+        self.assertEqual((end["sent"], end["crc"], end["itvl"]),
+                         (3, crc, 24))
+        self.assertEqual(codec.coc_status(2), "unknown stream")
+        self.assertEqual(codec.coc_status(99), "99")
+
+    def test_trace_lines(self):
+        recs = [struct.pack(codec.TRACE_HDR_FMT, 1, 2, 100) + b"xy",
+                struct.pack(codec.TRACE_HDR_FMT, 2, 0, 200)]
+        lines = list(codec.trace_lines(b"".join(recs) + b"\x01"))
+        self.assertEqual([base64.b64decode(ln[3:]) for ln in lines], recs)
+
+    def test_ota(self):
+        begin = codec.ota_begin(1000, bytes(32), 16)
+        self.assertEqual(len(begin), struct.calcsize(codec.OTA_BEGIN_FMT))
+        self.assertEqual(codec.ota_data(512, b"ab"), b"\0\x02\0\0ab")
+        r = codec.decode_ota(struct.pack(codec.OTA_RSP_FMT, codec.OTA_OP_RSP,
+                                         codec.OTA_OP_BEGIN, 0, 4096))
+        self.assertEqual((r["req"], r["status"], r["offset"]),
+                         (codec.OTA_OP_BEGIN, 0, 4096))
+        r = codec.decode_ota(bytes([codec.OTA_OP_NAK]) + b"\0\x01\0\0")
+        self.assertEqual(r["offset"], 256)
+
+    def test_tz(self):
+        self.assertEqual(codec.parse_tz("+5:45"), 23)
+        self.assertEqual(codec.parse_tz("-0:30"), -2)
+        self.assertEqual(codec.format_tz(-18), "UTC-4:30")
+        with self.assertRaises(ValueError):
+            codec.parse_tz("+5:10")
+
+
+if __name__ == "__main__":
+    unittest.main()
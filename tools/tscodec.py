@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Decode blocks written by the time-series codec in main/tscodec.c.
+
+The format is described in main/tscodec.h.  A schema string gives the kind
+of each column: "t" delta-of-delta time, "i" zig-zag varint integer,
+"f" Gorilla XOR float.  Blocks have a fixed size, so any one of them can be
+decoded on its own.
+
+Usage:
+    python tscodec.py blocks.tsc --schema tiiii            # CSV to stdout
+    python tscodec.py blocks.tsc --schema tifff --block 512
+    python tscodec.py blocks.tsc --schema tiiii --index 3  # one block
+
+As a module:
+    from tscodec import decode_block, decode_stream
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+HDR = struct.Struct("<HHI")
+DOD_WIDTH = (7, 9, 12, 32)
+
+
+class CodecError(ValueError):
+    pass
+
+
+class BitReader:
+    def __init__(self, data):
+        self.value = int.from_bytes(data, "big")
+        self.left = len(data) * 8
+
+    def get(self, n):
+        if n > self.left:
+            raise CodecError("truncated block")
+        self.left -= n
+        return (self.value >> self.left) & ((1 << n) - 1)
+
+
+def _unzigzag(z):
+    return (z >> 1) ^ -(z & 1)
+
+
+def _varint(r):
+    v = 0
+    for shift in range(0, 35, 7):
+        b = r.get(8)
+        v |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return v
+    raise CodecError("varint too long")
+
+
+def _dod(r):
+    if r.get(1) == 0:
+        return 0
+    ones = 0
+    while ones < 3 and r.get(1):
+        ones += 1
+    return _unzigzag(r.get(DOD_WIDTH[ones]))
+
+
+def decode_block(block, schema):
+    """Return the samples of one block as lists of unsigned 32-bit values."""
+    count, used, crc = HDR.unpack_from(block)
+    payload = block[HDR.size:HDR.size + used]
+    if len(payload) != used or \
+            zlib.crc32(payload, zlib.crc32(block[:4])) != crc:
+        raise CodecError("checksum mismatch")
+
+    r = BitReader(payload)
+    n = len(schema)
+    delta = [0] * n
+    lead = [0] * n
+    trail = [0] * n
+    rows = []
+    prev = None
+    for i in range(count):
+        if i == 0:
+            row = [r.get(32) for _ in range(n)]
+        else:
+            row = []
+            for c, kind in enumerate(schema):
+                if kind == "t":
+                    delta[c] = (delta[c] + _dod(r)) & 0xFFFFFFFF
+                    v = prev[c] + delta[c]
+                elif kind == "i":
+                    v = prev[c] + _unzigzag(_varint(r))
+                elif kind == "f":
+                    if r.get(1) == 0:
+                        v = prev[c]
+                    elif r.get(1) == 0:
+                        v = prev[c] ^ (r.get(32 - lead[c] - trail[c])
+                                       << trail[c])
+                    else:
+                        lead[c] = r.get(5)
+                        width = r.get(5) + 1
+                        if lead[c] + width > 32:
+                            raise CodecError("bad XOR window")
+                        trail[c] = 32 - lead[c] - width
+                        v = prev[c] ^ (r.get(width) << trail[c])
+                else:
+                    raise CodecError(f"unknown column kind {kind!r}")
+                row.append(v & 0xFFFFFFFF)
+        rows.append(row)
+        prev = row
+    return rows
+
+
+def decode_stream(data, schema, block_size=256):
+    """Yield the samples of every block in a stream."""
+    for off in range(0, len(data) - block_size + 1, block_size):
+        yield from decode_block(data[off:off + block_size], schema)
+
+
+def to_python(row, schema):
+    """Unsigned column values to int (signed) or float."""
+    out = []
+    for v, kind in zip(row, schema):
+        if kind == "f":
+            out.append(struct.unpack("<f", struct.pack("<I", v))[0])
+        elif kind == "i":
+            out.append(v - (1 << 32) if v & 0x80000000 else v)
+        else:
+            out.append(v)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Time-series block decoder")
+    parser.add_argument("file", help="blocks written by tsc_bench -o or "
+                                     "read from the device")
+    parser.add_argument("--schema", required=True,
+                        help="column kinds, e.g. tiiii or tifff")
+    parser.add_argument("--block", type=int, default=256,
+                        help="block size in bytes (default 256)")
+    parser.add_argument("--index", type=int,
+                        help="decode only this block")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    try:
+        if args.index is not None:
+            off = args.index * args.block
+            rows = decode_block(data[off:off + args.block], args.schema)
+        else:
+            rows = decode_stream(data, args.schema, args.block)
+        for row in rows:
+            print(",".join(f"{v:.6g}" if isinstance(v, float) else str(v)
+                           for v in to_python(row, args.schema)))
+    except CodecError as e:
+        print(f"tscodec: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()